@@ -69,9 +69,12 @@ typedef enum
     ENCOUNTER_ERR_OVERFLOW,
     /**< Overflow detected while processing data. */
 
-    ENCOUNTER_ERR_IMPL
+    ENCOUNTER_ERR_IMPL,
     /**< Hit an implementation limit. */
 
+    ENCOUNTER_ERR_CANCELED
+    /**< Canceled by the progress callback of a key generation. */
+
 } encounter_err_t;
 
 
@@ -93,6 +96,17 @@ typedef enum {
 	EC_KEYTYPE_NONE,		/* No key-type code */
         EC_KEYTYPE_PAILLIER_PUBLIC,	/* Paillier public-key */
         EC_KEYTYPE_PAILLIER_PRIVATE,	/* Paillier private-key */
+	EC_KEYTYPE_PAILLIER_NPLUS1_PUBLIC, /* Paillier public-key, g = n+1 */
+	EC_KEYTYPE_DAMGARD_JURIK_PUBLIC,  /* Damgard-Jurik public-key */
+	EC_KEYTYPE_DAMGARD_JURIK_PRIVATE, /* Damgard-Jurik private-key */
+	EC_KEYTYPE_ECELGAMAL_PUBLIC,	/* EC-ElGamal public-key, P-256 */
+	EC_KEYTYPE_ECELGAMAL_PRIVATE,	/* EC-ElGamal private-key, P-256 */
+	EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC,  /* Okamoto-Uchiyama public-key */
+	EC_KEYTYPE_OKAMOTO_UCHIYAMA_PRIVATE, /* Okamoto-Uchiyama private-key */
+	EC_KEYTYPE_PAILLIER_SUBGROUP_PUBLIC,  /* Paillier public-key, g of
+						 order alpha n (Scheme 3) */
+	EC_KEYTYPE_PAILLIER_SUBGROUP_PRIVATE, /* Paillier private-key, short
+						 decryption exponent */
 	EC_KEYTYPE_LAST			/* Last possible key-type code */
 } encounter_key_t;
 
@@ -106,6 +120,134 @@ typedef enum {
 } encounter_keyset_t;
 
 
+/** What to do when a pool of precomputed randomizers runs dry */
+typedef enum {
+	EC_POOL_DRY_INLINE,		/* Compute the randomizer inline */
+	EC_POOL_DRY_WAIT		/* Wait for the refill threads */
+} encounter_pool_dry_t;
+
+
+/** Arithmetic backend of the modular exponentiations */
+typedef enum {
+	EC_BACKEND_OPENSSL,		/* OpenSSL BIGNUMs, the default */
+	EC_BACKEND_GMP			/* GMP, libraries built with USE_GMP */
+} encounter_backend_t;
+
+
+/** Steps of a key generation reported to its progress callback */
+typedef enum {
+	EC_KEYGEN_CANDIDATE,		/* A prime candidate passed the sieve */
+	EC_KEYGEN_PRIME,		/* A prime was found */
+	EC_KEYGEN_GENERATOR		/* A generator candidate was drawn */
+} encounter_keygen_step_t;
+
+/** Progress callback of the key generations: the opaque argument of the
+  * configuration, the step, and the prime it concerns, 0 for p, 1 for q.
+  * The primes of a keypair are worked concurrently, so the calls come
+  * from several threads, though never two at a time. A non-zero return
+  * cancels the generation, which fails with ENCOUNTER_ERR_CANCELED */
+typedef int (*encounter_progress_cb_t)(void *, \
+			const encounter_keygen_step_t, const unsigned int);
+
+
+/** Largest window accepted for the fixed-base randomizer table */
+#define ENCOUNTER_FIXED_BASE_WINDOW_MAX	8
+
+/** Largest Damgard-Jurik degree: counters modulo n^(s+1), s <= this */
+#define ENCOUNTER_DJ_DEGREE_MAX		16
+
+/** Guard bits above each slot of a packed counter: room for the carries
+  * of 2^16 full-width additions */
+#define ENCOUNTER_PACKED_GUARD_BITS	16
+
+/** EC-ElGamal keys live on P-256, the only size encounter_keygen() takes
+  * for them */
+#define ENCOUNTER_ECELGAMAL_KEYSIZE	256
+
+/** EC-ElGamal counters decrypt by a search of 2^bits baby steps and as
+  * many giant steps: their plaintexts range over 0 .. 2^(2 bits) - 1 */
+#define ENCOUNTER_ECELGAMAL_TABLE_BITS	16
+
+/** Key sizes the keypair pool of a context may hold */
+#define ENCOUNTER_KEYPOOL_SIZES		4
+
+
+/** Encounter runtime configuration.
+  * A zeroed structure selects the defaults used by encounter_init() */
+typedef struct encounter_conf_s {
+	/* Precomputed r^n mod n^2 kept ready for each public-key,
+	 * 0 disables the randomizer pool */
+	unsigned int		pool_depth;
+
+	/* Precomputed encryptions of 1 kept ready for each public-key,
+	 * serving encounter_inc(..., 1). 0 disables them */
+	unsigned int		pool_ones;
+
+	/* Background threads refilling the pools of each public-key,
+	 * 0 means one */
+	unsigned int		pool_threads;
+
+	/* Behaviour when a pool runs dry */
+	encounter_pool_dry_t	pool_dry;
+
+	/* Randomize with h^alpha, for a fixed h = x^n and a short alpha,
+	 * instead of r^n. A table of about (512 / w) (2^w - 1) powers of h
+	 * is kept for each public-key, w being this window in bits. Each
+	 * randomizer then costs 512 / w products. 0 selects r^n */
+	unsigned int		fixed_base_window;
+
+	/* Keep counters in Montgomery form modulo n^2 from their first
+	 * update on, leaving it only to be serialized or decrypted */
+	bool			mont_counters;
+
+	/* Threads working each batch call, the caller's included.
+	 * 0 means one per online processor */
+	unsigned int		batch_threads;
+
+	/* Pathname of the baby-step table of the EC-ElGamal decryptions,
+	 * read if present and written once built, kept by reference.
+	 * NULL keeps the table in memory only */
+	const char		*ecelgamal_table;
+
+	/* Backend of the modular exponentiations of the Paillier family
+	 * of keys, Damgard-Jurik and subgroup ones included, and of the
+	 * Okamoto-Uchiyama keys. The products of the fixed-base tables
+	 * and of the Montgomery-resident counters stay on OpenSSL, as does
+	 * the EC-ElGamal point arithmetic. Keys, counters and their
+	 * serialized forms are the same whatever the backend, and move
+	 * freely between contexts. EC_BACKEND_GMP fails with
+	 * ENCOUNTER_ERR_IMPL unless the library was built with USE_GMP */
+	encounter_backend_t	backend;
+
+	/* Keep the OpenSSL backend to its portable Montgomery arithmetic,
+	 * leaving out the AVX-512 IFMA kernels it otherwise selects at
+	 * runtime for the moduli of 1536 bits and more, the multi-buffer
+	 * ones of the pool refills and batch decryptions included.
+	 * For comparisons */
+	bool			portable_kernels;
+
+	/* Progress callback of the key generations, and its argument.
+	 * NULL reports nothing and never cancels */
+	encounter_progress_cb_t	keygen_progress;
+	void			*keygen_arg;
+
+	/* Paillier keypairs kept ready for encounter_keygen_pooled(), for
+	 * each size of keypool_sizes, by a background thread of low
+	 * priority. 0 disables the keypair pool */
+	unsigned int		keypool_depth;
+
+	/* Key sizes of the keypair pool, a 0 ends the list early */
+	unsigned int		keypool_sizes[ENCOUNTER_KEYPOOL_SIZES];
+
+	/* Existing directory the pooled keypairs are spooled to, one pair
+	 * of plaintext keyset files each, readable by the owner only.
+	 * The next contexts on the directory take them up. Kept by
+	 * reference, NULL keeps the keypairs in memory only */
+	const char		*keypool_dir;
+
+} encounter_conf_t;
+
+
 
 /* __BEGIN_DECLS should be used at the beginning of your declarations,
    so that C++ compilers don't mangle their names.  Use __END_DECLS at
@@ -245,26 +387,93 @@ EC_CHECK_RETVAL EC_NONNULL_ARG( (2) ) \
 ENCOUNTER_RET encounter_init __P((\
                         const unsigned int, encounter_t EC_PTR EC_PTR));
 
+/** Create a new Encounter context tuned by the supplied configuration.
+  * A NULL configuration is the same as calling encounter_init() */
+EC_CHECK_RETVAL EC_NONNULL_ARG( (3) ) \
+ENCOUNTER_RET encounter_init_conf __P((const unsigned int, \
+      const encounter_conf_t EC_PTR, encounter_t EC_PTR EC_PTR));
+
 /** Return last errno */
 EC_CHECK_RETVAL EC_NONNULL_ARG( (1) ) \
 ENCOUNTER_RET encounter_error __P((encounter_t EC_PTR));
 
 /** Generate a keypair according to the scheme and size selected 
- * respectively by the second and third parametes */
+ * respectively by the second and third parametes. The EC-ElGamal keys
+ * are ENCOUNTER_ECELGAMAL_KEYSIZE bits; their counters take the same
+ * calls as the Paillier ones, but the packed counters and
+ * encounter_decrypt_bytes(). The Okamoto-Uchiyama keys of a given size
+ * have an n = p^2 q as wide as the Paillier ones; their counters are
+ * half the size, for plaintexts below p, and are never packed. The
+ * Paillier subgroup keys take a g of order alpha n for a small alpha:
+ * their counters are Paillier ones, but decrypt with the exponent alpha
+ * in place of p-1 and q-1 and are randomized by short exponents.
+ * The primes p and q, and the halves of a Paillier g, are searched
+ * concurrently on up to two batch_threads workers; keygen_progress of
+ * the configuration follows the search and may cancel it */
 EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 4, 5) ) \
 ENCOUNTER_RET encounter_keygen __P((encounter_t EC_PTR, encounter_key_t, \
 	unsigned int, ec_keyctx_t EC_PTR EC_PTR, ec_keyctx_t EC_PTR EC_PTR));
 
+/** Generate a keypair as encounter_keygen(), taking a ready one from the
+  * keypair pool of the context when the pool holds Paillier keypairs of
+  * the size asked for, and asking the pool for a replacement. A keypair
+  * spooled to keypool_dir is removed from the directory before it is
+  * returned. Generates the keypair inline when the pool is disabled,
+  * runs dry, or does not hold the type or size */
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 4, 5) ) \
+ENCOUNTER_RET encounter_keygen_pooled __P((encounter_t EC_PTR, \
+	encounter_key_t, unsigned int, ec_keyctx_t EC_PTR EC_PTR, \
+					ec_keyctx_t EC_PTR EC_PTR));
+
+/** Generate a Damgard-Jurik keypair of the degree s of the second
+  * parameter, up to ENCOUNTER_DJ_DEGREE_MAX: counters modulo n^(s+1) for
+  * plaintexts modulo n^s. Degree 1 is a Paillier keypair with g = n+1.
+  * The counters take the usual operations, not the owner mode */
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 4, 5) ) \
+ENCOUNTER_RET encounter_keygen_dj __P((encounter_t EC_PTR, \
+	const unsigned int, unsigned int, ec_keyctx_t EC_PTR EC_PTR, \
+					ec_keyctx_t EC_PTR EC_PTR));
+
+/** Accepts a key context and returns a new packed cryptographic counter
+  * of the slots of the third parameter, each of the bit width of the
+  * fourth one, at most 64, all zero. A 2048-bit n takes 31 slots of
+  * 48 bits. Packed counters add and subtract slot-wise, and go through
+  * encounter_inc_slot() and encounter_decrypt_packed(); the scalar
+  * updates, encounter_inc() and the like, refuse them */
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 5) ) \
+ENCOUNTER_RET encounter_new_packed_counter __P((encounter_t EC_PTR, \
+	ec_keyctx_t EC_PTR, const unsigned int, const unsigned int, \
+					ec_count_t EC_PTR EC_PTR));
+
 /** Accepts a key context and returns a new cryptographic cnt handle */
 EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3) ) \
 ENCOUNTER_RET encounter_new_counter __P((encounter_t EC_PTR, \
 			ec_keyctx_t EC_PTR, ec_count_t EC_PTR EC_PTR));
 
+/** Accepts a key context and returns the n new cryptographic counters
+  * of the last parameter at once, counter k holding the initial value k
+  * of the fourth parameter, or 0 when it is NULL. The handles are
+  * allocated in a single block and go back together through
+  * encounter_dispose_counters(). The counters of the Paillier family of
+  * keys are encrypted on the threads selected by the configuration,
+  * their randomizers by runs */
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 5) ) \
+ENCOUNTER_RET encounter_new_counters __P((encounter_t EC_PTR, \
+	ec_keyctx_t EC_PTR, const size_t, const unsigned int EC_PTR, \
+					ec_count_t EC_PTR EC_PTR));
+
 /** Dispose the cryptographic counter referenced by the 2nd parameter */
 EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2) )\
 ENCOUNTER_RET encounter_dispose_counter __P((encounter_t EC_PTR, \
 						ec_count_t EC_PTR));
 
+/** Dispose the n cryptographic counters of encounter_new_counters(), the
+  * array of handles being the one it filled. Some of them may have been
+  * disposed with encounter_dispose_counter() before */
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2) )\
+ENCOUNTER_RET encounter_dispose_counters __P((encounter_t EC_PTR, \
+				ec_count_t EC_PTR EC_PTR, const size_t));
+
 /** Increment the cryptographic counter by the amount in a,
   * without first decrypting it. */
 EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3) )\
@@ -277,6 +486,20 @@ EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3) )\
 ENCOUNTER_RET encounter_dec __P((encounter_t EC_PTR, \
         ec_keyctx_t EC_PTR, ec_count_t EC_PTR, const unsigned int));
 
+/** Increment the slot of the third parameter of a packed counter by
+  * the last one */
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3) ) \
+ENCOUNTER_RET encounter_inc_slot __P((encounter_t EC_PTR, \
+	ec_keyctx_t EC_PTR, ec_count_t EC_PTR, const unsigned int, \
+					const unsigned long long int));
+
+/** Decrement the slot of the third parameter of a packed counter by
+  * the last one. A slot is not to go below zero */
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3) ) \
+ENCOUNTER_RET encounter_dec_slot __P((encounter_t EC_PTR, \
+	ec_keyctx_t EC_PTR, ec_count_t EC_PTR, const unsigned int, \
+					const unsigned long long int));
+
 /** Touch the crypto counter by probabilistically re-rencrypting it.
   * The plaintext counter is not affected */
 EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3) )\
@@ -301,6 +524,67 @@ EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3 ) )\
 ENCOUNTER_RET encounter_mul __P((encounter_t EC_PTR, \
             ec_keyctx_t EC_PTR, ec_count_t EC_PTR, const unsigned int));
 
+/** Place the weighted sum of n cryptographic counters in out, which may
+  * be one of them, without first decrypting them. A single
+  * re-randomization covers the whole sum. */
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3, 4, 6) )\
+ENCOUNTER_RET encounter_linear_combination __P((encounter_t EC_PTR, \
+	ec_keyctx_t EC_PTR, ec_count_t EC_PTR EC_PTR, \
+	const unsigned int EC_PTR, const size_t, ec_count_t EC_PTR));
+
+/** Sum n cryptographic counters into out, without first decrypting
+  * them, and/or decrypt only the sum into the last argument with the
+  * private-key. Either out or the plaintext may be NULL, not both. */
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3) )\
+ENCOUNTER_RET encounter_sum __P((encounter_t EC_PTR, ec_keyctx_t EC_PTR, \
+	ec_count_t EC_PTR EC_PTR, const size_t, ec_count_t EC_PTR, \
+		ec_keyctx_t EC_PTR, unsigned long long int EC_PTR));
+
+/** Owner mode. The holder of the private-key matching pubK can have
+  * the counters created and updated modulo p^2 and q^2, in a fraction
+  * of the time. The resulting counters are the same as those of the
+  * public-key calls above */
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3, 4) ) \
+ENCOUNTER_RET encounter_new_counter_owner __P((encounter_t EC_PTR, \
+  ec_keyctx_t EC_PTR, ec_keyctx_t EC_PTR, ec_count_t EC_PTR EC_PTR));
+
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3, 4) )\
+ENCOUNTER_RET encounter_inc_owner __P((encounter_t EC_PTR, ec_keyctx_t EC_PTR,\
+	ec_keyctx_t EC_PTR, ec_count_t EC_PTR, const unsigned int));
+
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3, 4) )\
+ENCOUNTER_RET encounter_dec_owner __P((encounter_t EC_PTR, ec_keyctx_t EC_PTR,\
+	ec_keyctx_t EC_PTR, ec_count_t EC_PTR, const unsigned int));
+
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3, 4) )\
+ENCOUNTER_RET encounter_touch_owner __P((encounter_t EC_PTR, \
+	ec_keyctx_t EC_PTR, ec_keyctx_t EC_PTR, ec_count_t EC_PTR));
+
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3, 4, 5) )\
+ENCOUNTER_RET encounter_add_owner __P((encounter_t EC_PTR, ec_keyctx_t EC_PTR,\
+	ec_keyctx_t EC_PTR, ec_count_t EC_PTR, ec_count_t EC_PTR));
+
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3, 4, 5) )\
+ENCOUNTER_RET encounter_sub_owner __P((encounter_t EC_PTR, ec_keyctx_t EC_PTR,\
+	ec_keyctx_t EC_PTR, ec_count_t EC_PTR, ec_count_t EC_PTR));
+
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3, 4) )\
+ENCOUNTER_RET encounter_mul_owner __P((encounter_t EC_PTR, ec_keyctx_t EC_PTR,\
+	ec_keyctx_t EC_PTR, ec_count_t EC_PTR, const unsigned int));
+
+/** Decrement each of the n cryptographic counters by the matching
+  * amount, without first decrypting them. */
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3, 4) )\
+ENCOUNTER_RET encounter_dec_batch __P((encounter_t EC_PTR, ec_keyctx_t EC_PTR,\
+	ec_count_t EC_PTR EC_PTR, const unsigned int EC_PTR, const size_t));
+
+/** Subtract the n cryptographic counters of the second array from the
+  * matching, distinct, ones of the first, with a single modular
+  * inversion for the whole batch. */
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3, 4) )\
+ENCOUNTER_RET encounter_sub_batch __P((encounter_t EC_PTR, ec_keyctx_t EC_PTR,\
+	ec_count_t EC_PTR EC_PTR, ec_count_t EC_PTR EC_PTR, const size_t));
+
 /** Creates a new ec_count_t containing the value 'from' */
 EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3, 4 ) )\
 ENCOUNTER_RET encounter_dup __P((encounter_t EC_PTR, \
@@ -334,6 +618,40 @@ EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3, 4) )\
 ENCOUNTER_RET encounter_decrypt __P((encounter_t EC_PTR, \
  ec_count_t EC_PTR, ec_keyctx_t EC_PTR, unsigned long long int EC_PTR));
 
+/** Decrypt a cryptographic counter whose plaintext is known to be below
+  * 2^64, working modulo p alone at about half the cost. Counters that
+  * may have wrapped below zero or grown past 2^64 want the full-width
+  * encounter_decrypt(), which reports the overflow; a result modulo p
+  * that does not fit 64 bits falls back to it as well */
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3, 4) )\
+ENCOUNTER_RET encounter_decrypt_bounded __P((encounter_t EC_PTR, \
+ ec_count_t EC_PTR, ec_keyctx_t EC_PTR, unsigned long long int EC_PTR));
+
+/** Decrypt the n cryptographic counters in the array of the second
+  * parameter into the n plaintexts of the last one, as encounter_decrypt()
+  * would, on the threads selected by the configuration */
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 4, 5) )\
+ENCOUNTER_RET encounter_decrypt_batch __P((encounter_t EC_PTR, \
+	ec_count_t EC_PTR EC_PTR, const size_t, ec_keyctx_t EC_PTR, \
+					unsigned long long int EC_PTR));
+
+/** Decrypt the cryptographic counter into the big-endian buffer of the
+  * fourth parameter, whose size the last one holds on input and the
+  * plaintext length on output. ENCOUNTER_ERR_OVERFLOW leaves the size
+  * the buffer ought to have */
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3, 4, 5) )\
+ENCOUNTER_RET encounter_decrypt_bytes __P((encounter_t EC_PTR, \
+	ec_count_t EC_PTR, ec_keyctx_t EC_PTR, unsigned char EC_PTR, \
+						size_t EC_PTR));
+
+/** Decrypt all the slots of a packed counter into the array of the
+  * fourth parameter, of the size of the last one. A slot that overflowed
+  * its width, or went below zero, is reported as ENCOUNTER_ERR_OVERFLOW */
+EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2, 3, 4) )\
+ENCOUNTER_RET encounter_decrypt_packed __P((encounter_t EC_PTR, \
+	ec_count_t EC_PTR, ec_keyctx_t EC_PTR, unsigned long long int EC_PTR, \
+							const size_t));
+
 /** Dispose the cryptographic counter referenced by the handle */
 EC_CHECK_RETVAL EC_NONNULL_ARG( (1, 2) )\
 ENCOUNTER_RET encounter_dispose_keyctx __P((encounter_t EC_PTR, \
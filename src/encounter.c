@@ -4,19 +4,41 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 
 #include "encounter_priv.h"
 #include "utils.h"
 
 encounter_err_t encounter_init(const unsigned int maxc, encounter_t **ctx)
+{
+	return encounter_init_conf(maxc, NULL, ctx);
+}
+
+encounter_err_t encounter_init_conf(const unsigned int maxc, \
+			const encounter_conf_t *conf, encounter_t **ctx)
 {
 	encounter_err_t rc;
 	encounter_t *c = NULL;
+	unsigned int i;
 
 	/* Sanity check the supplied paramters */
 	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
 	if (maxc > ENCOUNTER_CONCURRENT_COUNTERS_MAX) 
 			return (ENCOUNTER_ERR_PARAM);
+	if (conf && conf->pool_dry > EC_POOL_DRY_WAIT)
+			return (ENCOUNTER_ERR_PARAM);
+	if (conf && conf->fixed_base_window > ENCOUNTER_FIXED_BASE_WINDOW_MAX)
+			return (ENCOUNTER_ERR_PARAM);
+	if (conf && conf->backend > EC_BACKEND_GMP)
+			return (ENCOUNTER_ERR_PARAM);
+	for (i = 0; conf && conf->keypool_depth \
+		    && i < ENCOUNTER_KEYPOOL_SIZES && conf->keypool_sizes[i]; ++i)
+		__ENCOUNTER_SANITYCHECK_KEYSIZE(conf->keypool_sizes[i], \
+							ENCOUNTER_ERR_PARAM);
+#ifndef USE_GMP
+	if (conf && conf->backend == EC_BACKEND_GMP)
+			return (ENCOUNTER_ERR_IMPL);
+#endif
 
 
 	/* Make room for the context */
@@ -28,6 +50,12 @@ encounter_err_t encounter_init(const unsigned int maxc, encounter_t **ctx)
                    + ((ENCOUNTER_LIB_VER_MINOR)<<8)  \
                    + (ENCOUNTER_LIB_VER_PATCH);
 	c->maxcounters = maxc;
+	if (conf) c->conf = *conf;
+	if (c->conf.pool_threads == 0) c->conf.pool_threads = 1;
+	if (c->conf.batch_threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		c->conf.batch_threads = (cpus > 0 ? (unsigned int) cpus : 1);
+	}
 
 	/* Initialize the crypto toolkit */
 	if (D.init_crypto(c) != ENCOUNTER_OK) {
@@ -40,6 +68,14 @@ encounter_err_t encounter_init(const unsigned int maxc, encounter_t **ctx)
 		rc = ENCOUNTER_ERR_STORE;
 		goto err;
 	}
+
+	/* Start the keypair pool, if any */
+	if (encounter_keypool_start(c) != ENCOUNTER_OK) {
+		rc = c->rc;
+		D.term_store(c);
+		D.term_crypto(c);
+		goto err;
+	}
 	
 	/* Okay, it worked. Setup error reporting. */
 	c->rc = ENCOUNTER_OK;
@@ -74,13 +110,54 @@ encounter_err_t encounter_keygen(encounter_t *ctx, \
 {
 	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
 	__ENCOUNTER_SANITYCHECK_KEYTYPE(type, ENCOUNTER_ERR_PARAM);
-	__ENCOUNTER_SANITYCHECK_KEYSIZE(size, ENCOUNTER_ERR_PARAM);
+	/* The curve sets the size of the EC-ElGamal keys */
+	if (!__ENCOUNTER_IS_ECELGAMAL_KEYTYPE(type))
+		__ENCOUNTER_SANITYCHECK_KEYSIZE(size, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(privK, ENCOUNTER_ERR_PARAM);
+
+	return D.keygen(ctx, type, size, pubK, privK);
+}
+
+/** Generate a keypair, taking it from the keypair pool when it holds
+ * one of the type and size */
+encounter_err_t encounter_keygen_pooled(encounter_t *ctx, \
+		encounter_key_t type, unsigned int size, \
+		ec_keyctx_t **pubK, ec_keyctx_t **privK)
+{
+	bool got = false;
+
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_KEYTYPE(type, ENCOUNTER_ERR_PARAM);
+	if (!__ENCOUNTER_IS_ECELGAMAL_KEYTYPE(type))
+		__ENCOUNTER_SANITYCHECK_KEYSIZE(size, ENCOUNTER_ERR_PARAM);
 	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
 	__ENCOUNTER_SANITYCHECK_MEM(privK, ENCOUNTER_ERR_PARAM);
 
+	/* The pool holds the keypairs of the default Paillier type */
+	if ((type == EC_KEYTYPE_PAILLIER_PUBLIC \
+	     || type == EC_KEYTYPE_PAILLIER_PRIVATE) \
+	    && encounter_keypool_get(ctx, size, pubK, privK, &got) \
+							!= ENCOUNTER_OK)
+		return ctx->rc;
+	if (got) return ctx->rc;
+
 	return D.keygen(ctx, type, size, pubK, privK);
 }
 
+/** Generate a Damgard-Jurik keypair of degree s */
+encounter_err_t encounter_keygen_dj(encounter_t *ctx, \
+		const unsigned int s, unsigned int size, \
+		ec_keyctx_t **pubK, ec_keyctx_t **privK)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_KEYSIZE(size, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(privK, ENCOUNTER_ERR_PARAM);
+
+	return D.keygen_dj(ctx, s, size, pubK, privK);
+}
+
 /** Accepts a key context and returns a new cryptographic counter handle */
 encounter_err_t encounter_new_counter(encounter_t *ctx, \
 			ec_keyctx_t *pubK, ec_count_t **encount)
@@ -89,10 +166,35 @@ encounter_err_t encounter_new_counter(encounter_t *ctx, \
 	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
 	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
 
-	return D.new_counter(ctx, pubK, encount);
+	return D.new_counter(ctx, pubK, NULL, encount);
 
 }
 
+/** Accepts a key context and returns a new packed counter handle */
+encounter_err_t encounter_new_packed_counter(encounter_t *ctx, \
+	ec_keyctx_t *pubK, const unsigned int slots, \
+		const unsigned int width, ec_count_t **encount)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
+
+	return D.new_packed(ctx, pubK, slots, width, encount);
+}
+
+/** Create n counters of the supplied key at once, from their initial
+ * values */
+encounter_err_t encounter_new_counters(encounter_t *ctx, \
+	ec_keyctx_t *pubK, const size_t n, const unsigned int *initial, \
+						ec_count_t **encount)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
+
+	return D.new_counters(ctx, pubK, n, initial, encount);
+}
+
 /** Dispose the cryptographic counter referenced by the 2nd parameter */
 encounter_err_t encounter_dispose_counter(encounter_t *ctx, \
 						ec_count_t *encount)
@@ -103,6 +205,16 @@ encounter_err_t encounter_dispose_counter(encounter_t *ctx, \
 	return D.dispose_counter(ctx, encount);
 }
 
+/** Dispose the n counters created at once by encounter_new_counters() */
+encounter_err_t encounter_dispose_counters(encounter_t *ctx, \
+			ec_count_t **encount, const size_t n)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
+
+	return D.dispose_counters(ctx, encount, n);
+}
+
 /** Increment the cryptographic counter by the amount in a,
   * without first decrypting it. */
 encounter_err_t encounter_inc(encounter_t *ctx, ec_keyctx_t *pubK, \
@@ -112,7 +224,7 @@ encounter_err_t encounter_inc(encounter_t *ctx, ec_keyctx_t *pubK, \
 	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
 	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
 
-	return D.inc(ctx, encount, pubK, a);
+	return D.inc(ctx, encount, pubK, NULL, a);
 }
 
 /** Decrement the cryptographic counter by the amount in a,
@@ -124,7 +236,31 @@ encounter_err_t encounter_dec(encounter_t *ctx, ec_keyctx_t *pubK, \
 	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
 	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
 
-	return D.dec(ctx, encount, pubK, a);
+	return D.dec(ctx, encount, pubK, NULL, a);
+}
+
+/** Increment one slot of a packed counter */
+encounter_err_t encounter_inc_slot(encounter_t *ctx, ec_keyctx_t *pubK, \
+	ec_count_t *encount, const unsigned int slot, \
+				const unsigned long long int a)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
+
+	return D.inc_slot(ctx, encount, pubK, slot, a);
+}
+
+/** Decrement one slot of a packed counter */
+encounter_err_t encounter_dec_slot(encounter_t *ctx, ec_keyctx_t *pubK, \
+	ec_count_t *encount, const unsigned int slot, \
+				const unsigned long long int a)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
+
+	return D.dec_slot(ctx, encount, pubK, slot, a);
 }
 
 /** Touch the crypto counter by probabilistically re-rencrypting it.
@@ -136,7 +272,7 @@ encounter_err_t encounter_touch(encounter_t *ctx, ec_keyctx_t *pubK, \
 	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
 	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
 
-	return D.touch(ctx, encount, pubK);
+	return D.touch(ctx, encount, pubK, NULL);
 }
 
 /** Adds two cryptographic counters placing the result in the first one
@@ -149,7 +285,7 @@ encounter_err_t encounter_add(encounter_t *ctx, ec_keyctx_t *pubK, \
 	__ENCOUNTER_SANITYCHECK_MEM(encountA, ENCOUNTER_ERR_PARAM);
 	__ENCOUNTER_SANITYCHECK_MEM(encountB, ENCOUNTER_ERR_PARAM);
 
-	return D.add(ctx, encountA, encountB, pubK );
+	return D.add(ctx, encountA, encountB, pubK, NULL);
 }
 
 /** Subtracts two cryptographic counters placing the result in the 
@@ -162,7 +298,7 @@ encounter_err_t encounter_sub(encounter_t *ctx, ec_keyctx_t *pubK, \
 	__ENCOUNTER_SANITYCHECK_MEM(encountA, ENCOUNTER_ERR_PARAM);
 	__ENCOUNTER_SANITYCHECK_MEM(encountB, ENCOUNTER_ERR_PARAM);
 
-	return D.sub(ctx, encountA, encountB, pubK );
+	return D.sub(ctx, encountA, encountB, pubK, NULL);
 }
 
 /** Multiply a cryptographic counter by the quantity given in a
@@ -174,7 +310,146 @@ encounter_err_t encounter_mul(encounter_t *ctx, ec_keyctx_t *pubK, \
 	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
 	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
 
-	return D.mul(ctx, encount, pubK, a);
+	return D.mul(ctx, encount, pubK, NULL, a);
+}
+
+/** out = sum of w[i] times encount[i], the n counters left untouched,
+  * without first decrypting them. out may be one of the counters */
+encounter_err_t encounter_linear_combination(encounter_t *ctx, \
+	ec_keyctx_t *pubK, ec_count_t **encount, const unsigned int *w, \
+				const size_t n, ec_count_t *out)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(w, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(out, ENCOUNTER_ERR_PARAM);
+
+	return D.linear_combination(ctx, encount, w, n, pubK, out);
+}
+
+/** Sum n cryptographic counters into out, and/or decrypt the sum only
+  * into c when privK is given. Either of out and c may be NULL */
+encounter_err_t encounter_sum(encounter_t *ctx, ec_keyctx_t *pubK, \
+	ec_count_t **encount, const size_t n, ec_count_t *out, \
+		ec_keyctx_t *privK, unsigned long long int *c)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
+
+	return D.sum(ctx, encount, n, pubK, out, privK, c);
+}
+
+/** Owner mode: encounter_new_counter() with the matching private-key,
+  * which moves the work modulo p^2 and q^2 */
+encounter_err_t encounter_new_counter_owner(encounter_t *ctx, \
+	ec_keyctx_t *pubK, ec_keyctx_t *privK, ec_count_t **encount)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(privK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
+
+	return D.new_counter(ctx, pubK, privK, encount);
+}
+
+/** Owner mode encounter_inc() */
+encounter_err_t encounter_inc_owner(encounter_t *ctx, ec_keyctx_t *pubK, \
+	ec_keyctx_t *privK, ec_count_t *encount, const unsigned int a)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(privK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
+
+	return D.inc(ctx, encount, pubK, privK, a);
+}
+
+/** Owner mode encounter_dec() */
+encounter_err_t encounter_dec_owner(encounter_t *ctx, ec_keyctx_t *pubK, \
+	ec_keyctx_t *privK, ec_count_t *encount, const unsigned int a)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(privK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
+
+	return D.dec(ctx, encount, pubK, privK, a);
+}
+
+/** Owner mode encounter_touch() */
+encounter_err_t encounter_touch_owner(encounter_t *ctx, ec_keyctx_t *pubK, \
+				ec_keyctx_t *privK, ec_count_t *encount)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(privK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
+
+	return D.touch(ctx, encount, pubK, privK);
+}
+
+/** Owner mode encounter_add() */
+encounter_err_t encounter_add_owner(encounter_t *ctx, ec_keyctx_t *pubK, \
+  ec_keyctx_t *privK, ec_count_t *encountA, ec_count_t *encountB)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(privK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encountA, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encountB, ENCOUNTER_ERR_PARAM);
+
+	return D.add(ctx, encountA, encountB, pubK, privK);
+}
+
+/** Owner mode encounter_sub() */
+encounter_err_t encounter_sub_owner(encounter_t *ctx, ec_keyctx_t *pubK, \
+  ec_keyctx_t *privK, ec_count_t *encountA, ec_count_t *encountB)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(privK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encountA, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encountB, ENCOUNTER_ERR_PARAM);
+
+	return D.sub(ctx, encountA, encountB, pubK, privK);
+}
+
+/** Decrement each of the n counters by the matching amount in a */
+encounter_err_t encounter_dec_batch(encounter_t *ctx, ec_keyctx_t *pubK, \
+	ec_count_t **encount, const unsigned int *a, const size_t n)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(a, ENCOUNTER_ERR_PARAM);
+
+	return D.dec_batch(ctx, encount, a, n, pubK);
+}
+
+/** Subtract encountB[i] from encountA[i] for each of the n pairs */
+encounter_err_t encounter_sub_batch(encounter_t *ctx, ec_keyctx_t *pubK, \
+	ec_count_t **encountA, ec_count_t **encountB, const size_t n)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encountA, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encountB, ENCOUNTER_ERR_PARAM);
+
+	return D.sub_batch(ctx, encountA, encountB, n, pubK);
+}
+
+/** Owner mode encounter_mul() */
+encounter_err_t encounter_mul_owner(encounter_t *ctx, ec_keyctx_t *pubK, \
+	ec_keyctx_t *privK, ec_count_t *encount, const unsigned int a)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(pubK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(privK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
+
+	return D.mul(ctx, encount, pubK, privK, a);
 }
 
 /** Creates a new ec_count_t containing the value 'from' */
@@ -248,6 +523,59 @@ encounter_err_t encounter_decrypt(encounter_t *ctx, \
 	return	D.decrypt(ctx, encount, privK, c);
 }
 
+/** Decrypt a cryptographic counter known to hold less than 2^64, at
+  * about half the cost of encounter_decrypt() */
+encounter_err_t encounter_decrypt_bounded(encounter_t *ctx, \
+    ec_count_t *encount, ec_keyctx_t *privK, unsigned long long int *c)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(privK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(c, ENCOUNTER_ERR_PARAM);
+
+	return	D.decrypt_bounded(ctx, encount, privK, c);
+}
+
+/** Decrypt n cryptographic counters at once, in parallel */
+encounter_err_t encounter_decrypt_batch(encounter_t *ctx, \
+	ec_count_t **encount, const size_t n, ec_keyctx_t *privK, \
+					unsigned long long int *c)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(privK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(c, ENCOUNTER_ERR_PARAM);
+
+	return	D.decrypt_batch(ctx, encount, n, privK, c);
+}
+
+/** Decrypt the counter into a big-endian byte string */
+encounter_err_t encounter_decrypt_bytes(encounter_t *ctx, \
+	ec_count_t *encount, ec_keyctx_t *privK, unsigned char *buf, \
+								size_t *len)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(privK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(buf, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(len, ENCOUNTER_ERR_PARAM);
+
+	return	D.decrypt_bytes(ctx, encount, privK, buf, len);
+}
+
+/** Decrypt every slot of a packed counter */
+encounter_err_t encounter_decrypt_packed(encounter_t *ctx, \
+	ec_count_t *encount, ec_keyctx_t *privK, unsigned long long int *c, \
+							const size_t n)
+{
+	__ENCOUNTER_SANITYCHECK_MEM(ctx, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(encount, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(privK, ENCOUNTER_ERR_PARAM);
+	__ENCOUNTER_SANITYCHECK_MEM(c, ENCOUNTER_ERR_PARAM);
+
+	return	D.decrypt_packed(ctx, encount, privK, c, n);
+}
+
 /** Dispose the cryptographic counter referenced by the handle */
 encounter_err_t encounter_dispose_keyctx(encounter_t *ctx, \
 						ec_keyctx_t *keyctx)
@@ -368,6 +696,7 @@ encounter_err_t encounter_dispose_keyset(encounter_t *ctx, \
 void encounter_term(encounter_t *ctx)
 {
 	if (ctx) {
+		encounter_keypool_stop(ctx);
 		D.term_store(ctx);
 		D.term_crypto(ctx);
 		(void) memset(ctx, 0, sizeof *ctx);
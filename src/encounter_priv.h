@@ -23,6 +23,12 @@ struct encounter_s
 	encounter_err_t rc;
 	char estr[256];
 
+	/* Runtime configuration */
+	encounter_conf_t conf;
+
+	/* Ready keypairs, NULL unless configured */
+	struct ec_keypool_s *keypool;
+
 #ifdef USE_OPENSSL
 	BIGNUM *m;
 #endif
@@ -33,6 +39,12 @@ typedef enum {
 	ENCOUNTER_COUNT_NONE,
 	/* Paillier cryptographic counter */
 	ENCOUNTER_COUNT_PAILLIER_V1,
+	/* Damgard-Jurik cryptographic counter, modulo n^(s+1) */
+	ENCOUNTER_COUNT_DAMGARD_JURIK_V1,
+	/* EC-ElGamal cryptographic counter, (rG, mG + rH) on P-256 */
+	ENCOUNTER_COUNT_ECELGAMAL_V1,
+	/* Okamoto-Uchiyama cryptographic counter, modulo n = p^2 q */
+	ENCOUNTER_COUNT_OKAMOTO_UCHIYAMA_V1,
 	ENCOUNTER_COUNT_LAST
 
 } encounter_count_t;
@@ -46,8 +58,14 @@ struct paillier_publickey_str {
         char  *n;		/* modulus */
         char  *g;		/* generator */
         char  *nsquared;	/* modulus squared */
+        char  *s;		/* Damgard-Jurik degree, decimal */
+        char  *alphabits;	/* Subgroup keys: bits of alpha, decimal */
 };
 
+/* Plaintext keysets open Paillier keys with g = n+1 with this tag and n,
+ * g and n^2 derive from it */
+#define ENCOUNTER_NPLUS1_KEYTAG		"nplus1:"
+
 /* Paillier Private-Key */
 struct paillier_privatekey_str {
         char *p, *q, *psquared, *qsquared;	/* primes and their squares */
@@ -56,8 +74,47 @@ struct paillier_privatekey_str {
         char *hsubp;				/* h_p */
         char *hsubq;				/* h_q */
         char *qInv;				/* q^-1 */
+        char *s;				/* Damgard-Jurik degree */
+        char *alpha;				/* Subgroup keys: alpha */
+};
+
+/* EC-ElGamal Public-Key */
+struct ecelgamal_publickey_str {
+        char  *curve;		/* curve name */
+        char  *h;		/* h = xG, compressed */
+};
+
+/* EC-ElGamal Private-Key */
+struct ecelgamal_privatekey_str {
+        char  *curve;		/* curve name */
+        char  *x;		/* secret scalar */
+};
+
+/* Plaintext keysets close Paillier subgroup keys with this tag and their
+ * extra parameter, see encounter_crypto_openssl_subgroup_extend() */
+#define ENCOUNTER_SUBGROUP_KEYTAG	"subgroup:"
+
+/* Plaintext keysets open EC-ElGamal keys with this tag and the curve */
+#define ENCOUNTER_ECELGAMAL_KEYTAG	"ecelgamal:"
+
+/* Okamoto-Uchiyama Public-Key */
+struct ou_publickey_str {
+        char  *n;		/* n = p^2 q */
+        char  *g;
+        char  *h;		/* h = g^n mod n */
+};
+
+/* Okamoto-Uchiyama Private-Key, the rest derives from p */
+struct ou_privatekey_str {
+        char  *p;
+        char  *q;
+        char  *g;
 };
 
+/* Plaintext keysets open Okamoto-Uchiyama keys with this tag, then n
+ * or p on the same line */
+#define ENCOUNTER_OU_KEYTAG		"ou:"
+
 /* Encounter Key Context */
 struct ec_keystring_s {
         encounter_key_t type;	
@@ -65,6 +122,10 @@ struct ec_keystring_s {
         union ec_key_str_u {
                 struct paillier_publickey_str      paillier_pubK;
                 struct paillier_privatekey_str     paillier_privK;
+                struct ecelgamal_publickey_str     ecelgamal_pubK;
+                struct ecelgamal_privatekey_str    ecelgamal_privK;
+                struct ou_publickey_str            ou_pubK;
+                struct ou_privatekey_str           ou_privK;
         }k;
 };
 
@@ -82,6 +143,13 @@ struct ec_keyset_s {
 
 #ifdef USE_OPENSSL
 # include "openssl_drv.h"
+# include "openssl_dj.h"
+# include "openssl_ecelgamal.h"
+# include "openssl_ou.h"
+# include "openssl_subgroup.h"
+# ifdef USE_GMP
+#  include "openssl_gmp.h"
+# endif
 #endif
 
 #ifdef USE_PLAINSTORE
@@ -89,6 +157,7 @@ struct ec_keyset_s {
 #endif
 
 #include "keyset.h"
+#include "keypool.h"
 
 
 /** Encounter limits and constants */
@@ -105,35 +174,78 @@ static struct
 	     encounter_key_t type, unsigned int keysize, \
 	     ec_keyctx_t **pubK, ec_keyctx_t **privK);
 
+	encounter_err_t (*keygen_dj)  (encounter_t *ctx, \
+	     const unsigned int s, unsigned int keysize, \
+	     ec_keyctx_t **pubK, ec_keyctx_t **privK);
+
 	encounter_err_t (*new_counter)(encounter_t *ctx, \
-	     ec_keyctx_t *keyctx, ec_count_t **encount);
+	     ec_keyctx_t *keyctx, ec_keyctx_t *privK, ec_count_t **encount);
+
+	encounter_err_t (*new_packed)(encounter_t *ctx, \
+	     ec_keyctx_t *keyctx, const unsigned int slots, \
+	     const unsigned int width, ec_count_t **encount);
+
+	encounter_err_t (*new_counters)(encounter_t *ctx, \
+	     ec_keyctx_t *keyctx, const size_t n, const unsigned int *, \
+						ec_count_t **encount);
 
 	encounter_err_t (*dispose_counter)(encounter_t *ctx, \
 				ec_count_t *encount);
 
+	encounter_err_t (*dispose_counters)(encounter_t *ctx, \
+			ec_count_t **encount, const size_t n);
+
+	/* The homomorphic ops take an optional private-key, the owner's */
 	encounter_err_t (*inc)        (encounter_t *ctx, \
-	  ec_count_t *encount, ec_keyctx_t *keyctx, const unsigned int);
+	  ec_count_t *encount, ec_keyctx_t *keyctx, ec_keyctx_t *privK, \
+						const unsigned int);
 
 	encounter_err_t (*dec)        (encounter_t *ctx, \
-	  ec_count_t *encount, ec_keyctx_t *keyctx, const unsigned int);
+	  ec_count_t *encount, ec_keyctx_t *keyctx, ec_keyctx_t *privK, \
+						const unsigned int);
+
+	encounter_err_t (*inc_slot)   (encounter_t *ctx, \
+	  ec_count_t *encount, ec_keyctx_t *keyctx, const unsigned int, \
+					const unsigned long long);
+
+	encounter_err_t (*dec_slot)   (encounter_t *ctx, \
+	  ec_count_t *encount, ec_keyctx_t *keyctx, const unsigned int, \
+					const unsigned long long);
 
 	encounter_err_t (*touch)      (encounter_t *ctx, \
-	     ec_count_t *encount, ec_keyctx_t *keyctx);
+	     ec_count_t *encount, ec_keyctx_t *keyctx, ec_keyctx_t *privK);
 
 	encounter_err_t (*add)      (encounter_t *ctx, \
 	     ec_count_t *encountA, ec_count_t *encountB, \
-				   ec_keyctx_t *keyctx);
+			   ec_keyctx_t *keyctx, ec_keyctx_t *privK);
 
 	encounter_err_t (*sub)      (encounter_t *ctx, \
 	     ec_count_t *encountA, ec_count_t *encountB, \
-				   ec_keyctx_t *keyctx);
+			   ec_keyctx_t *keyctx, ec_keyctx_t *privK);
+
+	encounter_err_t (*dec_batch)(encounter_t *ctx, \
+	  ec_count_t **encount, const unsigned int *, const size_t n, \
+						ec_keyctx_t *keyctx);
+
+	encounter_err_t (*sub_batch)(encounter_t *ctx, \
+	  ec_count_t **encountA, ec_count_t **encountB, const size_t n, \
+						ec_keyctx_t *keyctx);
 
 	encounter_err_t (*mul)        (encounter_t *ctx, \
-	  ec_count_t *encount, ec_keyctx_t *keyctx, const unsigned int);
+	  ec_count_t *encount, ec_keyctx_t *keyctx, ec_keyctx_t *privK, \
+						const unsigned int);
 
 	encounter_err_t (*mul_rand)        (encounter_t *ctx, \
 	                      ec_count_t *encount, ec_keyctx_t *keyctx);
 
+	encounter_err_t (*linear_combination)(encounter_t *ctx, \
+	  ec_count_t **encount, const unsigned int *, const size_t n, \
+				ec_keyctx_t *keyctx, ec_count_t *);
+
+	encounter_err_t (*sum)(encounter_t *ctx, \
+	  ec_count_t **encount, const size_t n, ec_keyctx_t *keyctx, \
+	  ec_count_t *, ec_keyctx_t *privK, unsigned long long *c);
+
 	encounter_err_t (*dup)        (encounter_t *ctx, \
 	         ec_keyctx_t *pubK, ec_count_t *encount, ec_count_t **);
 
@@ -151,6 +263,20 @@ static struct
 	encounter_err_t	(*decrypt)    (encounter_t *ctx, \
 	     ec_count_t *encount, ec_keyctx_t *keyctx, unsigned int *c);
 
+	encounter_err_t	(*decrypt_bounded)(encounter_t *ctx, \
+	  ec_count_t *encount, ec_keyctx_t *keyctx, unsigned long long *c);
+
+	encounter_err_t	(*decrypt_batch)(encounter_t *ctx, \
+	  ec_count_t **encount, const size_t n, ec_keyctx_t *keyctx, \
+					unsigned long long *c);
+
+	encounter_err_t	(*decrypt_bytes)(encounter_t *ctx, \
+	  ec_count_t *encount, ec_keyctx_t *keyctx, unsigned char *, size_t *);
+
+	encounter_err_t	(*decrypt_packed)(encounter_t *ctx, \
+	  ec_count_t *encount, ec_keyctx_t *keyctx, unsigned long long *, \
+							const size_t);
+
 	encounter_err_t (*dispose_key)(encounter_t *ctx, \
 				ec_keyctx_t *keyctx);
 
@@ -210,20 +336,34 @@ static struct
 #ifdef USE_OPENSSL
         encounter_crypto_openssl_init,
         encounter_crypto_openssl_keygen,
+	encounter_crypto_openssl_dj_keygen,
 	encounter_crypto_openssl_new_counter,
+	encounter_crypto_openssl_new_packed,
+	encounter_crypto_openssl_new_counters,
 	encounter_crypto_openssl_free_counter,
+	encounter_crypto_openssl_free_counters,
 	encounter_crypto_openssl_inc,
 	encounter_crypto_openssl_dec,
+	encounter_crypto_openssl_inc_slot,
+	encounter_crypto_openssl_dec_slot,
 	encounter_crypto_openssl_touch,
 	encounter_crypto_openssl_add,
 	encounter_crypto_openssl_sub,
+	encounter_crypto_openssl_dec_batch,
+	encounter_crypto_openssl_sub_batch,
 	encounter_crypto_openssl_mul,
 	encounter_crypto_openssl_mul_rand,
+	encounter_crypto_openssl_linear_combination,
+	encounter_crypto_openssl_sum,
 	encounter_crypto_openssl_dup,
 	encounter_crypto_openssl_copy,
 	encounter_crypto_openssl_cmp,
 	encounter_crypto_openssl_private_cmp2,
 	encounter_crypto_openssl_decrypt,
+	encounter_crypto_openssl_decrypt_bounded,
+	encounter_crypto_openssl_decrypt_batch,
+	encounter_crypto_openssl_decrypt_bytes,
+	encounter_crypto_openssl_decrypt_packed,
 	encounter_crypto_openssl_free_keyctx,
 	encounter_crypto_openssl_dispose_keystring,
 	encounter_crypto_openssl_term,
@@ -276,4 +416,12 @@ static struct
 			do { if ((size) < (ENCOUNTER_KEYSIZE_MIN)) \
 					return(e); } while(0)
 
+#define __ENCOUNTER_IS_ECELGAMAL_KEYTYPE(type) \
+			((type) == EC_KEYTYPE_ECELGAMAL_PUBLIC \
+			 || (type) == EC_KEYTYPE_ECELGAMAL_PRIVATE)
+
+#define __ENCOUNTER_IS_OU_KEYTYPE(type) \
+			((type) == EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC \
+			 || (type) == EC_KEYTYPE_OKAMOTO_UCHIYAMA_PRIVATE)
+
 #endif /* !_ENCOUNTER_PRIV_H_ */
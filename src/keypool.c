@@ -0,0 +1,431 @@
+#define	_GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/stat.h>
+
+#include "encounter.h"
+#include "encounter_priv.h"
+#include "keypool.h"
+#include "utils.h"
+
+
+/* Some static prototypes */
+static void encounter_keypool_path(char *, const char *, const char *);
+
+static void encounter_keypool_drop(encounter_t *, struct ec_keyslot_s *);
+
+static int encounter_keypool_progress(void *, const encounter_keygen_step_t,\
+							const unsigned int);
+
+static unsigned int encounter_keypool_next(struct ec_keypool_s *);
+
+static void encounter_keypool_push(struct ec_keypool_s *, \
+				const unsigned int, struct ec_keyslot_s *);
+
+static encounter_err_t encounter_keypool_spool(encounter_t *, \
+	struct ec_keypool_s *, const unsigned int, struct ec_keyslot_s *);
+
+static void encounter_keypool_load(encounter_t *, struct ec_keypool_s *);
+
+static void *encounter_keypool_refill(void *);
+
+
+
+/* Pathname of a spooled key, from the base pathname of its keypair, no
+ * longer than ENCOUNTER_FILENAME_MAX with its suffix */
+static void encounter_keypool_path(char *path, const char *base, \
+						const char *suffix)
+{
+	snprintf(path, ENCOUNTER_FILENAME_MAX, "%s%s", base, suffix);
+}
+
+/* Dispose a keypair that is not handed out, and forget its spool */
+static void encounter_keypool_drop(encounter_t *ctx, struct ec_keyslot_s *s)
+{
+	if (s->pubK) D.dispose_key(ctx, s->pubK);
+	if (s->privK) D.dispose_key(ctx, s->privK);
+	free(s->spool);
+	memset(s, 0, sizeof *s);
+}
+
+/* The progress callback of the refill thread cancels its key generation
+ * as soon as the pool stops */
+static int encounter_keypool_progress(void *arg, \
+	const encounter_keygen_step_t step, const unsigned int prime)
+{
+	struct ec_keypool_s *pool = arg;
+	bool stop;
+
+	(void) step;
+	(void) prime;
+
+	pthread_mutex_lock(&pool->lock);
+	stop = pool->stop;
+	pthread_mutex_unlock(&pool->lock);
+
+	return stop;
+}
+
+/* Pick the ring to refill next, the emptiest first, or
+ * ENCOUNTER_KEYPOOL_SIZES if all are full.
+ * Called with the pool lock held. */
+static unsigned int encounter_keypool_next(struct ec_keypool_s *pool)
+{
+	unsigned int k, next = ENCOUNTER_KEYPOOL_SIZES;
+
+	for (k = 0; k < ENCOUNTER_KEYPOOL_SIZES; ++k) {
+		if (!pool->ring[k].size) continue;
+		if (pool->ring[k].count >= pool->depth) continue;
+		if (next == ENCOUNTER_KEYPOOL_SIZES \
+		    || pool->ring[k].count < pool->ring[next].count)
+			next = k;
+	}
+
+	return next;
+}
+
+/* Move a keypair into the first free slot of a ring, which the caller
+ * knows to have room. Called with the pool lock held. */
+static void encounter_keypool_push(struct ec_keypool_s *pool, \
+			const unsigned int k, struct ec_keyslot_s *s)
+{
+	struct ec_keyring_s *ring = &pool->ring[k];
+
+	ring->v[(ring->head + ring->count) % pool->depth] = *s;
+	ring->count++;
+	memset(s, 0, sizeof *s);
+}
+
+/* Write a keypair to the spool directory, each key in a plaintext keyset
+ * file created for the owner only. The private-key comes last: its file
+ * stands for the keypair, and whoever unlinks it takes the keypair */
+static encounter_err_t encounter_keypool_spool(encounter_t *ctx, \
+	struct ec_keypool_s *pool, const unsigned int size, \
+						struct ec_keyslot_s *s)
+{
+	char path[ENCOUNTER_FILENAME_MAX];
+	size_t base;
+	int fd, len;
+
+	len = snprintf(path, sizeof path, "%s/%u-%ld-%u", \
+		pool->conf.keypool_dir, size, (long) getpid(), pool->seq++);
+	if (len < 0 || (size_t) len + sizeof EC_KEYPOOL_PRIVSUFFIX \
+							> sizeof path) {
+		encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+			"keypool_dir: too long");
+		return ctx->rc;
+	}
+	base = (size_t) len;
+
+	memcpy(path + base, EC_KEYPOOL_PUBSUFFIX, sizeof EC_KEYPOOL_PUBSUFFIX);
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) goto oserr;
+	close(fd);
+	if (D.store_key(ctx, s->pubK, path) != ENCOUNTER_OK) goto err;
+
+	memcpy(path + base, EC_KEYPOOL_PRIVSUFFIX, sizeof EC_KEYPOOL_PRIVSUFFIX);
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) goto oserr;
+	close(fd);
+	if (D.store_key(ctx, s->privK, path) != ENCOUNTER_OK) goto err;
+
+	path[base] = '\0';
+	if ((s->spool = strdup(path)) == NULL) {
+		encounter_set_error(ctx, ENCOUNTER_ERR_MEM, "strdup: failed");
+		goto err;
+	}
+
+	ctx->rc = ENCOUNTER_OK;
+	return ctx->rc;
+
+oserr:
+	encounter_set_error(ctx, ENCOUNTER_ERR_OS, "open: failed");
+err:
+	memcpy(path + base, EC_KEYPOOL_PRIVSUFFIX, sizeof EC_KEYPOOL_PRIVSUFFIX);
+	unlink(path);
+	memcpy(path + base, EC_KEYPOOL_PUBSUFFIX, sizeof EC_KEYPOOL_PUBSUFFIX);
+	unlink(path);
+
+	return ctx->rc;
+}
+
+/* Take up the keypairs left in the spool directory by the contexts gone
+ * before, as many as the rings have room for. They stay in the spool,
+ * for the other contexts on the directory as well */
+static void encounter_keypool_load(encounter_t *ctx, \
+					struct ec_keypool_s *pool)
+{
+	char path[ENCOUNTER_FILENAME_MAX];
+	struct ec_keyslot_s s;
+	struct dirent *e;
+	unsigned long size;
+	unsigned int k;
+	size_t len;
+	char *end;
+	DIR *dir;
+
+	if ((dir = opendir(pool->conf.keypool_dir)) == NULL) return;
+
+	while ((e = readdir(dir)) != NULL) {
+		len = strlen(e->d_name);
+		if (len <= sizeof EC_KEYPOOL_PRIVSUFFIX - 1 \
+		    || strcmp(e->d_name + len - (sizeof \
+			EC_KEYPOOL_PRIVSUFFIX - 1), EC_KEYPOOL_PRIVSUFFIX))
+			continue;
+
+		size = strtoul(e->d_name, &end, 10);
+		if (end == e->d_name || *end != '-') continue;
+
+		pthread_mutex_lock(&pool->lock);
+		for (k = 0; k < ENCOUNTER_KEYPOOL_SIZES; ++k)
+			if (pool->ring[k].size && pool->ring[k].size == size \
+			    && pool->ring[k].count < pool->depth)
+				break;
+		if (pool->stop) k = ENCOUNTER_KEYPOOL_SIZES;
+		pthread_mutex_unlock(&pool->lock);
+		if (k == ENCOUNTER_KEYPOOL_SIZES) continue;
+
+		memset(&s, 0, sizeof s);
+		if (snprintf(path, sizeof path, "%s/%.*s", \
+			pool->conf.keypool_dir, (int) (len - (sizeof \
+			EC_KEYPOOL_PRIVSUFFIX - 1)), e->d_name) \
+			+ sizeof EC_KEYPOOL_PRIVSUFFIX > sizeof path)
+			continue;
+		if ((s.spool = strdup(path)) == NULL) break;
+
+		encounter_keypool_path(path, s.spool, EC_KEYPOOL_PUBSUFFIX);
+		if (D.load_pubK(ctx, path, &s.pubK) != ENCOUNTER_OK) {
+			encounter_keypool_drop(ctx, &s);
+			continue;
+		}
+		encounter_keypool_path(path, s.spool, EC_KEYPOOL_PRIVSUFFIX);
+		if (D.load_privK(ctx, path, NULL, &s.privK) != ENCOUNTER_OK) {
+			encounter_keypool_drop(ctx, &s);
+			continue;
+		}
+
+		pthread_mutex_lock(&pool->lock);
+		encounter_keypool_push(pool, k, &s);
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	closedir(dir);
+}
+
+/* The refill thread generates one keypair at a time, on its own, at the
+ * lowest scheduling priority the system has for it */
+static void *encounter_keypool_refill(void *arg)
+{
+	struct ec_keypool_s *pool = arg;
+	struct ec_keyslot_s s;
+	encounter_t wctx;	/* Private error reporting */
+	unsigned int k, size;
+	bool ok;
+
+#ifdef SCHED_IDLE
+	struct sched_param param;
+
+	memset(&param, 0, sizeof param);
+	(void) pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+
+	memset(&wctx, 0, sizeof wctx);
+	wctx.conf = pool->conf;
+	wctx.conf.batch_threads = 1;
+	wctx.conf.keygen_progress = encounter_keypool_progress;
+	wctx.conf.keygen_arg = pool;
+
+	memset(&s, 0, sizeof s);
+	if (pool->conf.keypool_dir) encounter_keypool_load(&wctx, pool);
+
+	pthread_mutex_lock(&pool->lock);
+	while (!pool->stop) {
+		k = encounter_keypool_next(pool);
+		if (k == ENCOUNTER_KEYPOOL_SIZES) {
+			pthread_cond_wait(&pool->notfull, &pool->lock);
+			continue;
+		}
+		size = pool->ring[k].size;
+		pthread_mutex_unlock(&pool->lock);
+
+		/* The expensive part runs unlocked */
+		ok = D.keygen(&wctx, EC_KEYTYPE_PAILLIER_PUBLIC, size, \
+					&s.pubK, &s.privK) == ENCOUNTER_OK;
+		if (ok && pool->conf.keypool_dir)
+			ok = encounter_keypool_spool(&wctx, pool, size, &s) \
+							== ENCOUNTER_OK;
+
+		pthread_mutex_lock(&pool->lock);
+		if (!ok) break;
+
+		/* Only this thread fills the rings */
+		encounter_keypool_push(pool, k, &s);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	/* The encounter_keygen_pooled() callers generate inline from now */
+	encounter_keypool_drop(&wctx, &s);
+
+	return NULL;
+}
+
+/** Start the keypair pool of the supplied context and its refill thread,
+ * if the configuration asks for one */
+encounter_err_t encounter_keypool_start(encounter_t *ctx)
+{
+	struct ec_keypool_s *pool;
+	unsigned int i, k, n = 0;
+
+	if (!ctx)       return ENCOUNTER_ERR_PARAM;
+
+	ctx->keypool = NULL;
+	ctx->rc = ENCOUNTER_OK;
+	if (!ctx->conf.keypool_depth) return ctx->rc;
+
+	pool = calloc(1, sizeof *pool);
+	if (!pool) {
+		encounter_set_error(ctx, ENCOUNTER_ERR_MEM, "calloc: failed");
+		return ctx->rc;
+	}
+
+	pool->conf = ctx->conf;
+	pool->depth = ctx->conf.keypool_depth;
+
+	/* One ring per size, the repeated ones aside */
+	for (i = 0; i < ENCOUNTER_KEYPOOL_SIZES; ++i) {
+		if (!ctx->conf.keypool_sizes[i]) break;
+		for (k = 0; k < n; ++k)
+			if (pool->ring[k].size == ctx->conf.keypool_sizes[i])
+				break;
+		if (k < n) continue;
+
+		pool->ring[n].size = ctx->conf.keypool_sizes[i];
+		pool->ring[n].v = calloc(pool->depth, sizeof *pool->ring[n].v);
+		if (!pool->ring[n++].v) goto nomem;
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->notfull, NULL);
+
+	if (pthread_create(&pool->thread, NULL, encounter_keypool_refill, \
+								pool) != 0) {
+		pthread_cond_destroy(&pool->notfull);
+		pthread_mutex_destroy(&pool->lock);
+		for (k = 0; k < n; ++k) free(pool->ring[k].v);
+		free(pool);
+		encounter_set_error(ctx, ENCOUNTER_ERR_OS, \
+				"pthread_create: failed");
+		return ctx->rc;
+	}
+
+	ctx->keypool = pool;
+	return ctx->rc;
+
+nomem:
+	for (k = 0; k < n; ++k) free(pool->ring[k].v);
+	free(pool);
+	encounter_set_error(ctx, ENCOUNTER_ERR_MEM, "keypool: out of memory");
+	return ctx->rc;
+}
+
+/** Take a ready keypair of the given size from the pool of the supplied
+ * context, and wake up the refill thread. A spooled keypair is taken
+ * by unlinking its private-key file, the keypairs another context on
+ * the spool took first being dropped. *got is false when the pool is
+ * disabled, holds no such size, or ran dry */
+encounter_err_t encounter_keypool_get(encounter_t *ctx, \
+	const unsigned int size, ec_keyctx_t **pubK, ec_keyctx_t **privK, \
+								bool *got)
+{
+	char path[ENCOUNTER_FILENAME_MAX];
+	struct ec_keypool_s *pool;
+	struct ec_keyring_s *ring = NULL;
+	struct ec_keyslot_s s;
+	unsigned int k;
+
+	if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!pubK || !privK || !got) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	*got = false;
+	ctx->rc = ENCOUNTER_OK;
+
+	if ((pool = ctx->keypool) == NULL) return ctx->rc;
+	for (k = 0; k < ENCOUNTER_KEYPOOL_SIZES; ++k)
+		if (pool->ring[k].size == size) ring = &pool->ring[k];
+	if (!size || !ring) return ctx->rc;
+
+	pthread_mutex_lock(&pool->lock);
+	while (!*got && ring->count) {
+		s = ring->v[ring->head];
+		memset(&ring->v[ring->head], 0, sizeof s);
+		ring->head = (ring->head + 1) % pool->depth;
+		ring->count--;
+		pthread_cond_signal(&pool->notfull);
+
+		if (s.spool) {
+			encounter_keypool_path(path, s.spool, \
+						EC_KEYPOOL_PRIVSUFFIX);
+			if (unlink(path) != 0) {
+				encounter_keypool_drop(ctx, &s);
+				continue;
+			}
+			encounter_keypool_path(path, s.spool, \
+						EC_KEYPOOL_PUBSUFFIX);
+			unlink(path);
+			free(s.spool);
+		}
+
+		*pubK = s.pubK;
+		*privK = s.privK;
+		*got = true;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	/* The keypairs dropped may have touched the error */
+	ctx->rc = ENCOUNTER_OK;
+	return ctx->rc;
+}
+
+/** Stop the refill thread and dispose the keypair pool of the supplied
+ * context. The spooled keypairs stay in their directory */
+void encounter_keypool_stop(encounter_t *ctx)
+{
+	struct ec_keypool_s *pool;
+	unsigned int i, k;
+
+	if (!ctx || !ctx->keypool) return;
+
+	pool = ctx->keypool;
+	ctx->keypool = NULL;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->notfull);
+	pthread_mutex_unlock(&pool->lock);
+
+	pthread_join(pool->thread, NULL);
+
+	for (k = 0; k < ENCOUNTER_KEYPOOL_SIZES; ++k) {
+		if (!pool->ring[k].v) continue;
+		for (i = 0; i < pool->depth; ++i)
+			encounter_keypool_drop(ctx, &pool->ring[k].v[i]);
+		free(pool->ring[k].v);
+	}
+
+	pthread_cond_destroy(&pool->notfull);
+	pthread_mutex_destroy(&pool->lock);
+	memset(pool, 0, sizeof *pool);
+	free(pool);
+}
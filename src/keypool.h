@@ -0,0 +1,60 @@
+#ifndef _ENCOUNTER_KEYPOOL_H_
+#define _ENCOUNTER_KEYPOOL_H_
+
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "encounter.h"
+#include "encounter_priv.h"
+
+
+/* Suffixes of the keyset files of a spooled keypair, whose base name is
+ * <keysize>-<pid>-<sequence> in the spool directory */
+#define EC_KEYPOOL_PUBSUFFIX	".pub"
+#define EC_KEYPOOL_PRIVSUFFIX	".priv"
+
+/* A ready keypair */
+struct ec_keyslot_s {
+	ec_keyctx_t	*pubK;
+	ec_keyctx_t	*privK;
+	char		*spool;		/* Base pathname, NULL if in memory */
+};
+
+/* Ring of the ready keypairs of a key size */
+struct ec_keyring_s {
+	struct ec_keyslot_s *v;		/* depth slots */
+	unsigned int	size;		/* 0 if unused */
+	unsigned int	head;		/* Oldest ready keypair */
+	unsigned int	count;		/* Ready keypairs */
+};
+
+/* Per context pool of Paillier keypairs, refilled in the background by
+ * a thread of its own */
+struct ec_keypool_s {
+	pthread_mutex_t	lock;
+	pthread_cond_t	notfull;	/* Signalled on consumption */
+
+	struct ec_keyring_s ring[ENCOUNTER_KEYPOOL_SIZES];
+	unsigned int	depth;
+
+	encounter_conf_t conf;		/* Of the creating context */
+	pthread_t	thread;
+	unsigned int	seq;		/* Of the spooled keypairs */
+	bool		stop;
+};
+
+
+/* TODO use __BEGIN_DECLS */
+
+/** Start the keypair pool of a context, when configured */
+encounter_err_t encounter_keypool_start(encounter_t *);
+
+/** Take a ready keypair of the given size, if any */
+encounter_err_t encounter_keypool_get(encounter_t *, const unsigned int, \
+				ec_keyctx_t **, ec_keyctx_t **, bool *);
+
+/** Stop the keypair pool of a context, leaving the spool as it is */
+void encounter_keypool_stop(encounter_t *);
+
+
+#endif  /* _ENCOUNTER_KEYPOOL_H_ */
@@ -0,0 +1,414 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <openssl/bn.h>
+#include <openssl/err.h>
+
+#include "encounter_priv.h"
+
+#include "openssl_drv.h"
+#include "openssl_dj.h"
+
+#include "utils.h"
+
+
+/* Some static prototypes */
+static encounter_err_t encounter_crypto_openssl_dj_log(encounter_t *, \
+	BIGNUM *, const BIGNUM *, const BIGNUM *, const unsigned int, \
+								BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_dj_hConstant(\
+	encounter_t *, BIGNUM *, const BIGNUM *, const BIGNUM *, \
+	const BIGNUM *, const BIGNUM *, const unsigned int, BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_dj_pow(encounter_t *, \
+	BIGNUM **, const BIGNUM *, const unsigned int, BN_CTX *);
+
+
+
+/** i mod N^s out of a = (1+N)^i mod N^(s+1), one power of N at a time
+ * as in Damgard and Jurik, Theorem 1: with i known mod N^(j-1),
+ * L(a mod N^(j+1)) = sum_k C(i,k) N^(k-1) mod N^j gives it mod N^j */
+static encounter_err_t encounter_crypto_openssl_dj_log(encounter_t *ctx, \
+	BIGNUM *r, const BIGNUM *a, const BIGNUM *N, const unsigned int s, \
+							BN_CTX *bnctx)
+{
+	unsigned int j, k;
+
+	BN_CTX_start(bnctx);
+	BIGNUM *i = BN_CTX_get(bnctx);
+	BIGNUM *t1 = BN_CTX_get(bnctx);
+	BIGNUM *t2 = BN_CTX_get(bnctx);
+	BIGNUM *nj = BN_CTX_get(bnctx);		/* N^j */
+	BIGNUM *nj1 = BN_CTX_get(bnctx);	/* N^(j+1) */
+	BIGNUM *nk = BN_CTX_get(bnctx);		/* N^(k-1) */
+	BIGNUM *fact = BN_CTX_get(bnctx);	/* k! */
+	BIGNUM *tmp = BN_CTX_get(bnctx);
+
+	if (!tmp) OPENSSL_ERROR(end);
+
+	BN_zero(i);
+	if (!BN_copy(nj, N)) OPENSSL_ERROR(end);
+	if (!BN_sqr(nj1, N, bnctx)) OPENSSL_ERROR(end);
+
+	for (j = 1; j <= s; ++j) {
+		/* t1 = L(a mod N^(j+1)) = (a mod N^(j+1) - 1) / N */
+		if (!BN_nnmod(t1, a, nj1, bnctx)) OPENSSL_ERROR(end);
+		if (!BN_sub_word(t1, 1)) OPENSSL_ERROR(end);
+		if (!BN_div(t1, NULL, t1, N, bnctx)) OPENSSL_ERROR(end);
+
+		/* t1 -= C(i,k) N^(k-1) for k = 2 .. j */
+		if (!BN_copy(t2, i)) OPENSSL_ERROR(end);
+		if (!BN_one(nk) || !BN_one(fact)) OPENSSL_ERROR(end);
+		for (k = 2; k <= j; ++k) {
+			if (!BN_sub_word(i, 1)) OPENSSL_ERROR(end);
+			if (!BN_mod_mul(t2, t2, i, nj, bnctx))
+				OPENSSL_ERROR(end);
+			if (!BN_mul(nk, nk, N, bnctx)) OPENSSL_ERROR(end);
+			if (!BN_mul_word(fact, k)) OPENSSL_ERROR(end);
+
+			if (!BN_mod_inverse(tmp, fact, nj, bnctx))
+				OPENSSL_ERROR(end);
+			if (!BN_mod_mul(tmp, tmp, t2, nj, bnctx))
+				OPENSSL_ERROR(end);
+			if (!BN_mod_mul(tmp, tmp, nk, nj, bnctx))
+				OPENSSL_ERROR(end);
+			if (!BN_mod_sub(t1, t1, tmp, nj, bnctx))
+				OPENSSL_ERROR(end);
+		}
+		if (!BN_copy(i, t1)) OPENSSL_ERROR(end);
+
+		if (!BN_mul(nj, nj, N, bnctx)) OPENSSL_ERROR(end);
+		if (!BN_mul(nj1, nj1, N, bnctx)) OPENSSL_ERROR(end);
+	}
+
+	if (!BN_copy(r, i)) OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (i)     BN_clear(i);
+	if (t1)    BN_clear(t1);
+	if (t2)    BN_clear(t2);
+	if (tmp)   BN_clear(tmp);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** h_P = log_{1+P}((1+n)^(P-1) mod P^(s+1))^-1 mod P^s, so that
+ * m mod P^s = log_{1+P}(c^(P-1) mod P^(s+1)) h_P, the counterpart of
+ * the Paillier h_p for either prime P of n */
+static encounter_err_t encounter_crypto_openssl_dj_hConstant(\
+	encounter_t *ctx, BIGNUM *h, const BIGNUM *n, const BIGNUM *P, \
+	const BIGNUM *Ps, const BIGNUM *Ps1, const unsigned int s, \
+							BN_CTX *bnctx)
+{
+	BN_CTX_start(bnctx);
+	BIGNUM *a = BN_CTX_get(bnctx);
+	BIGNUM *min1 = BN_CTX_get(bnctx);
+
+	if (!min1) OPENSSL_ERROR(end);
+
+	if (!BN_copy(a, n) || !BN_add_word(a, 1)) OPENSSL_ERROR(end);
+	if (!BN_copy(min1, P) || !BN_sub_word(min1, 1)) OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_expmodBN(ctx, a, a, min1, Ps1, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	if (encounter_crypto_openssl_dj_log(ctx, a, a, P, s, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (!BN_mod_inverse(h, a, Ps, bnctx)) OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (a)     BN_clear(a);
+	if (min1)  BN_clear(min1);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** *r = a^e, allocated if need be */
+static encounter_err_t encounter_crypto_openssl_dj_pow(encounter_t *ctx, \
+	BIGNUM **r, const BIGNUM *a, const unsigned int e, BN_CTX *bnctx)
+{
+	unsigned int i;
+
+	if (!*r && (*r = BN_new()) == NULL) OPENSSL_ERROR(end);
+	if (!BN_copy(*r, a)) OPENSSL_ERROR(end);
+	for (i = 1; i < e; ++i)
+		if (!BN_mul(*r, *r, a, bnctx)) OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	return ctx->rc;
+}
+
+/** Turn a Paillier key with g = n+1, public or private, into the
+ * Damgard-Jurik key of degree s over the same n */
+encounter_err_t encounter_crypto_openssl_dj_extend(encounter_t *ctx, \
+	ec_keyctx_t *key, const unsigned int s, BN_CTX *bnctx)
+{
+	struct paillier_publickey *pk;
+	struct paillier_privatekey *sk;
+	unsigned int i;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!key || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (s < 2 || s > ENCOUNTER_DJ_DEGREE_MAX) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "Damgard-Jurik degree out of range");
+                return ctx->rc;
+	}
+	for (i = 0; i < EC_MOD_LAST; ++i)
+		if (key->mont[i]) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+				"key already in use");
+			return ctx->rc;
+		}
+
+	BN_CTX_start(bnctx);
+	BIGNUM *n = BN_CTX_get(bnctx);
+
+	if (!n) OPENSSL_ERROR(end);
+
+	switch (key->type) {
+		case EC_KEYTYPE_PAILLIER_NPLUS1_PUBLIC:
+		case EC_KEYTYPE_DAMGARD_JURIK_PUBLIC:
+			pk = &key->k.paillier_pubK;
+			if (!BN_copy(n, pk->n) || !BN_add_word(n, 1))
+				OPENSSL_ERROR(end);
+			if (BN_cmp(n, pk->g)) {
+				encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+					"Damgard-Jurik wants g = n+1");
+				goto end;
+			}
+
+			if (encounter_crypto_openssl_dj_pow(ctx, &pk->ns, \
+				pk->n, s, bnctx) != ENCOUNTER_OK)
+				goto end;
+			if (encounter_crypto_openssl_dj_pow(ctx, &pk->nsplus1,\
+				pk->n, s + 1, bnctx) != ENCOUNTER_OK)
+				goto end;
+
+			pk->s = s;
+			key->type = EC_KEYTYPE_DAMGARD_JURIK_PUBLIC;
+			break;
+
+		case EC_KEYTYPE_PAILLIER_PRIVATE:
+		case EC_KEYTYPE_DAMGARD_JURIK_PRIVATE:
+			sk = &key->k.paillier_privK;
+			if (!BN_mul(n, sk->p, sk->q, bnctx)) OPENSSL_ERROR(end);
+
+			if (encounter_crypto_openssl_dj_pow(ctx, &sk->ps, \
+				sk->p, s, bnctx) != ENCOUNTER_OK)
+				goto end;
+			if (encounter_crypto_openssl_dj_pow(ctx, &sk->qs, \
+				sk->q, s, bnctx) != ENCOUNTER_OK)
+				goto end;
+			if (encounter_crypto_openssl_dj_pow(ctx, &sk->psplus1,\
+				sk->p, s + 1, bnctx) != ENCOUNTER_OK)
+				goto end;
+			if (encounter_crypto_openssl_dj_pow(ctx, &sk->qsplus1,\
+				sk->q, s + 1, bnctx) != ENCOUNTER_OK)
+				goto end;
+
+			if (!sk->djhsubp && (sk->djhsubp = BN_new()) == NULL)
+				OPENSSL_ERROR(end);
+			if (!sk->djhsubq && (sk->djhsubq = BN_new()) == NULL)
+				OPENSSL_ERROR(end);
+			if (!sk->qsInv && (sk->qsInv = BN_new()) == NULL)
+				OPENSSL_ERROR(end);
+
+			if (encounter_crypto_openssl_dj_hConstant(ctx, \
+				sk->djhsubp, n, sk->p, sk->ps, sk->psplus1, s, \
+					bnctx) != ENCOUNTER_OK)
+				goto end;
+			if (encounter_crypto_openssl_dj_hConstant(ctx, \
+				sk->djhsubq, n, sk->q, sk->qs, sk->qsplus1, s, \
+					bnctx) != ENCOUNTER_OK)
+				goto end;
+			if (!BN_mod_inverse(sk->qsInv, sk->qs, sk->ps, bnctx))
+				OPENSSL_ERROR(end);
+
+			sk->s = s;
+			key->type = EC_KEYTYPE_DAMGARD_JURIK_PRIVATE;
+			break;
+
+		default:
+                	encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        	"Damgard-Jurik wants an n+1 Paillier key");
+			goto end;
+	}
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** A Damgard-Jurik key pair of degree s, on primes of keysize bits.
+ * Degree 1 is plain Paillier with g = n+1 */
+encounter_err_t encounter_crypto_openssl_dj_keygen(encounter_t *ctx, \
+	const unsigned int s, unsigned int keysize, ec_keyctx_t **pubK, \
+						ec_keyctx_t **privK)
+{
+	encounter_err_t rc;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!pubK || !privK) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (!s || s > ENCOUNTER_DJ_DEGREE_MAX) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "Damgard-Jurik degree out of range");
+                return ctx->rc;
+	}
+
+	*pubK = *privK = NULL;
+	if (encounter_crypto_openssl_keygen(ctx, \
+		EC_KEYTYPE_PAILLIER_NPLUS1_PUBLIC, keysize, pubK, privK) \
+			!= ENCOUNTER_OK)
+		return ctx->rc;
+	if (s == 1) return ctx->rc;
+
+	BN_CTX *bnctx = BN_CTX_new();
+
+	if (!bnctx) OPENSSL_ERROR(err);
+	if (encounter_crypto_openssl_dj_extend(ctx, *pubK, s, bnctx) \
+			!= ENCOUNTER_OK)
+		goto err;
+	if (encounter_crypto_openssl_dj_extend(ctx, *privK, s, bnctx) \
+			!= ENCOUNTER_OK)
+		goto err;
+
+	BN_CTX_free(bnctx);
+	return ctx->rc;
+
+err:
+	rc = ctx->rc;
+	if (bnctx) BN_CTX_free(bnctx);
+	encounter_crypto_openssl_free_keyctx(ctx, *pubK);
+	encounter_crypto_openssl_free_keyctx(ctx, *privK);
+	*pubK = *privK = NULL;
+
+	/* Report the failure, not the disposal */
+	ctx->rc = rc;
+	return ctx->rc;
+}
+
+/** (1+n)^m mod n^(s+1), or (1+n)^-m when invert is set, in standard
+ * form. The binomial expansion sum_k C(m,k) n^k stops at k = s, and
+ * (1+n)^-m = (1+n)^(n^s - m): s products whatever the size of m */
+encounter_err_t encounter_crypto_openssl_dj_gToM(encounter_t *ctx, \
+	BIGNUM *r, const BIGNUM *m, ec_keyctx_t *pubK, BN_CTX *bnctx, \
+							const bool invert)
+{
+	struct paillier_publickey *pk;
+	unsigned int k;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!r || !m || !pubK || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	pk = &pubK->k.paillier_pubK;
+
+	BN_CTX_start(bnctx);
+	BIGNUM *e = BN_CTX_get(bnctx);
+	BIGNUM *t = BN_CTX_get(bnctx);
+	BIGNUM *f = BN_CTX_get(bnctx);
+
+	if (!f) OPENSSL_ERROR(end);
+
+	if (!BN_nnmod(e, m, pk->ns, bnctx)) OPENSSL_ERROR(end);
+	if (invert && !BN_is_zero(e))
+		if (!BN_sub(e, pk->ns, e)) OPENSSL_ERROR(end);
+
+	/* t = C(e,k) n^k, from C(e,k-1) n^(k-1) (e-k+1) n / k */
+	if (!BN_one(r) || !BN_one(t)) OPENSSL_ERROR(end);
+	for (k = 1; k <= pk->s; ++k) {
+		if (BN_cmp(e, BN_value_one()) < 0 && k > 1) break;
+		if (!BN_copy(f, e)) OPENSSL_ERROR(end);
+		if (!BN_sub_word(f, k - 1)) OPENSSL_ERROR(end);
+		if (BN_is_zero(f)) break;
+
+		if (!BN_mod_mul(t, t, f, pk->nsplus1, bnctx))
+			OPENSSL_ERROR(end);
+		if (!BN_mod_mul(t, t, pk->n, pk->nsplus1, bnctx))
+			OPENSSL_ERROR(end);
+		if (!BN_set_word(f, k)) OPENSSL_ERROR(end);
+		if (!BN_mod_inverse(f, f, pk->nsplus1, bnctx))
+			OPENSSL_ERROR(end);
+		if (!BN_mod_mul(t, t, f, pk->nsplus1, bnctx))
+			OPENSSL_ERROR(end);
+		if (!BN_mod_add(r, r, t, pk->nsplus1, bnctx))
+			OPENSSL_ERROR(end);
+	}
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (e)     BN_clear(e);
+	if (t)     BN_clear(t);
+	if (f)     BN_clear(f);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** m mod p^s, as log_{1+p}(c^(p-1) mod p^(s+1)) h_p mod p^s, or m mod
+ * q^s when p is not set. c is in standard form */
+encounter_err_t encounter_crypto_openssl_dj_decryptHalf(encounter_t *ctx, \
+	BIGNUM *r, const BIGNUM *c, ec_keyctx_t *privK, const bool p, \
+							BN_CTX *bnctx)
+{
+	struct paillier_privatekey *k = &privK->k.paillier_privK;
+
+	BN_CTX_start(bnctx);
+	BIGNUM *tmp = BN_CTX_get(bnctx);
+	BIGNUM *min1 = BN_CTX_get(bnctx);
+
+	if (!min1) OPENSSL_ERROR(end);
+
+	/* p-1 */
+	if (!BN_sub(min1, p ? k->p : k->q, BN_value_one()))
+		OPENSSL_ERROR(end);
+
+	/* c^(p-1) mod p^(s+1), (1+p)^(m (p-1) / h_p) */
+	if (!BN_mod(tmp, c, p ? k->psplus1 : k->qsplus1, bnctx))
+		OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_expmod(ctx, tmp, tmp, min1, privK, \
+		p ? EC_MOD_PSQUARED : EC_MOD_QSQUARED, bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	if (encounter_crypto_openssl_dj_log(ctx, tmp, tmp, p ? k->p : k->q, \
+			k->s, bnctx) != ENCOUNTER_OK)
+		goto end;
+	if (!BN_mod_mul(r, tmp, p ? k->djhsubp : k->djhsubq, \
+			p ? k->ps : k->qs, bnctx))
+		OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (tmp)   BN_clear(tmp);
+	if (min1)  BN_clear(min1);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
@@ -0,0 +1,29 @@
+#ifndef _ENCOUNTER_CRYPTO_OPENSSL_DJ_H_
+#define _ENCOUNTER_CRYPTO_OPENSSL_DJ_H_
+
+#include <openssl/bn.h>
+
+#include "encounter_priv.h"
+
+
+/* Damgard-Jurik keys of degree s are Paillier keys with g = n+1 whose
+ * counters live modulo n^(s+1), for plaintexts modulo n^s. The ciphertext
+ * expansion is (s+1)/s. Everything but the Paillier fields is derived
+ * from n, or p and q, and s, see encounter_crypto_openssl_dj_extend() */
+
+
+/* TODO use __BEGIN_DECLS */
+
+encounter_err_t encounter_crypto_openssl_dj_keygen(encounter_t *, \
+	const unsigned int, unsigned int, ec_keyctx_t **, ec_keyctx_t **);
+
+encounter_err_t encounter_crypto_openssl_dj_extend(encounter_t *, \
+			ec_keyctx_t *, const unsigned int, BN_CTX *);
+
+encounter_err_t encounter_crypto_openssl_dj_gToM(encounter_t *, \
+	BIGNUM *, const BIGNUM *, ec_keyctx_t *, BN_CTX *, const bool);
+
+encounter_err_t encounter_crypto_openssl_dj_decryptHalf(encounter_t *, \
+	BIGNUM *, const BIGNUM *, ec_keyctx_t *, const bool, BN_CTX *);
+
+#endif  /* _ENCOUNTER_CRYPTO_OPENSSL_DJ_H_ */
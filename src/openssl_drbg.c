@@ -0,0 +1,397 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <openssl/bn.h>
+#include <openssl/err.h>
+#include <openssl/crypto.h>
+
+#include "encounter_priv.h"
+
+#include "openssl_drv.h"
+#include "openssl_drbg.h"
+
+#include "utils.h"
+
+
+/* getrandom(2) from glibc 2.25 on, /dev/urandom otherwise */
+#if defined(__GLIBC__) && \
+	(__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 25))
+#include <sys/random.h>
+#define EC_DRBG_GETRANDOM
+#endif
+
+#define EC_DRBG_ROTL(v, c)	(((v) << (c)) | ((v) >> (32 - (c))))
+
+#define EC_DRBG_QUARTER(x, a, b, c, d) do { \
+	x[a] += x[b]; x[d] ^= x[a]; x[d] = EC_DRBG_ROTL(x[d], 16); \
+	x[c] += x[d]; x[b] ^= x[c]; x[b] = EC_DRBG_ROTL(x[b], 12); \
+	x[a] += x[b]; x[d] ^= x[a]; x[d] = EC_DRBG_ROTL(x[d], 8); \
+	x[c] += x[d]; x[b] ^= x[c]; x[b] = EC_DRBG_ROTL(x[b], 7); \
+} while (0)
+
+/* Draws of up to these bytes need no allocation */
+#define EC_DRBG_STACKBYTES	1024
+
+/* State of the generator of a thread */
+struct ec_drbg_s {
+	uint32_t	key[8];
+	unsigned char	buf[64 * EC_DRBG_BLOCKS];	/* The keystream */
+	size_t		pos;		/* Bytes of buf handed out */
+	size_t		since;		/* Bytes since the last reseed */
+	unsigned int	forks;		/* drbg_forks at the last reseed */
+	bool		seeded;
+};
+
+
+/* Some static prototypes */
+static void encounter_crypto_openssl_drbg_once(void);
+
+static void encounter_crypto_openssl_drbg_atfork(void);
+
+static void encounter_crypto_openssl_drbg_destroy(void *);
+
+static void encounter_crypto_openssl_drbg_block(uint32_t *, \
+					const uint32_t *, const uint32_t);
+
+static void encounter_crypto_openssl_drbg_refill(struct ec_drbg_s *);
+
+static struct ec_drbg_s *encounter_crypto_openssl_drbg_get(encounter_t *);
+
+static void encounter_crypto_openssl_drbg_read(struct ec_drbg_s *, \
+					unsigned char *, size_t);
+
+static encounter_err_t encounter_crypto_openssl_drbg_draw(encounter_t *, \
+	struct ec_drbg_s *, BIGNUM *, const int, const BIGNUM *, \
+							unsigned char *);
+
+
+static pthread_once_t drbg_once = PTHREAD_ONCE_INIT;
+static pthread_key_t drbg_key;
+static bool drbg_keyok;
+
+/* Forks seen, a child reseeds rather than replay its parent's stream */
+static volatile unsigned int drbg_forks;
+
+
+
+static void encounter_crypto_openssl_drbg_once(void)
+{
+	drbg_keyok = !pthread_key_create(&drbg_key, \
+				encounter_crypto_openssl_drbg_destroy);
+	pthread_atfork(NULL, NULL, encounter_crypto_openssl_drbg_atfork);
+}
+
+static void encounter_crypto_openssl_drbg_atfork(void)
+{
+	drbg_forks++;
+}
+
+/** Wipe and free the state of an exiting thread */
+static void encounter_crypto_openssl_drbg_destroy(void *p)
+{
+	OPENSSL_cleanse(p, sizeof(struct ec_drbg_s));
+	free(p);
+}
+
+/** out = the ChaCha20 block of the key at counter, the nonce zero: each
+ * key serves a single refill */
+static void encounter_crypto_openssl_drbg_block(uint32_t *out, \
+			const uint32_t *key, const uint32_t counter)
+{
+	uint32_t in[16];
+	int i;
+
+	/* "expand 32-byte k" */
+	in[0] = 0x61707865;	in[1] = 0x3320646e;
+	in[2] = 0x79622d32;	in[3] = 0x6b206574;
+	for (i = 0; i < 8; ++i) in[4 + i] = key[i];
+	in[12] = counter;
+	in[13] = in[14] = in[15] = 0;
+
+	memcpy(out, in, sizeof in);
+	for (i = 0; i < 10; ++i) {
+		EC_DRBG_QUARTER(out, 0, 4, 8, 12);
+		EC_DRBG_QUARTER(out, 1, 5, 9, 13);
+		EC_DRBG_QUARTER(out, 2, 6, 10, 14);
+		EC_DRBG_QUARTER(out, 3, 7, 11, 15);
+		EC_DRBG_QUARTER(out, 0, 5, 10, 15);
+		EC_DRBG_QUARTER(out, 1, 6, 11, 12);
+		EC_DRBG_QUARTER(out, 2, 7, 8, 13);
+		EC_DRBG_QUARTER(out, 3, 4, 9, 14);
+	}
+	for (i = 0; i < 16; ++i) out[i] += in[i];
+
+	OPENSSL_cleanse(in, sizeof in);
+}
+
+/** A fresh keystream, its first 32 bytes the next key */
+static void encounter_crypto_openssl_drbg_refill(struct ec_drbg_s *st)
+{
+	uint32_t block[16];
+	unsigned int i;
+
+	for (i = 0; i < EC_DRBG_BLOCKS; ++i) {
+		encounter_crypto_openssl_drbg_block(block, st->key, i);
+		memcpy(st->buf + i * sizeof block, block, sizeof block);
+	}
+
+	memcpy(st->key, st->buf, sizeof st->key);
+	OPENSSL_cleanse(st->buf, sizeof st->key);
+	st->pos = sizeof st->key;
+
+	OPENSSL_cleanse(block, sizeof block);
+}
+
+/** The state of the calling thread, created on first use and reseeded
+ * from the OS when due */
+static struct ec_drbg_s *encounter_crypto_openssl_drbg_get(encounter_t *ctx)
+{
+	struct ec_drbg_s *st;
+	uint32_t seed[8];
+	int i;
+
+	pthread_once(&drbg_once, encounter_crypto_openssl_drbg_once);
+	if (!drbg_keyok) {
+		encounter_set_error(ctx, ENCOUNTER_ERR_OS, \
+			"pthread_key_create: failed");
+		return NULL;
+	}
+
+	st = pthread_getspecific(drbg_key);
+	if (!st) {
+		st = calloc(1, sizeof *st);
+		if (!st) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_MEM, \
+				"calloc: failed");
+			return NULL;
+		}
+		if (pthread_setspecific(drbg_key, st)) {
+			free(st);
+			encounter_set_error(ctx, ENCOUNTER_ERR_OS, \
+				"pthread_setspecific: failed");
+			return NULL;
+		}
+	}
+
+	if (st->seeded && st->since < EC_DRBG_RESEED \
+	    && st->forks == drbg_forks)
+		return st;
+
+	/* The fresh entropy joins the current key */
+	if (encounter_crypto_openssl_drbg_entropy(seed, sizeof seed) \
+			!= ENCOUNTER_OK) {
+		OPENSSL_cleanse(seed, sizeof seed);
+		encounter_set_error(ctx, ENCOUNTER_ERR_OS, \
+			"no entropy for the randomizers");
+		return NULL;
+	}
+	for (i = 0; i < 8; ++i) st->key[i] ^= seed[i];
+	OPENSSL_cleanse(seed, sizeof seed);
+
+	encounter_crypto_openssl_drbg_refill(st);
+	st->since = 0;
+	st->forks = drbg_forks;
+	st->seeded = true;
+
+	return st;
+}
+
+/** out = the next len bytes, wiped from the state */
+static void encounter_crypto_openssl_drbg_read(struct ec_drbg_s *st, \
+					unsigned char *out, size_t len)
+{
+	size_t n;
+
+	while (len) {
+		if (st->pos == sizeof st->buf)
+			encounter_crypto_openssl_drbg_refill(st);
+
+		n = sizeof st->buf - st->pos;
+		if (n > len) n = len;
+
+		memcpy(out, st->buf + st->pos, n);
+		OPENSSL_cleanse(st->buf + st->pos, n);
+		st->pos += n;
+		st->since += n;
+		out += n;
+		len -= n;
+	}
+}
+
+/** r uniform in [0, 2^bits), or in [1, range) when a range is supplied,
+ * by rejection of the draws of its bits out of it. buf holds
+ * (bits + 7) / 8 bytes */
+static encounter_err_t encounter_crypto_openssl_drbg_draw(encounter_t *ctx,\
+	struct ec_drbg_s *st, BIGNUM *r, const int bits, \
+			const BIGNUM *range, unsigned char *buf)
+{
+	const size_t len = (bits + 7) / 8;
+
+	do {
+		encounter_crypto_openssl_drbg_read(st, buf, len);
+		if (bits % 8) buf[0] &= 0xff >> (8 - bits % 8);
+		if (!BN_bin2bn(buf, len, r)) OPENSSL_ERROR(end);
+	} while (range && (BN_is_zero(r) || BN_ucmp(r, range) >= 0));
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	OPENSSL_cleanse(buf, len);
+
+	return ctx->rc;
+}
+
+/** buf = len bytes of the OS entropy source, read unbuffered so that no
+ * copy of them outlives the call */
+encounter_err_t encounter_crypto_openssl_drbg_entropy(void *buf, \
+							const size_t len)
+{
+#ifdef HAVE_ARC4RANDOM
+	arc4random_buf(buf, len);
+#else
+	unsigned char *p = buf;
+	size_t left = len;
+	ssize_t got;
+#ifdef EC_DRBG_GETRANDOM
+	while (left) {
+		got = getrandom(p, left, 0);
+		if (got < 0 && errno == EINTR) continue;
+		if (got <= 0) return ENCOUNTER_ERR_OS;
+		p += got;
+		left -= got;
+	}
+#else   /* Revert on /dev/urandom */
+	int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0) return ENCOUNTER_ERR_OS;
+	while (left) {
+		got = read(fd, p, left);
+		if (got < 0 && errno == EINTR) continue;
+		if (got <= 0) break;
+		p += got;
+		left -= got;
+	}
+	close(fd);
+
+	if (left) return ENCOUNTER_ERR_OS;
+#endif
+#endif
+
+	return ENCOUNTER_OK;
+}
+
+/** out = len bytes of the generator of the calling thread */
+encounter_err_t encounter_crypto_openssl_drbg_bytes(encounter_t *ctx, \
+				unsigned char *out, const size_t len)
+{
+	struct ec_drbg_s *st;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!out) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	st = encounter_crypto_openssl_drbg_get(ctx);
+	if (!st) return ctx->rc;
+
+	encounter_crypto_openssl_drbg_read(st, out, len);
+
+	ctx->rc = ENCOUNTER_OK;
+	return ctx->rc;
+}
+
+/** r uniform in [0, 2^bits), as BN_rand(r, bits, -1, 0) does: the short
+ * exponents of the fixed-base and subgroup randomizers */
+encounter_err_t encounter_crypto_openssl_drbg_bits(encounter_t *ctx, \
+					BIGNUM *r, const int bits)
+{
+	unsigned char stack[EC_DRBG_STACKBYTES], *buf = stack;
+	struct ec_drbg_s *st;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!r || bits <= 0) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	st = encounter_crypto_openssl_drbg_get(ctx);
+	if (!st) return ctx->rc;
+
+	if ((bits + 7) / 8 > EC_DRBG_STACKBYTES) {
+		buf = OPENSSL_malloc((bits + 7) / 8);
+		if (!buf) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_MEM, \
+				"OPENSSL_malloc: failed");
+			return ctx->rc;
+		}
+	}
+
+	encounter_crypto_openssl_drbg_draw(ctx, st, r, bits, NULL, buf);
+
+	if (buf != stack) OPENSSL_free(buf);
+
+	return ctx->rc;
+}
+
+/** r[k] uniform in [1, range) for the count values of r, drawn in bulk
+ * from the generator of the calling thread: the r of the randomizers
+ * r^n, with range n. No r shares a factor with n but with probability
+ * (p + q - 1) / n, under 2^-(bits of n / 2 - 1), the odds of factoring
+ * n at random: the gcd of each candidate with n is not worth its cost */
+encounter_err_t encounter_crypto_openssl_drbg_range(encounter_t *ctx, \
+		BIGNUM **r, const size_t count, const BIGNUM *range)
+{
+	unsigned char stack[EC_DRBG_STACKBYTES], *buf = stack;
+	struct ec_drbg_s *st;
+	size_t k;
+	int bits;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!r || !range || BN_is_negative(range) || BN_cmp(range, \
+			BN_value_one()) <= 0) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	for (k = 0; k < count; ++k)
+		if (!r[k]) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+				"null value");
+			return ctx->rc;
+		}
+
+	st = encounter_crypto_openssl_drbg_get(ctx);
+	if (!st) return ctx->rc;
+
+	bits = BN_num_bits(range);
+	if ((bits + 7) / 8 > EC_DRBG_STACKBYTES) {
+		buf = OPENSSL_malloc((bits + 7) / 8);
+		if (!buf) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_MEM, \
+				"OPENSSL_malloc: failed");
+			return ctx->rc;
+		}
+	}
+
+	ctx->rc = ENCOUNTER_OK;
+	for (k = 0; k < count; ++k)
+		if (encounter_crypto_openssl_drbg_draw(ctx, st, r[k], bits, \
+				range, buf) != ENCOUNTER_OK)
+			break;
+
+	if (buf != stack) OPENSSL_free(buf);
+
+	return ctx->rc;
+}
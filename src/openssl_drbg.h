@@ -0,0 +1,39 @@
+#ifndef _ENCOUNTER_CRYPTO_OPENSSL_DRBG_H_
+#define _ENCOUNTER_CRYPTO_OPENSSL_DRBG_H_
+
+#include <stddef.h>
+
+#include <openssl/bn.h>
+
+#include "encounter_priv.h"
+
+
+/* Per-thread ChaCha20 generator of the randomizers, so that the threads
+ * drawing them share no lock, OpenSSL's RAND included. Each thread keys
+ * its own from the OS on first use, again every EC_DRBG_RESEED bytes and
+ * after a fork. The key is replaced by the first 32 bytes of each refill
+ * of the keystream, and the bytes handed out are wiped from the buffer:
+ * a state captured later tells nothing of the values drawn before.
+ * Keys and the other long-lived secrets stay on OpenSSL's RAND */
+
+/* Bytes between the reseeds from the OS */
+#define EC_DRBG_RESEED		(1UL << 20)
+
+/* ChaCha20 blocks of 64 bytes generated at each refill */
+#define EC_DRBG_BLOCKS		16
+
+
+/* TODO use __BEGIN_DECLS */
+
+encounter_err_t encounter_crypto_openssl_drbg_entropy(void *, const size_t);
+
+encounter_err_t encounter_crypto_openssl_drbg_bytes(encounter_t *, \
+					unsigned char *, const size_t);
+
+encounter_err_t encounter_crypto_openssl_drbg_bits(encounter_t *, \
+					BIGNUM *, const int);
+
+encounter_err_t encounter_crypto_openssl_drbg_range(encounter_t *, \
+			BIGNUM **, const size_t, const BIGNUM *);
+
+#endif  /* _ENCOUNTER_CRYPTO_OPENSSL_DRBG_H_ */
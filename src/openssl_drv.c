@@ -1,5 +1,6 @@
 #include <sys/time.h>
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
@@ -16,6 +17,15 @@
 #include "encounter_priv.h"
 
 #include "openssl_drv.h"
+#include "openssl_pool.h"
+#include "openssl_fbase.h"
+#include "openssl_dj.h"
+#include "openssl_ecelgamal.h"
+#include "openssl_ou.h"
+#include "openssl_subgroup.h"
+#include "openssl_ifma.h"
+#include "openssl_drbg.h"
+#include "threadpool.h"
 
 #include "utils.h"
 
@@ -28,6 +38,25 @@ typedef struct seed_ss {
 #define BN_are_not_equal(a,b) (!(BN_are_equal(a,b)))
 #define BN_is_neg(a)          (a->neg == 1)
 
+/* The BN_GENCB are opaque and allocated by OpenSSL from 1.1.0 on, plain
+ * structures before */
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+# define BN_GENCB_get_arg(cb)  ((cb)->arg)
+#endif
+
+#define EC_IS_DJ_PUBLIC(k)   ((k)->type == EC_KEYTYPE_DAMGARD_JURIK_PUBLIC)
+#define EC_IS_DJ_PRIVATE(k)  ((k)->type == EC_KEYTYPE_DAMGARD_JURIK_PRIVATE)
+#define EC_IS_NPLUS1_PUBLIC(k) \
+			((k)->type == EC_KEYTYPE_PAILLIER_NPLUS1_PUBLIC)
+#define EC_COUNT_VERSION(k)  (EC_IS_DJ_PUBLIC(k) ? \
+		ENCOUNTER_COUNT_DAMGARD_JURIK_V1 : ENCOUNTER_COUNT_PAILLIER_V1)
+
+/* Counter string prefix of the Damgard-Jurik counters */
+#define EC_DJ_TAG            "DJ:"
+#define EC_DJ_TAG_LEN        (sizeof EC_DJ_TAG - 1)
+/* and of the packed ones, slots and width */
+#define EC_PACKED_TAG        "P%u.%u:"
+
 
 /* Some static prototypes */
 static encounter_err_t rng_init (void);
@@ -35,6 +64,9 @@ static encounter_err_t rng_init (void);
 static encounter_err_t encounter_crypto_openssl_new_keyctx(\
 			const encounter_key_t, ec_keyctx_t **);
 
+static encounter_err_t encounter_crypto_openssl_nplus1FromString(\
+			encounter_t *, ec_keyctx_t **);
+
 static encounter_err_t encounter_crypto_openssl_invMod2toW(\
 	encounter_t *,	BIGNUM *, const BIGNUM *, BN_CTX *);
 
@@ -47,24 +79,25 @@ static encounter_err_t encounter_crypto_openssl_fastL(\
       					const BIGNUM *, BN_CTX *);
 
 static encounter_err_t encounter_crypto_openssl_paillierEncrypt(\
-	encounter_t *, BIGNUM *, const BIGNUM *, const ec_keyctx_t *);
-
-static encounter_err_t IsInZnstar(encounter_t *, const BIGNUM *, \
-				const BIGNUM *, BN_CTX *, bool *);
+	encounter_t *, BIGNUM *, const BIGNUM *, ec_keyctx_t *, ec_keyctx_t *);
 
-static encounter_err_t IsInZnSquaredstar(encounter_t *, \
-	     const BIGNUM *a, const BIGNUM *n, BN_CTX *bnctx, bool *);
+static encounter_err_t encounter_crypto_openssl_randomizer(\
+	encounter_t *, BIGNUM *, ec_keyctx_t *, ec_keyctx_t *, BN_CTX *);
 
 static encounter_err_t encounter_crypto_openssl_paillierUpdate(\
-	encounter_t *, BIGNUM *, const ec_keyctx_t *, BN_CTX *, \
+	encounter_t *, BIGNUM *, ec_keyctx_t *, ec_keyctx_t *, BN_CTX *, \
 	const unsigned int, bool );
 
+static encounter_err_t encounter_crypto_openssl_paillierUpdateBN(\
+	encounter_t *, BIGNUM *, ec_keyctx_t *, ec_keyctx_t *, BN_CTX *, \
+	const BIGNUM *, bool);
+
 static encounter_err_t encounter_crypto_openssl_paillierAddSub(\
-    encounter_t *, BIGNUM *, BIGNUM *, const ec_keyctx_t *, \
-                                        BN_CTX *, const bool);
+    encounter_t *, BIGNUM *, BIGNUM *, const struct ec_mont_s *, \
+                  ec_keyctx_t *, ec_keyctx_t *, BN_CTX *, const bool);
 
 static encounter_err_t encounter_crypto_openssl_paillierMul(\
-	encounter_t *, BIGNUM *, const ec_keyctx_t *, BN_CTX *, \
+	encounter_t *, BIGNUM *, ec_keyctx_t *, ec_keyctx_t *, BN_CTX *, \
 	const unsigned int, bool);
 
 static encounter_err_t encounter_crypto_openssl_fastCRT(\
@@ -73,11 +106,104 @@ static encounter_err_t encounter_crypto_openssl_fastCRT(\
 							BN_CTX *bnctx);
 
 static encounter_err_t encounter_crypto_openssl_new_paillierGenerator(\
-			encounter_t *,	BIGNUM *, const ec_keyctx_t *);
+	encounter_t *, BIGNUM *, const BIGNUM *, const BIGNUM *, \
+							ec_keyctx_t *);
+
+static encounter_err_t encounter_crypto_openssl_generatorHalf(\
+	encounter_t *, struct ec_keygen_s *, BIGNUM *, const unsigned int, \
+								BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_keygenHalf(encounter_t *, \
+					void *, unsigned int, size_t);
+
+static bool encounter_crypto_openssl_keygen_canceled(\
+					struct ec_keygen_s *);
+
+static int encounter_crypto_openssl_genprimeCb(int, int, BN_GENCB *);
 
 static encounter_err_t encounter_crypto_openssl_qInv(encounter_t *ctx, \
 		BIGNUM *,  const BIGNUM *, const BIGNUM *, BN_CTX *);
 
+static const BIGNUM *encounter_crypto_openssl_modulus(\
+			const ec_keyctx_t *, const ec_modulus_t);
+
+static struct ec_mont_s *encounter_crypto_openssl_mont_ref(\
+						struct ec_mont_s *);
+
+static void encounter_crypto_openssl_mont_unref(struct ec_mont_s *);
+
+static encounter_err_t encounter_crypto_openssl_counterForm(\
+	encounter_t *, ec_count_t *, ec_keyctx_t *, BN_CTX *, const bool);
+
+static encounter_err_t encounter_crypto_openssl_counterValue(\
+	encounter_t *, BIGNUM *, const ec_count_t *, BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_hConstantNPlus1(\
+	encounter_t *, BIGNUM *, const BIGNUM *, const BIGNUM *, BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_gToM(encounter_t *, \
+	BIGNUM *, const BIGNUM *, ec_keyctx_t *, BN_CTX *, const bool);
+
+static encounter_err_t encounter_crypto_openssl_invModNSquared(\
+	encounter_t *, BIGNUM *, const BIGNUM *, ec_keyctx_t *, BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_ownerCheck(encounter_t *, \
+			ec_keyctx_t *, ec_keyctx_t *, BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_crtInv(encounter_t *, \
+			ec_keyctx_t *, BN_CTX *, const BIGNUM **);
+
+static encounter_err_t encounter_crypto_openssl_crtExp(encounter_t *, \
+	BIGNUM *, const BIGNUM *, const BIGNUM *, ec_keyctx_t *, BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_crtRtothen(encounter_t *, \
+			BIGNUM *, const BIGNUM *, ec_keyctx_t *, BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_decryptHalf(encounter_t *, \
+	BIGNUM *, const BIGNUM *, ec_keyctx_t *, const bool, BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_decryptHalves(\
+	encounter_t *, BIGNUM **, const BIGNUM **, const size_t, \
+				ec_keyctx_t *, const bool, BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_crtHalves(encounter_t *, \
+	BIGNUM *, const BIGNUM *, const BIGNUM *, ec_keyctx_t *, BN_CTX *);
+
+static char *encounter_crypto_openssl_degreeToString(const unsigned int);
+
+static encounter_err_t encounter_crypto_openssl_degreeFromString(\
+			encounter_t *, ec_keyctx_t **, const char *);
+
+static encounter_err_t encounter_crypto_openssl_decryptBN(encounter_t *, \
+		BIGNUM *, ec_count_t *, ec_keyctx_t *, BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_bn2ull(encounter_t *, \
+			const BIGNUM *, unsigned long long int *);
+
+static encounter_err_t encounter_crypto_openssl_ull2bn(encounter_t *, \
+			BIGNUM *, const unsigned long long int);
+
+static encounter_err_t encounter_crypto_openssl_updateSlot(encounter_t *, \
+	ec_count_t *, ec_keyctx_t *, const unsigned int, \
+			const unsigned long long int, const bool);
+
+static encounter_err_t encounter_crypto_openssl_decryptBatchItem(\
+			encounter_t *, void *, unsigned int, size_t);
+
+static encounter_err_t encounter_crypto_openssl_invModNSquaredBatch(\
+	encounter_t *, BIGNUM **, BIGNUM **, const size_t, ec_keyctx_t *, \
+								BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_updateBatchItem(\
+			encounter_t *, void *, unsigned int, size_t);
+
+static encounter_err_t encounter_crypto_openssl_sumItem(encounter_t *, \
+				void *, unsigned int, size_t);
+
+static encounter_err_t encounter_crypto_openssl_updateBatch(encounter_t *,\
+	ec_count_t **, ec_count_t **, const unsigned int *, const size_t, \
+							ec_keyctx_t *);
+
 
 
 
@@ -89,20 +215,13 @@ static encounter_err_t rng_init(void)
         seed_p = malloc(sizeof *seed_p);
         if(!seed_p) return (ENCOUNTER_ERR_MEM);
 
-#ifdef HAVE_ARC4RANDOM
-        for (int i = 0; i < (sizeof *seed_p/sizeof seed_p->r[0]); ++i)
-                seed_p->r[i] = arc4random_uniform(UINT32_MAX);
-#else   /* Revert on /dev/urandom */
-        do {
-                FILE *f = fopen("/dev/urandom", "r");
-                if (!f) return (ENCOUNTER_ERR_OS);
-                fread(seed_p, sizeof *seed_p, 1, f);
-                fclose(f);
-
-        } while(0);
-
-#endif
+        if (encounter_crypto_openssl_drbg_entropy(seed_p, sizeof *seed_p) \
+                        != ENCOUNTER_OK) {
+                free(seed_p);
+                return (ENCOUNTER_ERR_OS);
+        }
         RAND_seed(seed_p, sizeof *seed_p);
+        OPENSSL_cleanse(seed_p, sizeof *seed_p);
 
         c = RAND_status();
         if (seed_p) free(seed_p);
@@ -168,8 +287,12 @@ static encounter_err_t encounter_crypto_openssl_new_keyctx( \
 		key_p = calloc(1, sizeof *key_p);
 		if (key_p) {
 			key_p->type = type;
+			pthread_mutex_init(&key_p->lock, NULL);
 			switch (type) {
 				case EC_KEYTYPE_PAILLIER_PUBLIC:
+				case EC_KEYTYPE_PAILLIER_NPLUS1_PUBLIC:
+				case EC_KEYTYPE_DAMGARD_JURIK_PUBLIC:
+				case EC_KEYTYPE_PAILLIER_SUBGROUP_PUBLIC:
 					key_p->k.paillier_pubK.n = BN_new();
 					key_p->k.paillier_pubK.g = BN_new();
 					key_p->k.paillier_pubK.nsquared = \
@@ -183,6 +306,8 @@ static encounter_err_t encounter_crypto_openssl_new_keyctx( \
 					break;
 
 				case EC_KEYTYPE_PAILLIER_PRIVATE:
+				case EC_KEYTYPE_DAMGARD_JURIK_PRIVATE:
+				case EC_KEYTYPE_PAILLIER_SUBGROUP_PRIVATE:
 					key_p->k.paillier_privK.p = BN_new();
 					key_p->k.paillier_privK.q = BN_new();
 					key_p->k.paillier_privK.psquared = BN_new();
@@ -207,7 +332,64 @@ static encounter_err_t encounter_crypto_openssl_new_keyctx( \
 						rc = ENCOUNTER_ERR_MEM;
 					break;
 
+				case EC_KEYTYPE_ECELGAMAL_PUBLIC:
+					key_p->k.ecelgamal_pubK.group = \
+				EC_GROUP_new_by_curve_name(EC_ECELGAMAL_NID);
+					if (key_p->k.ecelgamal_pubK.group)
+						key_p->k.ecelgamal_pubK.h = \
+						EC_POINT_new(\
+						key_p->k.ecelgamal_pubK.group);
+
+					if (key_p->k.ecelgamal_pubK.h)
+						rc = ENCOUNTER_OK;
+					else
+						rc = ENCOUNTER_ERR_MEM;
+					break;
+
+				case EC_KEYTYPE_ECELGAMAL_PRIVATE:
+					key_p->k.ecelgamal_privK.group = \
+				EC_GROUP_new_by_curve_name(EC_ECELGAMAL_NID);
+					key_p->k.ecelgamal_privK.x = BN_new();
+
+					if (   key_p->k.ecelgamal_privK.group \
+					    && key_p->k.ecelgamal_privK.x)
+						rc = ENCOUNTER_OK;
+					else
+						rc = ENCOUNTER_ERR_MEM;
+					break;
+
+				case EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC:
+					key_p->k.ou_pubK.n = BN_new();
+					key_p->k.ou_pubK.g = BN_new();
+					key_p->k.ou_pubK.h = BN_new();
+
+					if (   key_p->k.ou_pubK.n \
+					    && key_p->k.ou_pubK.g \
+					    && key_p->k.ou_pubK.h)
+						rc = ENCOUNTER_OK;
+					else
+						rc = ENCOUNTER_ERR_MEM;
+					break;
+
+				case EC_KEYTYPE_OKAMOTO_UCHIYAMA_PRIVATE:
+					key_p->k.ou_privK.p = BN_new();
+					key_p->k.ou_privK.q = BN_new();
+					key_p->k.ou_privK.g = BN_new();
+					key_p->k.ou_privK.psquared = BN_new();
+					key_p->k.ou_privK.gpinv = BN_new();
+
+					if (   key_p->k.ou_privK.p \
+					    && key_p->k.ou_privK.q \
+					    && key_p->k.ou_privK.g \
+					    && key_p->k.ou_privK.psquared \
+					    && key_p->k.ou_privK.gpinv)
+						rc = ENCOUNTER_OK;
+					else
+						rc = ENCOUNTER_ERR_MEM;
+					break;
+
 				default:
+					pthread_mutex_destroy(&key_p->lock);
 					free(key_p);
 					key_p = NULL;
 					/* ctx->rc = ENCOUNTER_ERR_MEM; */
@@ -227,17 +409,31 @@ static encounter_err_t encounter_crypto_openssl_new_keyctx( \
 }
 
 encounter_err_t encounter_crypto_openssl_free_keyctx(encounter_t *ctx, ec_keyctx_t *keyctx) {
+	unsigned int i;
+
         if (!ctx) return ENCOUNTER_ERR_PARAM;
 
 	if (keyctx) {
+		/* Stop the background threads first, they use the key */
+		encounter_crypto_openssl_pool_free(ctx, keyctx);
+		encounter_crypto_openssl_fbase_free(ctx, keyctx);
+
 		switch (keyctx->type) {
 			case EC_KEYTYPE_PAILLIER_PUBLIC:
+			case EC_KEYTYPE_PAILLIER_NPLUS1_PUBLIC:
+			case EC_KEYTYPE_DAMGARD_JURIK_PUBLIC:
+			case EC_KEYTYPE_PAILLIER_SUBGROUP_PUBLIC:
 				BN_free(keyctx->k.paillier_pubK.n);
 				BN_free(keyctx->k.paillier_pubK.g);
 				BN_free(keyctx->k.paillier_pubK.nsquared);
+				BN_free(keyctx->k.paillier_pubK.ns);
+				BN_free(keyctx->k.paillier_pubK.nsplus1);
+				BN_free(keyctx->k.paillier_pubK.gn);
 				break;
 
 			case EC_KEYTYPE_PAILLIER_PRIVATE:
+			case EC_KEYTYPE_DAMGARD_JURIK_PRIVATE:
+			case EC_KEYTYPE_PAILLIER_SUBGROUP_PRIVATE:
 				BN_free(keyctx->k.paillier_privK.p);
 				BN_free(keyctx->k.paillier_privK.q);
 				BN_free(keyctx->k.paillier_privK.psquared);
@@ -247,12 +443,52 @@ encounter_err_t encounter_crypto_openssl_free_keyctx(encounter_t *ctx, ec_keyctx
 				BN_free(keyctx->k.paillier_privK.hsubp);
 				BN_free(keyctx->k.paillier_privK.hsubq);
 				BN_free(keyctx->k.paillier_privK.qInv);
+				BN_clear_free(keyctx->k.paillier_privK.ps);
+				BN_clear_free(keyctx->k.paillier_privK.qs);
+				BN_clear_free(keyctx->k.paillier_privK.psplus1);
+				BN_clear_free(keyctx->k.paillier_privK.qsplus1);
+				BN_clear_free(keyctx->k.paillier_privK.djhsubp);
+				BN_clear_free(keyctx->k.paillier_privK.djhsubq);
+				BN_clear_free(keyctx->k.paillier_privK.qsInv);
+				BN_clear_free(keyctx->k.paillier_privK.alpha);
+				break;
+
+			case EC_KEYTYPE_ECELGAMAL_PUBLIC:
+				EC_POINT_free(keyctx->k.ecelgamal_pubK.h);
+				EC_GROUP_free(keyctx->k.ecelgamal_pubK.group);
+				break;
+
+			case EC_KEYTYPE_ECELGAMAL_PRIVATE:
+				BN_clear_free(keyctx->k.ecelgamal_privK.x);
+				EC_GROUP_free(keyctx->k.ecelgamal_privK.group);
+				encounter_crypto_openssl_ecelgamal_bsgs_free(\
+									keyctx);
+				break;
+
+			case EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC:
+				BN_free(keyctx->k.ou_pubK.n);
+				BN_free(keyctx->k.ou_pubK.g);
+				BN_free(keyctx->k.ou_pubK.h);
+				break;
+
+			case EC_KEYTYPE_OKAMOTO_UCHIYAMA_PRIVATE:
+				BN_clear_free(keyctx->k.ou_privK.p);
+				BN_clear_free(keyctx->k.ou_privK.q);
+				BN_clear_free(keyctx->k.ou_privK.g);
+				BN_clear_free(keyctx->k.ou_privK.psquared);
+				BN_clear_free(keyctx->k.ou_privK.gpinv);
 				break;
 			default:
 				ctx->rc = ENCOUNTER_ERR_PARAM;
 				return ctx->rc;
 		}
 
+		for (i = 0; i < EC_MOD_LAST; ++i)
+			if (keyctx->mont[i]) \
+				encounter_crypto_openssl_mont_unref(keyctx->mont[i]);
+		if (keyctx->crtinv) BN_clear_free(keyctx->crtinv);
+
+		pthread_mutex_destroy(&keyctx->lock);
 		free(keyctx);
 		ctx->rc = ENCOUNTER_OK;
 	} else ctx->rc = ENCOUNTER_ERR_PARAM;
@@ -268,37 +504,119 @@ encounter_err_t encounter_crypto_openssl_keygen(encounter_t *ctx, \
         if (!ctx)       return ENCOUNTER_ERR_PARAM;
 
 	__ENCOUNTER_SANITYCHECK_KEYTYPE(type, ENCOUNTER_ERR_PARAM);
+
+	/* The curve sets the size of the EC-ElGamal keys */
+	if (__ENCOUNTER_IS_ECELGAMAL_KEYTYPE(type)) {
+		if (keysize != ENCOUNTER_ECELGAMAL_KEYSIZE || !pubK || !privK) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+				"EC-ElGamal keys are %u-bit", \
+				ENCOUNTER_ECELGAMAL_KEYSIZE);
+			return ctx->rc;
+		}
+		*pubK = *privK = NULL;
+		if ((rc = encounter_crypto_openssl_new_keyctx(\
+			EC_KEYTYPE_ECELGAMAL_PUBLIC, pubK)) != ENCOUNTER_OK \
+		    || (rc = encounter_crypto_openssl_new_keyctx(\
+			EC_KEYTYPE_ECELGAMAL_PRIVATE, privK)) != ENCOUNTER_OK){
+			ctx->rc = rc;
+		} else if (encounter_crypto_openssl_ecelgamal_keygen(ctx, \
+				*pubK, *privK) == ENCOUNTER_OK)
+			return ctx->rc;
+
+		rc = ctx->rc;
+		if (*pubK)  encounter_crypto_openssl_free_keyctx(ctx, *pubK);
+		if (*privK) encounter_crypto_openssl_free_keyctx(ctx, *privK);
+		*pubK = *privK = NULL;
+		ctx->rc = rc;
+		return ctx->rc;
+	}
+
 	__ENCOUNTER_SANITYCHECK_KEYSIZE(keysize, ENCOUNTER_ERR_PARAM);
 
+	if (__ENCOUNTER_IS_OU_KEYTYPE(type)) {
+		if (!pubK || !privK) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+				"null param");
+			return ctx->rc;
+		}
+		*pubK = *privK = NULL;
+		if ((rc = encounter_crypto_openssl_new_keyctx(\
+		    EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC, pubK)) != ENCOUNTER_OK \
+		    || (rc = encounter_crypto_openssl_new_keyctx(\
+		    EC_KEYTYPE_OKAMOTO_UCHIYAMA_PRIVATE, privK)) != ENCOUNTER_OK){
+			ctx->rc = rc;
+		} else if (encounter_crypto_openssl_ou_keygen(ctx, keysize, \
+				*pubK, *privK) == ENCOUNTER_OK)
+			return ctx->rc;
+
+		rc = ctx->rc;
+		if (*pubK)  encounter_crypto_openssl_free_keyctx(ctx, *pubK);
+		if (*privK) encounter_crypto_openssl_free_keyctx(ctx, *privK);
+		*pubK = *privK = NULL;
+		ctx->rc = rc;
+		return ctx->rc;
+	}
+
+	/* Damgard-Jurik keys want a degree, see dj_keygen() */
+	if (type == EC_KEYTYPE_DAMGARD_JURIK_PUBLIC \
+	    || type == EC_KEYTYPE_DAMGARD_JURIK_PRIVATE) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "Damgard-Jurik keys want a degree");
+                return ctx->rc;
+	}
+
 	BN_CTX *bnctx = BN_CTX_new();
+	const bool subgroup = (type == EC_KEYTYPE_PAILLIER_SUBGROUP_PUBLIC \
+			    || type == EC_KEYTYPE_PAILLIER_SUBGROUP_PRIVATE);
+	struct ec_keygen_s kg;
 
+	*pubK = *privK = NULL;
+	encounter_crypto_openssl_keygen_init(ctx, &kg);
 
+	/* Any other type code selects the legacy random generator */
 	rc = encounter_crypto_openssl_new_keyctx(\
+		type == EC_KEYTYPE_PAILLIER_NPLUS1_PUBLIC ? type : subgroup ? \
+		EC_KEYTYPE_PAILLIER_SUBGROUP_PUBLIC : \
 				EC_KEYTYPE_PAILLIER_PUBLIC, pubK);
 	if (rc != ENCOUNTER_OK) goto err;	
 
-	rc = encounter_crypto_openssl_new_keyctx(\
+	rc = encounter_crypto_openssl_new_keyctx(subgroup ? \
+		EC_KEYTYPE_PAILLIER_SUBGROUP_PRIVATE : \
 				EC_KEYTYPE_PAILLIER_PRIVATE, privK);
 	if (rc != ENCOUNTER_OK) goto err;	
 
-	/* Generate p and q primes */
-	if (!BN_generate_prime((*privK)->k.paillier_privK.p, keysize,0,\
-					NULL, NULL, NULL, NULL) )
-		OPENSSL_ERROR(err);
+	kg.privK = *privK;
+	kg.keysize = keysize;
 
-	if (!BN_generate_prime((*privK)->k.paillier_privK.q, keysize,0,\
-					NULL, NULL, NULL, NULL) )
-		OPENSSL_ERROR(err);
+	/* Generate p and q primes, p-1 and q-1 multiple of the factors of
+	 * alpha for the subgroup keys. The others work p and q at once,
+	 * along with the halves g_p and g_q of a general g */
+	if (subgroup) {
+		if ((rc = encounter_crypto_openssl_subgroup_primes(ctx, \
+			keysize, *privK, &kg, bnctx)) != ENCOUNTER_OK)
+			goto err;
 
-	/* p^2 */
-	if (!BN_sqr((*privK)->k.paillier_privK.psquared, \
-	       (*privK)->k.paillier_privK.p, bnctx) )
-		OPENSSL_ERROR(err);
+		/* p^2 */
+		if (!BN_sqr((*privK)->k.paillier_privK.psquared, \
+		       (*privK)->k.paillier_privK.p, bnctx) )
+			OPENSSL_ERROR(err);
 
-	/* q^2 */
-	if (!BN_sqr((*privK)->k.paillier_privK.qsquared, \
-	       (*privK)->k.paillier_privK.q, bnctx) )
-		OPENSSL_ERROR(err);
+		/* q^2 */
+		if (!BN_sqr((*privK)->k.paillier_privK.qsquared, \
+		       (*privK)->k.paillier_privK.q, bnctx) )
+			OPENSSL_ERROR(err);
+	} else {
+		if ((*pubK)->type == EC_KEYTYPE_PAILLIER_PUBLIC \
+		    && ((kg.g[0] = BN_new()) == NULL \
+			|| (kg.g[1] = BN_new()) == NULL))
+			OPENSSL_ERROR(err);
+
+		if ((rc = encounter_threadpool_run(ctx, \
+			encounter_threadpool_workers(ctx->conf.batch_threads, \
+			2), 2, encounter_crypto_openssl_keygenHalf, &kg)) \
+				!= ENCOUNTER_OK)
+			goto err;
+	}
 
 	/* n = pq */
 	if (!BN_mul((*pubK)->k.paillier_pubK.n,    \
@@ -312,8 +630,18 @@ encounter_err_t encounter_crypto_openssl_keygen(encounter_t *ctx, \
 		OPENSSL_ERROR(err);
 
 	/* Generate the Paillier generator */
-	if (encounter_crypto_openssl_new_paillierGenerator( ctx, \
-		(*pubK)->k.paillier_pubK.g, *privK) != ENCOUNTER_OK)
+	if ((*pubK)->type == EC_KEYTYPE_PAILLIER_NPLUS1_PUBLIC) {
+		if (!BN_add((*pubK)->k.paillier_pubK.g, \
+			(*pubK)->k.paillier_pubK.n, BN_value_one()))
+			OPENSSL_ERROR(err);
+	} else if (subgroup) {
+		/* Along with h_p and h_q */
+		if ((rc = encounter_crypto_openssl_subgroup_generator(ctx, \
+			*pubK, *privK, bnctx)) != ENCOUNTER_OK)
+			goto err;
+	} else if (encounter_crypto_openssl_new_paillierGenerator( ctx, \
+		(*pubK)->k.paillier_pubK.g, kg.g[0], kg.g[1], *privK) \
+			!= ENCOUNTER_OK)
 		OPENSSL_ERROR(err);	/* blame OpenSSL... */
 
 	/* _p = p^-1 mod 2^w */
@@ -329,25 +657,41 @@ encounter_err_t encounter_crypto_openssl_keygen(encounter_t *ctx, \
 		OPENSSL_ERROR(err);
 
 	/* Compute H constants */
-	/* h_p */
-	if (encounter_crypto_openssl_hConstant(ctx, \
-		(*privK)->k.paillier_privK.hsubp, \
-		(*pubK)->k.paillier_pubK.g, 	\
-		(*privK)->k.paillier_privK.p, 	\
-		(*privK)->k.paillier_privK.psquared, \
-		(*privK)->k.paillier_privK.pinvmod2tow, bnctx) \
-	  != ENCOUNTER_OK)
-		OPENSSL_ERROR(err);
+	if ((*pubK)->type == EC_KEYTYPE_PAILLIER_NPLUS1_PUBLIC) {
+		/* h_p = -q^-1 mod p */
+		if (encounter_crypto_openssl_hConstantNPlus1(ctx, \
+			(*privK)->k.paillier_privK.hsubp, \
+			(*privK)->k.paillier_privK.p, \
+			(*privK)->k.paillier_privK.q, bnctx) != ENCOUNTER_OK)
+			OPENSSL_ERROR(err);
 
-	/* h_q */
-	if (encounter_crypto_openssl_hConstant( ctx, \
-		(*privK)->k.paillier_privK.hsubq, \
-		(*pubK)->k.paillier_pubK.g, 	\
-		(*privK)->k.paillier_privK.q, 	\
-		(*privK)->k.paillier_privK.qsquared, \
-		(*privK)->k.paillier_privK.qinvmod2tow, bnctx) \
-	  != ENCOUNTER_OK)
-		OPENSSL_ERROR(err);
+		/* h_q = -p^-1 mod q */
+		if (encounter_crypto_openssl_hConstantNPlus1(ctx, \
+			(*privK)->k.paillier_privK.hsubq, \
+			(*privK)->k.paillier_privK.q, \
+			(*privK)->k.paillier_privK.p, bnctx) != ENCOUNTER_OK)
+			OPENSSL_ERROR(err);
+	} else if (!subgroup) {
+		/* h_p */
+		if (encounter_crypto_openssl_hConstant(ctx, \
+			(*privK)->k.paillier_privK.hsubp, \
+			(*pubK)->k.paillier_pubK.g, 	\
+			(*privK)->k.paillier_privK.p, 	\
+			(*privK)->k.paillier_privK.psquared, \
+			(*privK)->k.paillier_privK.pinvmod2tow, bnctx) \
+		  != ENCOUNTER_OK)
+			OPENSSL_ERROR(err);
+
+		/* h_q */
+		if (encounter_crypto_openssl_hConstant( ctx, \
+			(*privK)->k.paillier_privK.hsubq, \
+			(*pubK)->k.paillier_pubK.g, 	\
+			(*privK)->k.paillier_privK.q, 	\
+			(*privK)->k.paillier_privK.qsquared, \
+			(*privK)->k.paillier_privK.qinvmod2tow, bnctx) \
+		  != ENCOUNTER_OK)
+			OPENSSL_ERROR(err);
+	}
  
 	/* Q^-1 */
 	if (encounter_crypto_openssl_qInv(ctx,\
@@ -358,80 +702,46 @@ encounter_err_t encounter_crypto_openssl_keygen(encounter_t *ctx, \
 
 
 	if (bnctx) BN_CTX_free(bnctx);
+	encounter_crypto_openssl_keygen_destroy(&kg);
 
 	ctx->rc = ENCOUNTER_OK;
 	return ctx->rc;
 
 err:
-	ctx->rc = rc;
+	/* rc is left ENCOUNTER_OK by the OpenSSL failures, and the frees
+	 * reset ctx->rc */
+	if (rc == ENCOUNTER_OK) rc = ctx->rc;
 	if (bnctx) BN_CTX_free(bnctx);
+	encounter_crypto_openssl_keygen_destroy(&kg);
 	if (*pubK) encounter_crypto_openssl_free_keyctx(ctx, *pubK);
 	if (*privK) encounter_crypto_openssl_free_keyctx(ctx, *privK);
+	*pubK = *privK = NULL;
+	ctx->rc = rc;
 
 	return  ctx->rc;
 }
 
+/** g from its halves g_p and g_q, by the CRT */
 static encounter_err_t encounter_crypto_openssl_new_paillierGenerator(\
-		encounter_t *ctx, BIGNUM *g, const ec_keyctx_t *privK)
+	encounter_t *ctx, BIGNUM *g, const BIGNUM *gsubp, \
+			const BIGNUM *gsubq, ec_keyctx_t *privK)
 {
 	if (!ctx)         return ENCOUNTER_ERR_PARAM;
-	if (!g || !privK) {
+	if (!g || !gsubp || !gsubq || !privK) {
                 encounter_set_error(ctx, ENCOUNTER_ERR_PARAM,
                         "null param");
-                goto end;
+                return ctx->rc;
         }
 
-	BIGNUM *tmp, *inv, *pmin1, *qmin1, *gsubp, *gsubq;
-	bool in = false;
 	BN_CTX *bnctx = BN_CTX_new();
-	BN_CTX_start(bnctx);
-
-	tmp = BN_CTX_get(bnctx); inv = BN_CTX_get(bnctx);
-	pmin1 = BN_CTX_get(bnctx); qmin1 = BN_CTX_get(bnctx);
-	gsubp = BN_CTX_get(bnctx);gsubq = BN_CTX_get(bnctx);
+	if (!bnctx) OPENSSL_ERROR(out);
 
-	if (!gsubq) OPENSSL_ERROR(end);
+	BN_CTX_start(bnctx);
+	BIGNUM *tmp = BN_CTX_get(bnctx);
+	BIGNUM *inv = BN_CTX_get(bnctx);
 
-	/* p-1 and q-1 */
-	if (!BN_sub(pmin1, privK->k.paillier_privK.p, BN_value_one()))
-			OPENSSL_ERROR(end);
-	if (!BN_sub(qmin1, privK->k.paillier_privK.q, BN_value_one()))
-			OPENSSL_ERROR(end);
+	if (!inv) OPENSSL_ERROR(end);
 
-	/* g_p */
-	for (;;) {
-   		if (!BN_rand_range(gsubp, privK->k.paillier_privK.psquared))
-			OPENSSL_ERROR(end);
-   		if (IsInZnSquaredstar(ctx, gsubp, \
-			privK->k.paillier_privK.psquared, bnctx, &in) \
-				!= ENCOUNTER_OK )
-			OPENSSL_ERROR(end);
-		if (in)
-      		{
-      			if (!BN_mod_exp(tmp, gsubp, pmin1, \
-				privK->k.paillier_privK.psquared, bnctx))
-				OPENSSL_ERROR(end);
-      			if (BN_are_not_equal(tmp, BN_value_one()))
-         			break;
-      		}
-   	}
-	/* g_q */
-	for (;;) {
-   		if (!BN_rand_range(gsubq, privK->k.paillier_privK.qsquared))
-			OPENSSL_ERROR(end);
-   		if (IsInZnSquaredstar(ctx, gsubq, \
-			privK->k.paillier_privK.qsquared, bnctx, &in) \
-				!= ENCOUNTER_OK )
-			OPENSSL_ERROR(end);
-		if (in)
-      		{
-      			if (!BN_mod_exp(tmp, gsubq, qmin1, \
-				privK->k.paillier_privK.qsquared, bnctx))
-				OPENSSL_ERROR(end);
-      			if (BN_are_not_equal(tmp, BN_value_one()))
-         			break;
-      		}
-   	}
 	/* (q^2 mod p^2)^-1 */
 	if (!BN_mod(tmp, privK->k.paillier_privK.qsquared, \
 		privK->k.paillier_privK.psquared, bnctx))
@@ -447,20 +757,227 @@ static encounter_err_t encounter_crypto_openssl_new_paillierGenerator(\
 	ctx->rc = ENCOUNTER_OK;
 
 end:
-
 	if (tmp)   BN_clear(tmp);
 	if (inv)   BN_clear(inv);
-	if (pmin1) BN_clear(pmin1);
-	if (qmin1) BN_clear(qmin1);
-	if (gsubp) BN_clear(gsubp);
-	if (gsubq) BN_clear(gsubq);
 
-	if (bnctx) BN_CTX_end(bnctx);
+	BN_CTX_end(bnctx);
+	BN_CTX_free(bnctx);
+
+out:
+	return ctx->rc;
+}
+
+/** The half g_p of a general g modulo p^2 for item 0, g_q modulo q^2
+ * for item 1: an element of Z*_p^2 of order divisible by p, that is with
+ * g_p^(p-1) != 1 mod p^2. All but a fraction 2/p of the draws pass, the
+ * unit test being p not dividing g_p */
+static encounter_err_t encounter_crypto_openssl_generatorHalf(\
+	encounter_t *ctx, struct ec_keygen_s *kg, BIGNUM *g, \
+			const unsigned int item, BN_CTX *bnctx)
+{
+	const BIGNUM *p, *psquared;
+
+	p = item ? kg->privK->k.paillier_privK.q \
+			: kg->privK->k.paillier_privK.p;
+	psquared = item ? kg->privK->k.paillier_privK.qsquared \
+			: kg->privK->k.paillier_privK.psquared;
+
+	BN_CTX_start(bnctx);
+	BIGNUM *pmin1 = BN_CTX_get(bnctx);
+	BIGNUM *tmp = BN_CTX_get(bnctx);
+
+	if (!tmp) OPENSSL_ERROR(end);
+	if (!BN_sub(pmin1, p, BN_value_one())) OPENSSL_ERROR(end);
+
+	for (;;) {
+		if (!encounter_crypto_openssl_keygen_step(kg, \
+				EC_KEYGEN_GENERATOR, item)) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_CANCELED, \
+				"key generation canceled");
+			goto end;
+		}
+
+		if (!BN_rand_range(g, psquared)) OPENSSL_ERROR(end);
+		if (!BN_mod(tmp, g, p, bnctx)) OPENSSL_ERROR(end);
+		if (BN_is_zero(tmp)) continue;
+
+		if (encounter_crypto_openssl_expmod(ctx, tmp, g, pmin1, \
+			kg->privK, item ? EC_MOD_QSQUARED : EC_MOD_PSQUARED, \
+						bnctx) != ENCOUNTER_OK)
+			goto end;
+		if (BN_are_not_equal(tmp, BN_value_one())) break;
+	}
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (tmp)   BN_clear(tmp);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** Item 0 of a Paillier key generation works p, p^2 and g_p, item 1
+ * q, q^2 and g_q, each on its own worker */
+static encounter_err_t encounter_crypto_openssl_keygenHalf(encounter_t *ctx,\
+		void *arg, unsigned int worker, size_t item)
+{
+	struct ec_keygen_s *kg = arg;
+	struct paillier_privatekey *sk = &kg->privK->k.paillier_privK;
+	BIGNUM *p = item ? sk->q : sk->p;
+	BIGNUM *psquared = item ? sk->qsquared : sk->psquared;
+
+	(void) worker;
+
+	BN_CTX *bnctx = BN_CTX_new();
+	if (!bnctx) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_genprime(ctx, kg, p, kg->keysize, \
+			NULL, NULL, item) != ENCOUNTER_OK)
+		goto end;
+
+	if (!BN_sqr(psquared, p, bnctx)) OPENSSL_ERROR(end);
+
+	if (kg->g[item] && encounter_crypto_openssl_generatorHalf(ctx, kg, \
+			kg->g[item], item, bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
 	if (bnctx) BN_CTX_free(bnctx);
 
 	return ctx->rc;
 }
 
+/** Set up the shared state of a key generation from the configuration
+ * of ctx */
+void encounter_crypto_openssl_keygen_init(encounter_t *ctx, \
+						struct ec_keygen_s *kg)
+{
+	memset(kg, 0, sizeof *kg);
+	pthread_mutex_init(&kg->lock, NULL);
+	kg->cb = ctx->conf.keygen_progress;
+	kg->arg = ctx->conf.keygen_arg;
+}
+
+void encounter_crypto_openssl_keygen_destroy(struct ec_keygen_s *kg)
+{
+	if (kg->g[0]) BN_clear_free(kg->g[0]);
+	if (kg->g[1]) BN_clear_free(kg->g[1]);
+	pthread_mutex_destroy(&kg->lock);
+	memset(kg, 0, sizeof *kg);
+}
+
+/** Report a step of the key generation to the progress callback, one
+ * call at a time. False once the generation is canceled, from any of
+ * its threads */
+bool encounter_crypto_openssl_keygen_step(struct ec_keygen_s *kg, \
+	const encounter_keygen_step_t step, const unsigned int prime)
+{
+	bool go;
+
+	pthread_mutex_lock(&kg->lock);
+	if (!kg->canceled && kg->cb && kg->cb(kg->arg, step, prime))
+		kg->canceled = true;
+	go = !kg->canceled;
+	pthread_mutex_unlock(&kg->lock);
+
+	return go;
+}
+
+static bool encounter_crypto_openssl_keygen_canceled(\
+					struct ec_keygen_s *kg)
+{
+	bool canceled;
+
+	pthread_mutex_lock(&kg->lock);
+	canceled = kg->canceled;
+	pthread_mutex_unlock(&kg->lock);
+
+	return canceled;
+}
+
+/* The callback of OpenSSL's prime generation: a sieved candidate, then
+ * each of its Miller-Rabin rounds. The rounds only check the
+ * cancellation */
+struct ec_genprime_s {
+	struct ec_keygen_s	*kg;
+	unsigned int		prime;
+};
+
+static int encounter_crypto_openssl_genprimeCb(int a, int b, BN_GENCB *cb)
+{
+	struct ec_genprime_s *gp = BN_GENCB_get_arg(cb);
+
+	(void) b;
+
+	if (a != 0)
+		return !encounter_crypto_openssl_keygen_canceled(gp->kg);
+
+	return encounter_crypto_openssl_keygen_step(gp->kg, \
+			EC_KEYGEN_CANDIDATE, gp->prime);
+}
+
+/** A random prime p of the given bits, p = rem mod add when add is
+ * supplied, for the prime of the given index of the key generation kg.
+ * The candidates are sieved by OpenSSL against a table of small primes
+ * before any Miller-Rabin round. ENCOUNTER_ERR_CANCELED when the progress
+ * callback asks for it */
+encounter_err_t encounter_crypto_openssl_genprime(encounter_t *ctx, \
+	struct ec_keygen_s *kg, BIGNUM *p, const int bits, \
+		const BIGNUM *add, const BIGNUM *rem, const unsigned int prime)
+{
+	struct ec_genprime_s gp;
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	BN_GENCB gencb, *cb = &gencb;
+#else
+	BN_GENCB *cb = NULL;
+#endif
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!kg || !p) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	cb = BN_GENCB_new();
+	if (!cb) OPENSSL_ERROR(end);
+#endif
+
+	gp.kg = kg;
+	gp.prime = prime;
+	BN_GENCB_set(cb, encounter_crypto_openssl_genprimeCb, &gp);
+
+	if (!BN_generate_prime_ex(p, bits, 0, add, rem, cb)) {
+		if (encounter_crypto_openssl_keygen_canceled(kg)) {
+			ERR_clear_error();
+			encounter_set_error(ctx, ENCOUNTER_ERR_CANCELED, \
+				"key generation canceled");
+			goto end;
+		}
+		OPENSSL_ERROR(end);
+	}
+
+	if (!encounter_crypto_openssl_keygen_step(kg, EC_KEYGEN_PRIME, \
+			prime)) {
+		encounter_set_error(ctx, ENCOUNTER_ERR_CANCELED, \
+			"key generation canceled");
+		goto end;
+	}
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	if (cb) BN_GENCB_free(cb);
+#endif
+
+	return ctx->rc;
+}
+
 static encounter_err_t encounter_crypto_openssl_qInv(encounter_t *ctx, \
 	BIGNUM *qInv, const BIGNUM *p, const BIGNUM *q, BN_CTX *bnctx)
 
@@ -530,8 +1047,9 @@ static encounter_err_t encounter_crypto_openssl_hConstant (\
 
 	if (!BN_sub(pmin1,p,BN_value_one())) OPENSSL_ERROR(end);
 	if (!BN_mod(tmp,g,psquared,bnctx)) OPENSSL_ERROR(end);
-	if (!BN_mod_exp(tmp,tmp,pmin1,psquared,bnctx)) 
-		OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_expmodBN(ctx, tmp, tmp, pmin1, \
+			psquared, bnctx) != ENCOUNTER_OK)
+		goto end;
 
 	if (encounter_crypto_openssl_fastL(ctx, \
 			hsubp,tmp,p,pinvmod2tow,bnctx) != ENCOUNTER_OK)
@@ -548,6 +1066,30 @@ end:
 	return ctx->rc;
 }
 
+/* With g = n+1, g^(p-1) = 1 + (p-1)n mod p^2 and L_p of it is -q mod p,
+ * so h_p = -q^-1 mod p needs no exponentiation. Same for h_q. */
+static encounter_err_t encounter_crypto_openssl_hConstantNPlus1(\
+	encounter_t *ctx, BIGNUM *hsubp, const BIGNUM *p, const BIGNUM *q, \
+							BN_CTX *bnctx)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+        if (!hsubp || !p || !q || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                goto end;
+        }
+
+	if (encounter_crypto_openssl_qInv(ctx, hsubp, p, q, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (!BN_sub(hsubp, p, hsubp)) OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	return ctx->rc;
+}
+
 static encounter_err_t encounter_crypto_openssl_fastL(encounter_t *ctx,\
                           BIGNUM *y, const BIGNUM *u, const BIGNUM *n, \
                                const BIGNUM *ninvmod2tow, BN_CTX *bnctx)
@@ -581,18 +1123,35 @@ end:
 }
 
 
-encounter_err_t encounter_crypto_openssl_new_counter(encounter_t *ctx, ec_keyctx_t *pubK, ec_count_t **counter) 
+encounter_err_t encounter_crypto_openssl_new_counter(encounter_t *ctx, ec_keyctx_t *pubK, ec_keyctx_t *privK, ec_count_t **counter) 
 {
         if (!ctx)       return ENCOUNTER_ERR_PARAM;
 
 	if (counter) {
 		*counter = calloc(1, sizeof **counter);
-		if (*counter) {
-			(*counter)->version = ENCOUNTER_COUNT_PAILLIER_V1;
+		if (*counter && pubK && EC_IS_ECELGAMAL(pubK)) {
+			if (encounter_crypto_openssl_ecelgamal_new_counter(\
+				ctx, pubK, *counter) != ENCOUNTER_OK) {
+				encounter_crypto_openssl_free_counter(ctx, \
+								*counter);
+				free(*counter);
+				*counter = NULL;
+			}
+		} else if (*counter && pubK && EC_IS_OU(pubK)) {
+			if (encounter_crypto_openssl_ou_new_counter(ctx, \
+					pubK, *counter) != ENCOUNTER_OK) {
+				encounter_crypto_openssl_free_counter(ctx, \
+								*counter);
+				free(*counter);
+				*counter = NULL;
+			}
+		} else if (*counter) {
+			(*counter)->version = pubK ? EC_COUNT_VERSION(pubK) \
+						: ENCOUNTER_COUNT_PAILLIER_V1;
 			(*counter)->c = BN_new();
 
 			encounter_crypto_openssl_paillierEncrypt(\
-				ctx, (*counter)->c, ctx->m, pubK);
+				ctx, (*counter)->c, ctx->m, pubK, privK);
                         if (ctx->rc == ENCOUNTER_OK) {
 			        /* Update the time of last modification */
 			        time(&((*counter)->lastUpdated));
@@ -616,6 +1175,10 @@ encounter_err_t encounter_crypto_openssl_free_counter(encounter_t *ctx, ec_count
 
 	if (counter_p) {
 		BN_free(counter_p->c);
+		if (counter_p->mont)
+			encounter_crypto_openssl_mont_unref(counter_p->mont);
+		if (counter_p->c1) EC_POINT_clear_free(counter_p->c1);
+		if (counter_p->c2) EC_POINT_clear_free(counter_p->c2);
 		memset(counter_p, 0, sizeof *counter_p);
 
 	} else ctx->rc = ENCOUNTER_ERR_PARAM;
@@ -623,784 +1186,3021 @@ encounter_err_t encounter_crypto_openssl_free_counter(encounter_t *ctx, ec_count
 	return ctx->rc;
 }
 
-static encounter_err_t encounter_crypto_openssl_paillierEncrypt(\
-  encounter_t *ctx, BIGNUM *c, const BIGNUM *m, const ec_keyctx_t *pubK)
+/* A bulk creation of counters, in runs of PAILLIER_NEW_RUN counters */
+struct ec_new_counters_s {
+	ec_count_t	**counters;
+	size_t		n;
+	const unsigned int *initial;	/* NULL for all zero */
+	ec_keyctx_t	*pubK;
+	BN_CTX		**bnctx;	/* Scratch, by worker */
+};
+
+/* The randomizers of a run are drawn together, in place in the counters,
+ * and only the non-zero initial values cost a g^m */
+static encounter_err_t encounter_crypto_openssl_newCountersItem(\
+	encounter_t *ctx, void *arg, unsigned int worker, size_t item)
 {
-        if (!ctx)               return ENCOUNTER_ERR_PARAM;
-        if (!c || !m || !pubK)  {
-                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
-                        "null param");
-                goto end;
-        }
+	struct ec_new_counters_s *b = arg;
+	BN_CTX *bnctx = b->bnctx[worker];
+	BIGNUM *rn[PAILLIER_NEW_RUN];
+	struct ec_mont_s *mont;
+	const size_t first = item * PAILLIER_NEW_RUN;
+	size_t i, run;
+
+	run = b->n - first < PAILLIER_NEW_RUN ? b->n - first : \
+							PAILLIER_NEW_RUN;
+	for (i = 0; i < run; ++i)
+		rn[i] = b->counters[first + i]->c;
+
+	if (encounter_crypto_openssl_mont(ctx, b->pubK, EC_MOD_NSQUARED, \
+			bnctx, &mont) != ENCOUNTER_OK)
+		return ctx->rc;
 
-	BN_CTX *bnctx = BN_CTX_new();
-	bool in = false;
 	BN_CTX_start(bnctx);
-	BIGNUM *tmp   = BN_CTX_get(bnctx);
-	BIGNUM *tmp2  = BN_CTX_get(bnctx);
-	BIGNUM *r     = BN_CTX_get(bnctx);
+	BIGNUM *gm = BN_CTX_get(bnctx);
+	BIGNUM *m = BN_CTX_get(bnctx);
 
+	if (!m) OPENSSL_ERROR(end);
 
-	if (!BN_mod_exp(tmp, pubK->k.paillier_pubK.g, m, \
-			pubK->k.paillier_pubK.nsquared, bnctx))
-		OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_new_randomizers(ctx, rn, run, b->pubK,\
+			bnctx) != ENCOUNTER_OK)
+		goto end;
 
-	for (;;)
-   	{
-   		if (!BN_rand_range(r, pubK->k.paillier_pubK.n))
-			OPENSSL_ERROR(end);
-   		if (IsInZnstar(ctx, r,pubK->k.paillier_pubK.n, \
-				bnctx, &in) != ENCOUNTER_OK) {
-			OPENSSL_ERROR(end); 
+	for (i = 0; i < run; ++i) {
+		/* g^0 = 1, the randomizer alone */
+		if (b->initial && b->initial[first + i]) {
+			if (!BN_set_word(m, b->initial[first + i]))
+				OPENSSL_ERROR(end);
+			if (encounter_crypto_openssl_gToM(ctx, gm, m, b->pubK,\
+					bnctx, false) != ENCOUNTER_OK)
+				goto end;
+			if (encounter_crypto_openssl_montmul(ctx, rn[i], gm, \
+				rn[i], b->pubK, EC_MOD_NSQUARED, bnctx) \
+					!= ENCOUNTER_OK)
+				goto end;
 		}
-		if (in == true) break;
-   	}
 
-	if (!BN_mod_exp(tmp2, r, pubK->k.paillier_pubK.n, \
-		pubK->k.paillier_pubK.nsquared, bnctx))
-		OPENSSL_ERROR(end);
-	if (!BN_mod_mul(c, tmp, tmp2, \
-			pubK->k.paillier_pubK.nsquared, bnctx))
-		OPENSSL_ERROR(end);
+		if (!BN_from_montgomery(rn[i], rn[i], mont->ctx, bnctx))
+			OPENSSL_ERROR(end);
+	}
 
 	ctx->rc = ENCOUNTER_OK;
 
 end:
-	if (tmp)   BN_clear(tmp); 
-	if (tmp2)  BN_clear(tmp2); 
-	if (r)     BN_clear(r);
-	if (bnctx) BN_CTX_end(bnctx);
-	if (bnctx) BN_CTX_free(bnctx);
+	if (m)  BN_clear(m);
+	if (gm) BN_clear(gm);
+	BN_CTX_end(bnctx);
 
 	return ctx->rc;
 }
 
-static encounter_err_t IsInZnstar(encounter_t *ctx, const BIGNUM *a,\
-		const BIGNUM *n, BN_CTX *bnctx, bool *in)
+/** Create n counters of pubK at once, counter k holding initial[k], or 0
+ * when initial is NULL. The handles are allocated in a single block,
+ * counters[0] at its head, for free_counters(). The Paillier family of
+ * keys works runs of counters on up to conf.batch_threads threads; the
+ * EC-ElGamal and Okamoto-Uchiyama counters are made one at a time.
+ * Nothing is left of the counters after a failure */
+encounter_err_t encounter_crypto_openssl_new_counters(encounter_t *ctx, \
+	ec_keyctx_t *pubK, const size_t n, const unsigned int *initial, \
+						ec_count_t **counters)
 {
+	struct ec_new_counters_s b;
+	struct ec_mont_s *mont;
+	ec_count_t *block = NULL;
+	encounter_err_t rc;
+	unsigned int i, workers = 0;
+	size_t k, items;
+	time_t now;
+
         if (!ctx)       return ENCOUNTER_ERR_PARAM;
-	if (!a || !n || !bnctx || !in) {
+	if (!pubK || !counters) {
                 encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
                         "null param");
-                goto end;
+                return ctx->rc;
         }
 
-	*in = true;
 	ctx->rc = ENCOUNTER_OK;
+	if (!n) return ctx->rc;
+
+	memset(&b, 0, sizeof b);
+	memset(counters, 0, n * sizeof *counters);
+	if ((block = calloc(n, sizeof *block)) == NULL) goto nomem;
+	for (k = 0; k < n; ++k)
+		counters[k] = &block[k];
+
+	if (EC_IS_ECELGAMAL(pubK) || EC_IS_OU(pubK)) {
+		for (k = 0; k < n; ++k) {
+			if ((EC_IS_ECELGAMAL(pubK) ? \
+			    encounter_crypto_openssl_ecelgamal_new_counter(ctx,\
+							pubK, &block[k]) : \
+			    encounter_crypto_openssl_ou_new_counter(ctx, \
+				pubK, &block[k])) != ENCOUNTER_OK)
+				goto end;
+			if (!initial || !initial[k]) continue;
+			if ((EC_IS_ECELGAMAL(pubK) ? \
+			    encounter_crypto_openssl_ecelgamal_update(ctx, \
+				&block[k], pubK, initial[k], false) : \
+			    encounter_crypto_openssl_ou_update(ctx, \
+				&block[k], pubK, initial[k], false)) \
+					!= ENCOUNTER_OK)
+				goto end;
+		}
 
-	if (BN_cmp(a,n) >= 0) goto end;
+		ctx->rc = ENCOUNTER_OK;
+		goto end;
+	}
 
-	BN_CTX_start(bnctx);
-	BIGNUM *tmp = BN_CTX_get(bnctx);
+	for (k = 0; k < n; ++k) {
+		block[k].version = EC_COUNT_VERSION(pubK);
+		if ((block[k].c = BN_new()) == NULL) goto nomem;
+	}
 
-	if (!tmp) OPENSSL_ERROR(end);
+	b.counters = counters;
+	b.n = n;
+	b.initial = initial;
+	b.pubK = pubK;
+	items = (n + PAILLIER_NEW_RUN - 1) / PAILLIER_NEW_RUN;
+	workers = encounter_threadpool_workers(ctx->conf.batch_threads, items);
+
+	b.bnctx = calloc(workers, sizeof *b.bnctx);
+	if (!b.bnctx) goto nomem;
+	for (i = 0; i < workers; ++i)
+		if ((b.bnctx[i] = BN_CTX_new()) == NULL) goto nomem;
+
+	/* The context is built on first use, and better once */
+	if (encounter_crypto_openssl_mont(ctx, pubK, EC_MOD_NSQUARED, \
+		b.bnctx[0], &mont) != ENCOUNTER_OK)
+		goto end;
 
-	if (!BN_gcd(tmp,a,n,bnctx)) OPENSSL_ERROR(end);
-	if (BN_is_not_one(tmp)) *in = false;
+	if (encounter_threadpool_run(ctx, workers, items, \
+		encounter_crypto_openssl_newCountersItem, &b) != ENCOUNTER_OK)
+		goto end;
 
+	ctx->rc = ENCOUNTER_OK;
+	goto end;
 
+nomem:
+	encounter_set_error(ctx, ENCOUNTER_ERR_MEM, "batch: out of memory");
 end:
-	if (tmp)   BN_clear(tmp);
-	if (bnctx) BN_CTX_end(bnctx);
+	if (b.bnctx) {
+		for (i = 0; i < workers; ++i)
+			if (b.bnctx[i]) BN_CTX_free(b.bnctx[i]);
+		free(b.bnctx);
+	}
+
+	/* Update the time of last modification */
+	if (ctx->rc == ENCOUNTER_OK) {
+		time(&now);
+		for (k = 0; k < n; ++k)
+			block[k].lastUpdated = now;
+	} else if (block) {
+		rc = ctx->rc;
+		for (k = 0; k < n; ++k)
+			encounter_crypto_openssl_free_counter(ctx, &block[k]);
+		free(block);
+		memset(counters, 0, n * sizeof *counters);
+		ctx->rc = rc;
+	}
 
 	return ctx->rc;
 }
 
-static encounter_err_t IsInZnSquaredstar(encounter_t *ctx, \
-    const BIGNUM *a, const BIGNUM *nsquared, BN_CTX *bnctx, bool *in)
+/** Dispose the n counters of new_counters(), whose block is headed by
+ * counters[0]. Some of them may have been disposed one by one already */
+encounter_err_t encounter_crypto_openssl_free_counters(encounter_t *ctx, \
+				ec_count_t **counters, const size_t n)
 {
+	size_t k;
+
         if (!ctx)       return ENCOUNTER_ERR_PARAM;
-	if (!a || !nsquared || !bnctx || !in)  {
+	if (!counters || (n && !counters[0])) {
                 encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
                         "null param");
-                goto end;
+                return ctx->rc;
         }
 
-	*in = false;
 	ctx->rc = ENCOUNTER_OK;
+	if (!n) return ctx->rc;
+
+	for (k = 0; k < n; ++k)
+		if (counters[k])
+			encounter_crypto_openssl_free_counter(ctx, counters[k]);
+	free(counters[0]);
+	memset(counters, 0, n * sizeof *counters);
+
+	return ctx->rc;
+}
 
-	if (BN_cmp(a,nsquared) >= 0) goto end;
+static encounter_err_t encounter_crypto_openssl_paillierEncrypt(\
+  encounter_t *ctx, BIGNUM *c, const BIGNUM *m, ec_keyctx_t *pubK, \
+						ec_keyctx_t *privK)
+{
+        if (!ctx)               return ENCOUNTER_ERR_PARAM;
+        if (!c || !m || !pubK)  {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                goto end;
+        }
 
+	struct ec_mont_s *mont;
+	BN_CTX *bnctx = BN_CTX_new();
 	BN_CTX_start(bnctx);
-	BIGNUM *tmp = BN_CTX_get(bnctx);
+	BIGNUM *tmp   = BN_CTX_get(bnctx);
+	BIGNUM *tmp2  = BN_CTX_get(bnctx);
 
-	if (!tmp) OPENSSL_ERROR(end);
+	if (!tmp2) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_ownerCheck(ctx, pubK, privK, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_mont(ctx, pubK, EC_MOD_NSQUARED, \
+			bnctx, &mont) != ENCOUNTER_OK)
+		goto end;
+
+	/* A general g with an inline r^n, on OpenSSL: one simultaneous
+	 * exponentiation shares the squarings of g^m and r^n */
+	if (!BN_is_zero(m) && pubK->type == EC_KEYTYPE_PAILLIER_PUBLIC \
+	    && !privK && !ctx->conf.pool_depth \
+	    && !ctx->conf.fixed_base_window \
+	    && ctx->conf.backend == EC_BACKEND_OPENSSL) {
+		if (encounter_crypto_openssl_drbg_range(ctx, &tmp, 1, \
+			pubK->k.paillier_pubK.n) != ENCOUNTER_OK)
+			goto end;
+
+		if (!BN_mod_exp2_mont(c, pubK->k.paillier_pubK.g, m, tmp, \
+			pubK->k.paillier_pubK.n, \
+			pubK->k.paillier_pubK.nsquared, bnctx, mont->ctx))
+			OPENSSL_ERROR(end);
+
+		ctx->rc = ENCOUNTER_OK;
+		goto end;
+	}
+
+	if (encounter_crypto_openssl_randomizer(ctx, tmp2, pubK, privK, \
+			bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	/* g^0 = 1, the randomizer alone */
+	if (!BN_is_zero(m)) {
+		if (encounter_crypto_openssl_gToM(ctx, tmp, m, pubK, bnctx, \
+				false) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_crypto_openssl_montmul(ctx, tmp2, tmp, tmp2, \
+				pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+			goto end;
+	}
+
+	if (!BN_from_montgomery(c, tmp2, mont->ctx, bnctx)) OPENSSL_ERROR(end);
 
-	/* a is in Z*_n^2 iff GCD(a, n^2) = 1 */
-	if (!BN_gcd(tmp,a,nsquared,bnctx)) OPENSSL_ERROR(end);
-	if (BN_is_one(tmp)) *in = true;
+	ctx->rc = ENCOUNTER_OK;
 
 end:
-	if (tmp) BN_clear(tmp);
+	if (tmp)   BN_clear(tmp); 
+	if (tmp2)  BN_clear(tmp2); 
 	if (bnctx) BN_CTX_end(bnctx);
+	if (bnctx) BN_CTX_free(bnctx);
 
 	return ctx->rc;
 }
 
-encounter_err_t encounter_crypto_openssl_inc(encounter_t *ctx, \
-	ec_count_t *counter, ec_keyctx_t *pubK, const unsigned int a) 
+/* The key modulus a Montgomery context is cached for, NULL if the key
+ * has no such modulus */
+static const BIGNUM *encounter_crypto_openssl_modulus(\
+		const ec_keyctx_t *key, const ec_modulus_t which)
+{
+	switch (key->type) {
+		case EC_KEYTYPE_PAILLIER_PUBLIC:
+		case EC_KEYTYPE_PAILLIER_NPLUS1_PUBLIC:
+		case EC_KEYTYPE_PAILLIER_SUBGROUP_PUBLIC:
+			if (which == EC_MOD_NSQUARED)
+				return key->k.paillier_pubK.nsquared;
+			break;
+		case EC_KEYTYPE_DAMGARD_JURIK_PUBLIC:
+			if (which == EC_MOD_NSQUARED)
+				return key->k.paillier_pubK.nsplus1;
+			break;
+		case EC_KEYTYPE_DAMGARD_JURIK_PRIVATE:
+			if (which == EC_MOD_PSQUARED)
+				return key->k.paillier_privK.psplus1;
+			if (which == EC_MOD_QSQUARED)
+				return key->k.paillier_privK.qsplus1;
+			if (which == EC_MOD_P)
+				return key->k.paillier_privK.p;
+			if (which == EC_MOD_Q)
+				return key->k.paillier_privK.q;
+			break;
+		case EC_KEYTYPE_PAILLIER_PRIVATE:
+		case EC_KEYTYPE_PAILLIER_SUBGROUP_PRIVATE:
+			if (which == EC_MOD_PSQUARED)
+				return key->k.paillier_privK.psquared;
+			if (which == EC_MOD_QSQUARED)
+				return key->k.paillier_privK.qsquared;
+			if (which == EC_MOD_P)
+				return key->k.paillier_privK.p;
+			if (which == EC_MOD_Q)
+				return key->k.paillier_privK.q;
+			break;
+		default:
+			break;
+	}
+
+	return NULL;
+}
+
+/** Get the Montgomery context for one of the key moduli, built on first
+ * use and kept for the lifetime of the key */
+encounter_err_t encounter_crypto_openssl_mont(encounter_t *ctx, \
+	ec_keyctx_t *key, const ec_modulus_t which, BN_CTX *bnctx, \
+					struct ec_mont_s **mont)
 {
+	const BIGNUM *m;
+
         if (!ctx)       return ENCOUNTER_ERR_PARAM;
-        if (!counter || !pubK) {
+	if (!key || !bnctx || !mont || which >= EC_MOD_LAST) {
                 encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
                         "null param");
-                goto end;
+                return ctx->rc;
         }
-	BN_CTX *bnctx = BN_CTX_new();
 
-	if (encounter_crypto_openssl_paillierUpdate(ctx, \
-		counter->c, pubK, bnctx, a, false) != ENCOUNTER_OK)
-		OPENSSL_ERROR(end);
-			
+	m = encounter_crypto_openssl_modulus(key, which);
+	if (!m) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "modulus not in key");
+                return ctx->rc;
+	}
+
+	pthread_mutex_lock(&key->lock);
+	if (!key->mont[which]) {
+		*mont = calloc(1, sizeof **mont);
+		if (*mont) {
+			(*mont)->ctx = BN_MONT_CTX_new();
+			if (!(*mont)->ctx \
+			    || !BN_MONT_CTX_set((*mont)->ctx, m, bnctx) \
+			    || (encounter_crypto_openssl_ifma_usable(m) \
+				&& encounter_crypto_openssl_ifma_mod_new(ctx, \
+					m, (*mont)->ctx, bnctx, \
+					&(*mont)->ifma) != ENCOUNTER_OK)) {
+				if ((*mont)->ctx) BN_MONT_CTX_free((*mont)->ctx);
+				free(*mont);
+				*mont = NULL;
+			} else {
+				pthread_mutex_init(&(*mont)->lock, NULL);
+				(*mont)->refs = 1;	/* The key's */
+			}
+		}
+		key->mont[which] = *mont;
+	}
+	*mont = key->mont[which];
+	pthread_mutex_unlock(&key->lock);
+
+	if (!*mont) OPENSSL_ERROR(end);
+
 	ctx->rc = ENCOUNTER_OK;
 
 end:
-	/* Update the time of last modification */
-	time(&(counter->lastUpdated));
-
-	if (bnctx) BN_CTX_free(bnctx);
 	return ctx->rc;
 }
 
-encounter_err_t encounter_crypto_openssl_dec(encounter_t *ctx, \
-         ec_count_t *counter, ec_keyctx_t *pubK, const unsigned int a) 
+static struct ec_mont_s *encounter_crypto_openssl_mont_ref(\
+					struct ec_mont_s *mont)
+{
+	pthread_mutex_lock(&mont->lock);
+	mont->refs++;
+	pthread_mutex_unlock(&mont->lock);
+
+	return mont;
+}
+
+static void encounter_crypto_openssl_mont_unref(struct ec_mont_s *mont)
+{
+	unsigned int refs;
+
+	pthread_mutex_lock(&mont->lock);
+	refs = --mont->refs;
+	pthread_mutex_unlock(&mont->lock);
+
+	if (refs) return;
+
+	BN_MONT_CTX_free(mont->ctx);
+	encounter_crypto_openssl_ifma_mod_free(mont->ifma);
+	pthread_mutex_destroy(&mont->lock);
+	free(mont);
+}
+
+/** a b mod m on the cached Montgomery context of m: b is brought to
+ * Montgomery form, then a single Montgomery product drops the factor.
+ * a may be in either form, the result is in the same one */
+encounter_err_t encounter_crypto_openssl_mulmod(encounter_t *ctx, \
+	BIGNUM *r, const BIGNUM *a, const BIGNUM *b, ec_keyctx_t *key, \
+			const ec_modulus_t which, BN_CTX *bnctx)
 {
         if (!ctx)       return ENCOUNTER_ERR_PARAM;
-        if (!counter || !pubK) {
+	if (!r || !a || !b || !key || !bnctx) {
                 encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
                         "null param");
-                goto end;
+                return ctx->rc;
         }
-	BN_CTX *bnctx = BN_CTX_new();
 
-	if (encounter_crypto_openssl_paillierUpdate(ctx, \
-		counter->c, pubK, bnctx, a, true) != ENCOUNTER_OK)
-		OPENSSL_ERROR(end);
-			
+	BN_CTX_start(bnctx);
+	BIGNUM *t = BN_CTX_get(bnctx);
+
+	if (!t) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_tomont(ctx, t, b, key, which, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_montmul(ctx, r, a, t, key, which, \
+			bnctx) != ENCOUNTER_OK)
+		goto end;
+
 	ctx->rc = ENCOUNTER_OK;
 
 end:
-	/* Update the time of last modification */
-	time(&(counter->lastUpdated));
+	if (t)     BN_clear(t);
+	if (bnctx) BN_CTX_end(bnctx);
 
-	if (bnctx) BN_CTX_free(bnctx);
 	return ctx->rc;
 }
 
-encounter_err_t encounter_crypto_openssl_mul(encounter_t *ctx, \
-         ec_count_t *counter, ec_keyctx_t *pubK, const unsigned int a)
+/** a bR^-1 mod m, the bare Montgomery product. With b in Montgomery form
+ * this is a b mod m in the form of a, at the price of one product */
+encounter_err_t encounter_crypto_openssl_montmul(encounter_t *ctx, \
+	BIGNUM *r, const BIGNUM *a, const BIGNUM *b, ec_keyctx_t *key, \
+			const ec_modulus_t which, BN_CTX *bnctx)
 {
+	struct ec_mont_s *mont;
+	const BIGNUM *m;
+
         if (!ctx)       return ENCOUNTER_ERR_PARAM;
-        if (!counter || !pubK) {
+	if (!r || !a || !b || !key || !bnctx) {
                 encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
                         "null param");
-                goto end;
+                return ctx->rc;
         }
-	BN_CTX *bnctx = BN_CTX_new();
 
-	if (encounter_crypto_openssl_paillierMul(ctx, \
-		counter->c, pubK, bnctx, a, false) != ENCOUNTER_OK)
+	if (encounter_crypto_openssl_mont(ctx, key, which, bnctx, &mont) \
+			!= ENCOUNTER_OK)
+		return ctx->rc;
+	m = encounter_crypto_openssl_modulus(key, which);
+
+	BN_CTX_start(bnctx);
+	BIGNUM *u = BN_CTX_get(bnctx);
+
+	if (!u) OPENSSL_ERROR(end);
+
+	/* Montgomery products want reduced operands, and counters read
+	 * from the outside may not be */
+	if (BN_ucmp(a, m) >= 0) {
+		if (!BN_nnmod(u, a, m, bnctx)) OPENSSL_ERROR(end);
+		a = u;
+	}
+
+	if (!BN_mod_mul_montgomery(r, a, b, mont->ctx, bnctx))
 		OPENSSL_ERROR(end);
-			
+
 	ctx->rc = ENCOUNTER_OK;
 
 end:
-	/* Update the time of last modification */
-	time(&(counter->lastUpdated));
+	if (u)     BN_clear(u);
+	if (bnctx) BN_CTX_end(bnctx);
 
-	if (bnctx) BN_CTX_free(bnctx);
 	return ctx->rc;
 }
 
-encounter_err_t encounter_crypto_openssl_mul_rand(encounter_t *ctx, \
-                                ec_count_t *counter, ec_keyctx_t *pubK)
+/** aR mod m, the Montgomery form of a */
+encounter_err_t encounter_crypto_openssl_tomont(encounter_t *ctx, \
+	BIGNUM *r, const BIGNUM *a, ec_keyctx_t *key, \
+			const ec_modulus_t which, BN_CTX *bnctx)
 {
+	struct ec_mont_s *mont;
+	const BIGNUM *m;
+
         if (!ctx)       return ENCOUNTER_ERR_PARAM;
-        if (!counter || !pubK) {
+	if (!r || !a || !key || !bnctx) {
                 encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
                         "null param");
-                goto end;
+                return ctx->rc;
         }
-	BN_CTX *bnctx = BN_CTX_new();
 
-	if (encounter_crypto_openssl_paillierMul(ctx, \
-		counter->c, pubK, bnctx, 0, true) != ENCOUNTER_OK)
-		OPENSSL_ERROR(end);
-			
+	if (encounter_crypto_openssl_mont(ctx, key, which, bnctx, &mont) \
+			!= ENCOUNTER_OK)
+		return ctx->rc;
+	m = encounter_crypto_openssl_modulus(key, which);
+
+	if (BN_ucmp(a, m) >= 0) {
+		if (!BN_nnmod(r, a, m, bnctx)) OPENSSL_ERROR(end);
+		a = r;
+	}
+	if (!BN_to_montgomery(r, a, mont->ctx, bnctx)) OPENSSL_ERROR(end);
+
 	ctx->rc = ENCOUNTER_OK;
 
 end:
-	/* Update the time of last modification */
-	time(&(counter->lastUpdated));
-
-	if (bnctx) BN_CTX_free(bnctx);
 	return ctx->rc;
 }
 
-encounter_err_t encounter_crypto_openssl_dup(encounter_t *ctx, \
-                ec_keyctx_t *pubK, ec_count_t *from, ec_count_t **to)
+/** Bring the counter to the Montgomery form modulo the n^2 of pubK, or
+ * back to the standard one. Nothing to do if it is there already */
+static encounter_err_t encounter_crypto_openssl_counterForm(\
+	encounter_t *ctx, ec_count_t *counter, ec_keyctx_t *pubK, \
+				BN_CTX *bnctx, const bool resident)
 {
+	struct ec_mont_s *mont;
+
         if (!ctx)       return ENCOUNTER_ERR_PARAM;
-	if (from && to) {
-		*to = calloc(1, sizeof **to);
-		if (*to) {
-			(*to)->version = from->version;
-			(*to)->c = BN_dup(from->c);
-                        if ((*to)->c == NULL) {
-                                encounter_set_error(ctx, \
-                                   ENCOUNTER_ERR_MEM, "openssl: %s",\
-                                   ERR_error_string(ERR_get_error(),\
-                                   NULL));
-                                free(*to);
-                                *to = NULL;
-                                return ctx->rc;
-                        }
+	if (!counter || !pubK || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (!counter->c) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "not a Paillier counter");
+                return ctx->rc;
+	}
 
-                        encounter_crypto_openssl_touch(ctx, *to, pubK);
-                        if (ctx->rc == ENCOUNTER_OK) {
-			        /* Update the time of last modification */
-			        time(&((*to)->lastUpdated));
-                        } else {
-                                free(*to);
-                                *to = NULL;
-                        }
-		} else
-			ctx->rc = ENCOUNTER_ERR_MEM;
-		
-		return ctx->rc;
+	ctx->rc = ENCOUNTER_OK;
+
+	if (resident && !counter->mont) {
+		if (encounter_crypto_openssl_mont(ctx, pubK, \
+			EC_MOD_NSQUARED, bnctx, &mont) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_crypto_openssl_tomont(ctx, counter->c, \
+			counter->c, pubK, EC_MOD_NSQUARED, bnctx) \
+				!= ENCOUNTER_OK)
+			goto end;
+		counter->mont = encounter_crypto_openssl_mont_ref(mont);
 	}
 
-	ctx->rc = ENCOUNTER_ERR_PARAM;
+	if (!resident && counter->mont) {
+		if (!BN_from_montgomery(counter->c, counter->c, \
+				counter->mont->ctx, bnctx))
+			OPENSSL_ERROR(end);
+		encounter_crypto_openssl_mont_unref(counter->mont);
+		counter->mont = NULL;
+	}
+
+end:
 	return ctx->rc;
 }
 
-encounter_err_t encounter_crypto_openssl_copy(encounter_t *ctx, \
-                ec_keyctx_t *pubK, ec_count_t *from, ec_count_t *to)
+/** The counter value in standard form, whatever the form of the counter */
+static encounter_err_t encounter_crypto_openssl_counterValue(\
+	encounter_t *ctx, BIGNUM *r, const ec_count_t *counter, BN_CTX *bnctx)
 {
-        if (from && to) {
-                to->version = from->version;
-                if (!BN_copy(to->c, from->c)) {
-                        encounter_set_error(ctx, ENCOUNTER_ERR_MEM, \
-                                "openssl: %s", ERR_error_string( \
-                                ERR_get_error(), NULL));
-                        return ctx->rc;
-                }
-
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!r || !counter || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (!counter->c) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "not a Paillier counter");
+                return ctx->rc;
+	}
 
-                /* we are returning the return code from touch() */
-                encounter_crypto_openssl_touch(ctx, to, pubK);
-                time(&(to->lastUpdated));
+	if (counter->mont) {
+		if (!BN_from_montgomery(r, counter->c, counter->mont->ctx, \
+				bnctx))
+			OPENSSL_ERROR(end);
+	} else {
+		if (!BN_copy(r, counter->c)) OPENSSL_ERROR(end);
+	}
 
-        } else  ctx->rc = ENCOUNTER_ERR_PARAM;
+	ctx->rc = ENCOUNTER_OK;
 
-        return ctx->rc;
+end:
+	return ctx->rc;
 }
 
-/* encounter_cmp() naive (and straightforward) implementation */
-encounter_err_t encounter_crypto_openssl_cmp(encounter_t *ctx, \
-                ec_count_t *a, ec_count_t *b, ec_keyctx_t *privKA,\
-                                  ec_keyctx_t *privKB, int *result)
+/** a^e mod m on the IFMA kernels when the CPU has them, on the cached
+ * Montgomery context of m otherwise, or by GMP when so configured. Both
+ * kernels take their modulus from the cache */
+encounter_err_t encounter_crypto_openssl_expmod(encounter_t *ctx, \
+	BIGNUM *r, const BIGNUM *a, const BIGNUM *e, ec_keyctx_t *key, \
+			const ec_modulus_t which, BN_CTX *bnctx)
 {
-        unsigned long long int pa, pb;
-        ec_keyctx_t *ka, *kb;
+	struct ec_mont_s *mont;
 
         if (!ctx)       return ENCOUNTER_ERR_PARAM;
-        if (!a || !b || !result) {
-                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM,
+	if (!r || !a || !e || !key || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
                         "null param");
-                goto end;
+                return ctx->rc;
         }
 
-        /* At least one private key must be supplied */
-        if (!privKA && !privKB) goto end;
+#ifdef USE_GMP
+	if (ctx->conf.backend == EC_BACKEND_GMP)
+		return encounter_crypto_openssl_gmp_expmod(ctx, r, a, e, \
+			encounter_crypto_openssl_modulus(key, which));
+#endif
 
-        /* Decrypt each counter with the respective private-key,
-         * if available. Otherwise, use the only supplied key to
-         * decrypt both */
-        ka = (privKA ? privKA : privKB);
-        kb = (privKB ? privKB : privKA);
+	if (encounter_crypto_openssl_mont(ctx, key, which, bnctx, &mont) \
+			!= ENCOUNTER_OK)
+		return ctx->rc;
 
-        if (encounter_crypto_openssl_decrypt(ctx, a, ka, &pa)
-                != ENCOUNTER_OK) OPENSSL_ERROR(end);
-        if (encounter_crypto_openssl_decrypt(ctx, b, kb, &pb)
-                != ENCOUNTER_OK) OPENSSL_ERROR(end);
+	if (!ctx->conf.portable_kernels && mont->ifma)
+		return encounter_crypto_openssl_ifma_expmod(ctx, r, a, e, \
+							mont->ifma, bnctx);
 
-             if (pa  < pb) *result = -1;
-        else if (pa == pb) *result =  0;
-        else               *result =  1;
+	if (!BN_mod_exp_mont(r, a, e, \
+		encounter_crypto_openssl_modulus(key, which), bnctx, mont->ctx))
+		OPENSSL_ERROR(end);
 
-        ctx->rc = ENCOUNTER_OK;
-end:
-        pa = 0; pb = 0;
+	ctx->rc = ENCOUNTER_OK;
 
-        return ctx->rc;
+end:
+	return ctx->rc;
 }
 
-/** encounter_private_cmp2()
- * Compares the supplied counters encrypted under a common public-key
- * without ever decrypting the same counters. encounter_private_cmp2()
- * can use the supplied private-key to decrypt a quantity derived from
- * the cryptographic counters and hard to reverse-engineer.
- * The result is -1 if a < b, 0 if a == b and 1 if a > b */
-encounter_err_t encounter_crypto_openssl_private_cmp2(encounter_t *ctx, \
-                                 ec_count_t *a, ec_count_t *b, \
-                      ec_keyctx_t *pubK,ec_keyctx_t *privK, int *result)
+/** r = a^e mod m, m a modulus with no cached context: those of the
+ * Okamoto-Uchiyama keys, and the one-off ones of the key setups. By GMP
+ * when so configured, m odd then, by BN_mod_exp() otherwise */
+encounter_err_t encounter_crypto_openssl_expmodBN(encounter_t *ctx, \
+	BIGNUM *r, const BIGNUM *a, const BIGNUM *e, const BIGNUM *m, \
+								BN_CTX *bnctx)
 {
-        if (!ctx) return ENCOUNTER_ERR_PARAM;
-        if (!a || !b || !pubK || !privK || !result) {
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!r || !a || !e || !m || !bnctx) {
                 encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
                         "null param");
-                goto end;
+                return ctx->rc;
         }
 
-        encounter_err_t rc;
-        unsigned long long int c;
-        bool in = false;
-        ec_count_t *diffAB = NULL;
-	BN_CTX *bnctx = BN_CTX_new();
-	BIGNUM *rand  = BN_CTX_get(bnctx);
-	BIGNUM *tmp   = BN_CTX_get(bnctx);
-	BIGNUM *tmp2  = BN_CTX_get(bnctx);
-	BIGNUM *r     = BN_CTX_get(bnctx);
-	BIGNUM *m     = BN_CTX_get(bnctx);
-        BIGNUM *pmin1 = BN_CTX_get(bnctx); 
-	BIGNUM *qmin1 = BN_CTX_get(bnctx);
-	BIGNUM *msubp = BN_CTX_get(bnctx); 
-        BIGNUM *msubq = BN_CTX_get(bnctx);
+#ifdef USE_GMP
+	if (ctx->conf.backend == EC_BACKEND_GMP)
+		return encounter_crypto_openssl_gmp_expmod(ctx, r, a, e, m);
+#endif
 
-        if (!msubq) OPENSSL_ERROR(end);
+	if (!BN_mod_exp(r, a, e, m, bnctx)) OPENSSL_ERROR(end);
 
-        /* diffAB = dup a */
-        if (encounter_crypto_openssl_dup(ctx, pubK, a, &diffAB) \
-                != ENCOUNTER_OK) OPENSSL_ERROR(end);
+	ctx->rc = ENCOUNTER_OK;
 
-        if (!BN_rand(rand, PAILLIER_RANDOMIZER_SECLEVEL + 2, 0, 1) \
-                != ENCOUNTER_OK) OPENSSL_ERROR(end);
+end:
+	return ctx->rc;
+}
 
-        /* Add a random delta to diffAB */
-        if (!BN_mod_exp(tmp2, pubK->k.paillier_pubK.g, rand, \
-                pubK->k.paillier_pubK.nsquared, bnctx))
-                OPENSSL_ERROR(end);
-
-        if (!BN_mod_mul(diffAB->c, diffAB->c, tmp2, \
-                        pubK->k.paillier_pubK.nsquared, bnctx) )
-                OPENSSL_ERROR(end);
-
-        for (;;)
-        {
-                if (!BN_rand_range(r, pubK->k.paillier_pubK.n) )
-                        OPENSSL_ERROR(end);
-                if (IsInZnstar(ctx, r, pubK->k.paillier_pubK.n, \
-                                bnctx, &in)  != ENCOUNTER_OK)
-                        OPENSSL_ERROR(end);
-                if (in) break;
+/** Exponentiations modulo the given modulus of the key that a call of
+ * encounter_crypto_openssl_expmod_batch() runs at once: the lanes of the
+ * multi-buffer IFMA kernels when they serve the modulus, 1 otherwise */
+size_t encounter_crypto_openssl_expmod_lanes(encounter_t *ctx, \
+			ec_keyctx_t *key, const ec_modulus_t which)
+{
+	if (ctx->conf.backend != EC_BACKEND_OPENSSL \
+	    || ctx->conf.portable_kernels \
+	    || !encounter_crypto_openssl_ifma_usable(\
+				encounter_crypto_openssl_modulus(key, which)))
+		return 1;
+
+	return EC_IFMA_LANES;
+}
+
+/** r[k] = a[k]^e mod m for the count bases of a and the same e, by runs
+ * of the multi-buffer IFMA kernels when they serve m, one by one
+ * otherwise. The results may alias the bases */
+encounter_err_t encounter_crypto_openssl_expmod_batch(encounter_t *ctx, \
+	BIGNUM **r, BIGNUM **a, const size_t count, const BIGNUM *e, \
+		ec_keyctx_t *key, const ec_modulus_t which, BN_CTX *bnctx)
+{
+	struct ec_mont_s *mont = NULL;
+	size_t lanes, k, run;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!r || !a || !e || !key || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
         }
-        if (!BN_mod_exp(tmp, r, pubK->k.paillier_pubK.n, \
-                        pubK->k.paillier_pubK.nsquared, bnctx) )
-                OPENSSL_ERROR(end);
-        if (!BN_mod_mul(diffAB->c, diffAB->c, tmp, \
-                pubK->k.paillier_pubK.nsquared, bnctx))
-                OPENSSL_ERROR(end);
-        
-        /* subtract the other counter */
-        if (encounter_crypto_openssl_sub(ctx, diffAB, b, pubK)
-                != ENCOUNTER_OK) OPENSSL_ERROR(end);
 
+	lanes = encounter_crypto_openssl_expmod_lanes(ctx, key, which);
+	if (lanes > 1 && encounter_crypto_openssl_mont(ctx, key, which, \
+			bnctx, &mont) != ENCOUNTER_OK)
+		return ctx->rc;
 
-        /* Decrypt the result */
-	/* p-1 and q-1 */
-	if (!BN_sub(pmin1, privK->k.paillier_privK.p, BN_value_one()))
-		OPENSSL_ERROR(end);
-	if (!BN_sub(qmin1, privK->k.paillier_privK.q, BN_value_one()))
-		OPENSSL_ERROR(end);
+	ctx->rc = ENCOUNTER_OK;
 
-	/* c^(p-1) mod p^2 */
-	if (!BN_mod(tmp, diffAB->c, \
-			privK->k.paillier_privK.psquared, bnctx))
-		OPENSSL_ERROR(end);
-	if (!BN_mod_exp(tmp, tmp, pmin1, \
-			privK->k.paillier_privK.psquared, bnctx))
-		OPENSSL_ERROR(end);
+	for (k = 0; k < count; k += run) {
+		run = count - k < lanes ? count - k : lanes;
 
-	/* m_p = L_p ( c^(p-1) mod p^2 ) h_p mod p */
-	if (encounter_crypto_openssl_fastL(ctx, tmp, tmp, \
-		privK->k.paillier_privK.p, \
-		privK->k.paillier_privK.pinvmod2tow, bnctx) \
-		!= ENCOUNTER_OK)
-		OPENSSL_ERROR(end);
+		/* A lone exponentiation is faster on its own */
+		if (run == 1) {
+			if (encounter_crypto_openssl_expmod(ctx, r[k], a[k], \
+				e, key, which, bnctx) != ENCOUNTER_OK)
+				break;
+		} else if (encounter_crypto_openssl_ifma_expmod_mb(ctx, \
+			r + k, a + k, run, e, mont->ifma, bnctx) \
+				!= ENCOUNTER_OK)
+			break;
+	}
 
-	if (!BN_mod_mul(msubp, tmp, privK->k.paillier_privK.hsubp, \
-			privK->k.paillier_privK.p, bnctx))
-		OPENSSL_ERROR(end);
+	return ctx->rc;
+}
 
+/** A fresh randomizer in Montgomery form: h^alpha from the fixed-base
+ * table when so configured, r^n otherwise */
+encounter_err_t encounter_crypto_openssl_new_randomizer(encounter_t *ctx,\
+		BIGNUM *rn, ec_keyctx_t *pubK, BN_CTX *bnctx)
+{
+	return encounter_crypto_openssl_new_randomizers(ctx, &rn, 1, pubK, \
+								bnctx);
+}
 
-	/* c^(q-1) */
-	if (!BN_mod(tmp, diffAB->c, \
-		privK->k.paillier_privK.qsquared, bnctx))
-		OPENSSL_ERROR(end);
-	if (!BN_mod_exp(tmp, tmp, qmin1, \
-		privK->k.paillier_privK.qsquared,bnctx))
-		OPENSSL_ERROR(end);
+/** count fresh randomizers in Montgomery form, as new_randomizer() does,
+ * the r^n ones by runs of encounter_crypto_openssl_expmod_batch() */
+encounter_err_t encounter_crypto_openssl_new_randomizers(encounter_t *ctx,\
+	BIGNUM **rn, const size_t count, ec_keyctx_t *pubK, BN_CTX *bnctx)
+{
+	size_t k;
 
-	/* m_q = L_q( c^(q-1) mod q^2 ) h_q mod q */
-	if (encounter_crypto_openssl_fastL(ctx, tmp, tmp, \
-			privK->k.paillier_privK.q, \
-			privK->k.paillier_privK.qinvmod2tow, bnctx) \
-		!= ENCOUNTER_OK)
-		OPENSSL_ERROR(end);
-	if (!BN_mod_mul(msubq, tmp, privK->k.paillier_privK.hsubq, \
-			privK->k.paillier_privK.q, bnctx))
-		OPENSSL_ERROR(end);
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
 
-	/* m = CRT(m_p, m_q) mod pq */
-	if (encounter_crypto_openssl_fastCRT(ctx, m, msubp, \
-			privK->k.paillier_privK.p, msubq, \
-			privK->k.paillier_privK.q, \
-			privK->k.paillier_privK.qInv, bnctx) \
-		!= ENCOUNTER_OK)
-		OPENSSL_ERROR(end);
+	if (ctx->conf.fixed_base_window) {
+		for (k = 0; k < count; ++k)
+			if (encounter_crypto_openssl_fbase_randomizer(ctx, \
+				rn[k], pubK, bnctx) != ENCOUNTER_OK)
+				break;
+		return ctx->rc;
+	}
 
-        /* Compare */
-        *result = BN_cmp(m, rand);
+	if (encounter_crypto_openssl_rtothen_batch(ctx, rn, count, pubK, \
+			bnctx) != ENCOUNTER_OK)
+		return ctx->rc;
 
-        /* We are done */
-	ctx->rc = ENCOUNTER_OK;
+	for (k = 0; k < count; ++k)
+		if (encounter_crypto_openssl_tomont(ctx, rn[k], rn[k], pubK, \
+			EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+			break;
 
-end:
-        c = 0;
-        if (diffAB) encounter_crypto_openssl_free_counter(ctx, diffAB);
-        if (rand)   BN_clear(rand); 
-        if (tmp)    BN_clear(tmp);
-        if (tmp2)   BN_clear(tmp2);
-        if (r)      BN_clear(r);
-	if (pmin1)  BN_clear(pmin1); 
-	if (qmin1)  BN_clear(qmin1);
-	if (msubp)  BN_clear(msubp); 
-	if (msubq)  BN_clear(msubq);
-	if (m)      BN_clear(m);
-        if (bnctx)  BN_CTX_free(bnctx);
-        return ctx->rc;
+	return ctx->rc;
 }
 
-static encounter_err_t encounter_crypto_openssl_paillierUpdate(\
-  encounter_t *ctx, BIGNUM *c, const ec_keyctx_t *pubK, BN_CTX *bnctx, \
-			const unsigned int amount, bool decrement)
+/** Compute r^n mod n^2 for a fresh r in Z*_n, r^(n^s) mod n^(s+1) for
+ * the Damgard-Jurik keys, and (g^n)^r for a short r for the subgroup
+ * ones */
+encounter_err_t encounter_crypto_openssl_rtothen(encounter_t *ctx,\
+		BIGNUM *rn, ec_keyctx_t *pubK, BN_CTX *bnctx)
+{
+	return encounter_crypto_openssl_rtothen_batch(ctx, &rn, 1, pubK, \
+								bnctx);
+}
+
+/** count fresh randomizers as rtothen() computes them. The r^n share
+ * their exponent, and run through encounter_crypto_openssl_expmod_batch()
+ * from the r drawn in place */
+encounter_err_t encounter_crypto_openssl_rtothen_batch(encounter_t *ctx,\
+	BIGNUM **rn, const size_t count, ec_keyctx_t *pubK, BN_CTX *bnctx)
 {
+	size_t	k;
+
         if (!ctx)       return ENCOUNTER_ERR_PARAM;
-	if (!c || !pubK || !bnctx) {
+	if (!rn || !pubK || !bnctx) {
                 encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
                         "null param");
-                goto end;
+                return ctx->rc;
         }
+	for (k = 0; k < count; ++k)
+		if (!rn[k]) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+				"null randomizer");
+			return ctx->rc;
+		}
 
-	BN_CTX_start(bnctx);
-	BIGNUM *tmp = BN_CTX_get(bnctx);
-	BIGNUM *tmp2 = BN_CTX_get(bnctx);
-	BIGNUM *r = BN_CTX_get(bnctx);
-	BIGNUM *m = BN_CTX_get(bnctx);
-	bool	in = false;
+	ctx->rc = ENCOUNTER_OK;
+	if (EC_IS_SUBGROUP_PUBLIC(pubK)) {
+		for (k = 0; k < count; ++k)
+			if (encounter_crypto_openssl_subgroup_rtothen(ctx, \
+				rn[k], pubK, bnctx) != ENCOUNTER_OK)
+				break;
+		return ctx->rc;
+	}
 
-	if (!m) OPENSSL_ERROR(end);
-	if (!BN_set_word(m, amount)) OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_drbg_range(ctx, rn, count, \
+			pubK->k.paillier_pubK.n) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_expmod_batch(ctx, rn, rn, count, \
+		EC_IS_DJ_PUBLIC(pubK) ? pubK->k.paillier_pubK.ns \
+		: pubK->k.paillier_pubK.n, pubK, EC_MOD_NSQUARED, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
 
-#if 0
-	fprintf(stdout, "paillier inc: before increment: ");
-	BN_print_fp(stdout, c);
-	fprintf(stdout, "\n");
-#endif
-	if (amount == 1)  {
-		/* monotonically increasing/decreasing */
-		if (!BN_copy(tmp2, pubK->k.paillier_pubK.g))
-			OPENSSL_ERROR(end);
-	} else {
-		/* increment/decrement by the given amount */
-		if (!BN_mod_exp(tmp2, pubK->k.paillier_pubK.g, m, \
-			pubK->k.paillier_pubK.nsquared, bnctx))
-			OPENSSL_ERROR(end);
-	}
+	ctx->rc = ENCOUNTER_OK;
 
+end:
+	/* No r survives a failure */
+	if (ctx->rc != ENCOUNTER_OK)
+		for (k = 0; k < count; ++k) BN_clear(rn[k]);
 
-	if (decrement) /* decrementing */
-		if (!BN_mod_inverse(tmp2, tmp2, \
-			pubK->k.paillier_pubK.nsquared, bnctx) )
-			OPENSSL_ERROR(end);
+	return ctx->rc;
+}
 
-	if (!BN_mod_mul(c, c, tmp2, \
-			pubK->k.paillier_pubK.nsquared, bnctx) )  
-		OPENSSL_ERROR(end);
-	
-	for (;;)
-   	{
-		if (!BN_rand_range(r, pubK->k.paillier_pubK.n) )
-			OPENSSL_ERROR(end);
-   		if (IsInZnstar(ctx, r, pubK->k.paillier_pubK.n, \
-				bnctx, &in)  != ENCOUNTER_OK)
-			OPENSSL_ERROR(end);
-		if (in) break;
-   	}
-	if (!BN_mod_exp(tmp, r, pubK->k.paillier_pubK.n, \
-			pubK->k.paillier_pubK.nsquared, bnctx) ) 
-		OPENSSL_ERROR(end);
-	if (!BN_mod_mul(c, c, tmp, pubK->k.paillier_pubK.nsquared, bnctx))
-		OPENSSL_ERROR(end);
+/** r^n mod n^2 in Montgomery form, ready for montmul(). Taken from the
+ * pool of precomputed randomizers when configured and not dry, computed
+ * inline otherwise. The owner of the matching private-key, when supplied,
+ * computes the inline r^n modulo p^2 and q^2 */
+static encounter_err_t encounter_crypto_openssl_randomizer(\
+	encounter_t *ctx, BIGNUM *rn, ec_keyctx_t *pubK, ec_keyctx_t *privK,\
+							BN_CTX *bnctx)
+{
+	bool got = false;
+
+	if (ctx->conf.pool_depth && encounter_crypto_openssl_pool_get(ctx,\
+		pubK, EC_POOL_RANDOMIZER, rn, &got) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	if (got) return ctx->rc;
+
+	/* h^alpha is cheaper still, as are the short subgroup exponents */
+	if (!privK || ctx->conf.fixed_base_window \
+	    || EC_IS_SUBGROUP_PUBLIC(pubK))
+		return encounter_crypto_openssl_new_randomizer(ctx, rn, \
+							pubK, bnctx);
+
+	BN_CTX_start(bnctx);
+	BIGNUM *r = BN_CTX_get(bnctx);
+
+	if (!r) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_drbg_range(ctx, &r, 1, \
+			pubK->k.paillier_pubK.n) != ENCOUNTER_OK)
+		goto end;
+
+	if (encounter_crypto_openssl_crtRtothen(ctx, rn, r, privK, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_tomont(ctx, rn, rn, pubK, \
+			EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+		goto end;
 
-#if 0
-	fprintf(stdout, "paillier inc: after incrementing: ");
-	BN_print_fp(stdout, c);
-	fprintf(stdout, "\n");
-#endif
 	ctx->rc = ENCOUNTER_OK;
 
 end:
-	if (tmp)   BN_clear(tmp); 
-	if (tmp2)  BN_clear(tmp2); 
 	if (r)     BN_clear(r);
-	if (m)     BN_clear(m);
 	if (bnctx) BN_CTX_end(bnctx);
 
 	return ctx->rc;
 }
 
-static encounter_err_t encounter_crypto_openssl_paillierMul(\
-  encounter_t *ctx, BIGNUM *c, const ec_keyctx_t *pubK, BN_CTX *bnctx,\
-	unsigned int amount, bool rand)
+/** g^m mod n^2 in Montgomery form, or g^-m when invert is set. With
+ * g = n+1 the binomial expansion stops at 1 + mn, and g^-m = 1 + (n - m)n:
+ * no exponentiation and no inversion at all. A general g is served by
+ * the fixed-base tables of g and g^-1 for the usual short m */
+static encounter_err_t encounter_crypto_openssl_gToM(encounter_t *ctx, \
+	BIGNUM *r, const BIGNUM *m, ec_keyctx_t *pubK, BN_CTX *bnctx,\
+							const bool invert)
 {
+	bool got = false;
 
         if (!ctx)       return ENCOUNTER_ERR_PARAM;
-	if (!c || !pubK || !bnctx) {
-                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM,
+	if (!r || !m || !pubK || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
                         "null param");
-                goto end;
+                return ctx->rc;
         }
 
-	BN_CTX_start(bnctx);
-	BIGNUM *tmp = BN_CTX_get(bnctx);
-	BIGNUM *r = BN_CTX_get(bnctx);
-	BIGNUM *m = BN_CTX_get(bnctx);
-	bool	in = false;
-
-	if (!m) OPENSSL_ERROR(end);
-        if (rand) {
-                if (!BN_rand(m, PAILLIER_RANDOMIZER_SECLEVEL + 2, 0, 1)
-                        != ENCOUNTER_OK) OPENSSL_ERROR(end);
-        } else  {
-	        if (!BN_set_word(m, amount)) OPENSSL_ERROR(end);
-        }
+	if (EC_IS_DJ_PUBLIC(pubK)) {
+		if (encounter_crypto_openssl_dj_gToM(ctx, r, m, pubK, bnctx, \
+				invert) != ENCOUNTER_OK)
+			goto end;
+		goto mont;
+	}
 
-#if 0
-	fprintf(stdout, "paillier inc: before increment: ");
-	BN_print_fp(stdout, c);
-	fprintf(stdout, "\n");
-#endif
-	if (!BN_mod_exp(c, c, m, \
-			pubK->k.paillier_pubK.nsquared, bnctx))
-		OPENSSL_ERROR(end);
-	
-	for (;;)
-   	{
-		if (!BN_rand_range(r, pubK->k.paillier_pubK.n) )
+	if (pubK->type == EC_KEYTYPE_PAILLIER_NPLUS1_PUBLIC) {
+		if (!BN_nnmod(r, m, pubK->k.paillier_pubK.n, bnctx))
 			OPENSSL_ERROR(end);
-   		if (IsInZnstar(ctx, r, pubK->k.paillier_pubK.n, \
-				bnctx, &in)  != ENCOUNTER_OK)
+		if (invert && !BN_is_zero(r))
+			if (!BN_sub(r, pubK->k.paillier_pubK.n, r))
+				OPENSSL_ERROR(end);
+
+		/* r < n, hence rn + 1 < n^2 */
+		if (!BN_mul(r, r, pubK->k.paillier_pubK.n, bnctx))
 			OPENSSL_ERROR(end);
-		if (in) break;
-   	}
-	if (!BN_mod_exp(tmp, r, pubK->k.paillier_pubK.n, \
-			pubK->k.paillier_pubK.nsquared, bnctx) ) 
-		OPENSSL_ERROR(end);
-	if (!BN_mod_mul(c, c, tmp, pubK->k.paillier_pubK.nsquared, bnctx))
-		OPENSSL_ERROR(end);
+		if (!BN_add_word(r, 1)) OPENSSL_ERROR(end);
+
+		goto mont;
+	}
+
+	if (encounter_crypto_openssl_fbase_gpow(ctx, r, m, pubK, bnctx, \
+			invert, &got) != ENCOUNTER_OK)
+		goto end;
+	if (got) goto end;
+
+	if (encounter_crypto_openssl_expmod(ctx, r, \
+		pubK->k.paillier_pubK.g, m, pubK, EC_MOD_NSQUARED, \
+					bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	if (invert) {
+		if (encounter_crypto_openssl_invModNSquared(ctx, r, r, \
+			pubK, bnctx) != ENCOUNTER_OK)
+			goto end;
+	}
+
+mont:
+	if (encounter_crypto_openssl_tomont(ctx, r, r, pubK, \
+			EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+		goto end;
 
-#if 0
-	fprintf(stdout, "paillier inc: after incrementing: ");
-	BN_print_fp(stdout, c);
-	fprintf(stdout, "\n");
-#endif
 	ctx->rc = ENCOUNTER_OK;
 
 end:
-	if (tmp)  BN_clear(tmp); 
-	if (r)    BN_clear(r);
-	if (m)    BN_clear(m);
-	if (bnctx) BN_CTX_end(bnctx);
-
 	return ctx->rc;
 }
 
-
-
-encounter_err_t encounter_crypto_openssl_touch(encounter_t *ctx, \
-			ec_count_t *counter, ec_keyctx_t *pubK) 
+/** a^-1 mod n^2, lifted from the half-size a^-1 mod n: if x is the
+ * inverse mod n, then x(2 - ax) is the inverse mod n^2. Each step doubles
+ * the power of n, ceil(log2(s+1)) steps for the Damgard-Jurik n^(s+1) */
+static encounter_err_t encounter_crypto_openssl_invModNSquared(\
+	encounter_t *ctx, BIGNUM *r, const BIGNUM *a, \
+			ec_keyctx_t *pubK, BN_CTX *bnctx)
 {
         if (!ctx)       return ENCOUNTER_ERR_PARAM;
-        if (!counter || !pubK) {
-                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM,
+	if (!r || !a || !pubK || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
                         "null param");
-                goto end;
+                return ctx->rc;
         }
-	BN_CTX *bnctx = BN_CTX_new();
+
+	const BIGNUM *mod = encounter_crypto_openssl_modulus(pubK, \
+							EC_MOD_NSQUARED);
+	const unsigned int top = pubK->k.paillier_pubK.s ? \
+					pubK->k.paillier_pubK.s + 1 : 2;
+	unsigned int e;
+
 	BN_CTX_start(bnctx);
-	BIGNUM *tmp = BN_CTX_get(bnctx);
-	BIGNUM *r = BN_CTX_get(bnctx);
-	bool	in = false;
+	BIGNUM *x = BN_CTX_get(bnctx);
+	BIGNUM *t = BN_CTX_get(bnctx);
 
-	if (!r)	OPENSSL_ERROR(end);
+	if (!t) OPENSSL_ERROR(end);
 
-	for (;;)
-   	{
-   		if (!BN_rand_range(r, pubK->k.paillier_pubK.n))
-			OPENSSL_ERROR(end);
-   		if (IsInZnstar(ctx, r,pubK->k.paillier_pubK.n, \
-				bnctx, &in) != ENCOUNTER_OK)
-			OPENSSL_ERROR(end);
-		if (in) break; 
-   	}
-	if (!BN_mod_exp(tmp, r, pubK->k.paillier_pubK.n, \
-			pubK->k.paillier_pubK.nsquared, bnctx))
+	if (!BN_nnmod(t, a, pubK->k.paillier_pubK.n, bnctx))
 		OPENSSL_ERROR(end);
-	if (!BN_mod_mul(counter->c, counter->c, tmp, \
-			pubK->k.paillier_pubK.nsquared, bnctx))
+	if (!BN_mod_inverse(x, t, pubK->k.paillier_pubK.n, bnctx))
 		OPENSSL_ERROR(end);
 
-	/* Update the time of last modification */
-	time(&(counter->lastUpdated));
+	for (e = 1; e < top; e *= 2) {
+		/* t = 2 - ax mod n^2 */
+		if (encounter_crypto_openssl_mulmod(ctx, t, a, x, \
+				pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+			goto end;
+		if (!BN_sub(t, mod, t)) OPENSSL_ERROR(end);
+		if (!BN_add_word(t, 2)) OPENSSL_ERROR(end);
+
+		if (encounter_crypto_openssl_mulmod(ctx, x, x, t, \
+				pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+			goto end;
+	}
+	if (!BN_copy(r, x)) OPENSSL_ERROR(end);
 
-	
 	ctx->rc = ENCOUNTER_OK;
 
 end:
-	if (tmp)   BN_clear(tmp);
-	if (r)	   BN_clear(r);
+	if (x)     BN_clear(x);
+	if (t)     BN_clear(t);
 	if (bnctx) BN_CTX_end(bnctx);
-	if (bnctx) BN_CTX_free(bnctx);
 
 	return ctx->rc;
 }
 
-encounter_err_t encounter_crypto_openssl_add(encounter_t *ctx, \
-       ec_count_t *encountA, ec_count_t *encountB, ec_keyctx_t *pubK)
+/** Owner mode wants a private-key, and the one matching pubK. Nothing
+ * to check without one */
+static encounter_err_t encounter_crypto_openssl_ownerCheck(encounter_t *ctx,\
+		ec_keyctx_t *pubK, ec_keyctx_t *privK, BN_CTX *bnctx)
 {
-        if (!ctx)       return ENCOUNTER_ERR_PARAM;
-        if (!encountA || !encountB || !pubK) {
-                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM,
-                        "null param");
-                goto end;
-        }
-	BN_CTX *bnctx = BN_CTX_new();
+	ctx->rc = ENCOUNTER_OK;
+	if (!privK) return ctx->rc;
 
-	if (encounter_crypto_openssl_paillierAddSub(ctx, \
-             encountA->c, encountB->c, pubK, bnctx, false) \
-             != ENCOUNTER_OK)
+	/* The CRT shortcuts are written for n^2 */
+	if (EC_IS_DJ_PUBLIC(pubK)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "owner mode is for Paillier keys");
+                return ctx->rc;
+	}
+	if (privK->type != (EC_IS_SUBGROUP_PUBLIC(pubK) ? \
+			EC_KEYTYPE_PAILLIER_SUBGROUP_PRIVATE : \
+				EC_KEYTYPE_PAILLIER_PRIVATE)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "owner mode wants a private-key");
+                return ctx->rc;
+	}
+
+	BN_CTX_start(bnctx);
+	BIGNUM *n = BN_CTX_get(bnctx);
+
+	if (!n) OPENSSL_ERROR(end);
+	if (!BN_mul(n, privK->k.paillier_privK.p, \
+			privK->k.paillier_privK.q, bnctx))
 		OPENSSL_ERROR(end);
-			
+	if (BN_cmp(n, pubK->k.paillier_pubK.n)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "private-key does not match the public-key");
+                goto end;
+	}
+
 	ctx->rc = ENCOUNTER_OK;
 
 end:
-	/* Update the time of last modification */
-	time(&(encountA->lastUpdated));
+	if (bnctx) BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
 
+/** (q^2)^-1 mod p^2, built on first use and kept for the lifetime of
+ * the private-key */
+static encounter_err_t encounter_crypto_openssl_crtInv(encounter_t *ctx, \
+	ec_keyctx_t *privK, BN_CTX *bnctx, const BIGNUM **inv)
+{
+	pthread_mutex_lock(&privK->lock);
+	if (!privK->crtinv) {
+		privK->crtinv = BN_mod_inverse(NULL, \
+			privK->k.paillier_privK.qsquared, \
+			privK->k.paillier_privK.psquared, bnctx);
+	}
+	*inv = privK->crtinv;
+	pthread_mutex_unlock(&privK->lock);
+
+	if (!*inv) OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	return ctx->rc;
+}
+
+/** a^e mod n^2 in standard form, as two exponentiations modulo p^2 and
+ * q^2 recombined by CRT. Each half is about a quarter of the work of one
+ * exponentiation modulo n^2, and the result is the very same number */
+static encounter_err_t encounter_crypto_openssl_crtExp(encounter_t *ctx, \
+	BIGNUM *r, const BIGNUM *a, const BIGNUM *e, ec_keyctx_t *privK, \
+								BN_CTX *bnctx)
+{
+	const BIGNUM *inv;
+
+	if (encounter_crypto_openssl_crtInv(ctx, privK, bnctx, &inv) \
+			!= ENCOUNTER_OK)
+		return ctx->rc;
+
+	BN_CTX_start(bnctx);
+	BIGNUM *ap = BN_CTX_get(bnctx);
+	BIGNUM *aq = BN_CTX_get(bnctx);
+
+	if (!aq) OPENSSL_ERROR(end);
+
+	if (!BN_nnmod(ap, a, privK->k.paillier_privK.psquared, bnctx))
+		OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_expmod(ctx, ap, ap, e, privK, \
+			EC_MOD_PSQUARED, bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	if (!BN_nnmod(aq, a, privK->k.paillier_privK.qsquared, bnctx))
+		OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_expmod(ctx, aq, aq, e, privK, \
+			EC_MOD_QSQUARED, bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	if (encounter_crypto_openssl_fastCRT(ctx, r, ap, \
+		privK->k.paillier_privK.psquared, aq, \
+		privK->k.paillier_privK.qsquared, inv, bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (ap)    BN_clear(ap);
+	if (aq)    BN_clear(aq);
+	if (bnctx) BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** r^n mod n^2 in standard form, by CRT. r^p mod p^2 is the (p-1)-th
+ * root of unity congruent to r mod p, so that r^n = (r^q mod p)^p mod p^2:
+ * two exponents of half the size of n, the first one modulo p alone.
+ * Likewise modulo q^2 */
+static encounter_err_t encounter_crypto_openssl_crtRtothen(\
+	encounter_t *ctx, BIGNUM *rn, const BIGNUM *r, ec_keyctx_t *privK, \
+								BN_CTX *bnctx)
+{
+	const BIGNUM *inv;
+
+	if (encounter_crypto_openssl_crtInv(ctx, privK, bnctx, &inv) \
+			!= ENCOUNTER_OK)
+		return ctx->rc;
+
+	BN_CTX_start(bnctx);
+	BIGNUM *ap = BN_CTX_get(bnctx);
+	BIGNUM *aq = BN_CTX_get(bnctx);
+
+	if (!aq) OPENSSL_ERROR(end);
+
+	/* (r^q mod p)^p mod p^2 */
+	if (!BN_nnmod(ap, r, privK->k.paillier_privK.p, bnctx))
+		OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_expmod(ctx, ap, ap, \
+		privK->k.paillier_privK.q, privK, EC_MOD_P, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_expmod(ctx, ap, ap, \
+		privK->k.paillier_privK.p, privK, EC_MOD_PSQUARED, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	/* (r^p mod q)^q mod q^2 */
+	if (!BN_nnmod(aq, r, privK->k.paillier_privK.q, bnctx))
+		OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_expmod(ctx, aq, aq, \
+		privK->k.paillier_privK.p, privK, EC_MOD_Q, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_expmod(ctx, aq, aq, \
+		privK->k.paillier_privK.q, privK, EC_MOD_QSQUARED, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	if (encounter_crypto_openssl_fastCRT(ctx, rn, ap, \
+		privK->k.paillier_privK.psquared, aq, \
+		privK->k.paillier_privK.qsquared, inv, bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (ap)    BN_clear(ap);
+	if (aq)    BN_clear(aq);
+	if (bnctx) BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** Whether slots of width bits, each followed by its guard bits, fit
+ * below 2^bits. The product is bounded by a division, never formed */
+static encounter_err_t encounter_crypto_openssl_packedFits(encounter_t *ctx,\
+	const unsigned int slots, const unsigned int width, const int bits)
+{
+	if (!slots || !width || width > 8 * sizeof (unsigned long long) \
+	    || bits < 1 || (size_t) slots > ((size_t) bits - 1) / \
+			((size_t) width + ENCOUNTER_PACKED_GUARD_BITS)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "packing does not fit the plaintext space");
+                return ctx->rc;
+	}
+
+	return ENCOUNTER_OK;
+}
+
+/** Whether the key takes packed counters of the given layout: the
+ * Paillier keys alone, their plaintext space n, or n^s for Damgard-Jurik */
+static encounter_err_t encounter_crypto_openssl_packedCheck(\
+	encounter_t *ctx, ec_keyctx_t *pubK, const unsigned int slots, \
+						const unsigned int width)
+{
+	const BIGNUM *space;
+
+	if (EC_IS_ECELGAMAL(pubK)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_IMPL, \
+                        "no packed EC-ElGamal counters");
+                return ctx->rc;
+	}
+	if (EC_IS_OU(pubK)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_IMPL, \
+                        "no packed Okamoto-Uchiyama counters");
+                return ctx->rc;
+	}
+
+	space = EC_IS_DJ_PUBLIC(pubK) ? pubK->k.paillier_pubK.ns : \
+						pubK->k.paillier_pubK.n;
+
+	return encounter_crypto_openssl_packedFits(ctx, slots, width, \
+							BN_num_bits(space));
+}
+
+/** Packed counters take their slot updates alone: a scalar update would
+ * land across the slots and their guard bits */
+static encounter_err_t encounter_crypto_openssl_scalarCheck(\
+				encounter_t *ctx, const ec_count_t *counter)
+{
+	if (counter->slots) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "packed counter, update its slots");
+                return ctx->rc;
+	}
+
+	return ENCOUNTER_OK;
+}
+
+encounter_err_t encounter_crypto_openssl_inc(encounter_t *ctx, \
+	ec_count_t *counter, ec_keyctx_t *pubK, ec_keyctx_t *privK, \
+						const unsigned int a) 
+{
+	BN_CTX *bnctx = NULL;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+        if (!counter || !pubK) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (encounter_crypto_openssl_scalarCheck(ctx, counter) != ENCOUNTER_OK)
+		return ctx->rc;
+	if (EC_IS_ECELGAMAL(pubK))
+		return encounter_crypto_openssl_ecelgamal_update(ctx, \
+						counter, pubK, a, false);
+	if (EC_IS_OU(pubK))
+		return encounter_crypto_openssl_ou_update(ctx, counter, \
+							pubK, a, false);
+	if ((bnctx = BN_CTX_new()) == NULL) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_ownerCheck(ctx, pubK, privK, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_counterForm(ctx, counter, pubK, bnctx, \
+			ctx->conf.mont_counters) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_paillierUpdate(ctx, \
+		counter->c, pubK, privK, bnctx, a, false) != ENCOUNTER_OK)
+		OPENSSL_ERROR(end);
+			
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	/* Update the time of last modification */
+	time(&(counter->lastUpdated));
+
+	if (bnctx) BN_CTX_free(bnctx);
+	return ctx->rc;
+}
+
+encounter_err_t encounter_crypto_openssl_dec(encounter_t *ctx, \
+         ec_count_t *counter, ec_keyctx_t *pubK, ec_keyctx_t *privK, \
+						const unsigned int a) 
+{
+	BN_CTX *bnctx = NULL;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+        if (!counter || !pubK) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (encounter_crypto_openssl_scalarCheck(ctx, counter) != ENCOUNTER_OK)
+		return ctx->rc;
+	if (EC_IS_ECELGAMAL(pubK))
+		return encounter_crypto_openssl_ecelgamal_update(ctx, \
+						counter, pubK, a, true);
+	if (EC_IS_OU(pubK))
+		return encounter_crypto_openssl_ou_update(ctx, counter, \
+							pubK, a, true);
+	if ((bnctx = BN_CTX_new()) == NULL) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_ownerCheck(ctx, pubK, privK, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_counterForm(ctx, counter, pubK, bnctx, \
+			ctx->conf.mont_counters) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_paillierUpdate(ctx, \
+		counter->c, pubK, privK, bnctx, a, true) != ENCOUNTER_OK)
+		OPENSSL_ERROR(end);
+			
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	/* Update the time of last modification */
+	time(&(counter->lastUpdated));
+
+	if (bnctx) BN_CTX_free(bnctx);
+	return ctx->rc;
+}
+
+/** A packed counter of slots values of width bits, all zero. The slots,
+ * guard bits included, must fit the plaintext space */
+encounter_err_t encounter_crypto_openssl_new_packed(encounter_t *ctx, \
+	ec_keyctx_t *pubK, const unsigned int slots, const unsigned int width,\
+							ec_count_t **counter)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!pubK || !counter) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	if (encounter_crypto_openssl_packedCheck(ctx, pubK, slots, width) \
+			!= ENCOUNTER_OK)
+		return ctx->rc;
+
+	if (encounter_crypto_openssl_new_counter(ctx, pubK, NULL, counter) \
+			!= ENCOUNTER_OK)
+		return ctx->rc;
+	(*counter)->slots = slots;
+	(*counter)->width = width;
+
+	return ctx->rc;
+}
+
+/** Add, or take, amount to the given slot: multiply by g^(a 2^(slot w)),
+ * w being the slot width plus the guard bits */
+static encounter_err_t encounter_crypto_openssl_updateSlot(encounter_t *ctx, \
+	ec_count_t *counter, ec_keyctx_t *pubK, const unsigned int slot, \
+		const unsigned long long int a, const bool decrement)
+{
+	BN_CTX *bnctx = NULL;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+        if (!counter || !pubK) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (slot >= counter->slots) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "no such slot");
+                return ctx->rc;
+	}
+	if (encounter_crypto_openssl_packedCheck(ctx, pubK, counter->slots, \
+			counter->width) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	if ((bnctx = BN_CTX_new()) == NULL) OPENSSL_ERROR(err);
+	BN_CTX_start(bnctx);
+	BIGNUM *m = BN_CTX_get(bnctx);
+
+	if (!m) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_ull2bn(ctx, m, a) != ENCOUNTER_OK)
+		goto end;
+	if (!BN_lshift(m, m, (int) ((size_t) slot * ((size_t) counter->width \
+			+ ENCOUNTER_PACKED_GUARD_BITS))))
+		OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_counterForm(ctx, counter, pubK, bnctx, \
+			ctx->conf.mont_counters) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_paillierUpdateBN(ctx, counter->c, \
+		pubK, NULL, bnctx, m, decrement) != ENCOUNTER_OK)
+		goto end;
+
+	/* Update the time of last modification */
+	time(&(counter->lastUpdated));
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (m)     BN_clear(m);
+	BN_CTX_end(bnctx);
+	BN_CTX_free(bnctx);
+err:
+	return ctx->rc;
+}
+
+encounter_err_t encounter_crypto_openssl_inc_slot(encounter_t *ctx, \
+	ec_count_t *counter, ec_keyctx_t *pubK, const unsigned int slot, \
+					const unsigned long long int a)
+{
+	return encounter_crypto_openssl_updateSlot(ctx, counter, pubK, slot, \
+								a, false);
+}
+
+encounter_err_t encounter_crypto_openssl_dec_slot(encounter_t *ctx, \
+	ec_count_t *counter, ec_keyctx_t *pubK, const unsigned int slot, \
+					const unsigned long long int a)
+{
+	return encounter_crypto_openssl_updateSlot(ctx, counter, pubK, slot, \
+								a, true);
+}
+
+encounter_err_t encounter_crypto_openssl_mul(encounter_t *ctx, \
+         ec_count_t *counter, ec_keyctx_t *pubK, ec_keyctx_t *privK, \
+						const unsigned int a)
+{
+	BN_CTX *bnctx = NULL;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+        if (!counter || !pubK) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (encounter_crypto_openssl_scalarCheck(ctx, counter) != ENCOUNTER_OK)
+		return ctx->rc;
+	if (EC_IS_ECELGAMAL(pubK))
+		return encounter_crypto_openssl_ecelgamal_mul(ctx, counter, \
+							pubK, a, false);
+	if (EC_IS_OU(pubK))
+		return encounter_crypto_openssl_ou_mul(ctx, counter, pubK, \
+								a, false);
+	if ((bnctx = BN_CTX_new()) == NULL) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_ownerCheck(ctx, pubK, privK, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	/* The exponentiation wants the standard form */
+	if (encounter_crypto_openssl_counterForm(ctx, counter, pubK, bnctx, \
+			false) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_paillierMul(ctx, \
+		counter->c, pubK, privK, bnctx, a, false) != ENCOUNTER_OK)
+		OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_counterForm(ctx, counter, pubK, bnctx, \
+			ctx->conf.mont_counters) != ENCOUNTER_OK)
+		goto end;
+			
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	/* Update the time of last modification */
+	time(&(counter->lastUpdated));
+
+	if (bnctx) BN_CTX_free(bnctx);
+	return ctx->rc;
+}
+
+encounter_err_t encounter_crypto_openssl_mul_rand(encounter_t *ctx, \
+                                ec_count_t *counter, ec_keyctx_t *pubK)
+{
+	BN_CTX *bnctx = NULL;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+        if (!counter || !pubK) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (encounter_crypto_openssl_scalarCheck(ctx, counter) != ENCOUNTER_OK)
+		return ctx->rc;
+	if (EC_IS_ECELGAMAL(pubK))
+		return encounter_crypto_openssl_ecelgamal_mul(ctx, counter, \
+							pubK, 0, true);
+	if (EC_IS_OU(pubK))
+		return encounter_crypto_openssl_ou_mul(ctx, counter, pubK, \
+								0, true);
+	if ((bnctx = BN_CTX_new()) == NULL) OPENSSL_ERROR(end);
+
+	/* The exponentiation wants the standard form */
+	if (encounter_crypto_openssl_counterForm(ctx, counter, pubK, bnctx, \
+			false) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_paillierMul(ctx, \
+		counter->c, pubK, NULL, bnctx, 0, true) != ENCOUNTER_OK)
+		OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_counterForm(ctx, counter, pubK, bnctx, \
+			ctx->conf.mont_counters) != ENCOUNTER_OK)
+		goto end;
+			
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	/* Update the time of last modification */
+	time(&(counter->lastUpdated));
+
+	if (bnctx) BN_CTX_free(bnctx);
+	return ctx->rc;
+}
+
+/** out = prod counters[i]^weights[i], re-randomized once. Straus'
+ * interleaved multi-exponentiation: a table of c^1 .. c^(2^w - 1) per
+ * counter, then for each w-bit window of the weights w squarings shared
+ * by all the terms and one product per non-zero digit. The window
+ * minimizes the per-term cost of table plus digits. out may be one of
+ * the counters */
+encounter_err_t encounter_crypto_openssl_linear_combination(\
+	encounter_t *ctx, ec_count_t **counters, const unsigned int *weights,\
+		const size_t n, ec_keyctx_t *pubK, ec_count_t *out)
+{
+	struct ec_mont_s *mont;
+	BIGNUM **tab = NULL, *acc = NULL, *tmp = NULL;
+	BN_CTX *bnctx = NULL;
+	unsigned int w, bits = 0, cost, best = UINT_MAX, d, mask, s, win;
+	size_t i, j, size = 0;
+	bool started = false;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!counters || !weights || !pubK || !out) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	for (i = 0; i < n; ++i)
+		if (!counters[i]) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+				"null counter");
+			return ctx->rc;
+		}
+	if (EC_IS_ECELGAMAL(pubK))
+		return encounter_crypto_openssl_ecelgamal_linear_combination(\
+				ctx, counters, weights, n, pubK, out);
+	if (EC_IS_OU(pubK))
+		return encounter_crypto_openssl_ou_linear_combination(ctx, \
+				counters, weights, n, pubK, out);
+
+	/* The widest weight sets the number of windows */
+	for (i = 0; i < n; ++i)
+		for (s = 0; s < 32 && (weights[i] >> s); ++s)
+			if (s + 1 > bits) bits = s + 1;
+	for (w = s = 1; bits && s <= 6; ++s) {
+		cost = (1U << s) - 2 + (bits + s - 1) / s;
+		if (cost < best) { best = cost; w = s; }
+	}
+	mask = (1U << w) - 1;
+	win = (bits + w - 1) / w;
+
+	if ((bnctx = BN_CTX_new()) == NULL) OPENSSL_ERROR(end);
+	BN_CTX_start(bnctx);
+	acc = BN_CTX_get(bnctx);
+	tmp = BN_CTX_get(bnctx);
+
+	if (!tmp) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_mont(ctx, pubK, EC_MOD_NSQUARED, bnctx, \
+			&mont) != ENCOUNTER_OK)
+		goto end;
+
+	/* tab[i mask + d - 1] = c_i^d, in Montgomery form */
+	if (bits) {
+		size = n * mask;
+		if ((tab = calloc(size, sizeof *tab)) == NULL) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_MEM, \
+				"calloc: failed");
+			goto end;
+		}
+	}
+	for (i = 0; i < n && bits; ++i) {
+		BIGNUM **t = &tab[i * mask];
+
+		if (!weights[i]) continue;
+		for (d = 0; d < mask; ++d)
+			if ((t[d] = BN_new()) == NULL) OPENSSL_ERROR(end);
+
+		if (counters[i]->mont) {
+			if (!BN_copy(t[0], counters[i]->c)) OPENSSL_ERROR(end);
+		} else {
+			if (encounter_crypto_openssl_tomont(ctx, t[0], \
+				counters[i]->c, pubK, EC_MOD_NSQUARED, bnctx) \
+					!= ENCOUNTER_OK)
+				goto end;
+		}
+		for (d = 1; d < mask; ++d)
+			if (encounter_crypto_openssl_montmul(ctx, t[d], \
+				t[d - 1], t[0], pubK, EC_MOD_NSQUARED, bnctx) \
+					!= ENCOUNTER_OK)
+				goto end;
+	}
+
+	for (j = win; j-- > 0; ) {
+		for (s = 0; started && s < w; ++s)
+			if (encounter_crypto_openssl_montmul(ctx, acc, acc, \
+				acc, pubK, EC_MOD_NSQUARED, bnctx) \
+					!= ENCOUNTER_OK)
+				goto end;
+
+		for (i = 0; i < n; ++i) {
+			d = (weights[i] >> (j * w)) & mask;
+			if (!d) continue;
+
+			if (!started) {
+				if (!BN_copy(acc, tab[i * mask + d - 1]))
+					OPENSSL_ERROR(end);
+				started = true;
+			} else if (encounter_crypto_openssl_montmul(ctx, acc, \
+				acc, tab[i * mask + d - 1], pubK, \
+				EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+				goto end;
+		}
+	}
+
+	/* The one randomizer, E(0) on its own when all weights are zero */
+	if (encounter_crypto_openssl_randomizer(ctx, tmp, pubK, NULL, \
+			bnctx) != ENCOUNTER_OK)
+		goto end;
+	if (started) {
+		if (encounter_crypto_openssl_montmul(ctx, acc, acc, tmp, \
+			pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+			goto end;
+	} else if (!BN_copy(acc, tmp)) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_counterForm(ctx, out, pubK, bnctx, \
+			false) != ENCOUNTER_OK)
+		goto end;
+	if (!BN_from_montgomery(out->c, acc, mont->ctx, bnctx))
+		OPENSSL_ERROR(end);
+	out->version = EC_COUNT_VERSION(pubK);
+	out->slots = n ? counters[0]->slots : 0;
+	out->width = n ? counters[0]->width : 0;
+	if (encounter_crypto_openssl_counterForm(ctx, out, pubK, bnctx, \
+			ctx->conf.mont_counters) != ENCOUNTER_OK)
+		goto end;
+
+	/* Update the time of last modification */
+	time(&(out->lastUpdated));
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (tab) {
+		for (i = 0; i < size; ++i)
+			if (tab[i]) BN_clear_free(tab[i]);
+		free(tab);
+	}
+	if (acc)   BN_clear(acc);
+	if (tmp)   BN_clear(tmp);
+	if (bnctx) BN_CTX_end(bnctx);
+	if (bnctx) BN_CTX_free(bnctx);
+
+	return ctx->rc;
+}
+
+/* A summation, one contiguous run of the counters per item. The runs
+ * are chained Montgomery products of the counters as they are, and
+ * the R^-1 each product leaves is made up once at the end */
+struct ec_sum_s {
+	ec_count_t	**counters;
+	size_t		n;
+	size_t		runs;
+	BIGNUM		**part;		/* Product of each run */
+	ec_keyctx_t	*pubK;
+	BN_CTX		**bnctx;	/* Scratch, by worker */
+};
+
+static encounter_err_t encounter_crypto_openssl_sumItem(encounter_t *ctx, \
+		void *arg, unsigned int worker, size_t item)
+{
+	struct ec_sum_s *s = arg;
+	size_t i = item * s->n / s->runs, hi = (item + 1) * s->n / s->runs;
+
+	if (!BN_copy(s->part[item], s->counters[i]->c)) OPENSSL_ERROR(end);
+	for (++i; i < hi; ++i)
+		if (encounter_crypto_openssl_montmul(ctx, s->part[item], \
+			s->part[item], s->counters[i]->c, s->pubK, \
+			EC_MOD_NSQUARED, s->bnctx[worker]) != ENCOUNTER_OK)
+			goto end;
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	return ctx->rc;
+}
+
+/** The sum of n counters, into out and/or decrypted into plain with
+ * privK. The counters are multiplied in runs on up to
+ * conf.batch_threads threads, and the partial products of the runs
+ * then combined. Each Montgomery product of raw counters leaves a
+ * factor R^-1 (a resident counter brings one R), so the whole
+ * product is off by R^(res - n + 1) and a single product by R^(n -
+ * res) after the randomizer puts it right. A bare decryption needs no
+ * randomizer */
+encounter_err_t encounter_crypto_openssl_sum(encounter_t *ctx, \
+	ec_count_t **counters, const size_t n, ec_keyctx_t *pubK, \
+	ec_count_t *out, ec_keyctx_t *privK, unsigned long long int *plain)
+{
+	struct ec_sum_s s;
+	struct ec_mont_s *mont;
+	ec_count_t sum;
+	BIGNUM *x = NULL, *y = NULL, *e = NULL;
+	unsigned int i, workers;
+	size_t j, k, res = 0;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!counters || !pubK || (!out && !plain) || (plain && !privK)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	for (k = 0; k < n; ++k) {
+		if (!counters[k]) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+				"null counter");
+			return ctx->rc;
+		}
+		if (counters[k]->mont) res++;
+	}
+	if (EC_IS_ECELGAMAL(pubK))
+		return encounter_crypto_openssl_ecelgamal_sum(ctx, counters, \
+						n, pubK, out, privK, plain);
+	if (EC_IS_OU(pubK))
+		return encounter_crypto_openssl_ou_sum(ctx, counters, n, \
+						pubK, out, privK, plain);
+
+	memset(&s, 0, sizeof s);
+	s.counters = counters;
+	s.n = n;
+	s.pubK = pubK;
+	s.runs = (n + PAILLIER_SUM_RUN - 1) / PAILLIER_SUM_RUN;
+	workers = encounter_threadpool_workers(ctx->conf.batch_threads, \
+								s.runs);
+
+	s.bnctx = calloc(workers, sizeof *s.bnctx);
+	if (!s.bnctx) goto nomem;
+	for (i = 0; i < workers; ++i)
+		if ((s.bnctx[i] = BN_CTX_new()) == NULL) goto nomem;
+	if (s.runs) {
+		if ((s.part = calloc(s.runs, sizeof *s.part)) == NULL)
+			goto nomem;
+		for (k = 0; k < s.runs; ++k)
+			if ((s.part[k] = BN_new()) == NULL) goto nomem;
+	}
+
+	if ((x = BN_new()) == NULL || (y = BN_new()) == NULL || \
+				(e = BN_new()) == NULL)
+		goto nomem;
+
+	if (encounter_crypto_openssl_mont(ctx, pubK, EC_MOD_NSQUARED, \
+		s.bnctx[0], &mont) != ENCOUNTER_OK)
+		goto end;
+
+	if (encounter_threadpool_run(ctx, workers, s.runs, \
+		encounter_crypto_openssl_sumItem, &s) != ENCOUNTER_OK)
+		goto end;
+
+	/* Fold the runs pairwise, the empty sum being 1 */
+	for (k = 1; k < s.runs; k *= 2)
+		for (j = 0; j + k < s.runs; j += 2 * k)
+			if (encounter_crypto_openssl_montmul(ctx, s.part[j], \
+				s.part[j], s.part[j + k], pubK, \
+				EC_MOD_NSQUARED, s.bnctx[0]) != ENCOUNTER_OK)
+				goto end;
+	if (n) {
+		if (BN_copy(x, s.part[0]) == NULL) OPENSSL_ERROR(end);
+	} else if (!BN_one(x))
+		OPENSSL_ERROR(end);
+
+	if (out) {
+		if (encounter_crypto_openssl_randomizer(ctx, y, pubK, NULL, \
+				s.bnctx[0]) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_crypto_openssl_montmul(ctx, x, x, y, pubK, \
+			EC_MOD_NSQUARED, s.bnctx[0]) != ENCOUNTER_OK)
+			goto end;
+	}
+
+	/* R^(n - res), R itself being no change */
+	if (n && n - res != 1) {
+		if (!BN_one(y)) OPENSSL_ERROR(end);
+		if (encounter_crypto_openssl_tomont(ctx, y, y, pubK, \
+			EC_MOD_NSQUARED, s.bnctx[0]) != ENCOUNTER_OK)
+			goto end;
+		if (!BN_set_word(e, n - res)) OPENSSL_ERROR(end);
+		if (encounter_crypto_openssl_expmod(ctx, y, y, e, \
+			pubK, EC_MOD_NSQUARED, s.bnctx[0]) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_crypto_openssl_montmul(ctx, x, x, y, pubK, \
+			EC_MOD_NSQUARED, s.bnctx[0]) != ENCOUNTER_OK)
+			goto end;
+	}
+
+	if (out) {
+		if (encounter_crypto_openssl_counterForm(ctx, out, pubK, \
+			s.bnctx[0], false) != ENCOUNTER_OK)
+			goto end;
+		if (!BN_copy(out->c, x)) OPENSSL_ERROR(end);
+		out->version = EC_COUNT_VERSION(pubK);
+		out->slots = n ? counters[0]->slots : 0;
+		out->width = n ? counters[0]->width : 0;
+		if (encounter_crypto_openssl_counterForm(ctx, out, pubK, \
+			s.bnctx[0], ctx->conf.mont_counters) != ENCOUNTER_OK)
+			goto end;
+
+		/* Update the time of last modification */
+		time(&(out->lastUpdated));
+	}
+
+	if (plain) {
+		memset(&sum, 0, sizeof sum);
+		sum.version = EC_COUNT_VERSION(pubK);
+		sum.c = x;
+		if (encounter_crypto_openssl_decrypt(ctx, &sum, privK, \
+				plain) != ENCOUNTER_OK)
+			goto end;
+	}
+
+	ctx->rc = ENCOUNTER_OK;
+	goto end;
+
+nomem:
+	encounter_set_error(ctx, ENCOUNTER_ERR_MEM, "sum: out of memory");
+end:
+	if (x)     BN_clear_free(x);
+	if (y)     BN_clear_free(y);
+	if (e)     BN_free(e);
+	if (s.part) {
+		for (k = 0; k < s.runs; ++k)
+			if (s.part[k]) BN_clear_free(s.part[k]);
+		free(s.part);
+	}
+	if (s.bnctx) {
+		for (i = 0; i < workers; ++i)
+			if (s.bnctx[i]) BN_CTX_free(s.bnctx[i]);
+		free(s.bnctx);
+	}
+
+	return ctx->rc;
+}
+
+encounter_err_t encounter_crypto_openssl_dup(encounter_t *ctx, \
+                ec_keyctx_t *pubK, ec_count_t *from, ec_count_t **to)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (from && to) {
+		*to = calloc(1, sizeof **to);
+		if (*to) {
+			(*to)->version = from->version;
+			(*to)->slots = from->slots;
+			(*to)->width = from->width;
+			if (EC_IS_ECELGAMAL_COUNT(from) \
+			    && encounter_crypto_openssl_ecelgamal_copy(ctx, \
+					pubK, from, *to) != ENCOUNTER_OK) {
+				encounter_crypto_openssl_free_counter(ctx, *to);
+				free(*to);
+				*to = NULL;
+				return ctx->rc;
+			}
+			if (!EC_IS_ECELGAMAL_COUNT(from))
+				(*to)->c = BN_dup(from->c);
+			if (from->mont) (*to)->mont = \
+				encounter_crypto_openssl_mont_ref(from->mont);
+                        if ((*to)->c == NULL && (*to)->c1 == NULL) {
+                                encounter_set_error(ctx, \
+                                   ENCOUNTER_ERR_MEM, "openssl: %s",\
+                                   ERR_error_string(ERR_get_error(),\
+                                   NULL));
+                                encounter_crypto_openssl_free_counter(\
+                                                        ctx, *to);
+                                free(*to);
+                                *to = NULL;
+                                return ctx->rc;
+                        }
+
+                        encounter_crypto_openssl_touch(ctx, *to, pubK, \
+									NULL);
+                        if (ctx->rc == ENCOUNTER_OK) {
+			        /* Update the time of last modification */
+			        time(&((*to)->lastUpdated));
+                        } else {
+                                encounter_crypto_openssl_free_counter(\
+                                                        ctx, *to);
+                                free(*to);
+                                *to = NULL;
+                        }
+		} else
+			ctx->rc = ENCOUNTER_ERR_MEM;
+		
+		return ctx->rc;
+	}
+
+	ctx->rc = ENCOUNTER_ERR_PARAM;
+	return ctx->rc;
+}
+
+encounter_err_t encounter_crypto_openssl_copy(encounter_t *ctx, \
+                ec_keyctx_t *pubK, ec_count_t *from, ec_count_t *to)
+{
+        if (from && to) {
+                to->version = from->version;
+                to->slots = from->slots;
+                to->width = from->width;
+                if (EC_IS_ECELGAMAL_COUNT(from)) {
+                        if (encounter_crypto_openssl_ecelgamal_copy(ctx, \
+                                pubK, from, to) != ENCOUNTER_OK)
+                                return ctx->rc;
+                } else if (!BN_copy(to->c, from->c)) {
+                        encounter_set_error(ctx, ENCOUNTER_ERR_MEM, \
+                                "openssl: %s", ERR_error_string( \
+                                ERR_get_error(), NULL));
+                        return ctx->rc;
+                }
+                if (to->mont)
+                        encounter_crypto_openssl_mont_unref(to->mont);
+                to->mont = (from->mont ? \
+                        encounter_crypto_openssl_mont_ref(from->mont) : NULL);
+
+
+                /* we are returning the return code from touch() */
+                encounter_crypto_openssl_touch(ctx, to, pubK, NULL);
+                time(&(to->lastUpdated));
+
+        } else  ctx->rc = ENCOUNTER_ERR_PARAM;
+
+        return ctx->rc;
+}
+
+/* encounter_cmp() naive (and straightforward) implementation */
+encounter_err_t encounter_crypto_openssl_cmp(encounter_t *ctx, \
+                ec_count_t *a, ec_count_t *b, ec_keyctx_t *privKA,\
+                                  ec_keyctx_t *privKB, int *result)
+{
+        unsigned long long int pa, pb;
+        ec_keyctx_t *ka, *kb;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+        if (!a || !b || !result) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM,
+                        "null param");
+                goto end;
+        }
+
+        /* At least one private key must be supplied */
+        if (!privKA && !privKB) goto end;
+
+        /* Decrypt each counter with the respective private-key,
+         * if available. Otherwise, use the only supplied key to
+         * decrypt both */
+        ka = (privKA ? privKA : privKB);
+        kb = (privKB ? privKB : privKA);
+
+        if (encounter_crypto_openssl_decrypt(ctx, a, ka, &pa)
+                != ENCOUNTER_OK) OPENSSL_ERROR(end);
+        if (encounter_crypto_openssl_decrypt(ctx, b, kb, &pb)
+                != ENCOUNTER_OK) OPENSSL_ERROR(end);
+
+             if (pa  < pb) *result = -1;
+        else if (pa == pb) *result =  0;
+        else               *result =  1;
+
+        ctx->rc = ENCOUNTER_OK;
+end:
+        pa = 0; pb = 0;
+
+        return ctx->rc;
+}
+
+/** encounter_private_cmp2()
+ * Compares the supplied counters encrypted under a common public-key
+ * without ever decrypting the same counters. encounter_private_cmp2()
+ * can use the supplied private-key to decrypt a quantity derived from
+ * the cryptographic counters and hard to reverse-engineer.
+ * The result is -1 if a < b, 0 if a == b and 1 if a > b */
+encounter_err_t encounter_crypto_openssl_private_cmp2(encounter_t *ctx, \
+                                 ec_count_t *a, ec_count_t *b, \
+                      ec_keyctx_t *pubK,ec_keyctx_t *privK, int *result)
+{
+        if (!ctx) return ENCOUNTER_ERR_PARAM;
+        if (!a || !b || !pubK || !privK || !result) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (EC_IS_ECELGAMAL(privK))
+		return encounter_crypto_openssl_ecelgamal_private_cmp(ctx, \
+							a, b, privK, result);
+	if (EC_IS_OU(privK))
+		return encounter_crypto_openssl_ou_private_cmp(ctx, a, b, \
+						pubK, privK, result);
+
+        encounter_err_t rc;
+        unsigned long long int c;
+        ec_count_t *diffAB = NULL;
+	/* Owner mode is a Paillier affair */
+	ec_keyctx_t *owner = EC_IS_DJ_PRIVATE(privK) ? NULL : privK;
+	BN_CTX *bnctx = BN_CTX_new();
+	BIGNUM *rand  = BN_CTX_get(bnctx);
+	BIGNUM *tmp   = BN_CTX_get(bnctx);
+	BIGNUM *tmp2  = BN_CTX_get(bnctx);
+	BIGNUM *m     = BN_CTX_get(bnctx);
+
+        if (!m) OPENSSL_ERROR(end);
+
+        /* diffAB = dup a */
+        if (encounter_crypto_openssl_dup(ctx, pubK, a, &diffAB) \
+                != ENCOUNTER_OK) OPENSSL_ERROR(end);
+
+        if (!BN_rand(rand, PAILLIER_RANDOMIZER_SECLEVEL + 2, 0, 1) \
+                != ENCOUNTER_OK) OPENSSL_ERROR(end);
+
+        /* Add a random delta to diffAB */
+        if (encounter_crypto_openssl_gToM(ctx, tmp2, rand, pubK, bnctx, \
+                false) != ENCOUNTER_OK) goto end;
+
+        if (encounter_crypto_openssl_montmul(ctx, diffAB->c, diffAB->c, \
+                tmp2, pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+                goto end;
+
+        if (encounter_crypto_openssl_randomizer(ctx, tmp, pubK, owner, \
+                bnctx) != ENCOUNTER_OK) goto end;
+        if (encounter_crypto_openssl_montmul(ctx, diffAB->c, diffAB->c, \
+                tmp, pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+                goto end;
+        
+        /* subtract the other counter */
+        if (encounter_crypto_openssl_sub(ctx, diffAB, b, pubK, owner)
+                != ENCOUNTER_OK) OPENSSL_ERROR(end);
+
+
+        /* Decrypt the result */
+	if (encounter_crypto_openssl_decryptBN(ctx, m, diffAB, privK, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+        /* Compare */
+        *result = BN_cmp(m, rand);
+
+        /* We are done */
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+        c = 0;
+        if (diffAB) encounter_crypto_openssl_free_counter(ctx, diffAB);
+        if (rand)   BN_clear(rand); 
+        if (tmp)    BN_clear(tmp);
+        if (tmp2)   BN_clear(tmp2);
+	if (m)      BN_clear(m);
+        if (bnctx)  BN_CTX_free(bnctx);
+        return ctx->rc;
+}
+
+static encounter_err_t encounter_crypto_openssl_paillierUpdate(\
+  encounter_t *ctx, BIGNUM *c, ec_keyctx_t *pubK, ec_keyctx_t *privK, \
+	BN_CTX *bnctx, const unsigned int amount, bool decrement)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!c || !pubK || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                goto end;
+        }
+
+	BN_CTX_start(bnctx);
+	BIGNUM *tmp = BN_CTX_get(bnctx);
+	BIGNUM *tmp2 = BN_CTX_get(bnctx);
+	BIGNUM *m = BN_CTX_get(bnctx);
+	bool	got = false;
+
+	if (!m) OPENSSL_ERROR(end);
+	if (!BN_set_word(m, amount)) OPENSSL_ERROR(end);
+
+#if 0
+	fprintf(stdout, "paillier inc: before increment: ");
+	BN_print_fp(stdout, c);
+	fprintf(stdout, "\n");
+#endif
+	/* A precomputed E(1) makes the unit increment a single product */
+	if (amount == 1 && !decrement && ctx->conf.pool_ones) {
+		if (encounter_crypto_openssl_pool_get(ctx, pubK, \
+			EC_POOL_ONE, tmp, &got) != ENCOUNTER_OK)
+			goto end;
+		if (got) {
+			if (encounter_crypto_openssl_montmul(ctx, c, c, tmp, \
+				pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+				goto end;
+			ctx->rc = ENCOUNTER_OK;
+			goto end;
+		}
+	}
+
+	/* increment/decrement by the given amount */
+	if (encounter_crypto_openssl_paillierUpdateBN(ctx, c, pubK, privK, \
+			bnctx, m, decrement) != ENCOUNTER_OK)
+		goto end;
+
+#if 0
+	fprintf(stdout, "paillier inc: after incrementing: ");
+	BN_print_fp(stdout, c);
+	fprintf(stdout, "\n");
+#endif
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (tmp)   BN_clear(tmp); 
+	if (tmp2)  BN_clear(tmp2); 
+	if (m)     BN_clear(m);
+	if (bnctx) BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** c = c g^m r^n, or c g^-m r^n, for an amount of any size */
+static encounter_err_t encounter_crypto_openssl_paillierUpdateBN(\
+  encounter_t *ctx, BIGNUM *c, ec_keyctx_t *pubK, ec_keyctx_t *privK, \
+	BN_CTX *bnctx, const BIGNUM *m, bool decrement)
+{
+	BN_CTX_start(bnctx);
+	BIGNUM *tmp = BN_CTX_get(bnctx);
+
+	if (!tmp) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_gToM(ctx, tmp, m, pubK, bnctx, \
+			decrement) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_montmul(ctx, c, c, tmp, \
+			pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	if (encounter_crypto_openssl_randomizer(ctx, tmp, pubK, privK, \
+			bnctx) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_montmul(ctx, c, c, tmp, \
+			pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (tmp)   BN_clear(tmp);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+static encounter_err_t encounter_crypto_openssl_paillierMul(\
+  encounter_t *ctx, BIGNUM *c, ec_keyctx_t *pubK, ec_keyctx_t *privK, \
+	BN_CTX *bnctx, unsigned int amount, bool rand)
+{
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!c || !pubK || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM,
+                        "null param");
+                goto end;
+        }
+
+	BN_CTX_start(bnctx);
+	BIGNUM *tmp = BN_CTX_get(bnctx);
+	BIGNUM *m = BN_CTX_get(bnctx);
+
+	if (!m) OPENSSL_ERROR(end);
+        if (rand) {
+                if (!BN_rand(m, PAILLIER_RANDOMIZER_SECLEVEL + 2, 0, 1)
+                        != ENCOUNTER_OK) OPENSSL_ERROR(end);
+        } else  {
+	        if (!BN_set_word(m, amount)) OPENSSL_ERROR(end);
+        }
+
+#if 0
+	fprintf(stdout, "paillier inc: before increment: ");
+	BN_print_fp(stdout, c);
+	fprintf(stdout, "\n");
+#endif
+	if (privK) {
+		if (encounter_crypto_openssl_crtExp(ctx, c, c, m, privK, \
+				bnctx) != ENCOUNTER_OK)
+			goto end;
+	} else if (encounter_crypto_openssl_expmod(ctx, c, c, m, \
+			pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+		goto end;
+	
+	if (encounter_crypto_openssl_randomizer(ctx, tmp, pubK, privK, \
+			bnctx) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_montmul(ctx, c, c, tmp, \
+			pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+		goto end;
+
+#if 0
+	fprintf(stdout, "paillier inc: after incrementing: ");
+	BN_print_fp(stdout, c);
+	fprintf(stdout, "\n");
+#endif
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (tmp)  BN_clear(tmp); 
+	if (m)    BN_clear(m);
+	if (bnctx) BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+
+
+encounter_err_t encounter_crypto_openssl_touch(encounter_t *ctx, \
+	ec_count_t *counter, ec_keyctx_t *pubK, ec_keyctx_t *privK) 
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+        if (!counter || !pubK) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM,
+                        "null param");
+                return ctx->rc;
+        }
+	if (EC_IS_ECELGAMAL(pubK))
+		return encounter_crypto_openssl_ecelgamal_update(ctx, \
+						counter, pubK, 0, false);
+	if (EC_IS_OU(pubK))
+		return encounter_crypto_openssl_ou_update(ctx, counter, \
+							pubK, 0, false);
+	BN_CTX *bnctx = BN_CTX_new();
+	BN_CTX_start(bnctx);
+	BIGNUM *tmp = BN_CTX_get(bnctx);
+
+	if (!tmp) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_ownerCheck(ctx, pubK, privK, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_counterForm(ctx, counter, pubK, bnctx, \
+			ctx->conf.mont_counters) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_randomizer(ctx, tmp, pubK, privK, \
+			bnctx) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_montmul(ctx, counter->c, counter->c, \
+			tmp, pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	/* Update the time of last modification */
+	time(&(counter->lastUpdated));
+
+	
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (tmp)   BN_clear(tmp);
+	if (bnctx) BN_CTX_end(bnctx);
+	if (bnctx) BN_CTX_free(bnctx);
+
+	return ctx->rc;
+}
+
+encounter_err_t encounter_crypto_openssl_add(encounter_t *ctx, \
+       ec_count_t *encountA, ec_count_t *encountB, ec_keyctx_t *pubK, \
+						ec_keyctx_t *privK)
+{
+	BN_CTX *bnctx = NULL;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+        if (!encountA || !encountB || !pubK) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM,
+                        "null param");
+                return ctx->rc;
+        }
+	if (EC_IS_ECELGAMAL(pubK))
+		return encounter_crypto_openssl_ecelgamal_addsub(ctx, \
+				encountA, encountB, pubK, false);
+	if (EC_IS_OU(pubK))
+		return encounter_crypto_openssl_ou_addsub(ctx, encountA, \
+						encountB, pubK, false);
+	if ((bnctx = BN_CTX_new()) == NULL) OPENSSL_ERROR(end);
+
+	if (encountA->slots != encountB->slots \
+	    || encountA->width != encountB->width) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "counters of different packing");
+                goto end;
+	}
+	if (encounter_crypto_openssl_ownerCheck(ctx, pubK, privK, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	/* With both counters resident the sum is a single product */
+	if (encounter_crypto_openssl_counterForm(ctx, encountA, pubK, \
+			bnctx, ctx->conf.mont_counters) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_counterForm(ctx, encountB, pubK, \
+			bnctx, ctx->conf.mont_counters) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_paillierAddSub(ctx, encountA->c, \
+             encountB->c, encountB->mont, pubK, privK, bnctx, false) \
+             != ENCOUNTER_OK)
+		OPENSSL_ERROR(end);
+			
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	/* Update the time of last modification */
+	time(&(encountA->lastUpdated));
+
+	if (bnctx) BN_CTX_free(bnctx);
+	return ctx->rc;
+}
+
+encounter_err_t encounter_crypto_openssl_sub(encounter_t *ctx, \
+       ec_count_t *encountA, ec_count_t *encountB, ec_keyctx_t *pubK, \
+						ec_keyctx_t *privK)
+{
+	BN_CTX *bnctx = NULL;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+        if (!encountA || !encountB || !pubK) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM,
+                        "null param");
+                return ctx->rc;
+        }
+	if (EC_IS_ECELGAMAL(pubK))
+		return encounter_crypto_openssl_ecelgamal_addsub(ctx, \
+				encountA, encountB, pubK, true);
+	if (EC_IS_OU(pubK))
+		return encounter_crypto_openssl_ou_addsub(ctx, encountA, \
+						encountB, pubK, true);
+	if ((bnctx = BN_CTX_new()) == NULL) OPENSSL_ERROR(end);
+
+	if (encountA->slots != encountB->slots \
+	    || encountA->width != encountB->width) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "counters of different packing");
+                goto end;
+	}
+	if (encounter_crypto_openssl_ownerCheck(ctx, pubK, privK, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	/* With both counters resident the sum is a single product */
+	if (encounter_crypto_openssl_counterForm(ctx, encountA, pubK, \
+			bnctx, ctx->conf.mont_counters) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_counterForm(ctx, encountB, pubK, \
+			bnctx, ctx->conf.mont_counters) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_paillierAddSub(ctx, encountA->c, \
+             encountB->c, encountB->mont, pubK, privK, bnctx, true) \
+             != ENCOUNTER_OK)
+		OPENSSL_ERROR(end);
+			
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	/* Update the time of last modification */
+	time(&(encountA->lastUpdated));
+
+	if (bnctx) BN_CTX_free(bnctx);
+	return ctx->rc;
+}
+
+static encounter_err_t encounter_crypto_openssl_paillierAddSub(  \
+    		encounter_t *ctx, BIGNUM *c, BIGNUM *b, \
+	const struct ec_mont_s *bmont, ec_keyctx_t *pubK, ec_keyctx_t *privK,\
+				BN_CTX *bnctx, const bool subtract)
+{
+	if (!ctx) return ENCOUNTER_ERR_PARAM;
+	if (!c || !b || !pubK || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                goto end;
+        }
+
+	BN_CTX_start(bnctx);
+	BIGNUM *tmp = BN_CTX_get(bnctx);
+	BIGNUM *tmp2 = BN_CTX_get(bnctx);
+
+	if (!tmp2) OPENSSL_ERROR(end);
+
+#if 0
+	fprintf(stdout, "paillier inc: before increment: ");
+	BN_print_fp(stdout, c);
+	fprintf(stdout, "\n");
+#endif
+
+        if (subtract) {
+                /* FIXME: prevent from decrementing below zero */
+		if (bmont) {
+			if (!BN_from_montgomery(tmp2, b, bmont->ctx, bnctx))
+				OPENSSL_ERROR(end);
+			b = tmp2;
+		}
+		if (encounter_crypto_openssl_invModNSquared(ctx, tmp2, b, \
+			pubK, bnctx) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_crypto_openssl_mulmod(ctx, c, c, tmp2, \
+			pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+			goto end;
+        } else if (bmont) {
+		if (encounter_crypto_openssl_montmul(ctx, c, c, b, \
+			pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+			goto end;
+        } else {
+		if (encounter_crypto_openssl_mulmod(ctx, c, c, b, \
+			pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+			goto end;
+        }
+	
+	if (encounter_crypto_openssl_randomizer(ctx, tmp, pubK, privK, \
+			bnctx) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_montmul(ctx, c, c, tmp, \
+			pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+		goto end;
+
+#if 0
+	fprintf(stdout, "paillier inc: after incrementing: ");
+	BN_print_fp(stdout, c);
+	fprintf(stdout, "\n");
+#endif
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (tmp)   BN_clear(tmp); 
+	if (tmp2)  BN_clear(tmp); 
+	if (bnctx) BN_CTX_end(bnctx);
+
+	return ctx->rc;
+
+}
+
+/** Montgomery's simultaneous inversion: r[i] = R a[i]^-1 mod n^2, the
+ * Montgomery form of the inverse, for all k of the a[] in standard form.
+ * One inversion and 3(k-1) products, the prefix products being kept in
+ * r[] until the backward pass overwrites them. R factors cancel out:
+ * with P_i the i-th prefix and Y_i = R^i (a_0 .. a_i)^-1 throughout,
+ * Montgomery products of Y_i by P_(i-1) and a_i give R/a_i and Y_(i-1) */
+static encounter_err_t encounter_crypto_openssl_invModNSquaredBatch(\
+	encounter_t *ctx, BIGNUM **r, BIGNUM **a, const size_t k, \
+			ec_keyctx_t *pubK, BN_CTX *bnctx)
+{
+	size_t i;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!r || !a || !k || !pubK || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	BN_CTX_start(bnctx);
+	BIGNUM *y = BN_CTX_get(bnctx);
+
+	if (!y) OPENSSL_ERROR(end);
+
+	/* P_0 = a_0, P_i = P_(i-1) a_i R^-1 */
+	if (!BN_copy(r[0], a[0])) OPENSSL_ERROR(end);
+	for (i = 1; i < k; ++i)
+		if (encounter_crypto_openssl_montmul(ctx, r[i], r[i - 1], \
+			a[i], pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+			goto end;
+
+	/* Y = R P^-1, the only inversion */
+	if (encounter_crypto_openssl_invModNSquared(ctx, y, r[k - 1], \
+			pubK, bnctx) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_tomont(ctx, y, y, pubK, \
+			EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	for (i = k - 1; i > 0; --i) {
+		if (encounter_crypto_openssl_montmul(ctx, r[i], y, r[i - 1], \
+			pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_crypto_openssl_montmul(ctx, y, y, a[i], \
+			pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+			goto end;
+	}
+	if (!BN_copy(r[0], y)) OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (y)     BN_clear(y);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+
+/* A batch of updates, one per counter. Item i decrements counters[i]
+ * by amounts[i] or, with no amounts, multiplies it by inv[i] */
+struct ec_update_batch_s {
+	ec_count_t		**counters;
+	const unsigned int	*amounts;
+	BIGNUM			**inv;		/* Montgomery form, by item */
+	ec_keyctx_t		*pubK;
+	BN_CTX			**bnctx;	/* Scratch, by worker */
+};
+
+static encounter_err_t encounter_crypto_openssl_updateBatchItem(\
+	encounter_t *ctx, void *arg, unsigned int worker, size_t item)
+{
+	struct ec_update_batch_s *b = arg;
+	ec_count_t *counter = b->counters[item];
+	BN_CTX *bnctx = b->bnctx[worker];
+
+	BN_CTX_start(bnctx);
+	BIGNUM *tmp = BN_CTX_get(bnctx);
+
+	if (!tmp) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_counterForm(ctx, counter, b->pubK, \
+			bnctx, ctx->conf.mont_counters) != ENCOUNTER_OK)
+		goto end;
+
+	if (b->amounts) {
+		if (encounter_crypto_openssl_paillierUpdate(ctx, counter->c, \
+			b->pubK, NULL, bnctx, b->amounts[item], true) \
+				!= ENCOUNTER_OK)
+			goto end;
+	} else {
+		/* Either form of the counter is kept by a product with
+		 * a Montgomery form */
+		if (encounter_crypto_openssl_montmul(ctx, counter->c, \
+			counter->c, b->inv[item], b->pubK, EC_MOD_NSQUARED, \
+				bnctx) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_crypto_openssl_randomizer(ctx, tmp, b->pubK, \
+				NULL, bnctx) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_crypto_openssl_montmul(ctx, counter->c, \
+			counter->c, tmp, b->pubK, EC_MOD_NSQUARED, bnctx) \
+				!= ENCOUNTER_OK)
+			goto end;
+	}
+
+	/* Update the time of last modification */
+	time(&(counter->lastUpdated));
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (tmp)   BN_clear(tmp);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** Decrement counters[i] by amounts[i], or subtract others[i] from it,
+ * for all n of them on up to conf.batch_threads threads. The inverses
+ * of the others[] are taken all at once, before any counter changes */
+static encounter_err_t encounter_crypto_openssl_updateBatch(encounter_t *ctx,\
+	ec_count_t **counters, ec_count_t **others, \
+	const unsigned int *amounts, const size_t n, ec_keyctx_t *pubK)
+{
+	struct ec_update_batch_s b;
+	struct ec_mont_s *mont;
+	BIGNUM **val = NULL;
+	unsigned int i, workers;
+	size_t k;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!counters || (!others && !amounts) || !pubK) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	for (k = 0; k < n; ++k) {
+		if (!counters[k] || (others && !others[k])) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+				"null counter");
+			return ctx->rc;
+		}
+		if (others ? counters[k]->slots != others[k]->slots \
+			|| counters[k]->width != others[k]->width \
+		    : counters[k]->slots != 0) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+				"counter %zu: packing mismatch", k);
+			return ctx->rc;
+		}
+	}
+
+	ctx->rc = ENCOUNTER_OK;
+	if (!n) return ctx->rc;
+
+	/* A few point operations each, not worth the threads */
+	if (EC_IS_ECELGAMAL(pubK)) {
+		for (k = 0; k < n; ++k)
+			if ((others ? encounter_crypto_openssl_ecelgamal_addsub(\
+				ctx, counters[k], others[k], pubK, true) \
+			    : encounter_crypto_openssl_ecelgamal_update(ctx, \
+				counters[k], pubK, amounts[k], true)) \
+					!= ENCOUNTER_OK)
+				break;
+		return ctx->rc;
+	}
+	if (EC_IS_OU(pubK)) {
+		for (k = 0; k < n; ++k)
+			if ((others ? encounter_crypto_openssl_ou_addsub(ctx, \
+				counters[k], others[k], pubK, true) \
+			    : encounter_crypto_openssl_ou_update(ctx, \
+				counters[k], pubK, amounts[k], true)) \
+					!= ENCOUNTER_OK)
+				break;
+		return ctx->rc;
+	}
+
+	workers = encounter_threadpool_workers(ctx->conf.batch_threads, n);
+
+	memset(&b, 0, sizeof b);
+	b.counters = counters;
+	b.amounts = others ? NULL : amounts;
+	b.pubK = pubK;
+	b.bnctx = calloc(workers, sizeof *b.bnctx);
+	if (!b.bnctx) goto nomem;
+	for (i = 0; i < workers; ++i)
+		if ((b.bnctx[i] = BN_CTX_new()) == NULL) goto nomem;
+
+	if (encounter_crypto_openssl_mont(ctx, pubK, EC_MOD_NSQUARED, \
+		b.bnctx[0], &mont) != ENCOUNTER_OK)
+		goto end;
+
+	if (others) {
+		b.inv = calloc(n, sizeof *b.inv);
+		val = calloc(n, sizeof *val);
+		if (!b.inv || !val) goto nomem;
+		for (k = 0; k < n; ++k) {
+			if ((b.inv[k] = BN_new()) == NULL) goto nomem;
+			if ((val[k] = BN_new()) == NULL) goto nomem;
+			if (encounter_crypto_openssl_counterValue(ctx, val[k],\
+				others[k], b.bnctx[0]) != ENCOUNTER_OK)
+				goto end;
+		}
+		if (encounter_crypto_openssl_invModNSquaredBatch(ctx, b.inv, \
+			val, n, pubK, b.bnctx[0]) != ENCOUNTER_OK)
+			goto end;
+	}
+
+	if (encounter_threadpool_run(ctx, workers, n, \
+		encounter_crypto_openssl_updateBatchItem, &b) != ENCOUNTER_OK)
+		goto end;
+
+	ctx->rc = ENCOUNTER_OK;
+	goto end;
+
+nomem:
+	encounter_set_error(ctx, ENCOUNTER_ERR_MEM, "batch: out of memory");
+end:
+	if (b.inv) {
+		for (k = 0; k < n; ++k)
+			if (b.inv[k]) BN_clear_free(b.inv[k]);
+		free(b.inv);
+	}
+	if (val) {
+		for (k = 0; k < n; ++k)
+			if (val[k]) BN_clear_free(val[k]);
+		free(val);
+	}
+	if (b.bnctx) {
+		for (i = 0; i < workers; ++i)
+			if (b.bnctx[i]) BN_CTX_free(b.bnctx[i]);
+		free(b.bnctx);
+	}
+
+	return ctx->rc;
+}
+
+/** Decrement each of the n counters by its amount. The decrements take
+ * no inversion already, g^-m coming from a table or a closed form, so
+ * the batch only shares the setup and spreads the randomizers */
+encounter_err_t encounter_crypto_openssl_dec_batch(encounter_t *ctx, \
+	ec_count_t **counters, const unsigned int *amounts, const size_t n, \
+						ec_keyctx_t *pubK)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!amounts) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	return encounter_crypto_openssl_updateBatch(ctx, counters, NULL, \
+							amounts, n, pubK);
+}
+
+/** Subtract countersB[i] from countersA[i] for all n pairs, with a
+ * single inversion modulo n^2 for the whole batch. The countersA[] are
+ * meant to be distinct */
+encounter_err_t encounter_crypto_openssl_sub_batch(encounter_t *ctx, \
+	ec_count_t **countersA, ec_count_t **countersB, const size_t n, \
+						ec_keyctx_t *pubK)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!countersB) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	return encounter_crypto_openssl_updateBatch(ctx, countersA, \
+						countersB, NULL, n, pubK);
+}
+
+/** m mod p, as L_p(c^(p-1) mod p^2) h_p mod p, or m mod q when p is not
+ * set. The subgroup keys take the much shorter alpha for p-1. c is in
+ * standard form */
+static encounter_err_t encounter_crypto_openssl_decryptHalf(\
+	encounter_t *ctx, BIGNUM *r, const BIGNUM *c, ec_keyctx_t *privK, \
+					const bool p, BN_CTX *bnctx)
+{
+	return encounter_crypto_openssl_decryptHalves(ctx, &r, &c, 1, privK, \
+								p, bnctx);
+}
+
+/** decryptHalf() of the count counter values of c into r, the
+ * exponentiations modulo p^2 by runs of expmod_batch() */
+static encounter_err_t encounter_crypto_openssl_decryptHalves(\
+	encounter_t *ctx, BIGNUM **r, const BIGNUM **c, const size_t count, \
+			ec_keyctx_t *privK, const bool p, BN_CTX *bnctx)
+{
+	struct paillier_privatekey *k = &privK->k.paillier_privK;
+	size_t i;
+
+	if (EC_IS_DJ_PRIVATE(privK)) {
+		for (i = 0; i < count; ++i)
+			if (encounter_crypto_openssl_dj_decryptHalf(ctx, r[i], \
+				c[i], privK, p, bnctx) != ENCOUNTER_OK)
+				break;
+		return ctx->rc;
+	}
+
+	BN_CTX_start(bnctx);
+	BIGNUM *min1 = BN_CTX_get(bnctx);
+
+	if (!min1) OPENSSL_ERROR(end);
+
+	/* p-1, or alpha */
+	if (EC_IS_SUBGROUP_PRIVATE(privK)) {
+		if (!BN_copy(min1, k->alpha)) OPENSSL_ERROR(end);
+	} else if (!BN_sub(min1, p ? k->p : k->q, BN_value_one()))
+		OPENSSL_ERROR(end);
+
+	/* c^(p-1) mod p^2, in place in r */
+	for (i = 0; i < count; ++i)
+		if (!BN_mod(r[i], c[i], p ? k->psquared : k->qsquared, bnctx))
+			OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_expmod_batch(ctx, r, r, count, min1, \
+		privK, p ? EC_MOD_PSQUARED : EC_MOD_QSQUARED, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	/* m_p = L_p ( c^(p-1) mod p^2 ) h_p mod p */
+	for (i = 0; i < count; ++i) {
+		if (encounter_crypto_openssl_fastL(ctx, r[i], r[i], \
+			p ? k->p : k->q, p ? k->pinvmod2tow : k->qinvmod2tow, \
+				bnctx) != ENCOUNTER_OK)
+			OPENSSL_ERROR(end);
+		if (!BN_mod_mul(r[i], r[i], p ? k->hsubp : k->hsubq, \
+				p ? k->p : k->q, bnctx))
+			OPENSSL_ERROR(end);
+	}
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (min1)  BN_clear(min1);
+	if (bnctx) BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** The plaintext as an unsigned long long, with no detour through the
+ * decimal representation */
+static encounter_err_t encounter_crypto_openssl_bn2ull(encounter_t *ctx, \
+			const BIGNUM *m, unsigned long long int *a)
+{
+	unsigned char buf[sizeof *a];
+	int i, len;
+
+	if (BN_is_negative(m) || BN_num_bytes(m) > (int) sizeof buf) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_OVERFLOW, \
+                    "The requested value is larger than ULLONG_MAX. ");
+                return ctx->rc;
+	}
+
+	len = BN_bn2bin(m, buf);
+	for (*a = 0, i = 0; i < len; ++i)
+		*a = (*a << 8) | buf[i];
+
+	ctx->rc = ENCOUNTER_OK;
+	return ctx->rc;
+}
+
+/** The converse of bn2ull(), whatever the size of BN_ULONG */
+static encounter_err_t encounter_crypto_openssl_ull2bn(encounter_t *ctx, \
+			BIGNUM *m, const unsigned long long int a)
+{
+	unsigned char buf[sizeof a];
+	unsigned int i;
+
+	for (i = 0; i < sizeof buf; ++i)
+		buf[i] = (unsigned char) (a >> (8 * (sizeof buf - 1 - i)));
+	if (!BN_bin2bn(buf, sizeof buf, m)) OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	return ctx->rc;
+}
+
+/** m = CRT(m_p, m_q) mod pq, mod p^s q^s for the Damgard-Jurik keys */
+static encounter_err_t encounter_crypto_openssl_crtHalves(encounter_t *ctx, \
+	BIGNUM *m, const BIGNUM *msubp, const BIGNUM *msubq, \
+				ec_keyctx_t *privK, BN_CTX *bnctx)
+{
+	struct paillier_privatekey *k = &privK->k.paillier_privK;
+
+	if (EC_IS_DJ_PRIVATE(privK))
+		return encounter_crypto_openssl_fastCRT(ctx, m, msubp, k->ps, \
+						msubq, k->qs, k->qsInv, bnctx);
+
+	return encounter_crypto_openssl_fastCRT(ctx, m, msubp, k->p, msubq, \
+						k->q, k->qInv, bnctx);
+}
+
+/** The plaintext of the counter, whatever its size */
+static encounter_err_t encounter_crypto_openssl_decryptBN(encounter_t *ctx, \
+	BIGNUM *m, ec_count_t *counter, ec_keyctx_t *privK, BN_CTX *bnctx)
+{
+	if (EC_IS_OU(privK))
+		return encounter_crypto_openssl_ou_decryptBN(ctx, m, counter, \
+							privK, bnctx);
+
+	BN_CTX_start(bnctx);
+	BIGNUM *c = BN_CTX_get(bnctx);
+	BIGNUM *msubp = BN_CTX_get(bnctx);
+	BIGNUM *msubq = BN_CTX_get(bnctx);
+
+	if (!msubq) OPENSSL_ERROR(end);
+
+	/* Resident counters leave the Montgomery form here */
+	if (encounter_crypto_openssl_counterValue(ctx, c, counter, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	if (encounter_crypto_openssl_decryptHalf(ctx, msubp, c, privK, \
+			true, bnctx) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_decryptHalf(ctx, msubq, c, privK, \
+			false, bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	if (encounter_crypto_openssl_crtHalves(ctx, m, msubp, msubq, privK, \
+			bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (c)     BN_clear(c);
+	if (msubp) BN_clear(msubp);
+	if (msubq) BN_clear(msubq);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+encounter_err_t encounter_crypto_openssl_decrypt(encounter_t *ctx, \
+     ec_count_t *counter, ec_keyctx_t *privK, unsigned long long int *a)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+
+	if ( !counter || !privK ||  !a) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (EC_IS_ECELGAMAL(privK))
+		return encounter_crypto_openssl_ecelgamal_decrypt(ctx, \
+							counter, privK, a);
+
+	BN_CTX *bnctx = BN_CTX_new();
+	BN_CTX_start(bnctx);
+	BIGNUM *m = BN_CTX_get(bnctx);
+
+	if (!m) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_decryptBN(ctx, m, counter, privK, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	/* Make the plaintext counter available via a */
+	if (encounter_crypto_openssl_bn2ull(ctx, m, a) != ENCOUNTER_OK)
+		goto end;
+
+        /* We are done */
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (m)     BN_clear(m);
+
+	if (bnctx) BN_CTX_end(bnctx);
 	if (bnctx) BN_CTX_free(bnctx);
+
 	return ctx->rc;
 }
 
-encounter_err_t encounter_crypto_openssl_sub(encounter_t *ctx, \
-       ec_count_t *encountA, ec_count_t *encountB, ec_keyctx_t *pubK)
+/** The plaintext as a big-endian byte string, for the plaintexts that
+ * outgrow an unsigned long long: up to n^s with the Damgard-Jurik keys.
+ * *len is the size of buf on input, the length of the plaintext on
+ * output, and the size buf ought to have on ENCOUNTER_ERR_OVERFLOW */
+encounter_err_t encounter_crypto_openssl_decrypt_bytes(encounter_t *ctx, \
+	ec_count_t *counter, ec_keyctx_t *privK, unsigned char *buf, \
+								size_t *len)
 {
+	size_t need;
+
         if (!ctx)       return ENCOUNTER_ERR_PARAM;
-        if (!encountA || !encountB || !pubK) {
-                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM,
+
+	if (!counter || !privK || !buf || !len) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
                         "null param");
-                goto end;
+                return ctx->rc;
         }
+	if (EC_IS_ECELGAMAL(privK)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_IMPL, \
+                        "EC-ElGamal plaintexts fit an unsigned long long");
+                return ctx->rc;
+	}
+
 	BN_CTX *bnctx = BN_CTX_new();
+	if (!bnctx) OPENSSL_ERROR(err);
+	BN_CTX_start(bnctx);
+	BIGNUM *m = BN_CTX_get(bnctx);
+
+	if (!m) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_decryptBN(ctx, m, counter, privK, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	need = BN_num_bytes(m);
+	if (need > *len) {
+		*len = need;
+                encounter_set_error(ctx, ENCOUNTER_ERR_OVERFLOW, \
+                    "The plaintext does not fit the supplied buffer. ");
+		goto end;
+	}
+	*len = BN_bn2bin(m, buf);
 
-	if (encounter_crypto_openssl_paillierAddSub(ctx, \
-             encountA->c, encountB->c, pubK, bnctx, true) \
-             != ENCOUNTER_OK)
-		OPENSSL_ERROR(end);
-			
 	ctx->rc = ENCOUNTER_OK;
 
 end:
-	/* Update the time of last modification */
-	time(&(encountA->lastUpdated));
-
-	if (bnctx) BN_CTX_free(bnctx);
+	if (m)     BN_clear(m);
+	BN_CTX_end(bnctx);
+	BN_CTX_free(bnctx);
+err:
 	return ctx->rc;
 }
 
-static encounter_err_t encounter_crypto_openssl_paillierAddSub(  \
-    		encounter_t *ctx, BIGNUM *c, BIGNUM *b, \
-	const ec_keyctx_t *pubK, BN_CTX *bnctx, const bool subtract)
+/** One decryption for all the slots of a packed counter, into the n >=
+ * slots entries of out[]. A slot whose carries ran into its guard bits,
+ * or that went below zero, is an overflow */
+encounter_err_t encounter_crypto_openssl_decrypt_packed(encounter_t *ctx, \
+	ec_count_t *counter, ec_keyctx_t *privK, unsigned long long int *out,\
+							const size_t n)
 {
-	if (!ctx) return ENCOUNTER_ERR_PARAM;
-	if (!c || !b || !pubK || !bnctx) {
+	unsigned int i;
+	size_t stride;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!counter || !privK || !out) {
                 encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
                         "null param");
-                goto end;
+                return ctx->rc;
         }
+	if (!counter->slots || n < counter->slots) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "not a packed counter, or too few slots");
+                return ctx->rc;
+	}
+	if (EC_IS_ECELGAMAL(privK) || EC_IS_OU(privK)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "not a packed counter key");
+                return ctx->rc;
+	}
+	stride = (size_t) counter->width + ENCOUNTER_PACKED_GUARD_BITS;
 
+	BN_CTX *bnctx = BN_CTX_new();
+	if (!bnctx) OPENSSL_ERROR(err);
 	BN_CTX_start(bnctx);
-	BIGNUM *tmp = BN_CTX_get(bnctx);
-	BIGNUM *tmp2 = BN_CTX_get(bnctx);
-	BIGNUM *r = BN_CTX_get(bnctx);
-	bool in = false;
-
-	if (!r) OPENSSL_ERROR(end);
+	BIGNUM *m = BN_CTX_get(bnctx);
+	BIGNUM *v = BN_CTX_get(bnctx);
 
-#if 0
-	fprintf(stdout, "paillier inc: before increment: ");
-	BN_print_fp(stdout, c);
-	fprintf(stdout, "\n");
-#endif
+	if (!v) OPENSSL_ERROR(end);
 
-        if (subtract) {
-                /* FIXME: prevent from decrementing below zero */
-		if (!BN_mod_inverse(tmp2, b, \
-			pubK->k.paillier_pubK.nsquared, bnctx) )
-			OPENSSL_ERROR(end);
-        } else {
-                if (!BN_copy(tmp2, b))
-                        OPENSSL_ERROR(end);
-        }
+	/* The layout of an imported counter against the plaintext space, n
+	 * or n^s, as on creation */
+	const struct paillier_privatekey *k = &privK->k.paillier_privK;
+	const bool dj = EC_IS_DJ_PRIVATE(privK);
 
-	if (!BN_mod_mul(c, c, tmp2, \
-			pubK->k.paillier_pubK.nsquared, bnctx) )  
+	if (!BN_mul(v, dj ? k->ps : k->p, dj ? k->qs : k->q, bnctx))
 		OPENSSL_ERROR(end);
-	
-	for (;;)
-   	{
-		if (!BN_rand_range(r, pubK->k.paillier_pubK.n) )
-			OPENSSL_ERROR(end);
-   		if (IsInZnstar(ctx, r, pubK->k.paillier_pubK.n, \
-				bnctx, &in)  != ENCOUNTER_OK)
+	if (encounter_crypto_openssl_packedFits(ctx, counter->slots, \
+		counter->width, BN_num_bits(v)) != ENCOUNTER_OK)
+		goto end;
+
+	if (encounter_crypto_openssl_decryptBN(ctx, m, counter, privK, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	/* Slots past the last one are the borrow of a negative slot */
+	if ((size_t) BN_num_bits(m) > counter->slots * stride) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_OVERFLOW, \
+                        "packed counter underflow");
+                goto end;
+	}
+	for (i = 0; i < counter->slots; ++i) {
+		if (!BN_rshift(v, m, (int) (i * stride))) OPENSSL_ERROR(end);
+		if (!BN_mask_bits(v, (int) stride) \
+		    && (size_t) BN_num_bits(v) > stride)
 			OPENSSL_ERROR(end);
-		if (in) break;
-   	}
-	if (!BN_mod_exp(tmp, r, pubK->k.paillier_pubK.n, \
-			pubK->k.paillier_pubK.nsquared, bnctx) ) 
-		OPENSSL_ERROR(end);
-	if (!BN_mod_mul(c, c, tmp, pubK->k.paillier_pubK.nsquared, bnctx))
-		OPENSSL_ERROR(end);
+		if (BN_num_bits(v) > (int) counter->width) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_OVERFLOW, \
+				"slot %u overflow", i);
+			goto end;
+		}
+		if (encounter_crypto_openssl_bn2ull(ctx, v, &out[i]) \
+				!= ENCOUNTER_OK)
+			goto end;
+	}
 
-#if 0
-	fprintf(stdout, "paillier inc: after incrementing: ");
-	BN_print_fp(stdout, c);
-	fprintf(stdout, "\n");
-#endif
 	ctx->rc = ENCOUNTER_OK;
 
 end:
-	if (tmp)   BN_clear(tmp); 
-	if (tmp2)  BN_clear(tmp); 
-	if (r)     BN_clear(r);
-	if (bnctx) BN_CTX_end(bnctx);
-
+	if (m)     BN_clear(m);
+	if (v)     BN_clear(v);
+	BN_CTX_end(bnctx);
+	BN_CTX_free(bnctx);
+err:
 	return ctx->rc;
-
 }
 
-encounter_err_t encounter_crypto_openssl_decrypt(encounter_t *ctx, \
+/** Decrypt modulo p alone. A plaintext below 2^64 < p is m mod p, so
+ * the q^2 half and the CRT recombination are not needed. Should m mod p
+ * not fit, the plaintext is not below 2^64 and the full decryption
+ * takes over, with its overflow report */
+encounter_err_t encounter_crypto_openssl_decrypt_bounded(encounter_t *ctx, \
      ec_count_t *counter, ec_keyctx_t *privK, unsigned long long int *a)
 {
         if (!ctx)       return ENCOUNTER_ERR_PARAM;
@@ -1408,103 +4208,200 @@ encounter_err_t encounter_crypto_openssl_decrypt(encounter_t *ctx, \
 	if ( !counter || !privK ||  !a) {
                 encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
                         "null param");
-                goto end;
+                return ctx->rc;
         }
+	/* Bounded already, by the baby-step table, or by p */
+	if (EC_IS_ECELGAMAL(privK) || EC_IS_OU(privK))
+		return encounter_crypto_openssl_decrypt(ctx, counter, privK, a);
 
+	bool full = false;
 	BN_CTX *bnctx = BN_CTX_new();
 	BN_CTX_start(bnctx);
 	BIGNUM *m = BN_CTX_get(bnctx);
+	BIGNUM *msubp = BN_CTX_get(bnctx);
 
-	BIGNUM *tmp, *pmin1, *qmin1, *msubp, *msubq;
+	if (!msubp) OPENSSL_ERROR(end);
 
-	tmp = BN_CTX_get(bnctx); pmin1 = BN_CTX_get(bnctx); 
-	qmin1 = BN_CTX_get(bnctx);
-	msubp = BN_CTX_get(bnctx); msubq = BN_CTX_get(bnctx);
+	if (encounter_crypto_openssl_counterValue(ctx, m, counter, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_decryptHalf(ctx, msubp, m, privK, \
+			true, bnctx) != ENCOUNTER_OK)
+		goto end;
 
-	if (!msubq) OPENSSL_ERROR(end);
+	full = BN_num_bits(msubp) > (int) (8 * sizeof *a);
+	if (!full && encounter_crypto_openssl_bn2ull(ctx, msubp, a) \
+			!= ENCOUNTER_OK)
+		goto end;
 
-	/* p-1 and q-1 */
-	if (!BN_sub(pmin1, privK->k.paillier_privK.p, BN_value_one()))
-		OPENSSL_ERROR(end);
-	if (!BN_sub(qmin1, privK->k.paillier_privK.q, BN_value_one()))
-		OPENSSL_ERROR(end);
+	ctx->rc = ENCOUNTER_OK;
 
-	/* c^(p-1) mod p^2 */
-	if (!BN_mod(tmp, counter->c, \
-			privK->k.paillier_privK.psquared, bnctx))
-		OPENSSL_ERROR(end);
-	if (!BN_mod_exp(tmp, tmp, pmin1, \
-			privK->k.paillier_privK.psquared, bnctx))
-		OPENSSL_ERROR(end);
+end:
+	if (msubp) BN_clear(msubp);
+	if (m)     BN_clear(m);
 
-	/* m_p = L_p ( c^(p-1) mod p^2 ) h_p mod p */
-	if (encounter_crypto_openssl_fastL(ctx, tmp, tmp, \
-		privK->k.paillier_privK.p, \
-		privK->k.paillier_privK.pinvmod2tow, bnctx) \
-		!= ENCOUNTER_OK)
-		OPENSSL_ERROR(end);
+	if (bnctx) BN_CTX_end(bnctx);
+	if (bnctx) BN_CTX_free(bnctx);
 
-	if (!BN_mod_mul(msubp, tmp, privK->k.paillier_privK.hsubp, \
-			privK->k.paillier_privK.p, bnctx))
-		OPENSSL_ERROR(end);
+	if (full) return encounter_crypto_openssl_decrypt(ctx, counter, \
+								privK, a);
+	return ctx->rc;
+}
 
 
-	/* c^(q-1) */
-	if (!BN_mod(tmp, counter->c, \
-		privK->k.paillier_privK.qsquared, bnctx))
-		OPENSSL_ERROR(end);
-	if (!BN_mod_exp(tmp, tmp, qmin1, \
-		privK->k.paillier_privK.qsquared,bnctx))
-		OPENSSL_ERROR(end);
+/* A batch decryption, split in the halves modulo p and q of runs of
+ * counters, the lanes of expmod_batch() each. Item 2i is the p half of
+ * run i, item 2i+1 its q half */
+struct ec_decrypt_batch_s {
+	ec_count_t	**counters;
+	size_t		n;
+	size_t		lanes;		/* Counters a run */
+	ec_keyctx_t	*privK;
+	BIGNUM		**half;		/* m mod p and m mod q, by counter */
+	BN_CTX		**bnctx;	/* Scratch, by worker */
+};
+
+static encounter_err_t encounter_crypto_openssl_decryptBatchItem(\
+	encounter_t *ctx, void *arg, unsigned int worker, size_t item)
+{
+	struct ec_decrypt_batch_s *b = arg;
+	BN_CTX *bnctx = b->bnctx[worker];
+	BIGNUM *v[EC_IFMA_LANES], *r[EC_IFMA_LANES];
+	const BIGNUM *c[EC_IFMA_LANES];
+	const size_t first = (item / 2) * b->lanes;
+	size_t i, run;
 
-	/* m_q = L_q( c^(q-1) mod q^2 ) h_q mod q */
-	if (encounter_crypto_openssl_fastL(ctx, tmp, tmp, \
-			privK->k.paillier_privK.q, \
-			privK->k.paillier_privK.qinvmod2tow, bnctx) \
-		!= ENCOUNTER_OK)
-		OPENSSL_ERROR(end);
-	if (!BN_mod_mul(msubq, tmp, privK->k.paillier_privK.hsubq, \
-			privK->k.paillier_privK.q, bnctx))
-		OPENSSL_ERROR(end);
+	run = b->n - first < b->lanes ? b->n - first : b->lanes;
 
-	/* m = CRT(m_p, m_q) mod pq */
-	if (encounter_crypto_openssl_fastCRT(ctx, m, msubp, \
-			privK->k.paillier_privK.p, msubq, \
-			privK->k.paillier_privK.q, \
-			privK->k.paillier_privK.qInv, bnctx) \
-		!= ENCOUNTER_OK)
-		OPENSSL_ERROR(end);
+	BN_CTX_start(bnctx);
+	for (i = 0; i < run; ++i)
+		c[i] = v[i] = BN_CTX_get(bnctx);
+	if (!v[run - 1]) OPENSSL_ERROR(end);
+
+	for (i = 0; i < run; ++i) {
+		if (encounter_crypto_openssl_counterValue(ctx, v[i], \
+			b->counters[first + i], bnctx) != ENCOUNTER_OK)
+			goto end;
+		r[i] = b->half[2 * (first + i) + (item & 1)];
+	}
+	if (encounter_crypto_openssl_decryptHalves(ctx, r, c, run, \
+		b->privK, !(item & 1), bnctx) != ENCOUNTER_OK)
+		goto end;
 
-	/* Make the plaintext counter available via a */
-	char *plainC = BN_bn2dec(m);
-	if (!plainC) OPENSSL_ERROR(end);
+	ctx->rc = ENCOUNTER_OK;
 
-	*a = strtoull(plainC, NULL, 10);
-	OPENSSL_free(plainC);
-        if (*a == ULLONG_MAX) {
-                encounter_set_error(ctx, ENCOUNTER_ERR_OVERFLOW, \
-                    "The requested value is larger than ULLONG_MAX. ");
-                goto end;
+end:
+	for (i = 0; i < run; ++i)
+		if (v[i]) BN_clear(v[i]);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** Decrypt n counters into out[] on up to conf.batch_threads threads.
+ * The halves modulo p^2 and q^2 of each run of counters are worked on
+ * separately, so that even a single counter keeps two threads busy.
+ * The first failure stops the batch */
+encounter_err_t encounter_crypto_openssl_decrypt_batch(encounter_t *ctx, \
+	ec_count_t **counters, const size_t n, ec_keyctx_t *privK, \
+					unsigned long long int *out)
+{
+	struct ec_decrypt_batch_s b;
+	struct ec_mont_s *mont;
+	unsigned int i, workers;
+	size_t k, items;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!counters || !privK || !out) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
         }
+	for (k = 0; k < n; ++k)
+		if (!counters[k]) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+				"null counter");
+			return ctx->rc;
+		}
+	if (EC_IS_ECELGAMAL(privK))
+		return encounter_crypto_openssl_ecelgamal_decrypt_batch(ctx, \
+						counters, n, privK, out);
 
-        /* We are done */
 	ctx->rc = ENCOUNTER_OK;
+	if (!n) return ctx->rc;
 
-end:
-	if (tmp)   BN_clear(tmp); 
-	if (pmin1) BN_clear(pmin1); 
-	if (qmin1) BN_clear(qmin1);
-	if (msubp) BN_clear(msubp); 
-	if (msubq) BN_clear(msubq);
-	if (m)     BN_clear(m);
+	/* A single exponentiation modulo p^2 each */
+	if (EC_IS_OU(privK)) {
+		for (k = 0; k < n; ++k)
+			if (encounter_crypto_openssl_decrypt(ctx, counters[k], \
+					privK, &out[k]) != ENCOUNTER_OK)
+				break;
+		return ctx->rc;
+	}
 
-	if (bnctx) BN_CTX_end(bnctx);
-	if (bnctx) BN_CTX_free(bnctx);
+	/* Runs of counters for the multi-buffer kernels, when they serve
+	 * p^2 and q^2: fewer items, each many times cheaper a counter */
+	memset(&b, 0, sizeof b);
+	b.lanes = EC_IS_DJ_PRIVATE(privK) ? 1 : \
+		encounter_crypto_openssl_expmod_lanes(ctx, privK, \
+							EC_MOD_PSQUARED);
+	items = 2 * ((n + b.lanes - 1) / b.lanes);
+	workers = encounter_threadpool_workers(ctx->conf.batch_threads, items);
+
+	b.counters = counters;
+	b.n = n;
+	b.privK = privK;
+	b.half = calloc(2 * n, sizeof *b.half);
+	b.bnctx = calloc(workers, sizeof *b.bnctx);
+	if (!b.half || !b.bnctx) goto nomem;
+	for (k = 0; k < 2 * n; ++k)
+		if ((b.half[k] = BN_new()) == NULL) goto nomem;
+	for (i = 0; i < workers; ++i)
+		if ((b.bnctx[i] = BN_CTX_new()) == NULL) goto nomem;
+
+	/* The contexts are built on first use, and better once */
+	if (encounter_crypto_openssl_mont(ctx, privK, EC_MOD_PSQUARED, \
+		b.bnctx[0], &mont) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_mont(ctx, privK, EC_MOD_QSQUARED, \
+		b.bnctx[0], &mont) != ENCOUNTER_OK)
+		goto end;
+
+	if (encounter_threadpool_run(ctx, workers, items, \
+		encounter_crypto_openssl_decryptBatchItem, &b) != ENCOUNTER_OK)
+		goto end;
+
+	/* m = CRT(m_p, m_q) mod pq, as in the scalar path */
+	for (k = 0; k < n; ++k) {
+		if (encounter_crypto_openssl_crtHalves(ctx, b.half[2 * k], \
+			b.half[2 * k], b.half[2 * k + 1], privK, b.bnctx[0]) \
+				!= ENCOUNTER_OK)
+			goto end;
+		if (encounter_crypto_openssl_bn2ull(ctx, b.half[2 * k], \
+				&out[k]) != ENCOUNTER_OK)
+			goto end;
+	}
+
+	ctx->rc = ENCOUNTER_OK;
+	goto end;
+
+nomem:
+	encounter_set_error(ctx, ENCOUNTER_ERR_MEM, "batch: out of memory");
+end:
+	if (b.half) {
+		for (k = 0; k < 2 * n; ++k)
+			if (b.half[k]) BN_clear_free(b.half[k]);
+		free(b.half);
+	}
+	if (b.bnctx) {
+		for (i = 0; i < workers; ++i)
+			if (b.bnctx[i]) BN_CTX_free(b.bnctx[i]);
+		free(b.bnctx);
+	}
 
 	return ctx->rc;
 }
 
-
 static encounter_err_t encounter_crypto_openssl_fastCRT(\
 	encounter_t *ctx, BIGNUM *g, const BIGNUM *g1, const BIGNUM *p,\
    const BIGNUM *g2, const BIGNUM *q, const BIGNUM *qInv, BN_CTX *bnctx)
@@ -1556,24 +4453,48 @@ encounter_err_t encounter_crypto_openssl_numToString(encounter_t  *ctx,\
 		/* Set the key components in hex form */
 		switch (keyctx->type) {
 			case EC_KEYTYPE_PAILLIER_PUBLIC:
+			case EC_KEYTYPE_PAILLIER_NPLUS1_PUBLIC:
+			case EC_KEYTYPE_DAMGARD_JURIK_PUBLIC:
+			case EC_KEYTYPE_PAILLIER_SUBGROUP_PUBLIC:
 				(*key)->k.paillier_pubK.n = \
 				BN_bn2hex(keyctx->k.paillier_pubK.n);
 
-				(*key)->k.paillier_pubK.g = \
-				BN_bn2hex(keyctx->k.paillier_pubK.g);
-
-				(*key)->k.paillier_pubK.nsquared = \
-				BN_bn2hex(keyctx->k.paillier_pubK.nsquared);
+				/* g = n+1 and n^2 derive from n */
+				if (!EC_IS_NPLUS1_PUBLIC(keyctx)) {
+					(*key)->k.paillier_pubK.g = \
+					BN_bn2hex(keyctx->k.paillier_pubK.g);
+
+					(*key)->k.paillier_pubK.nsquared = \
+					BN_bn2hex(\
+					    keyctx->k.paillier_pubK.nsquared);
+				}
+
+				/* The rest derives from n and s */
+				if (EC_IS_DJ_PUBLIC(keyctx))
+					(*key)->k.paillier_pubK.s = \
+					encounter_crypto_openssl_degreeToString(\
+						keyctx->k.paillier_pubK.s);
+				if (EC_IS_SUBGROUP_PUBLIC(keyctx))
+					(*key)->k.paillier_pubK.alphabits = \
+					encounter_crypto_openssl_subgroup_toString(\
+								keyctx);
 
 				if (  (*key)->k.paillier_pubK.n 
-				    &&(*key)->k.paillier_pubK.g
-				    &&(*key)->k.paillier_pubK.nsquared)
+				    &&(EC_IS_NPLUS1_PUBLIC(keyctx) \
+				       ||((*key)->k.paillier_pubK.g
+				    &&   (*key)->k.paillier_pubK.nsquared))
+				    &&(!EC_IS_DJ_PUBLIC(keyctx) \
+				       || (*key)->k.paillier_pubK.s)
+				    &&(!EC_IS_SUBGROUP_PUBLIC(keyctx) \
+				       || (*key)->k.paillier_pubK.alphabits))
 					ctx->rc = ENCOUNTER_OK;
 				else	ctx->rc = ENCOUNTER_ERR_CRYPTO;
 
 				break;
 
 			case EC_KEYTYPE_PAILLIER_PRIVATE:
+			case EC_KEYTYPE_DAMGARD_JURIK_PRIVATE:
+			case EC_KEYTYPE_PAILLIER_SUBGROUP_PRIVATE:
 				(*key)->k.paillier_privK.p = \
 				BN_bn2hex(keyctx->k.paillier_privK.p);
 
@@ -1600,6 +4521,15 @@ encounter_err_t encounter_crypto_openssl_numToString(encounter_t  *ctx,\
 
 				(*key)->k.paillier_privK.qInv = \
 				BN_bn2hex(keyctx->k.paillier_privK.qInv);
+
+				if (EC_IS_DJ_PRIVATE(keyctx))
+					(*key)->k.paillier_privK.s = \
+					encounter_crypto_openssl_degreeToString(\
+						keyctx->k.paillier_privK.s);
+				if (EC_IS_SUBGROUP_PRIVATE(keyctx))
+					(*key)->k.paillier_privK.alpha = \
+					encounter_crypto_openssl_subgroup_toString(\
+								keyctx);
 				
 				if (  (*key)->k.paillier_privK.p
 				    &&(*key)->k.paillier_privK.q
@@ -1609,12 +4539,28 @@ encounter_err_t encounter_crypto_openssl_numToString(encounter_t  *ctx,\
 				    &&(*key)->k.paillier_privK.qinvmod2tow
 				    &&(*key)->k.paillier_privK.hsubp
 				    &&(*key)->k.paillier_privK.hsubq
-				    &&(*key)->k.paillier_privK.qInv)
+				    &&(*key)->k.paillier_privK.qInv
+				    &&(!EC_IS_DJ_PRIVATE(keyctx) \
+				       || (*key)->k.paillier_privK.s)
+				    &&(!EC_IS_SUBGROUP_PRIVATE(keyctx) \
+				       || (*key)->k.paillier_privK.alpha))
 					ctx->rc = ENCOUNTER_OK;
 				else	ctx->rc = ENCOUNTER_ERR_CRYPTO;
 
 				break;
 
+			case EC_KEYTYPE_ECELGAMAL_PUBLIC:
+			case EC_KEYTYPE_ECELGAMAL_PRIVATE:
+				encounter_crypto_openssl_ecelgamal_numToString(\
+							ctx, keyctx, *key);
+				break;
+
+			case EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC:
+			case EC_KEYTYPE_OKAMOTO_UCHIYAMA_PRIVATE:
+				encounter_crypto_openssl_ou_numToString(ctx, \
+							keyctx, *key);
+				break;
+
 			default:
 				assert(NOTREACHED);
 				break;
@@ -1624,6 +4570,113 @@ encounter_err_t encounter_crypto_openssl_numToString(encounter_t  *ctx,\
 	return ctx->rc;
 }
 
+/** The Damgard-Jurik degree in decimal, freed with OPENSSL_free() as
+ * the other key strings */
+static char *encounter_crypto_openssl_degreeToString(const unsigned int s)
+{
+	char *str = OPENSSL_malloc(16);
+
+	if (str) snprintf(str, 16, "%u", s);
+	return str;
+}
+
+/** Extend the freshly loaded Paillier fields to the degree in str. The
+ * key context is disposed on failure */
+static encounter_err_t encounter_crypto_openssl_degreeFromString(\
+		encounter_t *ctx, ec_keyctx_t **keyctx, const char *str)
+{
+	encounter_err_t rc;
+	unsigned long s;
+	char *endp = NULL;
+	BN_CTX *bnctx = NULL;
+
+	s = str ? strtoul(str, &endp, 10) : 0;
+	if (!str || endp == str || s > ENCOUNTER_DJ_DEGREE_MAX) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_DATA, \
+                        "bad Damgard-Jurik degree");
+                goto err;
+	}
+
+	if ((bnctx = BN_CTX_new()) == NULL) OPENSSL_ERROR(err);
+	if (encounter_crypto_openssl_dj_extend(ctx, *keyctx, s, bnctx) \
+			!= ENCOUNTER_OK)
+		goto err;
+
+	BN_CTX_free(bnctx);
+	return ctx->rc;
+
+err:
+	rc = ctx->rc;
+	if (bnctx) BN_CTX_free(bnctx);
+	encounter_crypto_openssl_free_keyctx(ctx, *keyctx);
+	*keyctx = NULL;
+	ctx->rc = rc;
+
+	return ctx->rc;
+}
+
+/** Derive g = n+1 and n^2 of a freshly loaded Paillier key from n alone.
+ * The key context is disposed on failure */
+static encounter_err_t encounter_crypto_openssl_nplus1FromString(\
+		encounter_t *ctx, ec_keyctx_t **keyctx)
+{
+	encounter_err_t rc;
+	BN_CTX *bnctx = NULL;
+	ec_keyctx_t *pubK = *keyctx;
+
+	if (BN_is_zero(pubK->k.paillier_pubK.n)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_DATA, \
+                        "bad Paillier modulus");
+                goto err;
+	}
+
+	if ((bnctx = BN_CTX_new()) == NULL) OPENSSL_ERROR(err);
+	if (!BN_add(pubK->k.paillier_pubK.g, \
+		pubK->k.paillier_pubK.n, BN_value_one()))
+		OPENSSL_ERROR(err);
+	if (!BN_sqr(pubK->k.paillier_pubK.nsquared, \
+		pubK->k.paillier_pubK.n, bnctx))
+		OPENSSL_ERROR(err);
+
+	BN_CTX_free(bnctx);
+	return ctx->rc;
+
+err:
+	rc = ctx->rc;
+	if (bnctx) BN_CTX_free(bnctx);
+	encounter_crypto_openssl_free_keyctx(ctx, *keyctx);
+	*keyctx = NULL;
+	ctx->rc = rc;
+
+	return ctx->rc;
+}
+
+/** Complete the freshly loaded Paillier fields of a subgroup key from str.
+ * The key context is disposed on failure */
+static encounter_err_t encounter_crypto_openssl_subgroupFromString(\
+		encounter_t *ctx, ec_keyctx_t **keyctx, const char *str)
+{
+	encounter_err_t rc;
+	BN_CTX *bnctx = NULL;
+
+	if ((bnctx = BN_CTX_new()) == NULL) OPENSSL_ERROR(err);
+	if (encounter_crypto_openssl_subgroup_extend(ctx, *keyctx, str, \
+			bnctx) != ENCOUNTER_OK)
+		goto err;
+
+	BN_CTX_free(bnctx);
+	return ctx->rc;
+
+err:
+	rc = ctx->rc;
+	if (bnctx) BN_CTX_free(bnctx);
+	encounter_crypto_openssl_free_keyctx(ctx, *keyctx);
+	*keyctx = NULL;
+	ctx->rc = rc;
+
+	return ctx->rc;
+}
+
 encounter_err_t encounter_crypto_openssl_stringToNum(encounter_t *ctx,\
                 ec_keystring_t *key, ec_keyctx_t **keyctx) 
 
@@ -1632,9 +4685,11 @@ encounter_err_t encounter_crypto_openssl_stringToNum(encounter_t *ctx,\
 	if (key && keyctx) {
 		switch (key->type) {
 			case EC_KEYTYPE_PAILLIER_PUBLIC:
+			case EC_KEYTYPE_PAILLIER_NPLUS1_PUBLIC:
+			case EC_KEYTYPE_DAMGARD_JURIK_PUBLIC:
+			case EC_KEYTYPE_PAILLIER_SUBGROUP_PUBLIC:
 				if (encounter_crypto_openssl_new_keyctx(\
-				    EC_KEYTYPE_PAILLIER_PUBLIC ,keyctx )\
-				 != ENCOUNTER_OK) 
+				    key->type, keyctx) != ENCOUNTER_OK) 
 					break;
 				
 				(*keyctx)->type = key->type;				
@@ -1654,12 +4709,45 @@ encounter_err_t encounter_crypto_openssl_stringToNum(encounter_t *ctx,\
 					ctx->rc = ENCOUNTER_OK;
 				else	ctx->rc = ENCOUNTER_ERR_CRYPTO;
 
+				if (ctx->rc == ENCOUNTER_OK \
+				    && EC_IS_NPLUS1_PUBLIC(*keyctx))
+					encounter_crypto_openssl_nplus1FromString(\
+					    ctx, keyctx);
+
+				/* Older keysets do not record the generator
+				 * kind: spot g = n+1 to take the fast paths */
+				if (ctx->rc == ENCOUNTER_OK \
+				    && !EC_IS_DJ_PUBLIC(*keyctx) \
+				    && !EC_IS_SUBGROUP_PUBLIC(*keyctx)) {
+					BIGNUM *nplus1 = BN_dup(\
+					    (*keyctx)->k.paillier_pubK.n);
+
+					if (nplus1 && BN_add_word(nplus1, 1) \
+					    && BN_are_equal(nplus1, \
+					    (*keyctx)->k.paillier_pubK.g))
+						(*keyctx)->type = \
+					    EC_KEYTYPE_PAILLIER_NPLUS1_PUBLIC;
+					if (nplus1) BN_free(nplus1);
+				}
+
+				if (ctx->rc == ENCOUNTER_OK \
+				    && EC_IS_DJ_PUBLIC(*keyctx))
+					encounter_crypto_openssl_degreeFromString(\
+					    ctx, keyctx, key->k.paillier_pubK.s);
+
+				if (ctx->rc == ENCOUNTER_OK \
+				    && EC_IS_SUBGROUP_PUBLIC(*keyctx))
+					encounter_crypto_openssl_subgroupFromString(\
+					    ctx, keyctx, \
+					    key->k.paillier_pubK.alphabits);
+
 				break;
 
 			case EC_KEYTYPE_PAILLIER_PRIVATE:
+			case EC_KEYTYPE_DAMGARD_JURIK_PRIVATE:
+			case EC_KEYTYPE_PAILLIER_SUBGROUP_PRIVATE:
 				if (encounter_crypto_openssl_new_keyctx(\
-				    EC_KEYTYPE_PAILLIER_PRIVATE ,keyctx )\
-				 != ENCOUNTER_OK) 
+				    key->type, keyctx) != ENCOUNTER_OK) 
 					break;
 
 				(*keyctx)->type = key->type;				
@@ -1709,6 +4797,50 @@ encounter_err_t encounter_crypto_openssl_stringToNum(encounter_t *ctx,\
 				    &&(*keyctx)->k.paillier_privK.qInv)
 					ctx->rc = ENCOUNTER_OK;
 				else	ctx->rc = ENCOUNTER_ERR_CRYPTO;
+
+				if (ctx->rc == ENCOUNTER_OK \
+				    && EC_IS_DJ_PRIVATE(*keyctx))
+					encounter_crypto_openssl_degreeFromString(\
+					    ctx, keyctx, key->k.paillier_privK.s);
+
+				if (ctx->rc == ENCOUNTER_OK \
+				    && EC_IS_SUBGROUP_PRIVATE(*keyctx))
+					encounter_crypto_openssl_subgroupFromString(\
+					    ctx, keyctx, key->k.paillier_privK.alpha);
+				break;
+
+			case EC_KEYTYPE_ECELGAMAL_PUBLIC:
+			case EC_KEYTYPE_ECELGAMAL_PRIVATE:
+				if (encounter_crypto_openssl_new_keyctx(\
+				    key->type, keyctx) != ENCOUNTER_OK) 
+					break;
+
+				if (encounter_crypto_openssl_ecelgamal_stringToNum(\
+				    ctx, key, *keyctx) != ENCOUNTER_OK) {
+					encounter_err_t rc = ctx->rc;
+
+					encounter_crypto_openssl_free_keyctx(\
+							ctx, *keyctx);
+					*keyctx = NULL;
+					ctx->rc = rc;
+				}
+				break;
+
+			case EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC:
+			case EC_KEYTYPE_OKAMOTO_UCHIYAMA_PRIVATE:
+				if (encounter_crypto_openssl_new_keyctx(\
+				    key->type, keyctx) != ENCOUNTER_OK) 
+					break;
+
+				if (encounter_crypto_openssl_ou_stringToNum(\
+				    ctx, key, *keyctx) != ENCOUNTER_OK) {
+					encounter_err_t rc = ctx->rc;
+
+					encounter_crypto_openssl_free_keyctx(\
+							ctx, *keyctx);
+					*keyctx = NULL;
+					ctx->rc = rc;
+				}
 				break;
 
 			default:
@@ -1726,9 +4858,54 @@ encounter_err_t encounter_crypto_openssl_counterToString(\
 {
         if (!ctx)       return ENCOUNTER_ERR_PARAM;
 
+	if (encount && counter && EC_IS_ECELGAMAL_COUNT(encount))
+		return encounter_crypto_openssl_ecelgamal_counterToString(ctx, \
+							encount, counter);
+
 	if (encount && counter) {
-		*counter = BN_bn2hex(encount->c);
-		if (counter) 	ctx->rc = ENCOUNTER_OK;
+		if (encount->mont) {
+			/* Serialized in standard form */
+			BN_CTX *bnctx = BN_CTX_new();
+			BIGNUM *c = BN_new();
+
+			*counter = NULL;
+			if (bnctx && c && \
+			    encounter_crypto_openssl_counterValue(ctx, c, \
+					encount, bnctx) == ENCOUNTER_OK)
+				*counter = BN_bn2hex(c);
+
+			if (c)     BN_clear_free(c);
+			if (bnctx) BN_CTX_free(bnctx);
+		} else
+			*counter = BN_bn2hex(encount->c);
+
+		/* Damgard-Jurik, Okamoto-Uchiyama and packed counters are
+		 * tagged */
+		if (*counter && (encount->slots || \
+		    encount->version == ENCOUNTER_COUNT_DAMGARD_JURIK_V1 || \
+		    EC_IS_OU_COUNT(encount))) {
+			char tag[EC_DJ_TAG_LEN + 32];
+			size_t len = strlen(*counter) + 1, taglen;
+			char *tagged;
+
+			taglen = snprintf(tag, sizeof tag, "%s", \
+			    encount->version == ENCOUNTER_COUNT_DAMGARD_JURIK_V1 \
+				? EC_DJ_TAG : EC_IS_OU_COUNT(encount) \
+				? EC_OU_TAG : "");
+			if (encount->slots)
+				taglen += snprintf(tag + taglen, \
+					sizeof tag - taglen, EC_PACKED_TAG, \
+					encount->slots, encount->width);
+
+			tagged = OPENSSL_malloc(taglen + len);
+			if (tagged) {
+				memcpy(tagged, tag, taglen);
+				memcpy(tagged + taglen, *counter, len);
+			}
+			OPENSSL_free(*counter);
+			*counter = tagged;
+		}
+		if (*counter) 	ctx->rc = ENCOUNTER_OK;
 		else		ctx->rc = ENCOUNTER_ERR_CRYPTO;
 
 	} else ctx->rc = ENCOUNTER_ERR_PARAM;
@@ -1753,14 +4930,21 @@ encounter_err_t encounter_crypto_openssl_dispose_keystring(\
 	if (key) {
 		switch(key->type) {
 			case EC_KEYTYPE_PAILLIER_PUBLIC:
+			case EC_KEYTYPE_PAILLIER_NPLUS1_PUBLIC:
+			case EC_KEYTYPE_DAMGARD_JURIK_PUBLIC:
+			case EC_KEYTYPE_PAILLIER_SUBGROUP_PUBLIC:
 				OPENSSL_free(key->k.paillier_pubK.n);
 				OPENSSL_free(key->k.paillier_pubK.g);
 				OPENSSL_free(key->k.paillier_pubK.nsquared);
+				OPENSSL_free(key->k.paillier_pubK.s);
+				OPENSSL_free(key->k.paillier_pubK.alphabits);
 				memset(key, 0, sizeof *key);
 				free(key);
 				ctx->rc = ENCOUNTER_OK;
 				break;
 			case EC_KEYTYPE_PAILLIER_PRIVATE:	
+			case EC_KEYTYPE_DAMGARD_JURIK_PRIVATE:
+			case EC_KEYTYPE_PAILLIER_SUBGROUP_PRIVATE:
 				OPENSSL_free(key->k.paillier_privK.p);	
 				OPENSSL_free(key->k.paillier_privK.q);	
 				OPENSSL_free(key->k.paillier_privK.psquared);	
@@ -1770,6 +4954,38 @@ encounter_err_t encounter_crypto_openssl_dispose_keystring(\
 				OPENSSL_free(key->k.paillier_privK.hsubp);	
 				OPENSSL_free(key->k.paillier_privK.hsubq);	
 				OPENSSL_free(key->k.paillier_privK.qInv);
+				OPENSSL_free(key->k.paillier_privK.s);
+				OPENSSL_free(key->k.paillier_privK.alpha);
+				memset(key, 0, sizeof *key);
+				free(key);
+				ctx->rc = ENCOUNTER_OK;
+				break;
+			case EC_KEYTYPE_ECELGAMAL_PUBLIC:
+				OPENSSL_free(key->k.ecelgamal_pubK.curve);
+				OPENSSL_free(key->k.ecelgamal_pubK.h);
+				memset(key, 0, sizeof *key);
+				free(key);
+				ctx->rc = ENCOUNTER_OK;
+				break;
+			case EC_KEYTYPE_ECELGAMAL_PRIVATE:
+				OPENSSL_free(key->k.ecelgamal_privK.curve);
+				OPENSSL_free(key->k.ecelgamal_privK.x);
+				memset(key, 0, sizeof *key);
+				free(key);
+				ctx->rc = ENCOUNTER_OK;
+				break;
+			case EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC:
+				OPENSSL_free(key->k.ou_pubK.n);
+				OPENSSL_free(key->k.ou_pubK.g);
+				OPENSSL_free(key->k.ou_pubK.h);
+				memset(key, 0, sizeof *key);
+				free(key);
+				ctx->rc = ENCOUNTER_OK;
+				break;
+			case EC_KEYTYPE_OKAMOTO_UCHIYAMA_PRIVATE:
+				OPENSSL_free(key->k.ou_privK.p);
+				OPENSSL_free(key->k.ou_privK.q);
+				OPENSSL_free(key->k.ou_privK.g);
 				memset(key, 0, sizeof *key);
 				free(key);
 				ctx->rc = ENCOUNTER_OK;
@@ -1806,7 +5022,45 @@ encounter_err_t encounter_crypto_openssl_stringToCounter(\
 
 	*encount = calloc(1, sizeof **encount);
 	if (*encount) {
+		if (!strncmp(counter, EC_ECELGAMAL_TAG, EC_ECELGAMAL_TAG_LEN)) {
+			if (encounter_crypto_openssl_ecelgamal_stringToCounter(\
+				ctx, counter, *encount) != ENCOUNTER_OK) {
+				encounter_crypto_openssl_free_counter(ctx, \
+								*encount);
+				goto err;
+			}
+			time(&((*encount)->lastUpdated));
+			return ctx->rc;
+		}
+
 		(*encount)->version = ENCOUNTER_COUNT_PAILLIER_V1;
+		if (!strncmp(counter, EC_DJ_TAG, EC_DJ_TAG_LEN)) {
+			(*encount)->version = ENCOUNTER_COUNT_DAMGARD_JURIK_V1;
+			counter += EC_DJ_TAG_LEN;
+		} else if (!strncmp(counter, EC_OU_TAG, EC_OU_TAG_LEN)) {
+			(*encount)->version = \
+				ENCOUNTER_COUNT_OKAMOTO_UCHIYAMA_V1;
+			counter += EC_OU_TAG_LEN;
+		}
+		if (*counter == 'P') {
+			int used = 0;
+
+			/* The key alone bounds the slots against its plaintext
+			 * space, on use; no Okamoto-Uchiyama packing */
+			if ((*encount)->version == \
+				ENCOUNTER_COUNT_OKAMOTO_UCHIYAMA_V1 \
+			    || sscanf(counter, EC_PACKED_TAG "%n", \
+				&(*encount)->slots, &(*encount)->width, \
+						&used) != 2 || !used \
+			    || !(*encount)->slots || !(*encount)->width \
+			    || (*encount)->width > \
+					8 * sizeof (unsigned long long)) {
+				encounter_set_error(ctx, ENCOUNTER_ERR_DATA, \
+					"bad packed counter tag");
+				goto err;
+			}
+			counter += used;
+		}
 		if (!BN_hex2bn(&(*encount)->c, counter))
 			OPENSSL_ERROR(err);
 
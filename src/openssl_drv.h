@@ -3,8 +3,10 @@
 
 #include <unistd.h>
 #include <sys/time.h>
+#include <pthread.h>
 
 #include <openssl/bn.h>
+#include <openssl/ec.h>
 
 #include "encounter_priv.h"
 
@@ -14,6 +16,15 @@ struct paillier_publickey {
 	BIGNUM	*n; 
 	BIGNUM	*g;
 	BIGNUM	*nsquared;
+
+	/* Damgard-Jurik keys of degree s > 1 (g = n+1), NULL otherwise */
+	unsigned int	s;
+	BIGNUM	*ns;		/* n^s, the plaintext modulus */
+	BIGNUM	*nsplus1;	/* n^(s+1), the ciphertext modulus */
+
+	/* Paillier subgroup keys, 0 and NULL otherwise */
+	unsigned int	alphabits;	/* Bits of alpha, the randomizers */
+	BIGNUM	*gn;		/* g^n mod n^2 */
 };
 
 /* Paillier Private-Key */
@@ -24,6 +35,94 @@ struct paillier_privatekey {
 	BIGNUM *hsubp;
 	BIGNUM *hsubq;
 	BIGNUM *qInv;
+
+	/* Damgard-Jurik keys of degree s > 1, NULL otherwise. Derived
+	 * from p, q and s, the Paillier fields above staying valid */
+	unsigned int	s;
+	BIGNUM *ps, *qs;		/* p^s, q^s */
+	BIGNUM *psplus1, *qsplus1;	/* p^(s+1), q^(s+1) */
+	BIGNUM *djhsubp, *djhsubq;	/* h_p mod p^s, h_q mod q^s */
+	BIGNUM *qsInv;			/* (q^s)^-1 mod p^s */
+
+	/* Paillier subgroup keys, NULL otherwise: the order of g mod n,
+	 * the decryption exponent. h_p and h_q are L(g^alpha)^-1 then */
+	BIGNUM *alpha;
+};
+
+/* EC-ElGamal Public-Key */
+struct ecelgamal_publickey {
+	EC_GROUP *group;	/* P-256 */
+	EC_POINT *h;		/* h = xG */
+};
+
+/* EC-ElGamal Private-Key */
+struct ecelgamal_privatekey {
+	EC_GROUP *group;	/* P-256 */
+	BIGNUM	*x;
+};
+
+/* Okamoto-Uchiyama Public-Key */
+struct ou_publickey {
+	BIGNUM *n;		/* n = p^2 q */
+	BIGNUM *g;
+	BIGNUM *h;		/* h = g^n mod n */
+};
+
+/* Okamoto-Uchiyama Private-Key */
+struct ou_privatekey {
+	BIGNUM *p;
+	BIGNUM *q;
+	BIGNUM *g;
+	BIGNUM *psquared;	/* p^2 */
+	BIGNUM *gpinv;		/* L(g^(p-1) mod p^2)^-1 mod p */
+};
+
+struct ec_pool_s;	/* Forward decl., see openssl_pool.h */
+struct ec_fbase_s;	/* Forward decl., see openssl_fbase.h */
+struct ec_bsgs_s;	/* Forward decl., see openssl_ecelgamal.h */
+struct ec_ifma_mod_s;	/* Forward decl., see openssl_ifma.h */
+
+/* Montgomery context shared by a key and the counters kept in
+ * Montgomery form under it, which may outlive the key */
+struct ec_mont_s {
+	BN_MONT_CTX	*ctx;
+	struct ec_ifma_mod_s *ifma;	/* When the IFMA kernels serve it */
+	pthread_mutex_t	lock;
+	unsigned int	refs;
+};
+
+/* Key moduli with a cached Montgomery context */
+typedef enum {
+	EC_MOD_NSQUARED,	/* n^2, public-keys; n^(s+1) Damgard-Jurik */
+	EC_MOD_PSQUARED,	/* p^2, private-keys; p^(s+1) Damgard-Jurik */
+	EC_MOD_QSQUARED,	/* q^2, private-keys; q^(s+1) Damgard-Jurik */
+	EC_MOD_P,		/* p, private-keys */
+	EC_MOD_Q,		/* q, private-keys */
+	EC_MOD_LAST
+} ec_modulus_t;
+
+/* Fixed-base tables kept by a public-key */
+typedef enum {
+	EC_FBASE_H,		/* h = x^n, randomizers */
+	EC_FBASE_G,		/* g, general generators only */
+	EC_FBASE_GINV,		/* g^-1, general generators only */
+	EC_FBASE_LAST
+} ec_fbase_kind_t;
+
+/* A key generation under way, shared by the threads working its primes:
+ * the progress callback of the configuration, serialized by lock, and the
+ * cancellation it may ask for. The halves of a Paillier keypair, prime
+ * and generator modulo its square, are worked as the items 0 and 1 of a
+ * threadpool run */
+struct ec_keygen_s {
+	pthread_mutex_t	lock;
+	encounter_progress_cb_t cb;
+	void		*arg;
+	bool		canceled;
+
+	ec_keyctx_t	*privK;
+	unsigned int	keysize;
+	BIGNUM		*g[2];		/* g_p, g_q; NULL for no search */
 };
 
 /* Encounter Key Context */
@@ -33,7 +132,19 @@ struct ec_keyctx_s {
 	union ec_key_u {
 		struct paillier_publickey	paillier_pubK;
 		struct paillier_privatekey	paillier_privK;
+		struct ecelgamal_publickey	ecelgamal_pubK;
+		struct ecelgamal_privatekey	ecelgamal_privK;
+		struct ou_publickey		ou_pubK;
+		struct ou_privatekey		ou_privK;
 	}k;
+
+	/* Runtime state, never serialized */
+	pthread_mutex_t	lock;		/* Guards the lazily built state */
+	struct ec_pool_s *pool;		/* Precomputed randomizers */
+	struct ec_fbase_s *fbase[EC_FBASE_LAST]; /* Built on first use */
+	struct ec_mont_s *mont[EC_MOD_LAST]; /* Built on first use */
+	BIGNUM		*crtinv;	/* (q^2)^-1 mod p^2, owner mode */
+	struct ec_bsgs_s *bsgs;		/* EC-ElGamal baby steps */
 };
 
 
@@ -44,11 +155,28 @@ struct ec_count_s {
 	time_t		  lastUpdated; /* UTC time for the last update */
 
 	BIGNUM *c;			/* the crypto counter */
+	struct ec_mont_s *mont;		/* Set while c holds cR mod n^2 */
+
+	/* Packed counters hold slots values of width bits, each followed
+	 * by ENCOUNTER_PACKED_GUARD_BITS for the carries. No slots for a
+	 * scalar counter */
+	unsigned int	slots;
+	unsigned int	width;
+
+	/* EC-ElGamal counters hold (rG, mG + rH) here, c is NULL */
+	EC_POINT	*c1;
+	EC_POINT	*c2;
 };
 
 
 #define PAILLIER_RANDOMIZER_SECLEVEL    256
 
+/* Counters per run of a summation, the unit of work of its threads */
+#define PAILLIER_SUM_RUN		64
+
+/* Counters per run of a bulk creation, the unit of work of its threads */
+#define PAILLIER_NEW_RUN		64
+
 #define	OPENSSL_ERROR(l)	do { \
 		encounter_set_error(ctx, ENCOUNTER_ERR_CRYPTO, \
 			"openssl error: %s", \
@@ -66,32 +194,52 @@ encounter_err_t encounter_crypto_openssl_keygen(encounter_t *, \
 	encounter_key_t, unsigned int, ec_keyctx_t **, ec_keyctx_t **);
 
 encounter_err_t encounter_crypto_openssl_new_counter(encounter_t *, \
-			ec_keyctx_t *pubK, ec_count_t **);
+		ec_keyctx_t *pubK, ec_keyctx_t *privK, ec_count_t **);
 
 encounter_err_t encounter_crypto_openssl_free_counter(encounter_t *, \
 			ec_count_t *);
 
+encounter_err_t encounter_crypto_openssl_new_counters(encounter_t *, \
+	ec_keyctx_t *, const size_t, const unsigned int *, ec_count_t **);
+
+encounter_err_t encounter_crypto_openssl_free_counters(encounter_t *, \
+				ec_count_t **, const size_t);
+
 encounter_err_t encounter_crypto_openssl_inc(encounter_t *, \
-		ec_count_t *, ec_keyctx_t *, const unsigned int );
+	ec_count_t *, ec_keyctx_t *, ec_keyctx_t *, const unsigned int );
 
 encounter_err_t encounter_crypto_openssl_dec(encounter_t *, \
-		ec_count_t *, ec_keyctx_t *, const unsigned int );
+	ec_count_t *, ec_keyctx_t *, ec_keyctx_t *, const unsigned int );
 
 encounter_err_t encounter_crypto_openssl_touch(encounter_t *, \
-				ec_count_t *, ec_keyctx_t *);
+			ec_count_t *, ec_keyctx_t *, ec_keyctx_t *);
 
 encounter_err_t encounter_crypto_openssl_add(encounter_t *, \
-		ec_count_t *, ec_count_t *, ec_keyctx_t *);
+	ec_count_t *, ec_count_t *, ec_keyctx_t *, ec_keyctx_t *);
 
 encounter_err_t encounter_crypto_openssl_sub(encounter_t *, \
-		ec_count_t *, ec_count_t *, ec_keyctx_t *);
+	ec_count_t *, ec_count_t *, ec_keyctx_t *, ec_keyctx_t *);
+
+encounter_err_t encounter_crypto_openssl_dec_batch(encounter_t *, \
+	ec_count_t **, const unsigned int *, const size_t, ec_keyctx_t *);
+
+encounter_err_t encounter_crypto_openssl_sub_batch(encounter_t *, \
+	ec_count_t **, ec_count_t **, const size_t, ec_keyctx_t *);
 
 encounter_err_t encounter_crypto_openssl_mul(encounter_t *, \
-		ec_count_t *, ec_keyctx_t *, const unsigned int);
+	ec_count_t *, ec_keyctx_t *, ec_keyctx_t *, const unsigned int);
 
 encounter_err_t encounter_crypto_openssl_mul_rand(encounter_t *, \
 		                        ec_count_t *, ec_keyctx_t *);
 
+encounter_err_t encounter_crypto_openssl_linear_combination(encounter_t *,\
+	ec_count_t **, const unsigned int *, const size_t, ec_keyctx_t *, \
+							ec_count_t *);
+
+encounter_err_t encounter_crypto_openssl_sum(encounter_t *, \
+	ec_count_t **, const size_t, ec_keyctx_t *, ec_count_t *, \
+			ec_keyctx_t *, unsigned long long int *);
+
 encounter_err_t encounter_crypto_openssl_dup(encounter_t *, \
 		ec_keyctx_t *, ec_count_t *, ec_count_t **);
 
@@ -109,6 +257,29 @@ encounter_err_t encounter_crypto_openssl_private_cmp2(encounter_t *, \
 encounter_err_t encounter_crypto_openssl_decrypt(encounter_t *, \
 		ec_count_t *, ec_keyctx_t *, unsigned long long int *);
 
+encounter_err_t encounter_crypto_openssl_decrypt_bounded(encounter_t *, \
+		ec_count_t *, ec_keyctx_t *, unsigned long long int *);
+
+encounter_err_t encounter_crypto_openssl_decrypt_batch(encounter_t *, \
+	ec_count_t **, const size_t, ec_keyctx_t *, unsigned long long int *);
+
+encounter_err_t encounter_crypto_openssl_decrypt_bytes(encounter_t *, \
+	ec_count_t *, ec_keyctx_t *, unsigned char *, size_t *);
+
+encounter_err_t encounter_crypto_openssl_new_packed(encounter_t *, \
+	ec_keyctx_t *, const unsigned int, const unsigned int, ec_count_t **);
+
+encounter_err_t encounter_crypto_openssl_inc_slot(encounter_t *, \
+	ec_count_t *, ec_keyctx_t *, const unsigned int, \
+					const unsigned long long int);
+
+encounter_err_t encounter_crypto_openssl_dec_slot(encounter_t *, \
+	ec_count_t *, ec_keyctx_t *, const unsigned int, \
+					const unsigned long long int);
+
+encounter_err_t encounter_crypto_openssl_decrypt_packed(encounter_t *, \
+	ec_count_t *, ec_keyctx_t *, unsigned long long int *, const size_t);
+
 encounter_err_t encounter_crypto_openssl_free_keyctx(encounter_t *, \
 						ec_keyctx_t *);
 
@@ -133,4 +304,56 @@ encounter_err_t encounter_crypto_openssl_dispose_counterString(\
 encounter_err_t encounter_crypto_openssl_stringToCounter(\
 			encounter_t *, const char *, ec_count_t **);
 
+encounter_err_t encounter_crypto_openssl_new_randomizer(encounter_t *, \
+			BIGNUM *, ec_keyctx_t *, BN_CTX *);
+
+encounter_err_t encounter_crypto_openssl_new_randomizers(encounter_t *, \
+		BIGNUM **, const size_t, ec_keyctx_t *, BN_CTX *);
+
+encounter_err_t encounter_crypto_openssl_rtothen(encounter_t *, \
+			BIGNUM *, ec_keyctx_t *, BN_CTX *);
+
+encounter_err_t encounter_crypto_openssl_rtothen_batch(encounter_t *, \
+		BIGNUM **, const size_t, ec_keyctx_t *, BN_CTX *);
+
+void encounter_crypto_openssl_keygen_init(encounter_t *, \
+						struct ec_keygen_s *);
+
+void encounter_crypto_openssl_keygen_destroy(struct ec_keygen_s *);
+
+bool encounter_crypto_openssl_keygen_step(struct ec_keygen_s *, \
+		const encounter_keygen_step_t, const unsigned int);
+
+encounter_err_t encounter_crypto_openssl_genprime(encounter_t *, \
+	struct ec_keygen_s *, BIGNUM *, const int, const BIGNUM *, \
+				const BIGNUM *, const unsigned int);
+
+encounter_err_t encounter_crypto_openssl_mont(encounter_t *, \
+	ec_keyctx_t *, const ec_modulus_t, BN_CTX *, struct ec_mont_s **);
+
+encounter_err_t encounter_crypto_openssl_mulmod(encounter_t *, BIGNUM *, \
+	const BIGNUM *, const BIGNUM *, ec_keyctx_t *, const ec_modulus_t, \
+								BN_CTX *);
+
+encounter_err_t encounter_crypto_openssl_montmul(encounter_t *, BIGNUM *, \
+	const BIGNUM *, const BIGNUM *, ec_keyctx_t *, const ec_modulus_t, \
+								BN_CTX *);
+
+encounter_err_t encounter_crypto_openssl_tomont(encounter_t *, BIGNUM *, \
+	const BIGNUM *, ec_keyctx_t *, const ec_modulus_t, BN_CTX *);
+
+encounter_err_t encounter_crypto_openssl_expmod(encounter_t *, BIGNUM *, \
+	const BIGNUM *, const BIGNUM *, ec_keyctx_t *, const ec_modulus_t, \
+								BN_CTX *);
+
+encounter_err_t encounter_crypto_openssl_expmodBN(encounter_t *, \
+	BIGNUM *, const BIGNUM *, const BIGNUM *, const BIGNUM *, BN_CTX *);
+
+size_t encounter_crypto_openssl_expmod_lanes(encounter_t *, \
+				ec_keyctx_t *, const ec_modulus_t);
+
+encounter_err_t encounter_crypto_openssl_expmod_batch(encounter_t *, \
+	BIGNUM **, BIGNUM **, const size_t, const BIGNUM *, ec_keyctx_t *, \
+					const ec_modulus_t, BN_CTX *);
+
 #endif  /* _ENCOUNTER_OPENSSL_DRV_H_ */
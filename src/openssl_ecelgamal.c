@@ -0,0 +1,1227 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/obj_mac.h>
+#include <openssl/err.h>
+#include <openssl/crypto.h>
+
+#include "encounter_priv.h"
+
+#include "openssl_drv.h"
+#include "openssl_ecelgamal.h"
+#include "openssl_drbg.h"
+#include "threadpool.h"
+
+#include "utils.h"
+
+
+/* Compressed P-256 point: sign byte and x */
+#define EC_ECELGAMAL_POINT_LEN	33
+
+/* First line of a persisted baby-step table: bits, then entry size */
+#define EC_BSGS_HEADER		"encounter-bsgs " EC_ECELGAMAL_CURVE " %u %u\n"
+
+
+/* Some static prototypes */
+static encounter_err_t encounter_crypto_openssl_ecelgamal_check(\
+	encounter_t *, const ec_count_t *, const ec_keyctx_t *, \
+					const encounter_key_t);
+
+static encounter_err_t encounter_crypto_openssl_ecelgamal_randomizer(\
+	encounter_t *, EC_POINT *, EC_POINT *, const EC_GROUP *, \
+		const EC_POINT *, const BIGNUM *, BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_ecelgamal_rerandomize(\
+	encounter_t *, EC_POINT *, EC_POINT *, ec_keyctx_t *, BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_ecelgamal_plainPoint(\
+	encounter_t *, EC_POINT *, const EC_POINT *, const EC_POINT *, \
+					ec_keyctx_t *, BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_ecelgamal_pointKey(\
+	encounter_t *, const EC_GROUP *, const EC_POINT *, uint64_t *, \
+								BN_CTX *);
+
+static int encounter_crypto_openssl_ecelgamal_entryCmp(const void *, \
+							const void *);
+
+static encounter_err_t encounter_crypto_openssl_ecelgamal_bsgs(\
+	encounter_t *, ec_keyctx_t *, BN_CTX *, const struct ec_bsgs_s **);
+
+static encounter_err_t encounter_crypto_openssl_ecelgamal_bsgsBuild(\
+	encounter_t *, const EC_GROUP *, struct ec_bsgs_s *, BN_CTX *);
+
+static bool encounter_crypto_openssl_ecelgamal_bsgsLoad(\
+				struct ec_bsgs_s *, const char *);
+
+static void encounter_crypto_openssl_ecelgamal_bsgsStore(\
+			const struct ec_bsgs_s *, const char *);
+
+static encounter_err_t encounter_crypto_openssl_ecelgamal_log(\
+	encounter_t *, const EC_GROUP *, const struct ec_bsgs_s *, \
+		const EC_POINT *, unsigned long long int *, BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_ecelgamal_decryptItem(\
+	encounter_t *, void *, unsigned int, size_t);
+
+static char *encounter_crypto_openssl_ecelgamal_curveToString(void);
+
+
+
+/** An EC-ElGamal counter, if any, and a key of the given type */
+static encounter_err_t encounter_crypto_openssl_ecelgamal_check(\
+	encounter_t *ctx, const ec_count_t *counter, const ec_keyctx_t *key, \
+						const encounter_key_t type)
+{
+	if (counter && (!EC_IS_ECELGAMAL_COUNT(counter) \
+	    || !counter->c1 || !counter->c2)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "not an EC-ElGamal counter");
+                return ctx->rc;
+	}
+	if (key->type != type) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "not an EC-ElGamal %s-key", \
+			type == EC_KEYTYPE_ECELGAMAL_PUBLIC ? \
+						"public" : "private");
+                return ctx->rc;
+	}
+
+	ctx->rc = ENCOUNTER_OK;
+	return ctx->rc;
+}
+
+/** x at random in [1, order), h = xG */
+encounter_err_t encounter_crypto_openssl_ecelgamal_keygen(encounter_t *ctx, \
+				ec_keyctx_t *pubK, ec_keyctx_t *privK)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!pubK || !privK) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	const EC_GROUP *group = privK->k.ecelgamal_privK.group;
+	BIGNUM *x = privK->k.ecelgamal_privK.x;
+	BN_CTX *bnctx = BN_CTX_new();
+	BN_CTX_start(bnctx);
+	BIGNUM *order = BN_CTX_get(bnctx);
+
+	if (!order) OPENSSL_ERROR(end);
+
+	if (!EC_GROUP_get_order(group, order, bnctx)) OPENSSL_ERROR(end);
+	do {
+		if (!BN_rand_range(x, order)) OPENSSL_ERROR(end);
+	} while (BN_is_zero(x));
+
+	if (!EC_POINT_mul(group, pubK->k.ecelgamal_pubK.h, x, NULL, NULL, \
+			bnctx))
+		OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (bnctx) BN_CTX_end(bnctx);
+	if (bnctx) BN_CTX_free(bnctx);
+
+	return ctx->rc;
+}
+
+/** t1 = rG, t2 = mG + rh for a fresh r: the encryption of m, an
+ * encryption of 0 when m is zero */
+static encounter_err_t encounter_crypto_openssl_ecelgamal_randomizer(\
+	encounter_t *ctx, EC_POINT *t1, EC_POINT *t2, const EC_GROUP *group, \
+		const EC_POINT *h, const BIGNUM *m, BN_CTX *bnctx)
+{
+	BN_CTX_start(bnctx);
+	BIGNUM *r = BN_CTX_get(bnctx);
+	BIGNUM *order = BN_CTX_get(bnctx);
+
+	if (!order) OPENSSL_ERROR(end);
+
+	if (!EC_GROUP_get_order(group, order, bnctx)) OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_drbg_range(ctx, &r, 1, order) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	/* G is a fixed base, with a precomputed table in OpenSSL */
+	if (!EC_POINT_mul(group, t1, r, NULL, NULL, bnctx))
+		OPENSSL_ERROR(end);
+	if (!EC_POINT_mul(group, t2, m, h, r, bnctx))
+		OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (r)    BN_clear(r);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** (c1, c2) += an encryption of 0 */
+static encounter_err_t encounter_crypto_openssl_ecelgamal_rerandomize(\
+	encounter_t *ctx, EC_POINT *c1, EC_POINT *c2, ec_keyctx_t *pubK, \
+								BN_CTX *bnctx)
+{
+	const EC_GROUP *group = pubK->k.ecelgamal_pubK.group;
+	EC_POINT *t1 = EC_POINT_new(group);
+	EC_POINT *t2 = EC_POINT_new(group);
+
+	BN_CTX_start(bnctx);
+	BIGNUM *zero = BN_CTX_get(bnctx);
+
+	if (!t1 || !t2 || !zero) OPENSSL_ERROR(end);
+	BN_zero(zero);
+
+	if (encounter_crypto_openssl_ecelgamal_randomizer(ctx, t1, t2, \
+		group, pubK->k.ecelgamal_pubK.h, zero, bnctx) != ENCOUNTER_OK)
+		goto end;
+	if (!EC_POINT_add(group, c1, c1, t1, bnctx)) OPENSSL_ERROR(end);
+	if (!EC_POINT_add(group, c2, c2, t2, bnctx)) OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	BN_CTX_end(bnctx);
+	if (t1) EC_POINT_clear_free(t1);
+	if (t2) EC_POINT_clear_free(t2);
+
+	return ctx->rc;
+}
+
+/** A fresh encryption of 0 into the points of counter */
+encounter_err_t encounter_crypto_openssl_ecelgamal_new_counter(\
+	encounter_t *ctx, ec_keyctx_t *pubK, ec_count_t *counter)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!pubK || !counter) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (encounter_crypto_openssl_ecelgamal_check(ctx, NULL, pubK, \
+			EC_KEYTYPE_ECELGAMAL_PUBLIC) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	const EC_GROUP *group = pubK->k.ecelgamal_pubK.group;
+	BN_CTX *bnctx = BN_CTX_new();
+	BN_CTX_start(bnctx);
+	BIGNUM *zero = BN_CTX_get(bnctx);
+
+	if (!zero) OPENSSL_ERROR(end);
+	BN_zero(zero);
+
+	counter->version = ENCOUNTER_COUNT_ECELGAMAL_V1;
+	counter->c1 = EC_POINT_new(group);
+	counter->c2 = EC_POINT_new(group);
+	if (!counter->c1 || !counter->c2) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_ecelgamal_randomizer(ctx, counter->c1, \
+		counter->c2, group, pubK->k.ecelgamal_pubK.h, zero, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	/* Update the time of last modification */
+	time(&(counter->lastUpdated));
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (bnctx) BN_CTX_end(bnctx);
+	if (bnctx) BN_CTX_free(bnctx);
+
+	return ctx->rc;
+}
+
+/** Add, or take, a to the counter: one fixed-base and one double
+ * product, and two additions. a = 0 re-randomizes the counter */
+encounter_err_t encounter_crypto_openssl_ecelgamal_update(encounter_t *ctx, \
+	ec_count_t *counter, ec_keyctx_t *pubK, const unsigned int a, \
+						const bool decrement)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!counter || !pubK) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (encounter_crypto_openssl_ecelgamal_check(ctx, counter, pubK, \
+			EC_KEYTYPE_ECELGAMAL_PUBLIC) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	const EC_GROUP *group = pubK->k.ecelgamal_pubK.group;
+	EC_POINT *t1 = EC_POINT_new(group);
+	EC_POINT *t2 = EC_POINT_new(group);
+	BN_CTX *bnctx = BN_CTX_new();
+	BN_CTX_start(bnctx);
+	BIGNUM *m = BN_CTX_get(bnctx);
+	BIGNUM *order = BN_CTX_get(bnctx);
+
+	if (!t1 || !t2 || !order) OPENSSL_ERROR(end);
+
+	if (!BN_set_word(m, a)) OPENSSL_ERROR(end);
+	if (decrement && a) {
+		/* -a mod the order of G */
+		if (!EC_GROUP_get_order(group, order, bnctx))
+			OPENSSL_ERROR(end);
+		if (!BN_sub(m, order, m)) OPENSSL_ERROR(end);
+	}
+
+	if (encounter_crypto_openssl_ecelgamal_randomizer(ctx, t1, t2, \
+		group, pubK->k.ecelgamal_pubK.h, m, bnctx) != ENCOUNTER_OK)
+		goto end;
+	if (!EC_POINT_add(group, counter->c1, counter->c1, t1, bnctx))
+		OPENSSL_ERROR(end);
+	if (!EC_POINT_add(group, counter->c2, counter->c2, t2, bnctx))
+		OPENSSL_ERROR(end);
+
+	/* Update the time of last modification */
+	time(&(counter->lastUpdated));
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (m)     BN_clear(m);
+	if (bnctx) BN_CTX_end(bnctx);
+	if (bnctx) BN_CTX_free(bnctx);
+	if (t1)    EC_POINT_clear_free(t1);
+	if (t2)    EC_POINT_clear_free(t2);
+
+	return ctx->rc;
+}
+
+/** a += b, or a -= b, pointwise */
+encounter_err_t encounter_crypto_openssl_ecelgamal_addsub(encounter_t *ctx, \
+	ec_count_t *a, const ec_count_t *b, ec_keyctx_t *pubK, const bool sub)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!a || !b || !pubK) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (encounter_crypto_openssl_ecelgamal_check(ctx, a, pubK, \
+			EC_KEYTYPE_ECELGAMAL_PUBLIC) != ENCOUNTER_OK)
+		return ctx->rc;
+	if (encounter_crypto_openssl_ecelgamal_check(ctx, b, pubK, \
+			EC_KEYTYPE_ECELGAMAL_PUBLIC) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	const EC_GROUP *group = pubK->k.ecelgamal_pubK.group;
+	EC_POINT *t1 = EC_POINT_dup(b->c1, group);
+	EC_POINT *t2 = EC_POINT_dup(b->c2, group);
+	BN_CTX *bnctx = BN_CTX_new();
+
+	if (!t1 || !t2 || !bnctx) OPENSSL_ERROR(end);
+
+	if (sub) {
+		if (!EC_POINT_invert(group, t1, bnctx)) OPENSSL_ERROR(end);
+		if (!EC_POINT_invert(group, t2, bnctx)) OPENSSL_ERROR(end);
+	}
+	if (!EC_POINT_add(group, a->c1, a->c1, t1, bnctx)) OPENSSL_ERROR(end);
+	if (!EC_POINT_add(group, a->c2, a->c2, t2, bnctx)) OPENSSL_ERROR(end);
+
+	/* Update the time of last modification */
+	time(&(a->lastUpdated));
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (bnctx) BN_CTX_free(bnctx);
+	if (t1)    EC_POINT_free(t1);
+	if (t2)    EC_POINT_free(t2);
+
+	return ctx->rc;
+}
+
+/** The counter times a, or times a random scalar, re-randomized */
+encounter_err_t encounter_crypto_openssl_ecelgamal_mul(encounter_t *ctx, \
+	ec_count_t *counter, ec_keyctx_t *pubK, const unsigned int a, \
+							const bool rand)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!counter || !pubK) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (encounter_crypto_openssl_ecelgamal_check(ctx, counter, pubK, \
+			EC_KEYTYPE_ECELGAMAL_PUBLIC) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	const EC_GROUP *group = pubK->k.ecelgamal_pubK.group;
+	EC_POINT *t = EC_POINT_new(group);
+	BN_CTX *bnctx = BN_CTX_new();
+	BN_CTX_start(bnctx);
+	BIGNUM *k = BN_CTX_get(bnctx);
+	BIGNUM *order = BN_CTX_get(bnctx);
+
+	if (!t || !order) OPENSSL_ERROR(end);
+
+	if (rand) {
+		if (!EC_GROUP_get_order(group, order, bnctx))
+			OPENSSL_ERROR(end);
+		do {
+			if (!BN_rand_range(k, order)) OPENSSL_ERROR(end);
+		} while (BN_is_zero(k));
+	} else if (!BN_set_word(k, a))
+		OPENSSL_ERROR(end);
+
+	if (!EC_POINT_mul(group, t, NULL, counter->c1, k, bnctx))
+		OPENSSL_ERROR(end);
+	if (!EC_POINT_copy(counter->c1, t)) OPENSSL_ERROR(end);
+	if (!EC_POINT_mul(group, t, NULL, counter->c2, k, bnctx))
+		OPENSSL_ERROR(end);
+	if (!EC_POINT_copy(counter->c2, t)) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_ecelgamal_rerandomize(ctx, counter->c1, \
+		counter->c2, pubK, bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	/* Update the time of last modification */
+	time(&(counter->lastUpdated));
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (k)     BN_clear(k);
+	if (bnctx) BN_CTX_end(bnctx);
+	if (bnctx) BN_CTX_free(bnctx);
+	if (t)     EC_POINT_free(t);
+
+	return ctx->rc;
+}
+
+/** out = sum weights[i] counters[i], re-randomized once. out may be one
+ * of the counters */
+encounter_err_t encounter_crypto_openssl_ecelgamal_linear_combination(\
+	encounter_t *ctx, ec_count_t **counters, const unsigned int *weights,\
+		const size_t n, ec_keyctx_t *pubK, ec_count_t *out)
+{
+	size_t i;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!counters || !weights || !pubK || !out) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	for (i = 0; i < n; ++i)
+		if (encounter_crypto_openssl_ecelgamal_check(ctx, \
+			counters[i], pubK, EC_KEYTYPE_ECELGAMAL_PUBLIC) \
+				!= ENCOUNTER_OK)
+			return ctx->rc;
+	if (encounter_crypto_openssl_ecelgamal_check(ctx, out, pubK, \
+			EC_KEYTYPE_ECELGAMAL_PUBLIC) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	const EC_GROUP *group = pubK->k.ecelgamal_pubK.group;
+	EC_POINT *acc1 = EC_POINT_new(group);
+	EC_POINT *acc2 = EC_POINT_new(group);
+	EC_POINT *t = EC_POINT_new(group);
+	BN_CTX *bnctx = BN_CTX_new();
+	BN_CTX_start(bnctx);
+	BIGNUM *w = BN_CTX_get(bnctx);
+
+	if (!acc1 || !acc2 || !t || !w) OPENSSL_ERROR(end);
+
+	if (!EC_POINT_set_to_infinity(group, acc1)) OPENSSL_ERROR(end);
+	if (!EC_POINT_set_to_infinity(group, acc2)) OPENSSL_ERROR(end);
+	for (i = 0; i < n; ++i) {
+		if (!weights[i]) continue;
+		if (!BN_set_word(w, weights[i])) OPENSSL_ERROR(end);
+		if (!EC_POINT_mul(group, t, NULL, counters[i]->c1, w, bnctx))
+			OPENSSL_ERROR(end);
+		if (!EC_POINT_add(group, acc1, acc1, t, bnctx))
+			OPENSSL_ERROR(end);
+		if (!EC_POINT_mul(group, t, NULL, counters[i]->c2, w, bnctx))
+			OPENSSL_ERROR(end);
+		if (!EC_POINT_add(group, acc2, acc2, t, bnctx))
+			OPENSSL_ERROR(end);
+	}
+
+	if (encounter_crypto_openssl_ecelgamal_rerandomize(ctx, acc1, acc2, \
+		pubK, bnctx) != ENCOUNTER_OK)
+		goto end;
+	if (!EC_POINT_copy(out->c1, acc1)) OPENSSL_ERROR(end);
+	if (!EC_POINT_copy(out->c2, acc2)) OPENSSL_ERROR(end);
+	out->slots = 0;
+	out->width = 0;
+
+	/* Update the time of last modification */
+	time(&(out->lastUpdated));
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (bnctx) BN_CTX_end(bnctx);
+	if (bnctx) BN_CTX_free(bnctx);
+	if (acc1)  EC_POINT_free(acc1);
+	if (acc2)  EC_POINT_free(acc2);
+	if (t)     EC_POINT_free(t);
+
+	return ctx->rc;
+}
+
+/** The sum of n counters, into out and/or decrypted into plain with
+ * privK. A sum of points costs far less than the threads would */
+encounter_err_t encounter_crypto_openssl_ecelgamal_sum(encounter_t *ctx, \
+	ec_count_t **counters, const size_t n, ec_keyctx_t *pubK, \
+	ec_count_t *out, ec_keyctx_t *privK, unsigned long long int *plain)
+{
+	ec_count_t sum;
+	size_t i;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!counters || !pubK || (!out && !plain) || (plain && !privK)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	for (i = 0; i < n; ++i)
+		if (encounter_crypto_openssl_ecelgamal_check(ctx, \
+			counters[i], pubK, EC_KEYTYPE_ECELGAMAL_PUBLIC) \
+				!= ENCOUNTER_OK)
+			return ctx->rc;
+	if (out && encounter_crypto_openssl_ecelgamal_check(ctx, out, pubK, \
+			EC_KEYTYPE_ECELGAMAL_PUBLIC) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	const EC_GROUP *group = pubK->k.ecelgamal_pubK.group;
+	BN_CTX *bnctx = BN_CTX_new();
+
+	memset(&sum, 0, sizeof sum);
+	sum.version = ENCOUNTER_COUNT_ECELGAMAL_V1;
+	sum.c1 = EC_POINT_new(group);
+	sum.c2 = EC_POINT_new(group);
+	if (!sum.c1 || !sum.c2 || !bnctx) OPENSSL_ERROR(end);
+
+	if (!EC_POINT_set_to_infinity(group, sum.c1)) OPENSSL_ERROR(end);
+	if (!EC_POINT_set_to_infinity(group, sum.c2)) OPENSSL_ERROR(end);
+	for (i = 0; i < n; ++i) {
+		if (!EC_POINT_add(group, sum.c1, sum.c1, counters[i]->c1, \
+				bnctx))
+			OPENSSL_ERROR(end);
+		if (!EC_POINT_add(group, sum.c2, sum.c2, counters[i]->c2, \
+				bnctx))
+			OPENSSL_ERROR(end);
+	}
+
+	/* A bare decryption needs no randomizer */
+	if (plain && encounter_crypto_openssl_ecelgamal_decrypt(ctx, &sum, \
+			privK, plain) != ENCOUNTER_OK)
+		goto end;
+
+	if (out) {
+		if (encounter_crypto_openssl_ecelgamal_rerandomize(ctx, \
+			sum.c1, sum.c2, pubK, bnctx) != ENCOUNTER_OK)
+			goto end;
+		if (!EC_POINT_copy(out->c1, sum.c1)) OPENSSL_ERROR(end);
+		if (!EC_POINT_copy(out->c2, sum.c2)) OPENSSL_ERROR(end);
+		out->slots = 0;
+		out->width = 0;
+
+		/* Update the time of last modification */
+		time(&(out->lastUpdated));
+	}
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (bnctx)  BN_CTX_free(bnctx);
+	if (sum.c1) EC_POINT_free(sum.c1);
+	if (sum.c2) EC_POINT_free(sum.c2);
+
+	return ctx->rc;
+}
+
+/** The points of from into to, allocated if need be */
+encounter_err_t encounter_crypto_openssl_ecelgamal_copy(encounter_t *ctx, \
+	ec_keyctx_t *pubK, const ec_count_t *from, ec_count_t *to)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!pubK || !from || !to) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (encounter_crypto_openssl_ecelgamal_check(ctx, from, pubK, \
+			EC_KEYTYPE_ECELGAMAL_PUBLIC) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	const EC_GROUP *group = pubK->k.ecelgamal_pubK.group;
+
+	if (!to->c1 && (to->c1 = EC_POINT_new(group)) == NULL)
+		OPENSSL_ERROR(end);
+	if (!to->c2 && (to->c2 = EC_POINT_new(group)) == NULL)
+		OPENSSL_ERROR(end);
+	if (!EC_POINT_copy(to->c1, from->c1)) OPENSSL_ERROR(end);
+	if (!EC_POINT_copy(to->c2, from->c2)) OPENSSL_ERROR(end);
+	to->version = ENCOUNTER_COUNT_ECELGAMAL_V1;
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	return ctx->rc;
+}
+
+/** M = c2 - x c1 = mG */
+static encounter_err_t encounter_crypto_openssl_ecelgamal_plainPoint(\
+	encounter_t *ctx, EC_POINT *M, const EC_POINT *c1, \
+	const EC_POINT *c2, ec_keyctx_t *privK, BN_CTX *bnctx)
+{
+	const EC_GROUP *group = privK->k.ecelgamal_privK.group;
+
+	if (!EC_POINT_mul(group, M, NULL, c1, privK->k.ecelgamal_privK.x, \
+			bnctx))
+		OPENSSL_ERROR(end);
+	if (!EC_POINT_invert(group, M, bnctx)) OPENSSL_ERROR(end);
+	if (!EC_POINT_add(group, M, M, c2, bnctx)) OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	return ctx->rc;
+}
+
+/** The leading 64 bits of x, their lowest one replaced by the sign of
+ * y, out of the compressed encoding of P. P is not the infinity */
+static encounter_err_t encounter_crypto_openssl_ecelgamal_pointKey(\
+	encounter_t *ctx, const EC_GROUP *group, const EC_POINT *P, \
+					uint64_t *key, BN_CTX *bnctx)
+{
+	unsigned char buf[EC_ECELGAMAL_POINT_LEN];
+	unsigned int i;
+
+	if (EC_POINT_point2oct(group, P, POINT_CONVERSION_COMPRESSED, buf, \
+			sizeof buf, bnctx) != sizeof buf)
+		OPENSSL_ERROR(end);
+
+	for (*key = 0, i = 1; i <= sizeof *key; ++i)
+		*key = (*key << 8) | buf[i];
+	*key = (*key & ~(uint64_t) 1) | (buf[0] & 1);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	return ctx->rc;
+}
+
+static int encounter_crypto_openssl_ecelgamal_entryCmp(const void *a, \
+							const void *b)
+{
+	const struct ec_bsgs_entry_s *x = a, *y = b;
+
+	return (x->key > y->key) - (x->key < y->key);
+}
+
+/** jG for 0 < j < n, sorted by key */
+static encounter_err_t encounter_crypto_openssl_ecelgamal_bsgsBuild(\
+	encounter_t *ctx, const EC_GROUP *group, struct ec_bsgs_s *t, \
+								BN_CTX *bnctx)
+{
+	const EC_POINT *G = EC_GROUP_get0_generator(group);
+	EC_POINT *P = NULL;
+	size_t j;
+
+	t->n = (size_t) 1 << ENCOUNTER_ECELGAMAL_TABLE_BITS;
+	t->e = calloc(t->n - 1, sizeof *t->e);
+	if (!t->e) {
+		encounter_set_error(ctx, ENCOUNTER_ERR_MEM, \
+			"baby-step table: out of memory");
+		goto end;
+	}
+	if ((P = EC_POINT_dup(G, group)) == NULL) OPENSSL_ERROR(end);
+
+	for (j = 1; j < t->n; ++j) {
+		if (encounter_crypto_openssl_ecelgamal_pointKey(ctx, group, \
+			P, &t->e[j - 1].key, bnctx) != ENCOUNTER_OK)
+			goto end;
+		t->e[j - 1].j = (uint32_t) j;
+		if (!EC_POINT_add(group, P, P, G, bnctx)) OPENSSL_ERROR(end);
+	}
+	qsort(t->e, t->n - 1, sizeof *t->e, \
+		encounter_crypto_openssl_ecelgamal_entryCmp);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (P) EC_POINT_free(P);
+	if (ctx->rc != ENCOUNTER_OK && t->e) {
+		free(t->e);
+		t->e = NULL;
+	}
+
+	return ctx->rc;
+}
+
+/** A table persisted by bsgsStore(), in host byte order. Entries out of
+ * order fail the load; wrong entries only fail the lookups, every hit
+ * being checked against the plaintext point */
+static bool encounter_crypto_openssl_ecelgamal_bsgsLoad(\
+			struct ec_bsgs_s *t, const char *path)
+{
+	char header[64], want[64];
+	bool ok = false;
+	FILE *f;
+	size_t k;
+
+	if ((f = fopen(path, "rb")) == NULL) return false;
+
+	snprintf(want, sizeof want, EC_BSGS_HEADER, \
+		ENCOUNTER_ECELGAMAL_TABLE_BITS, (unsigned) sizeof *t->e);
+	if (!fgets(header, sizeof header, f) || strcmp(header, want))
+		goto end;
+
+	t->n = (size_t) 1 << ENCOUNTER_ECELGAMAL_TABLE_BITS;
+	t->e = malloc((t->n - 1) * sizeof *t->e);
+	if (!t->e || fread(t->e, sizeof *t->e, t->n - 1, f) != t->n - 1)
+		goto end;
+	for (k = 1; k < t->n - 1; ++k)
+		if (t->e[k - 1].key > t->e[k].key) goto end;
+
+	ok = true;
+
+end:
+	if (!ok && t->e) {
+		free(t->e);
+		t->e = NULL;
+	}
+	fclose(f);
+
+	return ok;
+}
+
+/** Best effort: a table that cannot be written is built again next time */
+static void encounter_crypto_openssl_ecelgamal_bsgsStore(\
+			const struct ec_bsgs_s *t, const char *path)
+{
+	FILE *f;
+
+	if ((f = fopen(path, "wb")) == NULL) return;
+
+	fprintf(f, EC_BSGS_HEADER, ENCOUNTER_ECELGAMAL_TABLE_BITS, \
+					(unsigned) sizeof *t->e);
+	fwrite(t->e, sizeof *t->e, t->n - 1, f);
+	fclose(f);
+}
+
+/** The baby-step table of privK: loaded from conf.ecelgamal_table, or
+ * built and stored there, on first use */
+static encounter_err_t encounter_crypto_openssl_ecelgamal_bsgs(\
+	encounter_t *ctx, ec_keyctx_t *privK, BN_CTX *bnctx, \
+					const struct ec_bsgs_s **table)
+{
+	const char *path = ctx->conf.ecelgamal_table;
+	struct ec_bsgs_s *t;
+
+	ctx->rc = ENCOUNTER_OK;
+
+	pthread_mutex_lock(&privK->lock);
+	if (!privK->bsgs) {
+		if ((t = calloc(1, sizeof *t)) == NULL) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_MEM, \
+				"baby-step table: out of memory");
+			goto end;
+		}
+		if (!path || !encounter_crypto_openssl_ecelgamal_bsgsLoad(t, \
+				path)) {
+			if (encounter_crypto_openssl_ecelgamal_bsgsBuild(ctx, \
+				privK->k.ecelgamal_privK.group, t, bnctx) \
+					!= ENCOUNTER_OK) {
+				free(t);
+				goto end;
+			}
+			if (path)
+				encounter_crypto_openssl_ecelgamal_bsgsStore(t,\
+									path);
+		}
+		privK->bsgs = t;
+	}
+	*table = privK->bsgs;
+
+end:
+	pthread_mutex_unlock(&privK->lock);
+
+	return ctx->rc;
+}
+
+void encounter_crypto_openssl_ecelgamal_bsgs_free(ec_keyctx_t *keyctx)
+{
+	if (keyctx && keyctx->bsgs) {
+		free(keyctx->bsgs->e);
+		free(keyctx->bsgs);
+		keyctx->bsgs = NULL;
+	}
+}
+
+/** m out of M = mG, 0 <= m < n^2: M - i nG is looked up among the baby
+ * steps for i = 0, 1, ... Small plaintexts take a single lookup */
+static encounter_err_t encounter_crypto_openssl_ecelgamal_log(\
+	encounter_t *ctx, const EC_GROUP *group, const struct ec_bsgs_s *t, \
+	const EC_POINT *M, unsigned long long int *m, BN_CTX *bnctx)
+{
+	struct ec_bsgs_entry_s probe, *hit;
+	unsigned long long int cand;
+	EC_POINT *P = EC_POINT_dup(M, group);
+	EC_POINT *giant = EC_POINT_new(group);
+	EC_POINT *chk = EC_POINT_new(group);
+	size_t i;
+
+	BN_CTX_start(bnctx);
+	BIGNUM *k = BN_CTX_get(bnctx);
+
+	if (!P || !giant || !chk || !k) OPENSSL_ERROR(end);
+
+	/* giant = -nG */
+	if (!BN_set_word(k, t->n)) OPENSSL_ERROR(end);
+	if (!EC_POINT_mul(group, giant, k, NULL, NULL, bnctx))
+		OPENSSL_ERROR(end);
+	if (!EC_POINT_invert(group, giant, bnctx)) OPENSSL_ERROR(end);
+
+	for (i = 0; i < t->n; ++i) {
+		if (EC_POINT_is_at_infinity(group, P)) {
+			*m = (unsigned long long) i * t->n;
+			ctx->rc = ENCOUNTER_OK;
+			goto end;
+		}
+
+		if (encounter_crypto_openssl_ecelgamal_pointKey(ctx, group, \
+			P, &probe.key, bnctx) != ENCOUNTER_OK)
+			goto end;
+		hit = bsearch(&probe, t->e, t->n - 1, sizeof *t->e, \
+			encounter_crypto_openssl_ecelgamal_entryCmp);
+		if (hit) {
+			/* Only 64 bits of the point matched */
+			cand = (unsigned long long) i * t->n + hit->j;
+			if (!BN_set_word(k, cand)) OPENSSL_ERROR(end);
+			if (!EC_POINT_mul(group, chk, k, NULL, NULL, bnctx))
+				OPENSSL_ERROR(end);
+			if (EC_POINT_cmp(group, chk, M, bnctx) == 0) {
+				*m = cand;
+				ctx->rc = ENCOUNTER_OK;
+				goto end;
+			}
+		}
+
+		if (!EC_POINT_add(group, P, P, giant, bnctx))
+			OPENSSL_ERROR(end);
+	}
+
+	encounter_set_error(ctx, ENCOUNTER_ERR_OVERFLOW, \
+		"plaintext out of the EC-ElGamal range");
+
+end:
+	BN_CTX_end(bnctx);
+	if (P)     EC_POINT_clear_free(P);
+	if (giant) EC_POINT_free(giant);
+	if (chk)   EC_POINT_clear_free(chk);
+
+	return ctx->rc;
+}
+
+/** The plaintext of counter, ENCOUNTER_ERR_OVERFLOW past the range of
+ * the baby-step/giant-step search */
+encounter_err_t encounter_crypto_openssl_ecelgamal_decrypt(encounter_t *ctx, \
+	const ec_count_t *counter, ec_keyctx_t *privK, \
+					unsigned long long int *a)
+{
+	const struct ec_bsgs_s *t;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!counter || !privK || !a) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (encounter_crypto_openssl_ecelgamal_check(ctx, counter, privK, \
+			EC_KEYTYPE_ECELGAMAL_PRIVATE) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	const EC_GROUP *group = privK->k.ecelgamal_privK.group;
+	EC_POINT *M = EC_POINT_new(group);
+	BN_CTX *bnctx = BN_CTX_new();
+
+	if (!M || !bnctx) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_ecelgamal_bsgs(ctx, privK, bnctx, &t) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_ecelgamal_plainPoint(ctx, M, \
+		counter->c1, counter->c2, privK, bnctx) != ENCOUNTER_OK)
+		goto end;
+	encounter_crypto_openssl_ecelgamal_log(ctx, group, t, M, a, bnctx);
+
+end:
+	if (bnctx) BN_CTX_free(bnctx);
+	if (M)     EC_POINT_clear_free(M);
+
+	return ctx->rc;
+}
+
+/* A batch decryption, one counter per item */
+struct ec_ecelgamal_batch_s {
+	ec_count_t		**counters;
+	ec_keyctx_t		*privK;
+	unsigned long long int	*out;
+};
+
+static encounter_err_t encounter_crypto_openssl_ecelgamal_decryptItem(\
+	encounter_t *ctx, void *arg, unsigned int worker, size_t item)
+{
+	struct ec_ecelgamal_batch_s *b = arg;
+
+	(void) worker;
+	return encounter_crypto_openssl_ecelgamal_decrypt(ctx, \
+			b->counters[item], b->privK, &b->out[item]);
+}
+
+/** Decrypt n counters into out[] on up to conf.batch_threads threads.
+ * The table is set up first, the workers only read it */
+encounter_err_t encounter_crypto_openssl_ecelgamal_decrypt_batch(\
+	encounter_t *ctx, ec_count_t **counters, const size_t n, \
+		ec_keyctx_t *privK, unsigned long long int *out)
+{
+	struct ec_ecelgamal_batch_s b;
+	const struct ec_bsgs_s *t;
+	BN_CTX *bnctx;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!counters || !privK || !out) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (encounter_crypto_openssl_ecelgamal_check(ctx, NULL, privK, \
+			EC_KEYTYPE_ECELGAMAL_PRIVATE) != ENCOUNTER_OK)
+		return ctx->rc;
+	if (!n) return ctx->rc;
+
+	if ((bnctx = BN_CTX_new()) == NULL) OPENSSL_ERROR(end);
+	encounter_crypto_openssl_ecelgamal_bsgs(ctx, privK, bnctx, &t);
+	BN_CTX_free(bnctx);
+	if (ctx->rc != ENCOUNTER_OK) goto end;
+
+	b.counters = counters;
+	b.privK = privK;
+	b.out = out;
+	encounter_threadpool_run(ctx, encounter_threadpool_workers(\
+		ctx->conf.batch_threads, n), n, \
+		encounter_crypto_openssl_ecelgamal_decryptItem, &b);
+
+end:
+	return ctx->rc;
+}
+
+/** The sign of a - b, out of the decryption of a - b or b - a alone.
+ * ENCOUNTER_ERR_OVERFLOW when they are further apart than the range of
+ * the decryptions */
+encounter_err_t encounter_crypto_openssl_ecelgamal_private_cmp(\
+	encounter_t *ctx, const ec_count_t *a, const ec_count_t *b, \
+				ec_keyctx_t *privK, int *result)
+{
+	const struct ec_bsgs_s *t;
+	unsigned long long int m = 0;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!a || !b || !privK || !result) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (encounter_crypto_openssl_ecelgamal_check(ctx, a, privK, \
+			EC_KEYTYPE_ECELGAMAL_PRIVATE) != ENCOUNTER_OK)
+		return ctx->rc;
+	if (encounter_crypto_openssl_ecelgamal_check(ctx, b, privK, \
+			EC_KEYTYPE_ECELGAMAL_PRIVATE) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	const EC_GROUP *group = privK->k.ecelgamal_privK.group;
+	EC_POINT *d1 = EC_POINT_dup(b->c1, group);
+	EC_POINT *d2 = EC_POINT_dup(b->c2, group);
+	EC_POINT *M = EC_POINT_new(group);
+	BN_CTX *bnctx = BN_CTX_new();
+
+	if (!d1 || !d2 || !M || !bnctx) OPENSSL_ERROR(end);
+
+	/* (d1, d2) = a - b */
+	if (!EC_POINT_invert(group, d1, bnctx)) OPENSSL_ERROR(end);
+	if (!EC_POINT_invert(group, d2, bnctx)) OPENSSL_ERROR(end);
+	if (!EC_POINT_add(group, d1, d1, a->c1, bnctx)) OPENSSL_ERROR(end);
+	if (!EC_POINT_add(group, d2, d2, a->c2, bnctx)) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_ecelgamal_bsgs(ctx, privK, bnctx, &t) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_ecelgamal_plainPoint(ctx, M, d1, d2, \
+			privK, bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	if (encounter_crypto_openssl_ecelgamal_log(ctx, group, t, M, &m, \
+			bnctx) == ENCOUNTER_OK) {
+		*result = (m != 0);
+		goto end;
+	}
+	if (ctx->rc != ENCOUNTER_ERR_OVERFLOW) goto end;
+
+	/* Then b - a is in range, or neither is */
+	if (!EC_POINT_invert(group, M, bnctx)) OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_ecelgamal_log(ctx, group, t, M, &m, \
+			bnctx) == ENCOUNTER_OK)
+		*result = -1;
+
+end:
+	m = 0;
+	if (bnctx) BN_CTX_free(bnctx);
+	if (d1)    EC_POINT_free(d1);
+	if (d2)    EC_POINT_free(d2);
+	if (M)     EC_POINT_clear_free(M);
+
+	return ctx->rc;
+}
+
+/** The curve name, freed with OPENSSL_free() as the other key strings */
+static char *encounter_crypto_openssl_ecelgamal_curveToString(void)
+{
+	char *str = OPENSSL_malloc(sizeof EC_ECELGAMAL_CURVE);
+
+	if (str) memcpy(str, EC_ECELGAMAL_CURVE, sizeof EC_ECELGAMAL_CURVE);
+	return str;
+}
+
+/** The key components in hex form, into key */
+encounter_err_t encounter_crypto_openssl_ecelgamal_numToString(\
+	encounter_t *ctx, ec_keyctx_t *keyctx, ec_keystring_t *key)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!keyctx || !key) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	BN_CTX *bnctx = BN_CTX_new();
+
+	if (!bnctx) OPENSSL_ERROR(end);
+
+	switch (keyctx->type) {
+		case EC_KEYTYPE_ECELGAMAL_PUBLIC:
+			key->k.ecelgamal_pubK.curve = \
+			encounter_crypto_openssl_ecelgamal_curveToString();
+
+			key->k.ecelgamal_pubK.h = EC_POINT_point2hex(\
+				keyctx->k.ecelgamal_pubK.group, \
+				keyctx->k.ecelgamal_pubK.h, \
+				POINT_CONVERSION_COMPRESSED, bnctx);
+
+			if (   key->k.ecelgamal_pubK.curve \
+			    && key->k.ecelgamal_pubK.h)
+				ctx->rc = ENCOUNTER_OK;
+			else	ctx->rc = ENCOUNTER_ERR_CRYPTO;
+			break;
+
+		case EC_KEYTYPE_ECELGAMAL_PRIVATE:
+			key->k.ecelgamal_privK.curve = \
+			encounter_crypto_openssl_ecelgamal_curveToString();
+
+			key->k.ecelgamal_privK.x = \
+				BN_bn2hex(keyctx->k.ecelgamal_privK.x);
+
+			if (   key->k.ecelgamal_privK.curve \
+			    && key->k.ecelgamal_privK.x)
+				ctx->rc = ENCOUNTER_OK;
+			else	ctx->rc = ENCOUNTER_ERR_CRYPTO;
+			break;
+
+		default:
+			ctx->rc = ENCOUNTER_ERR_PARAM;
+			break;
+	}
+
+end:
+	if (bnctx) BN_CTX_free(bnctx);
+
+	return ctx->rc;
+}
+
+/** The key components of key into the fresh key context keyctx */
+encounter_err_t encounter_crypto_openssl_ecelgamal_stringToNum(\
+	encounter_t *ctx, ec_keystring_t *key, ec_keyctx_t *keyctx)
+{
+	const char *curve;
+	char *h = NULL;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!key || !keyctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	/* Both key strings open with the curve */
+	curve = key->k.ecelgamal_pubK.curve;
+	if (!curve || strcspn(curve, "\r\n") != sizeof EC_ECELGAMAL_CURVE - 1 \
+	    || strncmp(curve, EC_ECELGAMAL_CURVE, \
+				sizeof EC_ECELGAMAL_CURVE - 1)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_DATA, \
+                        "unsupported curve");
+                return ctx->rc;
+	}
+
+	BN_CTX *bnctx = BN_CTX_new();
+	BN_CTX_start(bnctx);
+	BIGNUM *order = BN_CTX_get(bnctx);
+
+	if (!order) OPENSSL_ERROR(end);
+
+	switch (keyctx->type) {
+		case EC_KEYTYPE_ECELGAMAL_PUBLIC:
+			/* The stores leave the line ending on, the hex
+			 * decoding takes none. Points off the curve are
+			 * turned down */
+			if (key->k.ecelgamal_pubK.h)
+				h = strndup(key->k.ecelgamal_pubK.h, \
+				    strcspn(key->k.ecelgamal_pubK.h, "\r\n"));
+			if (!h || !EC_POINT_hex2point(\
+			    keyctx->k.ecelgamal_pubK.group, h, \
+			    keyctx->k.ecelgamal_pubK.h, bnctx) \
+			    || EC_POINT_is_at_infinity(\
+			    keyctx->k.ecelgamal_pubK.group, \
+			    keyctx->k.ecelgamal_pubK.h)) {
+				encounter_set_error(ctx, ENCOUNTER_ERR_DATA, \
+					"bad EC-ElGamal public-key");
+				goto end;
+			}
+			ctx->rc = ENCOUNTER_OK;
+			break;
+
+		case EC_KEYTYPE_ECELGAMAL_PRIVATE:
+			if (!EC_GROUP_get_order(\
+			    keyctx->k.ecelgamal_privK.group, order, bnctx))
+				OPENSSL_ERROR(end);
+			if (!key->k.ecelgamal_privK.x || !BN_hex2bn(\
+			    &keyctx->k.ecelgamal_privK.x, \
+			    key->k.ecelgamal_privK.x) \
+			    || BN_is_zero(keyctx->k.ecelgamal_privK.x) \
+			    || BN_cmp(keyctx->k.ecelgamal_privK.x, order) >= 0){
+				encounter_set_error(ctx, ENCOUNTER_ERR_DATA, \
+					"bad EC-ElGamal private-key");
+				goto end;
+			}
+			ctx->rc = ENCOUNTER_OK;
+			break;
+
+		default:
+			ctx->rc = ENCOUNTER_ERR_PARAM;
+			break;
+	}
+
+end:
+	if (h)     free(h);
+	if (bnctx) BN_CTX_end(bnctx);
+	if (bnctx) BN_CTX_free(bnctx);
+
+	return ctx->rc;
+}
+
+/** EC_ECELGAMAL_TAG c1 ':' c2, freed with OPENSSL_free() */
+encounter_err_t encounter_crypto_openssl_ecelgamal_counterToString(\
+	encounter_t *ctx, const ec_count_t *counter, char **str)
+{
+	char *h1 = NULL, *h2 = NULL;
+	size_t len;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!counter || !str) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	/* The counters do not keep their key: the curve is the same */
+	EC_GROUP *group = EC_GROUP_new_by_curve_name(EC_ECELGAMAL_NID);
+	BN_CTX *bnctx = BN_CTX_new();
+
+	*str = NULL;
+	if (!group || !bnctx) OPENSSL_ERROR(end);
+
+	h1 = EC_POINT_point2hex(group, counter->c1, \
+			POINT_CONVERSION_COMPRESSED, bnctx);
+	h2 = EC_POINT_point2hex(group, counter->c2, \
+			POINT_CONVERSION_COMPRESSED, bnctx);
+	if (!h1 || !h2) OPENSSL_ERROR(end);
+
+	len = EC_ECELGAMAL_TAG_LEN + strlen(h1) + 1 + strlen(h2) + 1;
+	if ((*str = OPENSSL_malloc(len)) == NULL) OPENSSL_ERROR(end);
+	snprintf(*str, len, EC_ECELGAMAL_TAG "%s:%s", h1, h2);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (h1)    OPENSSL_free(h1);
+	if (h2)    OPENSSL_free(h2);
+	if (bnctx) BN_CTX_free(bnctx);
+	if (group) EC_GROUP_free(group);
+
+	return ctx->rc;
+}
+
+/** The points of str, as written by counterToString(), into counter */
+encounter_err_t encounter_crypto_openssl_ecelgamal_stringToCounter(\
+	encounter_t *ctx, const char *str, ec_count_t *counter)
+{
+	const char *sep;
+	char *h1 = NULL;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!str || !counter) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (strncmp(str, EC_ECELGAMAL_TAG, EC_ECELGAMAL_TAG_LEN)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_DATA, \
+                        "not an EC-ElGamal counter");
+                return ctx->rc;
+	}
+
+	EC_GROUP *group = EC_GROUP_new_by_curve_name(EC_ECELGAMAL_NID);
+	BN_CTX *bnctx = BN_CTX_new();
+
+	if (!group || !bnctx) OPENSSL_ERROR(end);
+
+	str += EC_ECELGAMAL_TAG_LEN;
+	if ((sep = strchr(str, ':')) == NULL) goto bad;
+	if ((h1 = strndup(str, sep - str)) == NULL) {
+		encounter_set_error(ctx, ENCOUNTER_ERR_MEM, \
+			"strndup: failed");
+		goto end;
+	}
+
+	counter->version = ENCOUNTER_COUNT_ECELGAMAL_V1;
+	counter->c1 = EC_POINT_hex2point(group, h1, NULL, bnctx);
+	counter->c2 = EC_POINT_hex2point(group, sep + 1, NULL, bnctx);
+	if (!counter->c1 || !counter->c2) goto bad;
+
+	ctx->rc = ENCOUNTER_OK;
+	goto end;
+
+bad:
+	encounter_set_error(ctx, ENCOUNTER_ERR_DATA, \
+		"bad EC-ElGamal counter");
+end:
+	if (h1)    free(h1);
+	if (bnctx) BN_CTX_free(bnctx);
+	if (group) EC_GROUP_free(group);
+
+	return ctx->rc;
+}
@@ -0,0 +1,97 @@
+#ifndef _ENCOUNTER_CRYPTO_OPENSSL_ECELGAMAL_H_
+#define _ENCOUNTER_CRYPTO_OPENSSL_ECELGAMAL_H_
+
+#include <stdint.h>
+
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+
+#include "encounter_priv.h"
+
+
+/* Exponential ElGamal on P-256: a counter of m under h = xG is the pair
+ * (rG, mG + rH), updated by point additions. Decryption recovers mG and
+ * then m by a baby-step/giant-step search, bounded by
+ * ENCOUNTER_ECELGAMAL_TABLE_BITS. The key contexts are allocated and
+ * freed by openssl_drv.c, as the Paillier ones */
+
+#define EC_ECELGAMAL_NID	NID_X9_62_prime256v1
+#define EC_ECELGAMAL_CURVE	"P-256"
+
+/* Counters serialize as EC_ECELGAMAL_TAG c1 ':' c2, compressed in hex */
+#define EC_ECELGAMAL_TAG	"EG:"
+#define EC_ECELGAMAL_TAG_LEN	(sizeof EC_ECELGAMAL_TAG - 1)
+
+#define EC_IS_ECELGAMAL(k)	(__ENCOUNTER_IS_ECELGAMAL_KEYTYPE((k)->type))
+#define EC_IS_ECELGAMAL_COUNT(c) \
+			((c)->version == ENCOUNTER_COUNT_ECELGAMAL_V1)
+
+/* The baby steps jG, 0 < j < n, sorted by the leading bits of their
+ * compressed encoding. Built on first decryption and shared by the
+ * decryptions under the private-key */
+struct ec_bsgs_entry_s {
+	uint64_t	key;
+	uint32_t	j;
+	uint32_t	pad;
+};
+
+struct ec_bsgs_s {
+	size_t			n;	/* 2^ENCOUNTER_ECELGAMAL_TABLE_BITS */
+	struct ec_bsgs_entry_s	*e;	/* n - 1 entries */
+};
+
+
+/* TODO use __BEGIN_DECLS */
+
+encounter_err_t encounter_crypto_openssl_ecelgamal_keygen(encounter_t *, \
+					ec_keyctx_t *, ec_keyctx_t *);
+
+encounter_err_t encounter_crypto_openssl_ecelgamal_new_counter(\
+		encounter_t *, ec_keyctx_t *, ec_count_t *);
+
+encounter_err_t encounter_crypto_openssl_ecelgamal_update(encounter_t *, \
+	ec_count_t *, ec_keyctx_t *, const unsigned int, const bool);
+
+encounter_err_t encounter_crypto_openssl_ecelgamal_addsub(encounter_t *, \
+	ec_count_t *, const ec_count_t *, ec_keyctx_t *, const bool);
+
+encounter_err_t encounter_crypto_openssl_ecelgamal_mul(encounter_t *, \
+	ec_count_t *, ec_keyctx_t *, const unsigned int, const bool);
+
+encounter_err_t encounter_crypto_openssl_ecelgamal_linear_combination(\
+	encounter_t *, ec_count_t **, const unsigned int *, const size_t, \
+					ec_keyctx_t *, ec_count_t *);
+
+encounter_err_t encounter_crypto_openssl_ecelgamal_sum(encounter_t *, \
+	ec_count_t **, const size_t, ec_keyctx_t *, ec_count_t *, \
+			ec_keyctx_t *, unsigned long long int *);
+
+encounter_err_t encounter_crypto_openssl_ecelgamal_copy(encounter_t *, \
+		ec_keyctx_t *, const ec_count_t *, ec_count_t *);
+
+encounter_err_t encounter_crypto_openssl_ecelgamal_decrypt(encounter_t *, \
+	const ec_count_t *, ec_keyctx_t *, unsigned long long int *);
+
+encounter_err_t encounter_crypto_openssl_ecelgamal_decrypt_batch(\
+	encounter_t *, ec_count_t **, const size_t, ec_keyctx_t *, \
+					unsigned long long int *);
+
+encounter_err_t encounter_crypto_openssl_ecelgamal_private_cmp(\
+	encounter_t *, const ec_count_t *, const ec_count_t *, \
+				ec_keyctx_t *, int *);
+
+encounter_err_t encounter_crypto_openssl_ecelgamal_numToString(\
+		encounter_t *, ec_keyctx_t *, ec_keystring_t *);
+
+encounter_err_t encounter_crypto_openssl_ecelgamal_stringToNum(\
+		encounter_t *, ec_keystring_t *, ec_keyctx_t *);
+
+encounter_err_t encounter_crypto_openssl_ecelgamal_counterToString(\
+		encounter_t *, const ec_count_t *, char **);
+
+encounter_err_t encounter_crypto_openssl_ecelgamal_stringToCounter(\
+		encounter_t *, const char *, ec_count_t *);
+
+void encounter_crypto_openssl_ecelgamal_bsgs_free(ec_keyctx_t *);
+
+#endif  /* _ENCOUNTER_CRYPTO_OPENSSL_ECELGAMAL_H_ */
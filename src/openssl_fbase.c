@@ -0,0 +1,372 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <openssl/bn.h>
+#include <openssl/err.h>
+#include <openssl/crypto.h>
+
+#include "encounter_priv.h"
+
+#include "openssl_drv.h"
+#include "openssl_fbase.h"
+#include "openssl_drbg.h"
+#include "openssl_ifma.h"
+
+#include "utils.h"
+
+
+/* Some static prototypes */
+static encounter_err_t encounter_crypto_openssl_fbase_new(encounter_t *, \
+	ec_keyctx_t *, const BIGNUM *, const unsigned int, const unsigned int,\
+					BN_CTX *, struct ec_fbase_s **);
+
+static void encounter_crypto_openssl_fbase_destroy(struct ec_fbase_s *);
+
+static encounter_err_t encounter_crypto_openssl_fbase_get(encounter_t *, \
+	ec_keyctx_t *, const ec_fbase_kind_t, BN_CTX *, struct ec_fbase_s **);
+
+static encounter_err_t encounter_crypto_openssl_fbase_exp(encounter_t *, \
+	BIGNUM *, const struct ec_fbase_s *, const BIGNUM *, ec_keyctx_t *, \
+								BN_CTX *);
+
+
+
+/** Build the table of the base b, in Montgomery form, for exponents of
+ * up to the given bits */
+static encounter_err_t encounter_crypto_openssl_fbase_new(encounter_t *ctx,\
+	ec_keyctx_t *pubK, const BIGNUM *b, const unsigned int window, \
+	const unsigned int bits, BN_CTX *bnctx, struct ec_fbase_s **fbase)
+{
+	struct ec_fbase_s *fb;
+	struct ec_mont_s *mont;
+	unsigned int i, j, span;
+	int limbs;
+
+	*fbase = NULL;
+
+	fb = calloc(1, sizeof *fb);
+	if (!fb) {
+		encounter_set_error(ctx, ENCOUNTER_ERR_MEM, "calloc: failed");
+		return ctx->rc;
+	}
+
+	fb->window = window;
+	fb->digits = (bits + window - 1) / window;
+	span = (1U << window) - 1;
+
+	fb->t = calloc(fb->digits * span, sizeof *fb->t);
+	if (!fb->t) goto nomem;
+	for (i = 0; i < fb->digits * span; ++i)
+		if ((fb->t[i] = BN_new()) == NULL) goto nomem;
+
+	if (!BN_copy(fb->t[0], b)) OPENSSL_ERROR(err);
+
+	for (i = 0; i < fb->digits; ++i) {
+		BIGNUM **row = &fb->t[i * span];
+
+		/* b^(2^(wi)) = b^((2^w - 1) 2^(w(i-1))) b^(2^(w(i-1))) */
+		if (i > 0 && encounter_crypto_openssl_montmul(ctx, row[0], \
+			row[-1], row[-(int) span], pubK, EC_MOD_NSQUARED, \
+						bnctx) != ENCOUNTER_OK)
+			goto err;
+
+		for (j = 1; j < span; ++j)
+			if (encounter_crypto_openssl_montmul(ctx, row[j], \
+				row[j - 1], row[0], pubK, EC_MOD_NSQUARED, \
+						bnctx) != ENCOUNTER_OK)
+				goto err;
+	}
+
+	/* The same entries on the fixed-width limbs of the IFMA kernels */
+	if (encounter_crypto_openssl_mont(ctx, pubK, EC_MOD_NSQUARED, bnctx, \
+			&mont) != ENCOUNTER_OK)
+		goto err;
+	if (mont->ifma) {
+		limbs = mont->ifma->limbs;
+		fb->ft = calloc((size_t) fb->digits * span * limbs, \
+							sizeof *fb->ft);
+		if (!fb->ft) goto nomem;
+		fb->ifma = mont->ifma;
+
+		for (i = 0; i < fb->digits * span; ++i)
+			if (encounter_crypto_openssl_ifma_import(ctx, \
+				fb->ft + (size_t) i * limbs, fb->t[i], \
+						fb->ifma) != ENCOUNTER_OK)
+				goto err;
+	}
+
+	*fbase = fb;
+	ctx->rc = ENCOUNTER_OK;
+	return ctx->rc;
+
+nomem:
+	encounter_set_error(ctx, ENCOUNTER_ERR_MEM, "fbase: out of memory");
+err:
+	encounter_crypto_openssl_fbase_destroy(fb);
+	return ctx->rc;
+}
+
+static void encounter_crypto_openssl_fbase_destroy(struct ec_fbase_s *fb)
+{
+	unsigned int i;
+
+	if (fb->t) {
+		for (i = 0; i < fb->digits * ((1U << fb->window) - 1); ++i)
+			if (fb->t[i]) BN_clear_free(fb->t[i]);
+		free(fb->t);
+	}
+	if (fb->ft) {
+		OPENSSL_cleanse(fb->ft, (size_t) fb->digits \
+			* ((1U << fb->window) - 1) * fb->ifma->limbs \
+							* sizeof *fb->ft);
+		free(fb->ft);
+	}
+
+	memset(fb, 0, sizeof *fb);
+	free(fb);
+}
+
+/** The table of the given kind for the supplied public-key, built on
+ * first use. h = x^n takes the window in the runtime configuration, g
+ * and g^-1 a fixed one sized for the update amounts */
+static encounter_err_t encounter_crypto_openssl_fbase_get(encounter_t *ctx,\
+	ec_keyctx_t *pubK, const ec_fbase_kind_t kind, BN_CTX *bnctx, \
+						struct ec_fbase_s **fbase)
+{
+	struct ec_fbase_s *built = NULL;
+	unsigned int window, bits;
+
+	pthread_mutex_lock(&pubK->lock);
+	*fbase = pubK->fbase[kind];
+	pthread_mutex_unlock(&pubK->lock);
+
+	if (*fbase) {
+		ctx->rc = ENCOUNTER_OK;
+		return ctx->rc;
+	}
+
+	BN_CTX_start(bnctx);
+	BIGNUM *b = BN_CTX_get(bnctx);
+
+	if (!b) OPENSSL_ERROR(end);
+
+	switch (kind) {
+	case EC_FBASE_H:
+		/* h = x^n, a randomizer of the classic kind */
+		if (encounter_crypto_openssl_rtothen(ctx, b, pubK, bnctx) \
+				!= ENCOUNTER_OK)
+			goto end;
+		window = ctx->conf.fixed_base_window;
+		bits = PAILLIER_FIXED_BASE_EXPBITS;
+		break;
+	case EC_FBASE_G:
+		if (!BN_copy(b, pubK->k.paillier_pubK.g)) OPENSSL_ERROR(end);
+		window = PAILLIER_GTABLE_WINDOW;
+		bits = PAILLIER_GTABLE_EXPBITS;
+		break;
+	case EC_FBASE_GINV:
+		/* Once per key, the full inversion will do */
+		if (!BN_mod_inverse(b, pubK->k.paillier_pubK.g, \
+			pubK->k.paillier_pubK.nsquared, bnctx))
+			OPENSSL_ERROR(end);
+		window = PAILLIER_GTABLE_WINDOW;
+		bits = PAILLIER_GTABLE_EXPBITS;
+		break;
+	default:
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "unknown fixed-base table");
+		goto end;
+	}
+	if (encounter_crypto_openssl_tomont(ctx, b, b, pubK, \
+			EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	/* Built unlocked, the key lock also guards the Montgomery
+	 * contexts the table is built with */
+	if (encounter_crypto_openssl_fbase_new(ctx, pubK, b, window, bits, \
+			bnctx, &built) != ENCOUNTER_OK)
+		goto end;
+
+	pthread_mutex_lock(&pubK->lock);
+	if (!pubK->fbase[kind]) {
+		pubK->fbase[kind] = built;
+		built = NULL;
+	}
+	*fbase = pubK->fbase[kind];
+	pthread_mutex_unlock(&pubK->lock);
+
+	/* Somebody else got there first */
+	if (built) encounter_crypto_openssl_fbase_destroy(built);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (b)     BN_clear(b);
+	if (bnctx) BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** b^e mod n^2 in Montgomery form from the table of b, one Montgomery
+ * product per non-zero digit of e. e must fit the table. The products
+ * run on the fixed-width limbs when the table has them, on the stack,
+ * with a single conversion of the result */
+static encounter_err_t encounter_crypto_openssl_fbase_exp(encounter_t *ctx,\
+	BIGNUM *r, const struct ec_fbase_s *fb, const BIGNUM *e, \
+				ec_keyctx_t *pubK, BN_CTX *bnctx)
+{
+	uint64_t acc[EC_IFMA_MAXLIMBS];
+	const uint64_t *entry;
+	unsigned int i, b, digit, span;
+	bool first = true, fixed;
+
+	fixed = fb->ft && !ctx->conf.portable_kernels \
+			&& ctx->conf.backend == EC_BACKEND_OPENSSL;
+
+	span = (1U << fb->window) - 1;
+	for (i = 0; i < fb->digits; ++i) {
+		for (digit = 0, b = 0; b < fb->window; ++b)
+			if (BN_is_bit_set(e, i * fb->window + b))
+				digit |= 1U << b;
+		if (!digit) continue;
+
+		if (fixed) {
+			entry = fb->ft + (size_t) (i * span + digit - 1) \
+							* fb->ifma->limbs;
+			if (first)
+				memcpy(acc, entry, fb->ifma->limbs * sizeof *acc);
+			else
+				encounter_crypto_openssl_ifma_mul(acc, acc, \
+							entry, fb->ifma);
+			first = false;
+		} else if (first) {
+			if (!BN_copy(r, fb->t[i * span + digit - 1]))
+				OPENSSL_ERROR(end);
+			first = false;
+		} else if (encounter_crypto_openssl_montmul(ctx, r, r, \
+			fb->t[i * span + digit - 1], pubK, EC_MOD_NSQUARED, \
+					bnctx) != ENCOUNTER_OK)
+			goto end;
+	}
+
+	/* e = 0, b^0 = 1 */
+	if (first) {
+		if (encounter_crypto_openssl_tomont(ctx, r, BN_value_one(), \
+			pubK, EC_MOD_NSQUARED, bnctx) != ENCOUNTER_OK)
+			goto end;
+	} else if (fixed) {
+		if (encounter_crypto_openssl_ifma_export(ctx, r, acc, \
+				fb->ifma) != ENCOUNTER_OK)
+			goto end;
+	}
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (fixed) OPENSSL_cleanse(acc, fb->ifma->limbs * sizeof *acc);
+
+	return ctx->rc;
+}
+
+/** h^alpha mod n^2 in Montgomery form, for a fresh short alpha. The
+ * table of the supplied public-key is built on first use, with the
+ * window in the runtime configuration */
+encounter_err_t encounter_crypto_openssl_fbase_randomizer(encounter_t *ctx,\
+		BIGNUM *rn, ec_keyctx_t *pubK, BN_CTX *bnctx)
+{
+	struct ec_fbase_s *fb;
+
+	if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!rn || !pubK || !bnctx || !ctx->conf.fixed_base_window) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	if (encounter_crypto_openssl_fbase_get(ctx, pubK, EC_FBASE_H, bnctx, \
+			&fb) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	BN_CTX_start(bnctx);
+	BIGNUM *alpha = BN_CTX_get(bnctx);
+
+	if (!alpha) OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_drbg_bits(ctx, alpha, \
+			PAILLIER_FIXED_BASE_EXPBITS) != ENCOUNTER_OK)
+		goto end;
+
+	if (encounter_crypto_openssl_fbase_exp(ctx, rn, fb, alpha, pubK, \
+			bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (alpha) BN_clear(alpha);
+	if (bnctx) BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** g^m mod n^2 in Montgomery form, or g^-m when invert is set, from the
+ * tables of g and g^-1 of the supplied public-key. got is left unset
+ * when the key or m is not served by the tables */
+encounter_err_t encounter_crypto_openssl_fbase_gpow(encounter_t *ctx, \
+	BIGNUM *r, const BIGNUM *m, ec_keyctx_t *pubK, BN_CTX *bnctx, \
+					const bool invert, bool *got)
+{
+	struct ec_fbase_s *fb;
+
+	if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!r || !m || !pubK || !bnctx || !got) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	*got = false;
+	ctx->rc = ENCOUNTER_OK;
+
+	/* g = n+1 needs no table */
+	if ((pubK->type != EC_KEYTYPE_PAILLIER_PUBLIC \
+	     && pubK->type != EC_KEYTYPE_PAILLIER_SUBGROUP_PUBLIC) \
+	    || BN_is_negative(m) \
+	    || BN_num_bits(m) > PAILLIER_GTABLE_EXPBITS)
+		return ctx->rc;
+
+	if (encounter_crypto_openssl_fbase_get(ctx, pubK, invert ? \
+		EC_FBASE_GINV : EC_FBASE_G, bnctx, &fb) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	if (encounter_crypto_openssl_fbase_exp(ctx, r, fb, m, pubK, bnctx) \
+			!= ENCOUNTER_OK)
+		return ctx->rc;
+
+	*got = true;
+	return ctx->rc;
+}
+
+/** Dispose the fixed-base tables of the supplied key */
+encounter_err_t encounter_crypto_openssl_fbase_free(encounter_t *ctx, \
+							ec_keyctx_t *keyctx)
+{
+	unsigned int i;
+
+	if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!keyctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	for (i = 0; i < EC_FBASE_LAST; ++i) {
+		if (keyctx->fbase[i])
+			encounter_crypto_openssl_fbase_destroy(keyctx->fbase[i]);
+		keyctx->fbase[i] = NULL;
+	}
+
+	ctx->rc = ENCOUNTER_OK;
+	return ctx->rc;
+}
@@ -0,0 +1,44 @@
+#ifndef _ENCOUNTER_CRYPTO_OPENSSL_FBASE_H_
+#define _ENCOUNTER_CRYPTO_OPENSSL_FBASE_H_
+
+#include <stdint.h>
+
+#include <openssl/bn.h>
+
+#include "encounter_priv.h"
+
+
+/* Bits of the short exponent alpha in h^alpha */
+#define PAILLIER_FIXED_BASE_EXPBITS	(2 * PAILLIER_RANDOMIZER_SECLEVEL)
+
+/* Exponents served by the tables of g and g^-1, and their window */
+#define PAILLIER_GTABLE_EXPBITS		64
+#define PAILLIER_GTABLE_WINDOW		4
+
+/* Fixed-base table for a base b modulo n^2. With w the window, entry
+ * t[i (2^w - 1) + j - 1] holds b^(j 2^(wi)) in Montgomery form, so that
+ * b^e is a product of one entry per non-zero w-bit digit of e. When the
+ * IFMA kernels serve n^2, ft holds the same entries on their fixed-width
+ * limbs, ifma->limbs words apart, and the products run there */
+struct ec_fbase_s {
+	BIGNUM		**t;
+	uint64_t	*ft;
+	const struct ec_ifma_mod_s *ifma;	/* The key's, with n^2 */
+	unsigned int	window;
+	unsigned int	digits;
+};
+
+
+/* TODO use __BEGIN_DECLS */
+
+encounter_err_t encounter_crypto_openssl_fbase_randomizer(encounter_t *, \
+				BIGNUM *, ec_keyctx_t *, BN_CTX *);
+
+encounter_err_t encounter_crypto_openssl_fbase_gpow(encounter_t *, \
+	BIGNUM *, const BIGNUM *, ec_keyctx_t *, BN_CTX *, const bool, \
+								bool *);
+
+encounter_err_t encounter_crypto_openssl_fbase_free(encounter_t *, \
+							ec_keyctx_t *);
+
+#endif  /* _ENCOUNTER_CRYPTO_OPENSSL_FBASE_H_ */
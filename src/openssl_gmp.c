@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <gmp.h>
+
+#include <openssl/bn.h>
+#include <openssl/err.h>
+#include <openssl/crypto.h>
+
+#include "encounter_priv.h"
+
+#include "openssl_drv.h"
+#include "openssl_gmp.h"
+
+#include "utils.h"
+
+
+/* Some static prototypes */
+static void encounter_crypto_openssl_gmp_import(mpz_t, const BIGNUM *, \
+							unsigned char *);
+
+static BIGNUM *encounter_crypto_openssl_gmp_export(BIGNUM *, \
+					const mpz_t, unsigned char *);
+
+
+
+/** z = a, through buf of at least BN_num_bytes(a) bytes */
+static void encounter_crypto_openssl_gmp_import(mpz_t z, const BIGNUM *a, \
+							unsigned char *buf)
+{
+	const size_t len = BN_bn2bin(a, buf);
+
+	mpz_import(z, len, 1, 1, 1, 0, buf);
+}
+
+/** r = z, through buf of at least mpz_sizeinbase(z, 256) bytes */
+static BIGNUM *encounter_crypto_openssl_gmp_export(BIGNUM *r, \
+				const mpz_t z, unsigned char *buf)
+{
+	size_t len = 0;
+
+	mpz_export(buf, &len, 1, 1, 1, 0, z);
+	return BN_bin2bn(buf, len, r);
+}
+
+/** r = a^e mod m by mpz_powm_sec(), whose time depends on the sizes of
+ * the operands only: the exponents are the secret p-1, q-1 or alpha of
+ * the decryptions, or the fresh r of the randomizers. m is odd, as are
+ * all the key moduli. a, e and m are not negative */
+encounter_err_t encounter_crypto_openssl_gmp_expmod(encounter_t *ctx, \
+	BIGNUM *r, const BIGNUM *a, const BIGNUM *e, const BIGNUM *m)
+{
+	unsigned char *buf = NULL;
+	size_t len;
+	mpz_t za, ze, zm;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!r || !a || !e || !m) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (!BN_is_odd(m) || BN_is_negative(a) || BN_is_negative(e)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "GMP exponentiations want an odd modulus");
+                return ctx->rc;
+	}
+
+	/* a^0 = 1 */
+	if (BN_is_zero(e)) {
+		if (!BN_one(r)) OPENSSL_ERROR(out);
+		if (BN_is_one(m)) BN_zero(r);
+
+		ctx->rc = ENCOUNTER_OK;
+		goto out;
+	}
+
+	len = BN_num_bytes(a);
+	if (len < (size_t) BN_num_bytes(e)) len = BN_num_bytes(e);
+	if (len < (size_t) BN_num_bytes(m)) len = BN_num_bytes(m);
+
+	/* The result is below m, one byte more for mpz_export() */
+	if ((buf = OPENSSL_malloc(len + 1)) == NULL) {
+		encounter_set_error(ctx, ENCOUNTER_ERR_MEM, \
+			"OPENSSL_malloc: failed");
+		goto out;
+	}
+
+	mpz_init(za);
+	mpz_init(ze);
+	mpz_init(zm);
+
+	encounter_crypto_openssl_gmp_import(za, a, buf);
+	encounter_crypto_openssl_gmp_import(ze, e, buf);
+	encounter_crypto_openssl_gmp_import(zm, m, buf);
+
+	mpz_powm_sec(za, za, ze, zm);
+
+	if (!encounter_crypto_openssl_gmp_export(r, za, buf))
+		OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	/* Wipe the byte copies of the operands */
+	OPENSSL_cleanse(buf, len + 1);
+	OPENSSL_free(buf);
+	mpz_clear(za);
+	mpz_clear(ze);
+	mpz_clear(zm);
+
+out:
+	return ctx->rc;
+}
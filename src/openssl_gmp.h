@@ -0,0 +1,20 @@
+#ifndef _ENCOUNTER_CRYPTO_OPENSSL_GMP_H_
+#define _ENCOUNTER_CRYPTO_OPENSSL_GMP_H_
+
+#include <openssl/bn.h>
+
+#include "encounter_priv.h"
+
+
+/* The GMP backend of the modular exponentiations, selected at runtime by
+ * conf.backend. Keys and counters stay OpenSSL BIGNUMs, so that their
+ * serialized forms do not depend on the backend: the operands travel to
+ * GMP and back as big-endian bytes around each exponentiation */
+
+
+/* TODO use __BEGIN_DECLS */
+
+encounter_err_t encounter_crypto_openssl_gmp_expmod(encounter_t *, \
+	BIGNUM *, const BIGNUM *, const BIGNUM *, const BIGNUM *);
+
+#endif  /* _ENCOUNTER_CRYPTO_OPENSSL_GMP_H_ */
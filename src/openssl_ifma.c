@@ -0,0 +1,772 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <openssl/bn.h>
+#include <openssl/err.h>
+#include <openssl/crypto.h>
+
+#include "encounter_priv.h"
+
+#include "openssl_drv.h"
+#include "openssl_ifma.h"
+
+#include "utils.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define EC_IFMA_KERNELS
+#include <immintrin.h>
+#endif
+
+
+#ifdef EC_IFMA_KERNELS
+
+#define EC_IFMA_TARGET		__attribute__((target("avx512f,avx512ifma")))
+
+#define EC_IFMA_LIMBBITS	52
+#define EC_IFMA_MASK		((1ULL << EC_IFMA_LIMBBITS) - 1)
+
+/* Fixed window of the exponentiations, 2^EC_IFMA_WINDOW table entries */
+#define EC_IFMA_WINDOW		5
+#define EC_IFMA_TABLE		(1 << EC_IFMA_WINDOW)
+
+/* Byte buffer of the conversions: little-endian limbs in the low half,
+ * big-endian BIGNUM bytes in the high one, 8 bytes of slack each */
+#define EC_IFMA_BUFLEN(limbs)	(16 * (limbs) + 16)
+
+typedef struct ec_ifma_mod_s ec_ifma_mod_t;
+
+
+/* Some static prototypes */
+static void encounter_crypto_openssl_ifma_amm(uint64_t *, const uint64_t *,\
+			const uint64_t *, const ec_ifma_mod_t *);
+
+static void encounter_crypto_openssl_ifma_select(uint64_t *, \
+			const uint64_t *, const unsigned int, const int);
+
+static void encounter_crypto_openssl_ifma_pack(uint64_t *, const BIGNUM *, \
+					unsigned char *, const int);
+
+static BIGNUM *encounter_crypto_openssl_ifma_unpack(BIGNUM *, \
+			const uint64_t *, unsigned char *, const int);
+
+static unsigned int encounter_crypto_openssl_ifma_window(const BIGNUM *, \
+								const int);
+
+static void encounter_crypto_openssl_ifma_reduce(uint64_t *, \
+						const ec_ifma_mod_t *);
+
+static void encounter_crypto_openssl_ifma_amm_mb(uint64_t *, \
+	const uint64_t *, const uint64_t *, const ec_ifma_mod_t *, uint64_t *);
+
+static encounter_err_t encounter_crypto_openssl_ifma_load(encounter_t *, \
+	uint64_t *, const BIGNUM *, const ec_ifma_mod_t *, unsigned char *, \
+								BN_CTX *);
+
+static int encounter_crypto_openssl_ifma_limbs(const BIGNUM *);
+
+
+
+/** r = a b 2^(-52 L) mod m, L = mod->limbs, for the Almost Montgomery
+ * Multiplication: r < 2m for a, b < 2m. The accumulator lives in n
+ * registers of eight 52-bit columns each, which take the low halves of
+ * the products a b_i and m y, move one column down, then take the high
+ * halves. The columns hold 64 bits, enough for the sums of L <= 160
+ * rounds; their carries are settled once at the end. r may alias a or b */
+static inline __attribute__((always_inline)) EC_IFMA_TARGET \
+void encounter_crypto_openssl_ifma_amm_n(uint64_t *r, const uint64_t *a, \
+	const uint64_t *b, const ec_ifma_mod_t *mod, const int n)
+{
+	__m512i R[EC_IFMA_MAXLIMBS / 8], B, Y;
+	const uint64_t *m = mod->m;
+	uint64_t r0, y, carry;
+	int i, j;
+
+	for (j = 0; j < n; ++j) R[j] = _mm512_setzero_si512();
+
+	for (i = 0; i < 8 * n; ++i) {
+		r0 = (uint64_t) _mm_cvtsi128_si64(_mm512_castsi512_si128(R[0]));
+		r0 += (a[0] * b[i]) & EC_IFMA_MASK;
+		y = (r0 * mod->k0) & EC_IFMA_MASK;
+		/* The low 52 bits of column 0 are now cancelled */
+		carry = (r0 + ((m[0] * y) & EC_IFMA_MASK)) >> EC_IFMA_LIMBBITS;
+
+		B = _mm512_set1_epi64((long long) b[i]);
+		Y = _mm512_set1_epi64((long long) y);
+
+#pragma GCC unroll 20
+		for (j = 0; j < n; ++j) {
+			R[j] = _mm512_madd52lo_epu64(R[j], \
+				_mm512_loadu_si512(a + 8 * j), B);
+			R[j] = _mm512_madd52lo_epu64(R[j], \
+				_mm512_loadu_si512(m + 8 * j), Y);
+		}
+
+#pragma GCC unroll 20
+		for (j = 0; j < n - 1; ++j)
+			R[j] = _mm512_alignr_epi64(R[j + 1], R[j], 1);
+		R[n - 1] = _mm512_alignr_epi64(_mm512_setzero_si512(), \
+							R[n - 1], 1);
+		R[0] = _mm512_mask_add_epi64(R[0], 1, R[0], \
+				_mm512_set1_epi64((long long) carry));
+
+#pragma GCC unroll 20
+		for (j = 0; j < n; ++j) {
+			R[j] = _mm512_madd52hi_epu64(R[j], \
+				_mm512_loadu_si512(a + 8 * j), B);
+			R[j] = _mm512_madd52hi_epu64(R[j], \
+				_mm512_loadu_si512(m + 8 * j), Y);
+		}
+	}
+
+	for (j = 0; j < n; ++j) _mm512_storeu_si512(r + 8 * j, R[j]);
+
+	for (carry = 0, i = 0; i < 8 * n; ++i) {
+		r[i] += carry;
+		carry = r[i] >> EC_IFMA_LIMBBITS;
+		r[i] &= EC_IFMA_MASK;
+	}
+}
+
+#define EC_IFMA_AMM_CASE(n) \
+	case n: encounter_crypto_openssl_ifma_amm_n(r, a, b, mod, n); break
+
+/** The AMM of mod->limbs limbs, each size unrolled on its own registers */
+static EC_IFMA_TARGET void encounter_crypto_openssl_ifma_amm(uint64_t *r, \
+	const uint64_t *a, const uint64_t *b, const ec_ifma_mod_t *mod)
+{
+	switch (mod->limbs / 8) {
+	EC_IFMA_AMM_CASE(3);	EC_IFMA_AMM_CASE(4);	EC_IFMA_AMM_CASE(5);
+	EC_IFMA_AMM_CASE(6);	EC_IFMA_AMM_CASE(7);	EC_IFMA_AMM_CASE(8);
+	EC_IFMA_AMM_CASE(9);	EC_IFMA_AMM_CASE(10);	EC_IFMA_AMM_CASE(11);
+	EC_IFMA_AMM_CASE(12);	EC_IFMA_AMM_CASE(13);	EC_IFMA_AMM_CASE(14);
+	EC_IFMA_AMM_CASE(15);	EC_IFMA_AMM_CASE(16);	EC_IFMA_AMM_CASE(17);
+	EC_IFMA_AMM_CASE(18);	EC_IFMA_AMM_CASE(19);	EC_IFMA_AMM_CASE(20);
+	}
+}
+
+/** The AMM of EC_IFMA_LANES independent products under the same m, one
+ * in each lane: limb j of the operands of all lanes is the vector at
+ * 8 j. Rather than shifting an accumulator, the products add into the
+ * 2L + 1 columns of t, the scratch, two rows of b at a time: each column
+ * is loaded and stored once for eight multiplications, which leaves the
+ * long dependency chains of the single AMM to throughput. r may alias
+ * a or b */
+static EC_IFMA_TARGET void encounter_crypto_openssl_ifma_amm_mb(\
+	uint64_t *r, const uint64_t *a, const uint64_t *b, \
+			const ec_ifma_mod_t *mod, uint64_t *t)
+{
+	const __m512i K0 = _mm512_set1_epi64((long long) mod->k0);
+	const __m512i MASK = _mm512_set1_epi64((long long) EC_IFMA_MASK);
+	const __m512i Z = _mm512_setzero_si512();
+	const uint64_t *m = mod->m;
+	const int L = mod->limbs;
+	__m512i B0, B1, Y0, Y1, T, C;
+	__m512i A0, A1, A2, M0, M1, M2;	/* Limbs j, j - 1 and j - 2 */
+	int i, j;
+
+	for (j = 0; j <= 2 * L; ++j) _mm512_storeu_si512(t + 8 * j, Z);
+
+	for (i = 0; i < L; i += 2) {
+		B0 = _mm512_loadu_si512(b + 8 * i);
+		B1 = _mm512_loadu_si512(b + 8 * (i + 1));
+		A1 = _mm512_loadu_si512(a);
+		M1 = _mm512_set1_epi64((long long) m[0]);
+		A0 = _mm512_loadu_si512(a + 8);
+		M0 = _mm512_set1_epi64((long long) m[1]);
+
+		/* Column i, whose low 52 bits y_0 cancels */
+		T = _mm512_madd52lo_epu64(_mm512_loadu_si512(t + 8 * i), A1, B0);
+		Y0 = _mm512_madd52lo_epu64(Z, T, K0);
+		T = _mm512_madd52lo_epu64(T, M1, Y0);
+		C = _mm512_srli_epi64(T, EC_IFMA_LIMBBITS);
+
+		/* Column i + 1, whose low 52 bits y_1 cancels */
+		T = _mm512_add_epi64(_mm512_loadu_si512(t + 8 * (i + 1)), C);
+		T = _mm512_madd52hi_epu64(T, A1, B0);
+		T = _mm512_madd52hi_epu64(T, M1, Y0);
+		T = _mm512_madd52lo_epu64(T, A0, B0);
+		T = _mm512_madd52lo_epu64(T, M0, Y0);
+		T = _mm512_madd52lo_epu64(T, A1, B1);
+		Y1 = _mm512_madd52lo_epu64(Z, T, K0);
+		T = _mm512_madd52lo_epu64(T, M1, Y1);
+		C = _mm512_srli_epi64(T, EC_IFMA_LIMBBITS);
+
+		for (j = 2; j < L; ++j) {
+			A2 = A1; A1 = A0;
+			M2 = M1; M1 = M0;
+			A0 = _mm512_loadu_si512(a + 8 * j);
+			M0 = _mm512_set1_epi64((long long) m[j]);
+
+			T = _mm512_loadu_si512(t + 8 * (i + j));
+			if (j == 2) T = _mm512_add_epi64(T, C);
+			T = _mm512_madd52hi_epu64(T, A1, B0);
+			T = _mm512_madd52hi_epu64(T, M1, Y0);
+			T = _mm512_madd52lo_epu64(T, A0, B0);
+			T = _mm512_madd52lo_epu64(T, M0, Y0);
+			T = _mm512_madd52hi_epu64(T, A2, B1);
+			T = _mm512_madd52hi_epu64(T, M2, Y1);
+			T = _mm512_madd52lo_epu64(T, A1, B1);
+			T = _mm512_madd52lo_epu64(T, M1, Y1);
+			_mm512_storeu_si512(t + 8 * (i + j), T);
+		}
+
+		T = _mm512_loadu_si512(t + 8 * (i + L));
+		T = _mm512_madd52hi_epu64(T, A0, B0);
+		T = _mm512_madd52hi_epu64(T, M0, Y0);
+		T = _mm512_madd52hi_epu64(T, A1, B1);
+		T = _mm512_madd52hi_epu64(T, M1, Y1);
+		T = _mm512_madd52lo_epu64(T, A0, B1);
+		T = _mm512_madd52lo_epu64(T, M0, Y1);
+		_mm512_storeu_si512(t + 8 * (i + L), T);
+
+		T = _mm512_loadu_si512(t + 8 * (i + L + 1));
+		T = _mm512_madd52hi_epu64(T, A0, B1);
+		T = _mm512_madd52hi_epu64(T, M0, Y1);
+		_mm512_storeu_si512(t + 8 * (i + L + 1), T);
+	}
+
+	for (C = Z, j = 0; j < L; ++j) {
+		T = _mm512_add_epi64(_mm512_loadu_si512(t + 8 * (L + j)), C);
+		C = _mm512_srli_epi64(T, EC_IFMA_LIMBBITS);
+		_mm512_storeu_si512(r + 8 * j, _mm512_and_si512(T, MASK));
+	}
+}
+
+/** r = table[idx], reading every entry whatever idx */
+static EC_IFMA_TARGET void encounter_crypto_openssl_ifma_select(uint64_t *r,\
+	const uint64_t *table, const unsigned int idx, const int limbs)
+{
+	const __m512i I = _mm512_set1_epi64(idx);
+	__mmask8 hit[EC_IFMA_TABLE];
+	__m512i acc;
+	int j, k;
+
+	for (k = 0; k < EC_IFMA_TABLE; ++k)
+		hit[k] = _mm512_cmpeq_epi64_mask(_mm512_set1_epi64(k), I);
+
+	for (j = 0; j < limbs; j += 8) {
+		acc = _mm512_setzero_si512();
+		for (k = 0; k < EC_IFMA_TABLE; ++k)
+			acc = _mm512_mask_mov_epi64(acc, hit[k], \
+				_mm512_loadu_si512(table + k * limbs + j));
+		_mm512_storeu_si512(r + j, acc);
+	}
+}
+
+/** r = a on limbs 52-bit limbs, a < 2^(52 limbs), through buf of
+ * EC_IFMA_BUFLEN(limbs) bytes */
+static void encounter_crypto_openssl_ifma_pack(uint64_t *r, const BIGNUM *a,\
+				unsigned char *buf, const int limbs)
+{
+	unsigned char *be = buf + EC_IFMA_BUFLEN(limbs) / 2;
+	size_t len, k;
+	uint64_t w;
+	int i;
+
+	/* Little-endian bytes in the low half, from the big-endian high */
+	memset(buf, 0, EC_IFMA_BUFLEN(limbs));
+	len = BN_bn2bin(a, be);
+	for (k = 0; k < len; ++k) buf[k] = be[len - 1 - k];
+
+	for (i = 0; i < limbs; ++i) {
+		memcpy(&w, buf + (i * EC_IFMA_LIMBBITS) / 8, sizeof w);
+		r[i] = (w >> ((i * EC_IFMA_LIMBBITS) % 8)) & EC_IFMA_MASK;
+	}
+}
+
+/** r = a, a normalized on limbs 52-bit limbs, through buf of
+ * EC_IFMA_BUFLEN(limbs) bytes */
+static BIGNUM *encounter_crypto_openssl_ifma_unpack(BIGNUM *r, \
+		const uint64_t *a, unsigned char *buf, const int limbs)
+{
+	const size_t len = (limbs * EC_IFMA_LIMBBITS + 7) / 8;
+	unsigned char *be = buf + EC_IFMA_BUFLEN(limbs) / 2;
+	size_t k;
+	uint64_t w;
+	int i;
+
+	memset(buf, 0, EC_IFMA_BUFLEN(limbs));
+	for (i = 0; i < limbs; ++i) {
+		memcpy(&w, buf + (i * EC_IFMA_LIMBBITS) / 8, sizeof w);
+		w |= a[i] << ((i * EC_IFMA_LIMBBITS) % 8);
+		memcpy(buf + (i * EC_IFMA_LIMBBITS) / 8, &w, sizeof w);
+	}
+	for (k = 0; k < len; ++k) be[k] = buf[len - 1 - k];
+
+	return BN_bin2bn(be, len, r);
+}
+
+/** Bits pos .. pos + EC_IFMA_WINDOW - 1 of e */
+static unsigned int encounter_crypto_openssl_ifma_window(const BIGNUM *e, \
+							const int pos)
+{
+	unsigned int w = 0;
+	int i;
+
+	for (i = EC_IFMA_WINDOW - 1; i >= 0; --i)
+		w = (w << 1) | (BN_is_bit_set(e, pos + i) ? 1 : 0);
+
+	return w;
+}
+
+/** r = r mod m for r <= 2m - 1, by a subtraction whose result is kept
+ * or dropped by a mask rather than a branch */
+static void encounter_crypto_openssl_ifma_reduce(uint64_t *r, \
+						const ec_ifma_mod_t *mod)
+{
+	uint64_t d[EC_IFMA_MAXLIMBS], borrow, keep;
+	int i;
+
+	for (borrow = 0, i = 0; i < mod->limbs; ++i) {
+		d[i] = r[i] - mod->m[i] - borrow;
+		borrow = d[i] >> 63;
+		d[i] &= EC_IFMA_MASK;
+	}
+
+	/* No borrow out: r >= m and d = r - m */
+	keep = borrow - 1;
+	for (i = 0; i < mod->limbs; ++i)
+		r[i] = (d[i] & keep) | (r[i] & ~keep);
+}
+
+/** x = a mod m on the limbs of m, through buf */
+static encounter_err_t encounter_crypto_openssl_ifma_load(encounter_t *ctx,\
+	uint64_t *x, const BIGNUM *a, const ec_ifma_mod_t *mod, \
+				unsigned char *buf, BN_CTX *bnctx)
+{
+	if (BN_ucmp(a, mod->bn) < 0) {
+		encounter_crypto_openssl_ifma_pack(x, a, buf, mod->limbs);
+		ctx->rc = ENCOUNTER_OK;
+		return ctx->rc;
+	}
+
+	BN_CTX_start(bnctx);
+	BIGNUM *t = BN_CTX_get(bnctx);
+
+	if (!t) OPENSSL_ERROR(end);
+	if (!BN_mod(t, a, mod->bn, bnctx)) OPENSSL_ERROR(end);
+	encounter_crypto_openssl_ifma_pack(x, t, buf, mod->limbs);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (t) BN_clear(t);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** Limbs of m, two spare bits included, rounded up to a multiple of 8 */
+static int encounter_crypto_openssl_ifma_limbs(const BIGNUM *m)
+{
+	const int limbs = (BN_num_bits(m) + 2 + EC_IFMA_LIMBBITS - 1) \
+							/ EC_IFMA_LIMBBITS;
+
+	return (limbs + 7) & ~7;
+}
+
+#endif  /* EC_IFMA_KERNELS */
+
+
+/** True when the exponentiations modulo m may run on the IFMA kernels:
+ * an odd m of EC_IFMA_MINBITS bits at least, and a CPU with AVX-512 IFMA */
+bool encounter_crypto_openssl_ifma_usable(const BIGNUM *m)
+{
+#ifdef EC_IFMA_KERNELS
+	static int cpu = -1;
+	const int bits = BN_num_bits(m);
+
+	if (cpu < 0) {
+		__builtin_cpu_init();
+		cpu = __builtin_cpu_supports("avx512f") \
+			&& __builtin_cpu_supports("avx512ifma");
+	}
+
+	return cpu && BN_is_odd(m) && bits >= EC_IFMA_MINBITS \
+			&& bits <= EC_IFMA_LIMBBITS * EC_IFMA_MAXLIMBS - 2;
+#else
+	(void) m;
+	return false;
+#endif
+}
+
+/** The fixed-width modulus of the kernels for m, m passing
+ * encounter_crypto_openssl_ifma_usable(), with mont its OpenSSL
+ * Montgomery context */
+encounter_err_t encounter_crypto_openssl_ifma_mod_new(encounter_t *ctx, \
+	const BIGNUM *m, BN_MONT_CTX *mont, BN_CTX *bnctx, \
+					struct ec_ifma_mod_s **mod)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!m || !mont || !bnctx || !mod) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	*mod = NULL;
+
+	if (!encounter_crypto_openssl_ifma_usable(m)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "modulus out of the IFMA kernels");
+                return ctx->rc;
+	}
+
+#ifdef EC_IFMA_KERNELS
+	unsigned char buf[EC_IFMA_BUFLEN(EC_IFMA_MAXLIMBS)];
+	struct ec_ifma_mod_s *md;
+	uint64_t inv;
+	int i;
+
+	md = calloc(1, sizeof *md);
+	if (!md) {
+		encounter_set_error(ctx, ENCOUNTER_ERR_MEM, "calloc: failed");
+		return ctx->rc;
+	}
+
+	BN_CTX_start(bnctx);
+	BIGNUM *t = BN_CTX_get(bnctx);
+
+	if (!t) OPENSSL_ERROR(end);
+	if ((md->bn = BN_dup(m)) == NULL) OPENSSL_ERROR(end);
+
+	md->limbs = encounter_crypto_openssl_ifma_limbs(m);
+	encounter_crypto_openssl_ifma_pack(md->m, m, buf, md->limbs);
+
+	/* -m^-1 mod 2^52 by Newton, each step doubling the good bits */
+	for (inv = md->m[0], i = 0; i < 5; ++i) inv *= 2 - md->m[0] * inv;
+	md->k0 = (0 - inv) & EC_IFMA_MASK;
+
+	BN_zero(t);
+	if (!BN_set_bit(t, 2 * EC_IFMA_LIMBBITS * md->limbs))
+		OPENSSL_ERROR(end);
+	if (!BN_mod(t, t, m, bnctx)) OPENSSL_ERROR(end);
+	encounter_crypto_openssl_ifma_pack(md->rr, t, buf, md->limbs);
+
+	/* R^2 R_o^-1, R_o the one OpenSSL brings in with BN_to_montgomery */
+	if (!BN_from_montgomery(t, t, mont, bnctx)) OPENSSL_ERROR(end);
+	encounter_crypto_openssl_ifma_pack(md->in, t, buf, md->limbs);
+
+	if (!BN_to_montgomery(t, BN_value_one(), mont, bnctx))
+		OPENSSL_ERROR(end);
+	encounter_crypto_openssl_ifma_pack(md->out, t, buf, md->limbs);
+
+	*mod = md;
+	md = NULL;
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (md) encounter_crypto_openssl_ifma_mod_free(md);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+#else
+	encounter_set_error(ctx, ENCOUNTER_ERR_IMPL, \
+		"IFMA kernels not built on this platform");
+	return ctx->rc;
+#endif
+}
+
+void encounter_crypto_openssl_ifma_mod_free(struct ec_ifma_mod_s *mod)
+{
+	if (!mod) return;
+
+	if (mod->bn) BN_free(mod->bn);
+	free(mod);
+}
+
+/** r = a^e mod m, m the modulus of mod. The exponent is scanned in fixed
+ * windows of EC_IFMA_WINDOW bits, each table entry selected by a sweep of
+ * the whole table, so that the time depends on the sizes of the operands
+ * only. The table and operands live on the stack at the largest width,
+ * and bnctx serves the bases not below m only. a and e are not negative */
+encounter_err_t encounter_crypto_openssl_ifma_expmod(encounter_t *ctx, \
+	BIGNUM *r, const BIGNUM *a, const BIGNUM *e, \
+			const struct ec_ifma_mod_s *mod, BN_CTX *bnctx)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!r || !a || !e || !mod || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (BN_is_negative(a) || BN_is_negative(e)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "negative operand");
+                return ctx->rc;
+	}
+
+#ifdef EC_IFMA_KERNELS
+	uint64_t table[EC_IFMA_TABLE * EC_IFMA_MAXLIMBS];
+	uint64_t x[EC_IFMA_MAXLIMBS], acc[EC_IFMA_MAXLIMBS];
+	uint64_t one[EC_IFMA_MAXLIMBS];
+	unsigned char buf[EC_IFMA_BUFLEN(EC_IFMA_MAXLIMBS)];
+	const int limbs = mod->limbs;
+	int pos, i;
+
+	/* a^0 = 1, m > 1 */
+	if (BN_is_zero(e)) {
+		if (!BN_one(r)) OPENSSL_ERROR(out);
+
+		ctx->rc = ENCOUNTER_OK;
+		goto out;
+	}
+
+	if (encounter_crypto_openssl_ifma_load(ctx, x, a, mod, buf, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	memset(one, 0, limbs * sizeof *one);
+	one[0] = 1;
+
+	/* table[k] = a^k in Montgomery form, limbs words apart */
+	encounter_crypto_openssl_ifma_amm(table, one, mod->rr, mod);
+	encounter_crypto_openssl_ifma_amm(table + limbs, x, mod->rr, mod);
+	for (i = 2; i < EC_IFMA_TABLE; ++i)
+		encounter_crypto_openssl_ifma_amm(table + i * limbs, \
+			table + (i - 1) * limbs, table + limbs, mod);
+
+	pos = ((BN_num_bits(e) - 1) / EC_IFMA_WINDOW) * EC_IFMA_WINDOW;
+	encounter_crypto_openssl_ifma_select(acc, table, \
+		encounter_crypto_openssl_ifma_window(e, pos), limbs);
+
+	for (pos -= EC_IFMA_WINDOW; pos >= 0; pos -= EC_IFMA_WINDOW) {
+		for (i = 0; i < EC_IFMA_WINDOW; ++i)
+			encounter_crypto_openssl_ifma_amm(acc, acc, acc, mod);
+
+		encounter_crypto_openssl_ifma_select(x, table, \
+			encounter_crypto_openssl_ifma_window(e, pos), limbs);
+		encounter_crypto_openssl_ifma_amm(acc, acc, x, mod);
+	}
+
+	/* Out of Montgomery form, acc <= m */
+	encounter_crypto_openssl_ifma_amm(acc, acc, one, mod);
+	encounter_crypto_openssl_ifma_reduce(acc, mod);
+	if (!encounter_crypto_openssl_ifma_unpack(r, acc, buf, limbs))
+		OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	/* Wipe the powers of a */
+	OPENSSL_cleanse(table, EC_IFMA_TABLE * limbs * sizeof *table);
+	OPENSSL_cleanse(x, sizeof x);
+	OPENSSL_cleanse(acc, sizeof acc);
+	OPENSSL_cleanse(buf, sizeof buf);
+
+out:
+	return ctx->rc;
+#else
+	encounter_set_error(ctx, ENCOUNTER_ERR_IMPL, \
+		"IFMA kernels not built on this platform");
+	return ctx->rc;
+#endif
+}
+
+/** r[l] = a[l]^e mod m for the count <= EC_IFMA_LANES bases of a, m the
+ * modulus of mod, one base in each lane of the vectors: the randomizers
+ * r^n of a key, or the halves modulo p^2 of a batch of decryptions. As in
+ * encounter_crypto_openssl_ifma_expmod() the time depends on the sizes of
+ * the operands only; eight times its table does not fit the stack, and
+ * is allocated. The results may alias the bases */
+encounter_err_t encounter_crypto_openssl_ifma_expmod_mb(encounter_t *ctx, \
+	BIGNUM **r, BIGNUM **a, const size_t count, const BIGNUM *e, \
+			const struct ec_ifma_mod_s *mod, BN_CTX *bnctx)
+{
+	size_t l;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!r || !a || !e || !mod || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (!count || count > EC_IFMA_LANES || BN_is_negative(e)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "batch out of the IFMA kernels");
+                return ctx->rc;
+	}
+	for (l = 0; l < count; ++l)
+		if (!r[l] || !a[l] || BN_is_negative(a[l])) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+				"null or negative base");
+			return ctx->rc;
+		}
+
+#ifdef EC_IFMA_KERNELS
+	uint64_t *table = NULL, *x, *acc, *rr, *one, *t;
+	uint64_t limb[EC_IFMA_MAXLIMBS];
+	unsigned char buf[EC_IFMA_BUFLEN(EC_IFMA_MAXLIMBS)];
+	const int limbs = mod->limbs;
+	int pos, i, j;
+	size_t size;
+
+	/* a^0 = 1, m > 1 */
+	if (BN_is_zero(e)) {
+		for (l = 0; l < count; ++l)
+			if (!BN_one(r[l])) OPENSSL_ERROR(out);
+
+		ctx->rc = ENCOUNTER_OK;
+		goto out;
+	}
+
+	/* Vectors of limbs words: the table, x, acc, rr, one and the
+	 * 2 limbs + 1 columns of the products */
+	size = ((EC_IFMA_TABLE + 6) * 8 * limbs + 8) * sizeof *table;
+	table = OPENSSL_malloc(size);
+	if (!table) {
+		encounter_set_error(ctx, ENCOUNTER_ERR_MEM, \
+			"OPENSSL_malloc: failed");
+		goto out;
+	}
+	x = table + EC_IFMA_TABLE * 8 * limbs;
+	acc = x + 8 * limbs;
+	rr = acc + 8 * limbs;
+	one = rr + 8 * limbs;
+	t = one + 8 * limbs;
+
+	/* rr and one the same in every lane, the bases one lane each */
+	memset(x, 0, 8 * limbs * sizeof *x);
+	memset(one, 0, 8 * limbs * sizeof *one);
+	for (j = 0; j < limbs; ++j)
+		for (i = 0; i < EC_IFMA_LANES; ++i) {
+			rr[8 * j + i] = mod->rr[j];
+			if (!j) one[i] = 1;
+		}
+
+	for (l = 0; l < count; ++l) {
+		if (encounter_crypto_openssl_ifma_load(ctx, limb, a[l], mod, \
+				buf, bnctx) != ENCOUNTER_OK)
+			goto end;
+		for (j = 0; j < limbs; ++j) x[8 * j + l] = limb[j];
+	}
+
+	/* table[k] = a^k in Montgomery form, lane by lane */
+	encounter_crypto_openssl_ifma_amm_mb(table, one, rr, mod, t);
+	encounter_crypto_openssl_ifma_amm_mb(table + 8 * limbs, x, rr, mod, t);
+	for (i = 2; i < EC_IFMA_TABLE; ++i)
+		encounter_crypto_openssl_ifma_amm_mb(table + i * 8 * limbs, \
+			table + (i - 1) * 8 * limbs, table + 8 * limbs, mod, t);
+
+	/* The exponent is common to the lanes, and so are the windows */
+	pos = ((BN_num_bits(e) - 1) / EC_IFMA_WINDOW) * EC_IFMA_WINDOW;
+	encounter_crypto_openssl_ifma_select(acc, table, \
+		encounter_crypto_openssl_ifma_window(e, pos), 8 * limbs);
+
+	for (pos -= EC_IFMA_WINDOW; pos >= 0; pos -= EC_IFMA_WINDOW) {
+		for (i = 0; i < EC_IFMA_WINDOW; ++i)
+			encounter_crypto_openssl_ifma_amm_mb(acc, acc, acc, \
+								mod, t);
+
+		encounter_crypto_openssl_ifma_select(x, table, \
+			encounter_crypto_openssl_ifma_window(e, pos), 8 * limbs);
+		encounter_crypto_openssl_ifma_amm_mb(acc, acc, x, mod, t);
+	}
+
+	/* Out of Montgomery form, each lane <= m */
+	encounter_crypto_openssl_ifma_amm_mb(acc, acc, one, mod, t);
+	for (l = 0; l < count; ++l) {
+		for (j = 0; j < limbs; ++j) limb[j] = acc[8 * j + l];
+		encounter_crypto_openssl_ifma_reduce(limb, mod);
+		if (!encounter_crypto_openssl_ifma_unpack(r[l], limb, buf, \
+				limbs))
+			OPENSSL_ERROR(end);
+	}
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	/* Wipe the powers of the bases */
+	OPENSSL_cleanse(table, size);
+	OPENSSL_free(table);
+	OPENSSL_cleanse(limb, sizeof limb);
+	OPENSSL_cleanse(buf, sizeof buf);
+
+out:
+	return ctx->rc;
+#else
+	encounter_set_error(ctx, ENCOUNTER_ERR_IMPL, \
+		"IFMA kernels not built on this platform");
+	return ctx->rc;
+#endif
+}
+
+/** r = a R R_o^-1 mod m on the limbs of mod: a in the Montgomery form of
+ * OpenSSL, a < m, brought to the one of the kernels */
+encounter_err_t encounter_crypto_openssl_ifma_import(encounter_t *ctx, \
+	uint64_t *r, const BIGNUM *a, const struct ec_ifma_mod_s *mod)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!r || !a || !mod || BN_is_negative(a) \
+	    || BN_ucmp(a, mod->bn) >= 0) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+#ifdef EC_IFMA_KERNELS
+	unsigned char buf[EC_IFMA_BUFLEN(EC_IFMA_MAXLIMBS)];
+
+	encounter_crypto_openssl_ifma_pack(r, a, buf, mod->limbs);
+	encounter_crypto_openssl_ifma_amm(r, r, mod->in, mod);
+	OPENSSL_cleanse(buf, sizeof buf);
+
+	ctx->rc = ENCOUNTER_OK;
+	return ctx->rc;
+#else
+	encounter_set_error(ctx, ENCOUNTER_ERR_IMPL, \
+		"IFMA kernels not built on this platform");
+	return ctx->rc;
+#endif
+}
+
+/** r = a R_o R^-1 mod m: a on the limbs of mod in the Montgomery form of
+ * the kernels, a < 2m, back to the one of OpenSSL */
+encounter_err_t encounter_crypto_openssl_ifma_export(encounter_t *ctx, \
+	BIGNUM *r, const uint64_t *a, const struct ec_ifma_mod_s *mod)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!r || !a || !mod) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+#ifdef EC_IFMA_KERNELS
+	unsigned char buf[EC_IFMA_BUFLEN(EC_IFMA_MAXLIMBS)];
+	uint64_t x[EC_IFMA_MAXLIMBS];
+
+	/* x < m + m 2m / R < 2m */
+	encounter_crypto_openssl_ifma_amm(x, a, mod->out, mod);
+	encounter_crypto_openssl_ifma_reduce(x, mod);
+	if (!encounter_crypto_openssl_ifma_unpack(r, x, buf, mod->limbs))
+		OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	OPENSSL_cleanse(x, sizeof x);
+	OPENSSL_cleanse(buf, sizeof buf);
+
+	return ctx->rc;
+#else
+	encounter_set_error(ctx, ENCOUNTER_ERR_IMPL, \
+		"IFMA kernels not built on this platform");
+	return ctx->rc;
+#endif
+}
+
+/** r = a b R^-1 mod m on the limbs of mod, r < 2m for a, b < 2m. No
+ * checks, no conversions: the inner product of the fixed-base tables.
+ * r may alias a or b */
+void encounter_crypto_openssl_ifma_mul(uint64_t *r, const uint64_t *a, \
+		const uint64_t *b, const struct ec_ifma_mod_s *mod)
+{
+#ifdef EC_IFMA_KERNELS
+	encounter_crypto_openssl_ifma_amm(r, a, b, mod);
+#else
+	(void) r; (void) a; (void) b; (void) mod;
+#endif
+}
@@ -0,0 +1,70 @@
+#ifndef _ENCOUNTER_CRYPTO_OPENSSL_IFMA_H_
+#define _ENCOUNTER_CRYPTO_OPENSSL_IFMA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <openssl/bn.h>
+
+#include "encounter_priv.h"
+
+
+/* Montgomery exponentiation on 52-bit limbs with the AVX-512 IFMA
+ * instructions, eight limbs a vector, for the odd moduli of 1536 to
+ * 52 EC_IFMA_MAXLIMBS - 2 bits: n^2, p^2, q^2 and their halves up to
+ * 8192-bit moduli. Selected at runtime by CPUID, the kernels work on
+ * fixed-width operands, each width unrolled on its own registers, for
+ * the key moduli prepared once in a struct ec_ifma_mod_s. Batches of
+ * exponentiations under the same modulus and exponent run
+ * EC_IFMA_LANES at a time, one in each lane of the vectors.
+ * Elsewhere, and on the other CPUs, the OpenSSL Montgomery arithmetic
+ * stays in charge */
+
+#define EC_IFMA_MAXLIMBS	160
+#define EC_IFMA_MINBITS		1536
+
+/* Exponentiations of a multi-buffer run, one in each 64-bit lane */
+#define EC_IFMA_LANES		8
+
+/* A key modulus m on limbs 52-bit limbs, limbs a multiple of 8 with two
+ * spare bits at least: m < 2^(52 limbs - 2). Built once for each key
+ * modulus, next to its OpenSSL Montgomery context, with R = 2^(52 limbs)
+ * and R_o the R of OpenSSL for the conversions between the two forms */
+struct ec_ifma_mod_s {
+	uint64_t	m[EC_IFMA_MAXLIMBS];
+	uint64_t	rr[EC_IFMA_MAXLIMBS];	/* R^2 mod m */
+	uint64_t	in[EC_IFMA_MAXLIMBS];	/* R^2 R_o^-1 mod m */
+	uint64_t	out[EC_IFMA_MAXLIMBS];	/* R_o mod m */
+	uint64_t	k0;			/* -m^-1 mod 2^52 */
+	int		limbs;
+	BIGNUM		*bn;			/* m */
+};
+
+
+/* TODO use __BEGIN_DECLS */
+
+bool encounter_crypto_openssl_ifma_usable(const BIGNUM *);
+
+encounter_err_t encounter_crypto_openssl_ifma_mod_new(encounter_t *, \
+	const BIGNUM *, BN_MONT_CTX *, BN_CTX *, struct ec_ifma_mod_s **);
+
+void encounter_crypto_openssl_ifma_mod_free(struct ec_ifma_mod_s *);
+
+encounter_err_t encounter_crypto_openssl_ifma_expmod(encounter_t *, \
+	BIGNUM *, const BIGNUM *, const BIGNUM *, \
+				const struct ec_ifma_mod_s *, BN_CTX *);
+
+encounter_err_t encounter_crypto_openssl_ifma_expmod_mb(encounter_t *, \
+	BIGNUM **, BIGNUM **, const size_t, const BIGNUM *, \
+				const struct ec_ifma_mod_s *, BN_CTX *);
+
+encounter_err_t encounter_crypto_openssl_ifma_import(encounter_t *, \
+		uint64_t *, const BIGNUM *, const struct ec_ifma_mod_s *);
+
+encounter_err_t encounter_crypto_openssl_ifma_export(encounter_t *, \
+		BIGNUM *, const uint64_t *, const struct ec_ifma_mod_s *);
+
+void encounter_crypto_openssl_ifma_mul(uint64_t *, const uint64_t *, \
+			const uint64_t *, const struct ec_ifma_mod_s *);
+
+#endif  /* _ENCOUNTER_CRYPTO_OPENSSL_IFMA_H_ */
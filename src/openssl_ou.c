@@ -0,0 +1,715 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <openssl/bn.h>
+#include <openssl/err.h>
+#include <openssl/crypto.h>
+
+#include "encounter_priv.h"
+
+#include "openssl_drv.h"
+#include "openssl_ou.h"
+#include "openssl_drbg.h"
+
+#include "utils.h"
+
+
+/* Some static prototypes */
+static encounter_err_t encounter_crypto_openssl_ou_check(encounter_t *, \
+	const ec_count_t *, const ec_keyctx_t *, const encounter_key_t);
+
+static encounter_err_t encounter_crypto_openssl_ou_rerandomize(\
+		encounter_t *, BIGNUM *, ec_keyctx_t *, BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_ou_gInv(encounter_t *, \
+	BIGNUM *, const BIGNUM *, const BIGNUM *, const BIGNUM *, BN_CTX *);
+
+
+
+/** The counter, if any, is an Okamoto-Uchiyama one and key of the given
+ * type */
+static encounter_err_t encounter_crypto_openssl_ou_check(encounter_t *ctx, \
+	const ec_count_t *counter, const ec_keyctx_t *key, \
+					const encounter_key_t type)
+{
+	if (counter && (!EC_IS_OU_COUNT(counter) || !counter->c)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "not an Okamoto-Uchiyama counter");
+                return ctx->rc;
+	}
+	if (key->type != type) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "not an Okamoto-Uchiyama %s-key", \
+			type == EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC ? \
+						"public" : "private");
+                return ctx->rc;
+	}
+
+	ctx->rc = ENCOUNTER_OK;
+	return ctx->rc;
+}
+
+/** r = L(g^(p-1) mod p^2)^-1 mod p, the decryption constant. Fails when
+ * the order of g mod p^2 is prime to p, g no generator then */
+static encounter_err_t encounter_crypto_openssl_ou_gInv(encounter_t *ctx, \
+	BIGNUM *r, const BIGNUM *g, const BIGNUM *p, const BIGNUM *psquared, \
+								BN_CTX *bnctx)
+{
+	BN_CTX_start(bnctx);
+	BIGNUM *t = BN_CTX_get(bnctx);
+	BIGNUM *pminus1 = BN_CTX_get(bnctx);
+
+	if (!pminus1) OPENSSL_ERROR(end);
+
+	if (!BN_sub(pminus1, p, BN_value_one())) OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_expmodBN(ctx, t, g, pminus1, \
+		psquared, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (!BN_sub_word(t, 1)) OPENSSL_ERROR(end);
+	if (!BN_div(t, NULL, t, p, bnctx)) OPENSSL_ERROR(end);
+	if (!BN_nnmod(t, t, p, bnctx)) OPENSSL_ERROR(end);
+
+	if (BN_is_zero(t)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_DATA, \
+                        "bad Okamoto-Uchiyama generator");
+		goto end;
+	}
+	if (!BN_mod_inverse(r, t, p, bnctx)) OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (t) BN_clear(t);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** p and q of 2/3 of keysize bits: n = p^2 q is as wide as the n of a
+ * Paillier key of the same keysize. g at random, h = g^n mod n. The
+ * progress goes to the callback of the configuration */
+encounter_err_t encounter_crypto_openssl_ou_keygen(encounter_t *ctx, \
+	const unsigned int keysize, ec_keyctx_t *pubK, ec_keyctx_t *privK)
+{
+	struct ou_publickey *pk;
+	struct ou_privatekey *sk;
+	struct ec_keygen_s kg;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!pubK || !privK) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	pk = &pubK->k.ou_pubK;
+	sk = &privK->k.ou_privK;
+	encounter_crypto_openssl_keygen_init(ctx, &kg);
+	BN_CTX *bnctx = BN_CTX_new();
+	BN_CTX_start(bnctx);
+	BIGNUM *t = BN_CTX_get(bnctx);
+
+	if (!t) OPENSSL_ERROR(end);
+
+	/* Generate p and q primes */
+	if (encounter_crypto_openssl_genprime(ctx, &kg, sk->p, \
+			2 * keysize / 3, NULL, NULL, 0) != ENCOUNTER_OK)
+		goto end;
+	do {
+		if (encounter_crypto_openssl_genprime(ctx, &kg, sk->q, \
+			2 * keysize / 3, NULL, NULL, 1) != ENCOUNTER_OK)
+			goto end;
+	} while (!BN_cmp(sk->p, sk->q));
+
+	/* n = p^2 q */
+	if (!BN_sqr(sk->psquared, sk->p, bnctx)) OPENSSL_ERROR(end);
+	if (!BN_mul(pk->n, sk->psquared, sk->q, bnctx)) OPENSSL_ERROR(end);
+
+	/* g of order divisible by p mod p^2, nearly any will do */
+	for (;;) {
+		if (!encounter_crypto_openssl_keygen_step(&kg, \
+				EC_KEYGEN_GENERATOR, 0)) {
+			encounter_set_error(ctx, ENCOUNTER_ERR_CANCELED, \
+				"key generation canceled");
+			goto end;
+		}
+		if (!BN_rand_range(sk->g, pk->n)) OPENSSL_ERROR(end);
+		if (!BN_gcd(t, sk->g, pk->n, bnctx)) OPENSSL_ERROR(end);
+		if (BN_cmp(sk->g, BN_value_one()) <= 0 || !BN_is_one(t))
+			continue;
+		if (encounter_crypto_openssl_ou_gInv(ctx, sk->gpinv, sk->g, \
+			sk->p, sk->psquared, bnctx) == ENCOUNTER_OK)
+			break;
+		if (ctx->rc != ENCOUNTER_ERR_DATA) goto end;
+	}
+
+	if (!BN_copy(pk->g, sk->g)) OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_expmodBN(ctx, pk->h, pk->g, pk->n, \
+		pk->n, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (bnctx) BN_CTX_end(bnctx);
+	if (bnctx) BN_CTX_free(bnctx);
+	encounter_crypto_openssl_keygen_destroy(&kg);
+
+	return ctx->rc;
+}
+
+/** c = c h^r mod n for a fresh r, an encryption of 0 multiplied in */
+static encounter_err_t encounter_crypto_openssl_ou_rerandomize(\
+	encounter_t *ctx, BIGNUM *c, ec_keyctx_t *pubK, BN_CTX *bnctx)
+{
+	const struct ou_publickey *pk = &pubK->k.ou_pubK;
+
+	BN_CTX_start(bnctx);
+	BIGNUM *r = BN_CTX_get(bnctx);
+	BIGNUM *t = BN_CTX_get(bnctx);
+
+	if (!t) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_drbg_range(ctx, &r, 1, pk->n) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	if (encounter_crypto_openssl_expmodBN(ctx, t, pk->h, r, pk->n, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (!BN_mod_mul(c, c, t, pk->n, bnctx)) OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (r) BN_clear(r);
+	if (t) BN_clear(t);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** A fresh encryption of 0, h^r mod n, into counter */
+encounter_err_t encounter_crypto_openssl_ou_new_counter(encounter_t *ctx, \
+				ec_keyctx_t *pubK, ec_count_t *counter)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!pubK || !counter) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (encounter_crypto_openssl_ou_check(ctx, NULL, pubK, \
+			EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	BN_CTX *bnctx = BN_CTX_new();
+
+	counter->version = ENCOUNTER_COUNT_OKAMOTO_UCHIYAMA_V1;
+	counter->c = BN_new();
+	if (!counter->c || !bnctx) OPENSSL_ERROR(end);
+
+	if (!BN_one(counter->c)) OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_ou_rerandomize(ctx, counter->c, pubK, \
+			bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	/* Update the time of last modification */
+	time(&(counter->lastUpdated));
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (bnctx) BN_CTX_free(bnctx);
+
+	return ctx->rc;
+}
+
+/** c = c g^a h^r mod n, or c g^-a h^r. a = 0 re-randomizes the counter */
+encounter_err_t encounter_crypto_openssl_ou_update(encounter_t *ctx, \
+	ec_count_t *counter, ec_keyctx_t *pubK, const unsigned int a, \
+						const bool decrement)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!counter || !pubK) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (encounter_crypto_openssl_ou_check(ctx, counter, pubK, \
+			EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	const struct ou_publickey *pk = &pubK->k.ou_pubK;
+	BN_CTX *bnctx = BN_CTX_new();
+	BN_CTX_start(bnctx);
+	BIGNUM *m = BN_CTX_get(bnctx);
+	BIGNUM *t = BN_CTX_get(bnctx);
+
+	if (!t) OPENSSL_ERROR(end);
+
+	if (a) {
+		if (!BN_set_word(m, a)) OPENSSL_ERROR(end);
+		if (encounter_crypto_openssl_expmodBN(ctx, t, pk->g, m, \
+			pk->n, bnctx) \
+				!= ENCOUNTER_OK)
+			goto end;
+		if (decrement && !BN_mod_inverse(t, t, pk->n, bnctx))
+			OPENSSL_ERROR(end);
+		if (!BN_mod_mul(counter->c, counter->c, t, pk->n, bnctx))
+			OPENSSL_ERROR(end);
+	}
+	if (encounter_crypto_openssl_ou_rerandomize(ctx, counter->c, pubK, \
+			bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	/* Update the time of last modification */
+	time(&(counter->lastUpdated));
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (m)     BN_clear(m);
+	if (bnctx) BN_CTX_end(bnctx);
+	if (bnctx) BN_CTX_free(bnctx);
+
+	return ctx->rc;
+}
+
+/** a = a b mod n, or a b^-1 */
+encounter_err_t encounter_crypto_openssl_ou_addsub(encounter_t *ctx, \
+	ec_count_t *a, const ec_count_t *b, ec_keyctx_t *pubK, const bool sub)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!a || !b || !pubK) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (encounter_crypto_openssl_ou_check(ctx, a, pubK, \
+			EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC) != ENCOUNTER_OK)
+		return ctx->rc;
+	if (encounter_crypto_openssl_ou_check(ctx, b, pubK, \
+			EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	const struct ou_publickey *pk = &pubK->k.ou_pubK;
+	BN_CTX *bnctx = BN_CTX_new();
+	BN_CTX_start(bnctx);
+	BIGNUM *t = BN_CTX_get(bnctx);
+
+	if (!t) OPENSSL_ERROR(end);
+
+	if (sub) {
+		if (!BN_mod_inverse(t, b->c, pk->n, bnctx)) OPENSSL_ERROR(end);
+	} else if (!BN_copy(t, b->c))
+		OPENSSL_ERROR(end);
+	if (!BN_mod_mul(a->c, a->c, t, pk->n, bnctx)) OPENSSL_ERROR(end);
+
+	/* Update the time of last modification */
+	time(&(a->lastUpdated));
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (bnctx) BN_CTX_end(bnctx);
+	if (bnctx) BN_CTX_free(bnctx);
+
+	return ctx->rc;
+}
+
+/** c = c^a h^r mod n, or c^k h^r for a random k */
+encounter_err_t encounter_crypto_openssl_ou_mul(encounter_t *ctx, \
+	ec_count_t *counter, ec_keyctx_t *pubK, const unsigned int a, \
+							const bool rand)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!counter || !pubK) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (encounter_crypto_openssl_ou_check(ctx, counter, pubK, \
+			EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	const struct ou_publickey *pk = &pubK->k.ou_pubK;
+	BN_CTX *bnctx = BN_CTX_new();
+	BN_CTX_start(bnctx);
+	BIGNUM *k = BN_CTX_get(bnctx);
+
+	if (!k) OPENSSL_ERROR(end);
+
+	if (rand) {
+		do {
+			if (!BN_rand_range(k, pk->n)) OPENSSL_ERROR(end);
+		} while (BN_is_zero(k));
+	} else if (!BN_set_word(k, a))
+		OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_expmodBN(ctx, counter->c, counter->c, k, \
+		pk->n, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (encounter_crypto_openssl_ou_rerandomize(ctx, counter->c, pubK, \
+			bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	/* Update the time of last modification */
+	time(&(counter->lastUpdated));
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (k)     BN_clear(k);
+	if (bnctx) BN_CTX_end(bnctx);
+	if (bnctx) BN_CTX_free(bnctx);
+
+	return ctx->rc;
+}
+
+/** out = prod counters[i]^weights[i] h^r mod n. out may be one of the
+ * counters */
+encounter_err_t encounter_crypto_openssl_ou_linear_combination(\
+	encounter_t *ctx, ec_count_t **counters, const unsigned int *weights,\
+		const size_t n, ec_keyctx_t *pubK, ec_count_t *out)
+{
+	size_t i;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!counters || !weights || !pubK || !out) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	for (i = 0; i < n; ++i)
+		if (encounter_crypto_openssl_ou_check(ctx, counters[i], \
+			pubK, EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC) != ENCOUNTER_OK)
+			return ctx->rc;
+	if (encounter_crypto_openssl_ou_check(ctx, out, pubK, \
+			EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	const struct ou_publickey *pk = &pubK->k.ou_pubK;
+	BN_CTX *bnctx = BN_CTX_new();
+	BN_CTX_start(bnctx);
+	BIGNUM *acc = BN_CTX_get(bnctx);
+	BIGNUM *w = BN_CTX_get(bnctx);
+	BIGNUM *t = BN_CTX_get(bnctx);
+
+	if (!t) OPENSSL_ERROR(end);
+
+	if (!BN_one(acc)) OPENSSL_ERROR(end);
+	for (i = 0; i < n; ++i) {
+		if (!weights[i]) continue;
+		if (!BN_set_word(w, weights[i])) OPENSSL_ERROR(end);
+		if (encounter_crypto_openssl_expmodBN(ctx, t, \
+			counters[i]->c, w, pk->n, bnctx) != ENCOUNTER_OK)
+			goto end;
+		if (!BN_mod_mul(acc, acc, t, pk->n, bnctx))
+			OPENSSL_ERROR(end);
+	}
+
+	if (encounter_crypto_openssl_ou_rerandomize(ctx, acc, pubK, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (!BN_copy(out->c, acc)) OPENSSL_ERROR(end);
+	out->slots = 0;
+	out->width = 0;
+
+	/* Update the time of last modification */
+	time(&(out->lastUpdated));
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (bnctx) BN_CTX_end(bnctx);
+	if (bnctx) BN_CTX_free(bnctx);
+
+	return ctx->rc;
+}
+
+/** The sum of n counters, into out and/or decrypted into plain with
+ * privK. Products modulo n cost far less than the threads would */
+encounter_err_t encounter_crypto_openssl_ou_sum(encounter_t *ctx, \
+	ec_count_t **counters, const size_t n, ec_keyctx_t *pubK, \
+	ec_count_t *out, ec_keyctx_t *privK, unsigned long long int *plain)
+{
+	ec_count_t sum;
+	size_t i;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!counters || !pubK || (!out && !plain) || (plain && !privK)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	for (i = 0; i < n; ++i)
+		if (encounter_crypto_openssl_ou_check(ctx, counters[i], \
+			pubK, EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC) != ENCOUNTER_OK)
+			return ctx->rc;
+	if (out && encounter_crypto_openssl_ou_check(ctx, out, pubK, \
+			EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	const struct ou_publickey *pk = &pubK->k.ou_pubK;
+	BN_CTX *bnctx = BN_CTX_new();
+
+	memset(&sum, 0, sizeof sum);
+	sum.version = ENCOUNTER_COUNT_OKAMOTO_UCHIYAMA_V1;
+	sum.c = BN_new();
+	if (!sum.c || !bnctx) OPENSSL_ERROR(end);
+
+	if (!BN_one(sum.c)) OPENSSL_ERROR(end);
+	for (i = 0; i < n; ++i)
+		if (!BN_mod_mul(sum.c, sum.c, counters[i]->c, pk->n, bnctx))
+			OPENSSL_ERROR(end);
+
+	/* A bare decryption needs no randomizer */
+	if (plain && encounter_crypto_openssl_decrypt(ctx, &sum, privK, \
+			plain) != ENCOUNTER_OK)
+		goto end;
+
+	if (out) {
+		if (encounter_crypto_openssl_ou_rerandomize(ctx, sum.c, \
+				pubK, bnctx) != ENCOUNTER_OK)
+			goto end;
+		if (!BN_copy(out->c, sum.c)) OPENSSL_ERROR(end);
+		out->slots = 0;
+		out->width = 0;
+
+		/* Update the time of last modification */
+		time(&(out->lastUpdated));
+	}
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (bnctx) BN_CTX_free(bnctx);
+	if (sum.c) BN_clear_free(sum.c);
+
+	return ctx->rc;
+}
+
+/** m = L(c^(p-1) mod p^2) L(g^(p-1) mod p^2)^-1 mod p, the work of a
+ * single exponentiation modulo p^2 */
+encounter_err_t encounter_crypto_openssl_ou_decryptBN(encounter_t *ctx, \
+	BIGNUM *m, const ec_count_t *counter, ec_keyctx_t *privK, \
+								BN_CTX *bnctx)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!m || !counter || !privK || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (encounter_crypto_openssl_ou_check(ctx, counter, privK, \
+			EC_KEYTYPE_OKAMOTO_UCHIYAMA_PRIVATE) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	const struct ou_privatekey *sk = &privK->k.ou_privK;
+
+	BN_CTX_start(bnctx);
+	BIGNUM *t = BN_CTX_get(bnctx);
+	BIGNUM *pminus1 = BN_CTX_get(bnctx);
+
+	if (!pminus1) OPENSSL_ERROR(end);
+
+	if (!BN_sub(pminus1, sk->p, BN_value_one())) OPENSSL_ERROR(end);
+	if (!BN_nnmod(t, counter->c, sk->psquared, bnctx)) OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_expmodBN(ctx, t, t, pminus1, \
+		sk->psquared, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (!BN_sub_word(t, 1)) OPENSSL_ERROR(end);
+	if (!BN_div(t, NULL, t, sk->p, bnctx)) OPENSSL_ERROR(end);
+	if (!BN_mod_mul(m, t, sk->gpinv, sk->p, bnctx)) OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (t) BN_clear(t);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** The sign of a - b, out of the decryption of d = a b^-1 g^r h^r' mod n
+ * alone, an encryption of a - b + r for a fresh random r that is then
+ * compared with r. Neither a nor b is ever decrypted */
+encounter_err_t encounter_crypto_openssl_ou_private_cmp(encounter_t *ctx, \
+	const ec_count_t *a, const ec_count_t *b, ec_keyctx_t *pubK, \
+					ec_keyctx_t *privK, int *result)
+{
+	ec_count_t d;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!a || !b || !pubK || !privK || !result) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (encounter_crypto_openssl_ou_check(ctx, a, pubK, \
+			EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC) != ENCOUNTER_OK)
+		return ctx->rc;
+	if (encounter_crypto_openssl_ou_check(ctx, b, pubK, \
+			EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC) != ENCOUNTER_OK)
+		return ctx->rc;
+
+	const struct ou_publickey *pk = &pubK->k.ou_pubK;
+	BN_CTX *bnctx = BN_CTX_new();
+	BN_CTX_start(bnctx);
+	BIGNUM *r = BN_CTX_get(bnctx);
+	BIGNUM *t = BN_CTX_get(bnctx);
+	BIGNUM *m = BN_CTX_get(bnctx);
+
+	memset(&d, 0, sizeof d);
+	d.version = ENCOUNTER_COUNT_OKAMOTO_UCHIYAMA_V1;
+	d.c = BN_new();
+	if (!m || !d.c) OPENSSL_ERROR(end);
+
+	/* r hides a - b and keeps a - b + r positive, far below p */
+	if (!BN_rand(r, PAILLIER_RANDOMIZER_SECLEVEL + 2, 0, 1))
+		OPENSSL_ERROR(end);
+
+	/* d = a b^-1 g^r, re-randomized */
+	if (!BN_mod_inverse(t, b->c, pk->n, bnctx)) OPENSSL_ERROR(end);
+	if (!BN_mod_mul(d.c, a->c, t, pk->n, bnctx)) OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_expmodBN(ctx, t, pk->g, r, pk->n, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (!BN_mod_mul(d.c, d.c, t, pk->n, bnctx)) OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_ou_rerandomize(ctx, d.c, pubK, \
+			bnctx) != ENCOUNTER_OK)
+		goto end;
+
+	if (encounter_crypto_openssl_ou_decryptBN(ctx, m, &d, privK, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	*result = BN_cmp(m, r);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (r)     BN_clear(r);
+	if (t)     BN_clear(t);
+	if (m)     BN_clear(m);
+	if (d.c)   BN_clear_free(d.c);
+	if (bnctx) BN_CTX_end(bnctx);
+	if (bnctx) BN_CTX_free(bnctx);
+
+	return ctx->rc;
+}
+
+/** The key components in hex form, into key: n, g and h, or p, q and g */
+encounter_err_t encounter_crypto_openssl_ou_numToString(encounter_t *ctx, \
+			ec_keyctx_t *keyctx, ec_keystring_t *key)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!keyctx || !key) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	switch (keyctx->type) {
+		case EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC:
+			key->k.ou_pubK.n = BN_bn2hex(keyctx->k.ou_pubK.n);
+			key->k.ou_pubK.g = BN_bn2hex(keyctx->k.ou_pubK.g);
+			key->k.ou_pubK.h = BN_bn2hex(keyctx->k.ou_pubK.h);
+
+			if (   key->k.ou_pubK.n \
+			    && key->k.ou_pubK.g \
+			    && key->k.ou_pubK.h)
+				ctx->rc = ENCOUNTER_OK;
+			else	ctx->rc = ENCOUNTER_ERR_CRYPTO;
+			break;
+
+		case EC_KEYTYPE_OKAMOTO_UCHIYAMA_PRIVATE:
+			key->k.ou_privK.p = BN_bn2hex(keyctx->k.ou_privK.p);
+			key->k.ou_privK.q = BN_bn2hex(keyctx->k.ou_privK.q);
+			key->k.ou_privK.g = BN_bn2hex(keyctx->k.ou_privK.g);
+
+			if (   key->k.ou_privK.p \
+			    && key->k.ou_privK.q \
+			    && key->k.ou_privK.g)
+				ctx->rc = ENCOUNTER_OK;
+			else	ctx->rc = ENCOUNTER_ERR_CRYPTO;
+			break;
+
+		default:
+			ctx->rc = ENCOUNTER_ERR_PARAM;
+			break;
+	}
+
+	return ctx->rc;
+}
+
+/** The key components of key into the fresh key context keyctx, p^2
+ * and the decryption constant derived again */
+encounter_err_t encounter_crypto_openssl_ou_stringToNum(encounter_t *ctx, \
+			ec_keystring_t *key, ec_keyctx_t *keyctx)
+{
+	struct ou_publickey *pk;
+	struct ou_privatekey *sk;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!key || !keyctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	BN_CTX *bnctx = BN_CTX_new();
+
+	if (!bnctx) OPENSSL_ERROR(end);
+
+	switch (keyctx->type) {
+		case EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC:
+			pk = &keyctx->k.ou_pubK;
+			if (   !key->k.ou_pubK.n || !key->k.ou_pubK.g \
+			    || !key->k.ou_pubK.h \
+			    || !BN_hex2bn(&pk->n, key->k.ou_pubK.n) \
+			    || !BN_hex2bn(&pk->g, key->k.ou_pubK.g) \
+			    || !BN_hex2bn(&pk->h, key->k.ou_pubK.h) \
+			    || BN_cmp(pk->n, BN_value_one()) <= 0 \
+			    || BN_is_zero(pk->g) || BN_is_zero(pk->h)) {
+				encounter_set_error(ctx, ENCOUNTER_ERR_DATA, \
+					"bad Okamoto-Uchiyama public-key");
+				goto end;
+			}
+			ctx->rc = ENCOUNTER_OK;
+			break;
+
+		case EC_KEYTYPE_OKAMOTO_UCHIYAMA_PRIVATE:
+			sk = &keyctx->k.ou_privK;
+			if (   !key->k.ou_privK.p || !key->k.ou_privK.q \
+			    || !key->k.ou_privK.g \
+			    || !BN_hex2bn(&sk->p, key->k.ou_privK.p) \
+			    || !BN_hex2bn(&sk->q, key->k.ou_privK.q) \
+			    || !BN_hex2bn(&sk->g, key->k.ou_privK.g) \
+			    || BN_cmp(sk->p, BN_value_one()) <= 0) {
+				encounter_set_error(ctx, ENCOUNTER_ERR_DATA, \
+					"bad Okamoto-Uchiyama private-key");
+				goto end;
+			}
+			if (!BN_sqr(sk->psquared, sk->p, bnctx))
+				OPENSSL_ERROR(end);
+			encounter_crypto_openssl_ou_gInv(ctx, sk->gpinv, \
+				sk->g, sk->p, sk->psquared, bnctx);
+			break;
+
+		default:
+			ctx->rc = ENCOUNTER_ERR_PARAM;
+			break;
+	}
+
+end:
+	if (bnctx) BN_CTX_free(bnctx);
+
+	return ctx->rc;
+}
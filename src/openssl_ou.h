@@ -0,0 +1,63 @@
+#ifndef _ENCOUNTER_CRYPTO_OPENSSL_OU_H_
+#define _ENCOUNTER_CRYPTO_OPENSSL_OU_H_
+
+#include <openssl/bn.h>
+
+#include "encounter_priv.h"
+
+
+/* Okamoto-Uchiyama: n = p^2 q, a counter of m is g^m h^r mod n with
+ * h = g^n, for plaintexts modulo p. The counters live modulo n, half
+ * the size of the Paillier ones for the same n. Decryption is
+ * L(c^(p-1) mod p^2) / L(g^(p-1) mod p^2) mod p, L(x) = (x - 1) / p.
+ * The key contexts are allocated and freed by openssl_drv.c, as the
+ * Paillier ones */
+
+/* Counters serialize as EC_OU_TAG and c in hex */
+#define EC_OU_TAG		"OU:"
+#define EC_OU_TAG_LEN		(sizeof EC_OU_TAG - 1)
+
+#define EC_IS_OU(k)		(__ENCOUNTER_IS_OU_KEYTYPE((k)->type))
+#define EC_IS_OU_COUNT(c) \
+		((c)->version == ENCOUNTER_COUNT_OKAMOTO_UCHIYAMA_V1)
+
+
+/* TODO use __BEGIN_DECLS */
+
+encounter_err_t encounter_crypto_openssl_ou_keygen(encounter_t *, \
+		const unsigned int, ec_keyctx_t *, ec_keyctx_t *);
+
+encounter_err_t encounter_crypto_openssl_ou_new_counter(encounter_t *, \
+					ec_keyctx_t *, ec_count_t *);
+
+encounter_err_t encounter_crypto_openssl_ou_update(encounter_t *, \
+	ec_count_t *, ec_keyctx_t *, const unsigned int, const bool);
+
+encounter_err_t encounter_crypto_openssl_ou_addsub(encounter_t *, \
+	ec_count_t *, const ec_count_t *, ec_keyctx_t *, const bool);
+
+encounter_err_t encounter_crypto_openssl_ou_mul(encounter_t *, \
+	ec_count_t *, ec_keyctx_t *, const unsigned int, const bool);
+
+encounter_err_t encounter_crypto_openssl_ou_linear_combination(\
+	encounter_t *, ec_count_t **, const unsigned int *, const size_t, \
+						ec_keyctx_t *, ec_count_t *);
+
+encounter_err_t encounter_crypto_openssl_ou_sum(encounter_t *, \
+	ec_count_t **, const size_t, ec_keyctx_t *, ec_count_t *, \
+			ec_keyctx_t *, unsigned long long int *);
+
+encounter_err_t encounter_crypto_openssl_ou_decryptBN(encounter_t *, \
+	BIGNUM *, const ec_count_t *, ec_keyctx_t *, BN_CTX *);
+
+encounter_err_t encounter_crypto_openssl_ou_private_cmp(encounter_t *, \
+	const ec_count_t *, const ec_count_t *, ec_keyctx_t *, \
+					ec_keyctx_t *, int *);
+
+encounter_err_t encounter_crypto_openssl_ou_numToString(encounter_t *, \
+				ec_keyctx_t *, ec_keystring_t *);
+
+encounter_err_t encounter_crypto_openssl_ou_stringToNum(encounter_t *, \
+				ec_keystring_t *, ec_keyctx_t *);
+
+#endif  /* _ENCOUNTER_CRYPTO_OPENSSL_OU_H_ */
@@ -0,0 +1,300 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <openssl/bn.h>
+#include <openssl/err.h>
+
+#include "encounter_priv.h"
+
+#include "openssl_drv.h"
+#include "openssl_pool.h"
+#include "openssl_ifma.h"
+
+#include "utils.h"
+
+
+/* Some static prototypes */
+static encounter_err_t encounter_crypto_openssl_pool_new(encounter_t *, \
+							ec_keyctx_t *);
+
+static void encounter_crypto_openssl_pool_destroy(struct ec_pool_s *);
+
+static ec_pool_kind_t encounter_crypto_openssl_pool_next(\
+						struct ec_pool_s *);
+
+static void *encounter_crypto_openssl_pool_refill(void *);
+
+
+
+static encounter_err_t encounter_crypto_openssl_pool_new(encounter_t *ctx,\
+							ec_keyctx_t *pubK)
+{
+	struct ec_pool_s *pool;
+	unsigned int i, k;
+
+	pool = calloc(1, sizeof *pool);
+	if (!pool) {
+		encounter_set_error(ctx, ENCOUNTER_ERR_MEM, "calloc: failed");
+		return ctx->rc;
+	}
+
+	pool->pubK = pubK;
+	pool->conf = ctx->conf;
+	pool->ring[EC_POOL_RANDOMIZER].depth = ctx->conf.pool_depth;
+	pool->ring[EC_POOL_ONE].depth = ctx->conf.pool_ones;
+
+	for (k = 0; k < EC_POOL_LAST; ++k) {
+		struct ec_ring_s *ring = &pool->ring[k];
+
+		if (!ring->depth) continue;
+		ring->v = calloc(ring->depth, sizeof *ring->v);
+		if (!ring->v) goto nomem;
+		for (i = 0; i < ring->depth; ++i)
+			if ((ring->v[i] = BN_new()) == NULL) goto nomem;
+	}
+
+	pool->threads = calloc(ctx->conf.pool_threads, sizeof *pool->threads);
+	if (!pool->threads) goto nomem;
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->notempty, NULL);
+	pthread_cond_init(&pool->notfull, NULL);
+
+	/* The refill threads wait for the lock until we are done here */
+	pthread_mutex_lock(&pool->lock);
+	for (i = 0; i < ctx->conf.pool_threads; ++i) {
+		if (pthread_create(&pool->threads[i], NULL, \
+			encounter_crypto_openssl_pool_refill, pool) != 0)
+			break;
+		pool->nthreads++;
+		pool->alive++;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	if (pool->nthreads == 0) {
+		encounter_crypto_openssl_pool_destroy(pool);
+		encounter_set_error(ctx, ENCOUNTER_ERR_OS, \
+				"pthread_create: failed");
+		return ctx->rc;
+	}
+
+	pubK->pool = pool;
+	ctx->rc = ENCOUNTER_OK;
+	return ctx->rc;
+
+nomem:
+	for (k = 0; k < EC_POOL_LAST; ++k) {
+		if (!pool->ring[k].v) continue;
+		for (i = 0; i < pool->ring[k].depth; ++i)
+			if (pool->ring[k].v[i]) BN_free(pool->ring[k].v[i]);
+		free(pool->ring[k].v);
+	}
+	free(pool->threads);
+	free(pool);
+	encounter_set_error(ctx, ENCOUNTER_ERR_MEM, "pool: out of memory");
+	return ctx->rc;
+}
+
+static void encounter_crypto_openssl_pool_destroy(struct ec_pool_s *pool)
+{
+	unsigned int i, k;
+
+	for (k = 0; k < EC_POOL_LAST; ++k) {
+		for (i = 0; i < pool->ring[k].depth; ++i)
+			BN_clear_free(pool->ring[k].v[i]);
+		free(pool->ring[k].v);
+	}
+
+	pthread_cond_destroy(&pool->notfull);
+	pthread_cond_destroy(&pool->notempty);
+	pthread_mutex_destroy(&pool->lock);
+
+	free(pool->threads);
+	memset(pool, 0, sizeof *pool);
+	free(pool);
+}
+
+/* Pick the ring to refill next, the emptiest first.
+ * Called with the pool lock held. */
+static ec_pool_kind_t encounter_crypto_openssl_pool_next(\
+						struct ec_pool_s *pool)
+{
+	ec_pool_kind_t k, next = EC_POOL_LAST;
+	unsigned long fill, best = 0;
+
+	for (k = 0; k < EC_POOL_LAST; ++k) {
+		struct ec_ring_s *ring = &pool->ring[k];
+
+		if (ring->count + ring->pending >= ring->depth) continue;
+
+		fill = ((unsigned long) (ring->count + ring->pending) << 16) \
+								/ ring->depth;
+		if (next == EC_POOL_LAST || fill < best) {
+			next = k;
+			best = fill;
+		}
+	}
+
+	return next;
+}
+
+/* The refill threads compute as many values at once as the multi-buffer
+ * exponentiations of the key take, within the room left in the ring */
+static void *encounter_crypto_openssl_pool_refill(void *arg)
+{
+	struct ec_pool_s *pool = arg;
+	struct ec_ring_s *ring;
+	encounter_t wctx;	/* Private error reporting */
+	ec_pool_kind_t k;
+	BIGNUM *v[EC_IFMA_LANES], **slot, *swap;
+	BN_CTX *bnctx = BN_CTX_new();
+	size_t lanes, run, i;
+	bool ok;
+
+	memset(&wctx, 0, sizeof wctx);
+	wctx.conf = pool->conf;
+	lanes = encounter_crypto_openssl_expmod_lanes(&wctx, pool->pubK, \
+							EC_MOD_NSQUARED);
+	for (ok = (bnctx != NULL), i = 0; i < lanes; ++i)
+		if ((v[i] = BN_new()) == NULL) ok = false;
+
+	pthread_mutex_lock(&pool->lock);
+	if (!ok) goto end;
+
+	while (!pool->stop) {
+		k = encounter_crypto_openssl_pool_next(pool);
+		if (k == EC_POOL_LAST) {
+			pthread_cond_wait(&pool->notfull, &pool->lock);
+			continue;
+		}
+
+		ring = &pool->ring[k];
+		run = ring->depth - ring->count - ring->pending;
+		if (run > lanes) run = lanes;
+		ring->pending += run;
+		pthread_mutex_unlock(&pool->lock);
+
+		/* The expensive part runs unlocked */
+		ok = encounter_crypto_openssl_new_randomizers(&wctx, v, run, \
+				pool->pubK, bnctx) == ENCOUNTER_OK;
+		for (i = 0; ok && k == EC_POOL_ONE && i < run; ++i)
+			ok = encounter_crypto_openssl_mulmod(&wctx, v[i], v[i],\
+				pool->pubK->k.paillier_pubK.g, pool->pubK, \
+				EC_MOD_NSQUARED, bnctx) == ENCOUNTER_OK;
+
+		pthread_mutex_lock(&pool->lock);
+		ring->pending -= run;
+		if (!ok) break;
+
+		/* Swap the fresh values into the first free slots */
+		for (i = 0; i < run; ++i) {
+			slot = &ring->v[(ring->head + ring->count) \
+							% ring->depth];
+			swap = *slot; *slot = v[i]; v[i] = swap;
+			ring->count++;
+		}
+
+		pthread_cond_broadcast(&pool->notempty);
+	}
+
+end:
+	/* Waiters fall back on the inline computation once we are gone */
+	pool->alive--;
+	pthread_cond_broadcast(&pool->notempty);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < lanes; ++i)
+		if (v[i]) BN_clear_free(v[i]);
+	if (bnctx) BN_CTX_free(bnctx);
+
+	return NULL;
+}
+
+/** Take a precomputed quantity of the given kind from the pool of the
+ * supplied public-key, starting the pool on first use. *got is false
+ * when the pool is disabled or ran dry, and the caller has to compute
+ * the quantity inline. */
+encounter_err_t encounter_crypto_openssl_pool_get(encounter_t *ctx, \
+		ec_keyctx_t *pubK, const ec_pool_kind_t kind, BIGNUM *v, \
+								bool *got)
+{
+	struct ec_pool_s *pool;
+	struct ec_ring_s *ring;
+	BIGNUM **slot;
+
+	if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!pubK || !v || !got || kind >= EC_POOL_LAST) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	*got = false;
+	ctx->rc = ENCOUNTER_OK;
+
+	pthread_mutex_lock(&pubK->lock);
+	if (!pubK->pool && (ctx->conf.pool_depth || ctx->conf.pool_ones))
+		encounter_crypto_openssl_pool_new(ctx, pubK);
+	pool = pubK->pool;
+	pthread_mutex_unlock(&pubK->lock);
+
+	if (!pool) return ctx->rc;
+
+	ring = &pool->ring[kind];
+
+	pthread_mutex_lock(&pool->lock);
+	if (ring->depth) {
+		while (!ring->count && pool->alive \
+		     && ctx->conf.pool_dry == EC_POOL_DRY_WAIT)
+			pthread_cond_wait(&pool->notempty, &pool->lock);
+
+		if (ring->count) {
+			slot = &ring->v[ring->head];
+			*got = (BN_copy(v, *slot) != NULL);
+			BN_clear(*slot);
+
+			ring->head = (ring->head + 1) % ring->depth;
+			ring->count--;
+			pthread_cond_signal(&pool->notfull);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return ctx->rc;
+}
+
+/** Stop the refill threads and dispose the pool of the supplied key */
+encounter_err_t encounter_crypto_openssl_pool_free(encounter_t *ctx, \
+							ec_keyctx_t *keyctx)
+{
+	struct ec_pool_s *pool;
+	unsigned int i;
+
+	if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!keyctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	pool = keyctx->pool;
+	keyctx->pool = NULL;
+
+	if (pool) {
+		pthread_mutex_lock(&pool->lock);
+		pool->stop = true;
+		pthread_cond_broadcast(&pool->notfull);
+		pthread_cond_broadcast(&pool->notempty);
+		pthread_mutex_unlock(&pool->lock);
+
+		for (i = 0; i < pool->nthreads; ++i)
+			pthread_join(pool->threads[i], NULL);
+
+		encounter_crypto_openssl_pool_destroy(pool);
+	}
+
+	ctx->rc = ENCOUNTER_OK;
+	return ctx->rc;
+}
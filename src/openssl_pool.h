@@ -0,0 +1,54 @@
+#ifndef _ENCOUNTER_CRYPTO_OPENSSL_POOL_H_
+#define _ENCOUNTER_CRYPTO_OPENSSL_POOL_H_
+
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <openssl/bn.h>
+
+#include "encounter_priv.h"
+
+
+/* Kinds of precomputed quantities */
+typedef enum {
+	EC_POOL_RANDOMIZER,	/* r^n mod n^2, Montgomery form */
+	EC_POOL_ONE,		/* E(1) = g r^n mod n^2, Montgomery form */
+	EC_POOL_LAST
+} ec_pool_kind_t;
+
+/* Ring of precomputed quantities */
+struct ec_ring_s {
+	BIGNUM		**v;		/* depth preallocated slots */
+	unsigned int	depth;		/* 0 if disabled */
+	unsigned int	head;		/* Oldest ready value */
+	unsigned int	count;		/* Ready values */
+	unsigned int	pending;	/* Values being computed */
+};
+
+/* Per public-key pool of precomputed quantities, refilled in the
+ * background by its own threads */
+struct ec_pool_s {
+	pthread_mutex_t	lock;
+	pthread_cond_t	notempty;	/* Signalled on refill */
+	pthread_cond_t	notfull;	/* Signalled on consumption */
+
+	struct ec_ring_s ring[EC_POOL_LAST];
+
+	ec_keyctx_t	*pubK;		/* The owner */
+	encounter_conf_t conf;		/* Of the creating context */
+	pthread_t	*threads;
+	unsigned int	nthreads;
+	unsigned int	alive;		/* Refill threads still running */
+	bool		stop;
+};
+
+
+/* TODO use __BEGIN_DECLS */
+
+encounter_err_t encounter_crypto_openssl_pool_get(encounter_t *, \
+	ec_keyctx_t *, const ec_pool_kind_t, BIGNUM *, bool *);
+
+encounter_err_t encounter_crypto_openssl_pool_free(encounter_t *, \
+							ec_keyctx_t *);
+
+#endif  /* _ENCOUNTER_CRYPTO_OPENSSL_POOL_H_ */
@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <openssl/bn.h>
+#include <openssl/err.h>
+#include <openssl/crypto.h>
+
+#include "encounter_priv.h"
+
+#include "openssl_drv.h"
+#include "openssl_subgroup.h"
+#include "openssl_drbg.h"
+
+#include "utils.h"
+
+
+/* Some static prototypes */
+static encounter_err_t encounter_crypto_openssl_subgroup_hConstant(\
+	encounter_t *, BIGNUM *, const BIGNUM *, const BIGNUM *, \
+		const BIGNUM *, const BIGNUM *, BN_CTX *);
+
+static encounter_err_t encounter_crypto_openssl_subgroup_gn(encounter_t *, \
+				struct paillier_publickey *, BN_CTX *);
+
+
+
+/** r = L_p(g^alpha mod p^2)^-1 mod p, the decryption constant of the
+ * subgroup keys. Fails when the order of g mod p^2 is prime to p */
+static encounter_err_t encounter_crypto_openssl_subgroup_hConstant(\
+	encounter_t *ctx, BIGNUM *r, const BIGNUM *g, const BIGNUM *alpha, \
+		const BIGNUM *p, const BIGNUM *psquared, BN_CTX *bnctx)
+{
+	BN_CTX_start(bnctx);
+	BIGNUM *t = BN_CTX_get(bnctx);
+
+	if (!t) OPENSSL_ERROR(end);
+
+	if (!BN_nnmod(t, g, psquared, bnctx)) OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_expmodBN(ctx, t, t, alpha, \
+		psquared, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (!BN_sub_word(t, 1)) OPENSSL_ERROR(end);
+	if (!BN_div(t, NULL, t, p, bnctx)) OPENSSL_ERROR(end);
+	if (!BN_nnmod(t, t, p, bnctx)) OPENSSL_ERROR(end);
+
+	if (BN_is_zero(t)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_DATA, \
+                        "bad Paillier subgroup generator");
+		goto end;
+	}
+	if (!BN_mod_inverse(r, t, p, bnctx)) OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (t) BN_clear(t);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** g^n mod n^2, the base of the randomizers */
+static encounter_err_t encounter_crypto_openssl_subgroup_gn(\
+	encounter_t *ctx, struct paillier_publickey *pk, BN_CTX *bnctx)
+{
+	if (!pk->gn && (pk->gn = BN_new()) == NULL) OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_expmodBN(ctx, pk->gn, pk->g, pk->n, \
+		pk->nsquared, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	return ctx->rc;
+}
+
+/** p and q of keysize bits with p = 1 mod 2 alpha_p and q = 1 mod 2
+ * alpha_q, for two distinct primes alpha_p and alpha_q of half of
+ * PAILLIER_SUBGROUP_ALPHABITS bits. Sets p, q and alpha. The progress of
+ * alpha_p and p goes to kg as prime 0, that of alpha_q and q as prime 1 */
+encounter_err_t encounter_crypto_openssl_subgroup_primes(encounter_t *ctx, \
+	const unsigned int keysize, ec_keyctx_t *privK, \
+			struct ec_keygen_s *kg, BN_CTX *bnctx)
+{
+	struct paillier_privatekey *sk;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!privK || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	sk = &privK->k.paillier_privK;
+	BN_CTX_start(bnctx);
+	BIGNUM *alphap = BN_CTX_get(bnctx);
+	BIGNUM *alphaq = BN_CTX_get(bnctx);
+	BIGNUM *add = BN_CTX_get(bnctx);
+
+	if (!add) OPENSSL_ERROR(end);
+	if (!sk->alpha && (sk->alpha = BN_new()) == NULL) OPENSSL_ERROR(end);
+
+	if (encounter_crypto_openssl_genprime(ctx, kg, alphap, \
+		PAILLIER_SUBGROUP_ALPHABITS / 2, NULL, NULL, 0) != ENCOUNTER_OK)
+		goto end;
+	do {
+		if (encounter_crypto_openssl_genprime(ctx, kg, alphaq, \
+			PAILLIER_SUBGROUP_ALPHABITS / 2, NULL, NULL, 1) \
+				!= ENCOUNTER_OK)
+			goto end;
+	} while (!BN_cmp(alphap, alphaq));
+
+	/* p = 1 mod 2 alpha_p */
+	if (!BN_lshift1(add, alphap)) OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_genprime(ctx, kg, sk->p, keysize, add, \
+			BN_value_one(), 0) != ENCOUNTER_OK)
+		goto end;
+
+	/* q = 1 mod 2 alpha_q */
+	if (!BN_lshift1(add, alphaq)) OPENSSL_ERROR(end);
+	do {
+		if (encounter_crypto_openssl_genprime(ctx, kg, sk->q, \
+			keysize, add, BN_value_one(), 1) != ENCOUNTER_OK)
+			goto end;
+	} while (!BN_cmp(sk->p, sk->q));
+
+	if (!BN_mul(sk->alpha, alphap, alphaq, bnctx)) OPENSSL_ERROR(end);
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (alphap) BN_clear(alphap);
+	if (alphaq) BN_clear(alphaq);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** g = x^((p-1)(q-1)/alpha) mod n^2 for a random x, of order alpha n:
+ * g is no 1 mod p nor mod q, and neither L_p(g^alpha mod p^2) nor
+ * L_q(g^alpha mod q^2) vanishes. Sets g and g^n in the public-key, h_p
+ * and h_q in the private one. Wants p, q, their squares, alpha, n and
+ * n^2 */
+encounter_err_t encounter_crypto_openssl_subgroup_generator(\
+	encounter_t *ctx, ec_keyctx_t *pubK, ec_keyctx_t *privK, BN_CTX *bnctx)
+{
+	struct paillier_publickey *pk;
+	struct paillier_privatekey *sk;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!pubK || !privK || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	pk = &pubK->k.paillier_pubK;
+	sk = &privK->k.paillier_privK;
+	BN_CTX_start(bnctx);
+	BIGNUM *e = BN_CTX_get(bnctx);
+	BIGNUM *t = BN_CTX_get(bnctx);
+
+	if (!t) OPENSSL_ERROR(end);
+
+	/* e = (p-1)(q-1) / alpha */
+	if (!BN_sub(e, sk->p, BN_value_one())) OPENSSL_ERROR(end);
+	if (!BN_sub(t, sk->q, BN_value_one())) OPENSSL_ERROR(end);
+	if (!BN_mul(e, e, t, bnctx)) OPENSSL_ERROR(end);
+	if (!BN_div(e, t, e, sk->alpha, bnctx)) OPENSSL_ERROR(end);
+	if (!BN_is_zero(t)) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "alpha does not divide (p-1)(q-1)");
+		goto end;
+	}
+
+	for (;;) {
+		if (!BN_rand_range(t, pk->nsquared)) OPENSSL_ERROR(end);
+		if (!BN_gcd(pk->g, t, pk->n, bnctx)) OPENSSL_ERROR(end);
+		if (!BN_is_one(pk->g)) continue;
+
+		if (encounter_crypto_openssl_expmodBN(ctx, pk->g, t, e, \
+			pk->nsquared, bnctx) \
+				!= ENCOUNTER_OK)
+			goto end;
+
+		/* Order alpha_p mod p, alpha_q mod q */
+		if (!BN_mod(t, pk->g, sk->p, bnctx)) OPENSSL_ERROR(end);
+		if (BN_is_one(t)) continue;
+		if (!BN_mod(t, pk->g, sk->q, bnctx)) OPENSSL_ERROR(end);
+		if (BN_is_one(t)) continue;
+
+		/* and divisible by p mod p^2, q mod q^2 */
+		if (encounter_crypto_openssl_subgroup_hConstant(ctx, \
+			sk->hsubp, pk->g, sk->alpha, sk->p, sk->psquared, \
+				bnctx) != ENCOUNTER_OK) {
+			if (ctx->rc != ENCOUNTER_ERR_DATA) goto end;
+			continue;
+		}
+		if (encounter_crypto_openssl_subgroup_hConstant(ctx, \
+			sk->hsubq, pk->g, sk->alpha, sk->q, sk->qsquared, \
+				bnctx) == ENCOUNTER_OK)
+			break;
+		if (ctx->rc != ENCOUNTER_ERR_DATA) goto end;
+	}
+
+	pk->alphabits = BN_num_bits(sk->alpha);
+	if (encounter_crypto_openssl_subgroup_gn(ctx, pk, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (e) BN_clear(e);
+	if (t) BN_clear(t);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** Complete the freshly loaded Paillier fields of a subgroup key from its
+ * extra key string: the bits of alpha in decimal for a public-key, then
+ * g^n computed, alpha in hex for a private one */
+encounter_err_t encounter_crypto_openssl_subgroup_extend(encounter_t *ctx, \
+		ec_keyctx_t *key, const char *str, BN_CTX *bnctx)
+{
+	struct paillier_publickey *pk;
+	struct paillier_privatekey *sk;
+	unsigned long bits;
+	char *endp = NULL;
+
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!key || !bnctx) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+	if (!str) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_DATA, \
+                        "missing Paillier subgroup parameter");
+                return ctx->rc;
+	}
+
+	switch (key->type) {
+		case EC_KEYTYPE_PAILLIER_SUBGROUP_PUBLIC:
+			pk = &key->k.paillier_pubK;
+			bits = strtoul(str, &endp, 10);
+			if (endp == str || !bits \
+			    || bits >= (unsigned long) BN_num_bits(pk->n)) {
+				encounter_set_error(ctx, ENCOUNTER_ERR_DATA, \
+					"bad Paillier subgroup order size");
+				break;
+			}
+			pk->alphabits = bits;
+			encounter_crypto_openssl_subgroup_gn(ctx, pk, bnctx);
+			break;
+
+		case EC_KEYTYPE_PAILLIER_SUBGROUP_PRIVATE:
+			sk = &key->k.paillier_privK;
+			if (!BN_hex2bn(&sk->alpha, str) || BN_is_zero(sk->alpha)) {
+				encounter_set_error(ctx, ENCOUNTER_ERR_DATA, \
+					"bad Paillier subgroup order");
+				break;
+			}
+			ctx->rc = ENCOUNTER_OK;
+			break;
+
+		default:
+                	encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        	"not a Paillier subgroup key");
+			break;
+	}
+
+	return ctx->rc;
+}
+
+/** (g^n)^r mod n^2 in standard form, for a fresh r of as many bits as
+ * alpha: an exponent of PAILLIER_SUBGROUP_ALPHABITS in place of the
+ * bits of n for r^n */
+encounter_err_t encounter_crypto_openssl_subgroup_rtothen(encounter_t *ctx,\
+		BIGNUM *rn, ec_keyctx_t *pubK, BN_CTX *bnctx)
+{
+        if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!rn || !pubK || !bnctx || !pubK->k.paillier_pubK.gn) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	BN_CTX_start(bnctx);
+	BIGNUM *r = BN_CTX_get(bnctx);
+
+	if (!r) OPENSSL_ERROR(end);
+	if (encounter_crypto_openssl_drbg_bits(ctx, r, \
+		pubK->k.paillier_pubK.alphabits) != ENCOUNTER_OK)
+		goto end;
+
+	if (encounter_crypto_openssl_expmod(ctx, rn, \
+		pubK->k.paillier_pubK.gn, r, pubK, EC_MOD_NSQUARED, bnctx) \
+			!= ENCOUNTER_OK)
+		goto end;
+
+	ctx->rc = ENCOUNTER_OK;
+
+end:
+	if (r)     BN_clear(r);
+	BN_CTX_end(bnctx);
+
+	return ctx->rc;
+}
+
+/** The extra key string of a subgroup key, freed with OPENSSL_free() as
+ * the other key strings: the bits of alpha in decimal for a public-key,
+ * alpha in hex for a private one */
+char *encounter_crypto_openssl_subgroup_toString(const ec_keyctx_t *key)
+{
+	char *str = NULL;
+
+	if (EC_IS_SUBGROUP_PUBLIC(key)) {
+		if ((str = OPENSSL_malloc(16)) != NULL)
+			snprintf(str, 16, "%u", key->k.paillier_pubK.alphabits);
+	} else if (EC_IS_SUBGROUP_PRIVATE(key) && key->k.paillier_privK.alpha)
+		str = BN_bn2hex(key->k.paillier_privK.alpha);
+
+	return str;
+}
@@ -0,0 +1,44 @@
+#ifndef _ENCOUNTER_CRYPTO_OPENSSL_SUBGROUP_H_
+#define _ENCOUNTER_CRYPTO_OPENSSL_SUBGROUP_H_
+
+#include <openssl/bn.h>
+
+#include "encounter_priv.h"
+
+
+/* Paillier subgroup keys (Paillier's Scheme 3) are Paillier keys whose g
+ * has order alpha n mod n^2, alpha = alpha_p alpha_q the product of two
+ * small primes with alpha_p | p-1 and alpha_q | q-1. A counter of m is
+ * g^m (g^n)^r mod n^2 for a short r, and decrypts with the exponent
+ * alpha in place of p-1 and q-1: L_p(c^alpha mod p^2) h_p mod p, with
+ * h_p = L_p(g^alpha mod p^2)^-1. The counters are Paillier ones, the
+ * key contexts are allocated and freed by openssl_drv.c */
+
+/* Bits of alpha, half of them for each of alpha_p and alpha_q */
+#define PAILLIER_SUBGROUP_ALPHABITS	320
+
+struct ec_keygen_s;	/* Forward decl., see openssl_drv.h */
+
+#define EC_IS_SUBGROUP_PUBLIC(k) \
+		((k)->type == EC_KEYTYPE_PAILLIER_SUBGROUP_PUBLIC)
+#define EC_IS_SUBGROUP_PRIVATE(k) \
+		((k)->type == EC_KEYTYPE_PAILLIER_SUBGROUP_PRIVATE)
+
+
+/* TODO use __BEGIN_DECLS */
+
+encounter_err_t encounter_crypto_openssl_subgroup_primes(encounter_t *, \
+	const unsigned int, ec_keyctx_t *, struct ec_keygen_s *, BN_CTX *);
+
+encounter_err_t encounter_crypto_openssl_subgroup_generator(\
+	encounter_t *, ec_keyctx_t *, ec_keyctx_t *, BN_CTX *);
+
+encounter_err_t encounter_crypto_openssl_subgroup_extend(encounter_t *, \
+			ec_keyctx_t *, const char *, BN_CTX *);
+
+encounter_err_t encounter_crypto_openssl_subgroup_rtothen(encounter_t *, \
+			BIGNUM *, ec_keyctx_t *, BN_CTX *);
+
+char *encounter_crypto_openssl_subgroup_toString(const ec_keyctx_t *);
+
+#endif  /* _ENCOUNTER_CRYPTO_OPENSSL_SUBGROUP_H_ */
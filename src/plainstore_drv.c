@@ -9,6 +9,10 @@
 #include "utils.h"
 
 #define ENCOUNTER_STORE_PLAIN_MAXLINE   1024+16384
+#define ENCOUNTER_STORE_PLAIN_ECTAG_LEN (sizeof ENCOUNTER_ECELGAMAL_KEYTAG - 1)
+#define ENCOUNTER_STORE_PLAIN_OUTAG_LEN (sizeof ENCOUNTER_OU_KEYTAG - 1)
+#define ENCOUNTER_STORE_PLAIN_SGTAG_LEN (sizeof ENCOUNTER_SUBGROUP_KEYTAG - 1)
+#define ENCOUNTER_STORE_PLAIN_N1TAG_LEN (sizeof ENCOUNTER_NPLUS1_KEYTAG - 1)
 
 encounter_err_t encounter_plain_storekey(encounter_t *ctx, \
 			ec_keyctx_t *keyctx, const char *path)
@@ -28,18 +32,40 @@ encounter_err_t encounter_plain_storekey(encounter_t *ctx, \
 
 	/* Write the key components in the plaintext keyset */
 	switch (key->type) {
+		case EC_KEYTYPE_PAILLIER_NPLUS1_PUBLIC:
+			keyfile = fopen(path, "wb");
+			if (!keyfile) goto end;
+
+			/* g = n+1 and n^2 derive from n */
+			fprintf(keyfile, ENCOUNTER_NPLUS1_KEYTAG "%s\n", \
+						key->k.paillier_pubK.n);
+
+			ctx->rc = ENCOUNTER_OK;
+			break;
+
 		case EC_KEYTYPE_PAILLIER_PUBLIC:
+		case EC_KEYTYPE_DAMGARD_JURIK_PUBLIC:
+		case EC_KEYTYPE_PAILLIER_SUBGROUP_PUBLIC:
 			keyfile = fopen(path, "wb");
 			if (!keyfile) goto end;
 
 			fprintf(keyfile, "%s\n", key->k.paillier_pubK.n);
 			fprintf(keyfile, "%s\n", key->k.paillier_pubK.g);
 			fprintf(keyfile, "%s\n", key->k.paillier_pubK.nsquared);
+			/* The Damgard-Jurik degree, last */
+			if (key->k.paillier_pubK.s)
+				fprintf(keyfile, "%s\n", key->k.paillier_pubK.s);
+			/* or the subgroup tag and the bits of alpha */
+			if (key->k.paillier_pubK.alphabits)
+				fprintf(keyfile, ENCOUNTER_SUBGROUP_KEYTAG "%s\n",\
+					key->k.paillier_pubK.alphabits);
 
 			ctx->rc = ENCOUNTER_OK;
 			break;
 
 		case EC_KEYTYPE_PAILLIER_PRIVATE:
+		case EC_KEYTYPE_DAMGARD_JURIK_PRIVATE:
+		case EC_KEYTYPE_PAILLIER_SUBGROUP_PRIVATE:
 			keyfile = fopen(path, "wb");
 			if (!keyfile) goto end;
 
@@ -52,7 +78,57 @@ encounter_err_t encounter_plain_storekey(encounter_t *ctx, \
 			fprintf(keyfile, "%s\n", key->k.paillier_privK.hsubp);
 			fprintf(keyfile, "%s\n", key->k.paillier_privK.hsubq);
 			fprintf(keyfile, "%s\n", key->k.paillier_privK.qInv);
+			if (key->k.paillier_privK.s)
+				fprintf(keyfile, "%s\n", key->k.paillier_privK.s);
+			if (key->k.paillier_privK.alpha)
+				fprintf(keyfile, ENCOUNTER_SUBGROUP_KEYTAG "%s\n",\
+					key->k.paillier_privK.alpha);
+
+			ctx->rc = ENCOUNTER_OK;
+			break;
 
+		case EC_KEYTYPE_ECELGAMAL_PUBLIC:
+			keyfile = fopen(path, "wb");
+			if (!keyfile) goto end;
+
+			fprintf(keyfile, ENCOUNTER_ECELGAMAL_KEYTAG "%s\n", \
+						key->k.ecelgamal_pubK.curve);
+			fprintf(keyfile, "%s\n", key->k.ecelgamal_pubK.h);
+
+			ctx->rc = ENCOUNTER_OK;
+			break;
+
+		case EC_KEYTYPE_ECELGAMAL_PRIVATE:
+			keyfile = fopen(path, "wb");
+			if (!keyfile) goto end;
+
+			fprintf(keyfile, ENCOUNTER_ECELGAMAL_KEYTAG "%s\n", \
+						key->k.ecelgamal_privK.curve);
+			fprintf(keyfile, "%s\n", key->k.ecelgamal_privK.x);
+
+			ctx->rc = ENCOUNTER_OK;
+			break;
+
+		case EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC:
+			keyfile = fopen(path, "wb");
+			if (!keyfile) goto end;
+
+			fprintf(keyfile, ENCOUNTER_OU_KEYTAG "%s\n", \
+						key->k.ou_pubK.n);
+			fprintf(keyfile, "%s\n", key->k.ou_pubK.g);
+			fprintf(keyfile, "%s\n", key->k.ou_pubK.h);
+
+			ctx->rc = ENCOUNTER_OK;
+			break;
+
+		case EC_KEYTYPE_OKAMOTO_UCHIYAMA_PRIVATE:
+			keyfile = fopen(path, "wb");
+			if (!keyfile) goto end;
+
+			fprintf(keyfile, ENCOUNTER_OU_KEYTAG "%s\n", \
+						key->k.ou_privK.p);
+			fprintf(keyfile, "%s\n", key->k.ou_privK.q);
+			fprintf(keyfile, "%s\n", key->k.ou_privK.g);
 
 			ctx->rc = ENCOUNTER_OK;
 			break;
@@ -72,9 +148,42 @@ end:
 	return ctx->rc;
 }
 
+/** Reads what follows the fields of a Paillier key: the degree of a
+ * Damgard-Jurik key, in decimal, or the tag and value of a subgroup one.
+ * Blank lines are skipped; any other line is an error */
+static encounter_err_t encounter_plain_keyExtension(encounter_t *ctx, \
+		FILE *keyfile, char *line, char **degree, char **tagged)
+{
+	size_t digits;
+
+	while (fgets(line, ENCOUNTER_STORE_PLAIN_MAXLINE, keyfile)) {
+		if (!line[strspn(line, " \t\r\n")])
+			continue;
+
+		if (!strncmp(line, ENCOUNTER_SUBGROUP_KEYTAG, \
+				ENCOUNTER_STORE_PLAIN_SGTAG_LEN)) {
+			*tagged = strdup(line + ENCOUNTER_STORE_PLAIN_SGTAG_LEN);
+			break;
+		}
+		digits = strspn(line, "0123456789");
+		if (digits && !line[digits + strspn(line + digits, " \t\r\n")]) {
+			*degree = strdup(line);
+			break;
+		}
+
+		encounter_set_error(ctx, ENCOUNTER_ERR_DATA, \
+			"unexpected line past the key");
+		return ctx->rc;
+	}
+
+	return ENCOUNTER_OK;
+}
+
 encounter_err_t encounter_plain_loadPublicKey(encounter_t *ctx, \
 			const char *path, ec_keyctx_t **keyctx) 
 {
+	encounter_err_t rc;
+
 	if (!ctx)       return ENCOUNTER_ERR_PARAM;
 	if (!path || !keyctx) {
                 encounter_set_error(ctx, ENCOUNTER_ERR_PARAM,\
@@ -97,8 +206,63 @@ encounter_err_t encounter_plain_loadPublicKey(encounter_t *ctx, \
 	/* Set the key-type */
 	key->type = EC_KEYTYPE_PAILLIER_PUBLIC;
 
+	/* An EC-ElGamal key opens with its tag and curve, then h */
+	if (fgets(line, ENCOUNTER_STORE_PLAIN_MAXLINE, keyfile) \
+	    && !strncmp(line, ENCOUNTER_ECELGAMAL_KEYTAG, \
+				ENCOUNTER_STORE_PLAIN_ECTAG_LEN)) {
+		key->type = EC_KEYTYPE_ECELGAMAL_PUBLIC;
+		key->k.ecelgamal_pubK.curve = \
+			strdup(line + ENCOUNTER_STORE_PLAIN_ECTAG_LEN);
+
+		if (fgets(line, ENCOUNTER_STORE_PLAIN_MAXLINE, keyfile))
+			key->k.ecelgamal_pubK.h = strdup(line);
+
+		if (key->k.ecelgamal_pubK.curve && key->k.ecelgamal_pubK.h)
+			ctx->rc = D.stringToNum(ctx, key, keyctx);
+		else 
+			encounter_set_error(ctx, ENCOUNTER_ERR_OS, \
+			   "unable to read the required parameters");
+		goto end;
+	}
+
+	/* An Okamoto-Uchiyama key opens with its tag and n, then g, h */
+	if (!strncmp(line, ENCOUNTER_OU_KEYTAG, \
+				ENCOUNTER_STORE_PLAIN_OUTAG_LEN)) {
+		key->type = EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC;
+		key->k.ou_pubK.n = \
+			strdup(line + ENCOUNTER_STORE_PLAIN_OUTAG_LEN);
+
+		if (fgets(line, ENCOUNTER_STORE_PLAIN_MAXLINE, keyfile))
+			key->k.ou_pubK.g = strdup(line);
+
+		if (fgets(line, ENCOUNTER_STORE_PLAIN_MAXLINE, keyfile))
+			key->k.ou_pubK.h = strdup(line);
+
+		if (key->k.ou_pubK.n && key->k.ou_pubK.g && key->k.ou_pubK.h)
+			ctx->rc = D.stringToNum(ctx, key, keyctx);
+		else 
+			encounter_set_error(ctx, ENCOUNTER_ERR_OS, \
+			   "unable to read the required parameters");
+		goto end;
+	}
+
+	/* A Paillier key with g = n+1 holds its tag and n alone */
+	if (!strncmp(line, ENCOUNTER_NPLUS1_KEYTAG, \
+				ENCOUNTER_STORE_PLAIN_N1TAG_LEN)) {
+		key->type = EC_KEYTYPE_PAILLIER_NPLUS1_PUBLIC;
+		key->k.paillier_pubK.n = \
+			strdup(line + ENCOUNTER_STORE_PLAIN_N1TAG_LEN);
+
+		if (key->k.paillier_pubK.n)
+			ctx->rc = D.stringToNum(ctx, key, keyctx);
+		else 
+			encounter_set_error(ctx, ENCOUNTER_ERR_OS, \
+			   "unable to read the required parameters");
+		goto end;
+	}
+
 	/* Read, in the following order, n, g, and nsquared */
-	if (fgets(line, ENCOUNTER_STORE_PLAIN_MAXLINE, keyfile))
+	if (*line)
 		key->k.paillier_pubK.n = strdup(line);
 	
 	if (fgets(line, ENCOUNTER_STORE_PLAIN_MAXLINE, keyfile))
@@ -107,6 +271,16 @@ encounter_err_t encounter_plain_loadPublicKey(encounter_t *ctx, \
 	if (fgets(line, ENCOUNTER_STORE_PLAIN_MAXLINE, keyfile))
 		key->k.paillier_pubK.nsquared = strdup(line);
 
+	/* A Damgard-Jurik key goes on with its degree, a subgroup one with
+	 * its tag and the bits of alpha */
+	if (encounter_plain_keyExtension(ctx, keyfile, line, \
+		&key->k.paillier_pubK.s, &key->k.paillier_pubK.alphabits) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (key->k.paillier_pubK.alphabits)
+		key->type = EC_KEYTYPE_PAILLIER_SUBGROUP_PUBLIC;
+	if (key->k.paillier_pubK.s)
+		key->type = EC_KEYTYPE_DAMGARD_JURIK_PUBLIC;
 
 	if (    key->k.paillier_pubK.n \
 	     && key->k.paillier_pubK.g \
@@ -118,18 +292,22 @@ encounter_err_t encounter_plain_loadPublicKey(encounter_t *ctx, \
 		   "unable to read the required parameters");
 
 end:
-	/* Okay, dispose temp resources, if any */
+	/* Okay, dispose temp resources, if any, keeping the outcome */
+	rc = ctx->rc;
 	if (key) D.dispose_keystring(ctx, key);
 	if (line) free(line);
 	if (keyfile) fclose(keyfile);
 
 	/* We are done */
+	ctx->rc = rc;
 	return ctx->rc;
 }
 
 encounter_err_t encounter_plain_loadPrivKey(encounter_t *ctx, \
 	const char *path, const char *passphrase, ec_keyctx_t **keyctx)
 {
+	encounter_err_t rc;
+
         if (!ctx)       return ENCOUNTER_ERR_PARAM;
 	if (!path || !keyctx) {
                 encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
@@ -152,10 +330,51 @@ encounter_err_t encounter_plain_loadPrivKey(encounter_t *ctx, \
 	/* Set the key-type */
 	key->type = EC_KEYTYPE_PAILLIER_PRIVATE;
 
+	/* An EC-ElGamal key opens with its tag and curve, then x */
+	if (fgets(line, ENCOUNTER_STORE_PLAIN_MAXLINE, keyfile) \
+	    && !strncmp(line, ENCOUNTER_ECELGAMAL_KEYTAG, \
+				ENCOUNTER_STORE_PLAIN_ECTAG_LEN)) {
+		key->type = EC_KEYTYPE_ECELGAMAL_PRIVATE;
+		key->k.ecelgamal_privK.curve = \
+			strdup(line + ENCOUNTER_STORE_PLAIN_ECTAG_LEN);
+
+		if (fgets(line, ENCOUNTER_STORE_PLAIN_MAXLINE, keyfile))
+			key->k.ecelgamal_privK.x = strdup(line);
+
+		if (key->k.ecelgamal_privK.curve && key->k.ecelgamal_privK.x)
+			ctx->rc = D.stringToNum(ctx, key, keyctx);
+		else 
+			encounter_set_error(ctx, ENCOUNTER_ERR_OS, \
+			   "unable to read the required parameters");
+		goto end;
+	}
+
+	/* An Okamoto-Uchiyama key opens with its tag and p, then q, g */
+	if (!strncmp(line, ENCOUNTER_OU_KEYTAG, \
+				ENCOUNTER_STORE_PLAIN_OUTAG_LEN)) {
+		key->type = EC_KEYTYPE_OKAMOTO_UCHIYAMA_PRIVATE;
+		key->k.ou_privK.p = \
+			strdup(line + ENCOUNTER_STORE_PLAIN_OUTAG_LEN);
+
+		if (fgets(line, ENCOUNTER_STORE_PLAIN_MAXLINE, keyfile))
+			key->k.ou_privK.q = strdup(line);
+
+		if (fgets(line, ENCOUNTER_STORE_PLAIN_MAXLINE, keyfile))
+			key->k.ou_privK.g = strdup(line);
+
+		if (   key->k.ou_privK.p && key->k.ou_privK.q \
+		    && key->k.ou_privK.g)
+			ctx->rc = D.stringToNum(ctx, key, keyctx);
+		else 
+			encounter_set_error(ctx, ENCOUNTER_ERR_OS, \
+			   "unable to read the required parameters");
+		goto end;
+	}
+
 	/* Read, in the following order:
 	 * p, q, psquared, qsquared, pinvmod2tow qinvmod2tow,
 	 * hsubp, hsubq, qInv */
-	if (fgets(line, ENCOUNTER_STORE_PLAIN_MAXLINE, keyfile))
+	if (*line)
 		key->k.paillier_privK.p = strdup(line);
 	
 	if (fgets(line, ENCOUNTER_STORE_PLAIN_MAXLINE, keyfile))
@@ -182,6 +401,16 @@ encounter_err_t encounter_plain_loadPrivKey(encounter_t *ctx, \
 	if (fgets(line, ENCOUNTER_STORE_PLAIN_MAXLINE, keyfile))
 		key->k.paillier_privK.qInv = strdup(line);
 
+	/* The degree of a Damgard-Jurik key, or the tag and alpha of a
+	 * subgroup one */
+	if (encounter_plain_keyExtension(ctx, keyfile, line, \
+		&key->k.paillier_privK.s, &key->k.paillier_privK.alpha) \
+			!= ENCOUNTER_OK)
+		goto end;
+	if (key->k.paillier_privK.alpha)
+		key->type = EC_KEYTYPE_PAILLIER_SUBGROUP_PRIVATE;
+	if (key->k.paillier_privK.s)
+		key->type = EC_KEYTYPE_DAMGARD_JURIK_PRIVATE;
 
 	if (    key->k.paillier_privK.p \
 	     && key->k.paillier_privK.q \
@@ -199,12 +428,14 @@ encounter_err_t encounter_plain_loadPrivKey(encounter_t *ctx, \
 		   "unable to read the required parameters");
 
 end:
-	/* Okay, dispose temp resources, if any */
+	/* Okay, dispose temp resources, if any, keeping the outcome */
+	rc = ctx->rc;
 	if (key) D.dispose_keystring(ctx, key);
 	if (line) free(line);
 	if (keyfile) fclose(keyfile);
 
 	/* We are done */
+	ctx->rc = rc;
 	return ctx->rc;
 }
 
@@ -0,0 +1,148 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "encounter_priv.h"
+
+#include "threadpool.h"
+
+#include "utils.h"
+
+
+/* A fork-join run over the items of a batch */
+struct ec_threadpool_run_s {
+	pthread_mutex_t		lock;
+	size_t			next;		/* First item not handed out */
+	size_t			items;
+	encounter_err_t		rc;		/* First failure, if any */
+	char			estr[256];
+
+	ec_threadpool_fn_t	fn;
+	void			*arg;
+};
+
+/* A worker of the run */
+struct ec_threadpool_worker_s {
+	struct ec_threadpool_run_s	*run;
+	unsigned int			index;
+	encounter_t			wctx;
+};
+
+
+/* Some static prototypes */
+static void *encounter_threadpool_worker(void *);
+
+
+
+/** Hand out the items one at a time until none is left or one fails */
+static void *encounter_threadpool_worker(void *arg)
+{
+	struct ec_threadpool_worker_s *w = arg;
+	struct ec_threadpool_run_s *run = w->run;
+	size_t item;
+
+	for (;;) {
+		pthread_mutex_lock(&run->lock);
+		if (run->rc != ENCOUNTER_OK || run->next == run->items) {
+			pthread_mutex_unlock(&run->lock);
+			break;
+		}
+		item = run->next++;
+		pthread_mutex_unlock(&run->lock);
+
+		if (run->fn(&w->wctx, run->arg, w->index, item) \
+				== ENCOUNTER_OK)
+			continue;
+
+		pthread_mutex_lock(&run->lock);
+		if (run->rc == ENCOUNTER_OK) {
+			run->rc = w->wctx.rc;
+			memcpy(run->estr, w->wctx.estr, sizeof run->estr);
+		}
+		pthread_mutex_unlock(&run->lock);
+		break;
+	}
+
+	return NULL;
+}
+
+/** The workers a run over the given items would use, at most threads */
+unsigned int encounter_threadpool_workers(const unsigned int threads, \
+						const size_t items)
+{
+	if (!items) return 1;
+	if (!threads) return 1;
+
+	return (items < threads ? (unsigned int) items : threads);
+}
+
+/** Run fn over items [0, items) on up to threads workers, the calling
+ * thread being worker 0, and return when all are done. The first
+ * failure stops the handing out of items and is reported via ctx */
+encounter_err_t encounter_threadpool_run(encounter_t *ctx, \
+	unsigned int threads, size_t items, ec_threadpool_fn_t fn, void *arg)
+{
+	struct ec_threadpool_run_s run;
+	struct ec_threadpool_worker_s *w;
+	pthread_t *tid;
+	unsigned int i, workers, started = 1;
+
+	if (!ctx)       return ENCOUNTER_ERR_PARAM;
+	if (!fn) {
+                encounter_set_error(ctx, ENCOUNTER_ERR_PARAM, \
+                        "null param");
+                return ctx->rc;
+        }
+
+	ctx->rc = ENCOUNTER_OK;
+	if (!items) return ctx->rc;
+
+	workers = encounter_threadpool_workers(threads, items);
+
+	w = calloc(workers, sizeof *w);
+	tid = calloc(workers, sizeof *tid);
+	if (!w || !tid) {
+		free(w);
+		free(tid);
+		encounter_set_error(ctx, ENCOUNTER_ERR_MEM, "calloc: failed");
+		return ctx->rc;
+	}
+
+	memset(&run, 0, sizeof run);
+	pthread_mutex_init(&run.lock, NULL);
+	run.items = items;
+	run.rc = ENCOUNTER_OK;
+	run.fn = fn;
+	run.arg = arg;
+
+	for (i = 0; i < workers; ++i) {
+		w[i].run = &run;
+		w[i].index = i;
+		w[i].wctx.conf = ctx->conf;
+	}
+
+	/* Fewer threads than asked for only make the run longer */
+	for (i = 1; i < workers; ++i) {
+		if (pthread_create(&tid[i], NULL, encounter_threadpool_worker, \
+					&w[i]) != 0)
+			break;
+		started++;
+	}
+
+	encounter_threadpool_worker(&w[0]);
+
+	for (i = 1; i < started; ++i)
+		pthread_join(tid[i], NULL);
+
+	pthread_mutex_destroy(&run.lock);
+
+	if (run.rc != ENCOUNTER_OK) {
+		ctx->rc = run.rc;
+		memcpy(ctx->estr, run.estr, sizeof ctx->estr);
+	}
+
+	free(w);
+	free(tid);
+
+	return ctx->rc;
+}
@@ -0,0 +1,24 @@
+#ifndef _ENCOUNTER_THREADPOOL_H_
+#define _ENCOUNTER_THREADPOOL_H_
+
+#include <stddef.h>
+
+#include "encounter_priv.h"
+
+
+/* One item of a batch. Each worker has a private runtime context, a
+ * copy of the caller's configuration, and its index in [0, workers),
+ * meant for per-worker scratch kept by the caller */
+typedef encounter_err_t (*ec_threadpool_fn_t)(encounter_t *, void *, \
+						unsigned int, size_t);
+
+
+/* TODO use __BEGIN_DECLS */
+
+encounter_err_t encounter_threadpool_run(encounter_t *, unsigned int, \
+				size_t, ec_threadpool_fn_t, void *);
+
+unsigned int encounter_threadpool_workers(const unsigned int, \
+							const size_t);
+
+#endif  /* _ENCOUNTER_THREADPOOL_H_ */
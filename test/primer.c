@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "encounter.h"
@@ -8,8 +9,36 @@
 #define COUNTERPATH	"./counter.txt"
 #define PUBLICKEYPATH	"./publickey.txt"
 #define PRIVATEKEYPATH	"./privatekey.txt"
+#define BSGSTABLEPATH	"./bsgs.tbl"
 
 #define	KEYSIZE 1024
+#define	WIDE	11
+
+/* Disposes of the counters and the keypair of a run, those set, and resets
+ * their handles for the next pass */
+static void disposeRun(encounter_t *ctx, ec_count_t **A, ec_count_t **B, \
+				ec_keyctx_t **pubK, ec_keyctx_t **privK)
+{
+	if (A && *A) encounter_dispose_counter(ctx, *A);
+	if (B && *B) encounter_dispose_counter(ctx, *B);
+	if (pubK && *pubK) encounter_dispose_keyctx(ctx, *pubK);
+	if (privK && *privK) encounter_dispose_keyctx(ctx, *privK);
+
+	if (A) *A = NULL;
+	if (B) *B = NULL;
+	if (pubK) *pubK = NULL;
+	if (privK) *privK = NULL;
+}
+
+/* Counts the primes found for p and q, cancels when steps[2] is set */
+static int keygenProgress(void *arg, const encounter_keygen_step_t step, \
+						const unsigned int prime)
+{
+	unsigned int *steps = arg;
+
+	if (step == EC_KEYGEN_PRIME) steps[prime]++;
+	return steps[2];
+}
 
 int main(int argc, char *argv[]) 
 {
@@ -22,18 +51,61 @@ int main(int argc, char *argv[])
         ec_count_t  *counter_dup = NULL;
         ec_count_t  *counter_copy = NULL;
 	ec_keyset_t *keyset = NULL, *keyset2 = NULL;
-	unsigned long long int c = 0;
+	unsigned long long int c = 0, plain[3];
+	ec_count_t  *batch[3], *batchB[2];
+	unsigned int amount[2], amount3[3];
+	unsigned char bytes[512];
+	size_t len;
+	ec_keyctx_t *djPubK = NULL, *djPrivK = NULL;
+	ec_count_t  *djA = NULL, *djB = NULL;
+	ec_keyctx_t *egPubK = NULL, *egPrivK = NULL;
+	ec_count_t  *egA = NULL, *egB = NULL;
+	FILE *table;
+	ec_keyctx_t *ouPubK = NULL, *ouPrivK = NULL;
+	ec_count_t  *ouA = NULL, *ouB = NULL;
+	ec_count_t  *packA = NULL, *packB = NULL;
+	ec_count_t  *sgA = NULL;
+	ec_count_t  *bulk[5] = { NULL };
+	unsigned int initial[5] = { 0, 1, 7, 1000, 65535 };
+	unsigned long long int bulkPlain[5];
+	encounter_t *gctx = NULL;
+	unsigned long long int gc = 0;
+	encounter_t *wctx = NULL;
+	ec_keyctx_t *widePubK = NULL, *widePrivK = NULL;
+	ec_keyctx_t *poolPubK = NULL, *poolPrivK = NULL;
+	ec_count_t  *wide[WIDE];
+	unsigned long long int widePlain[WIDE];
+	unsigned int w;
+	unsigned long long int slot[4];
+	unsigned int steps[3] = { 0, 0, 0 };
 	int a = 0, result = 0;
+	encounter_conf_t conf;
+	encounter_key_t keytype;
 
 start:
-	/* Initialize Encounter */
-	rc = encounter_init(0, &ctx);
+	/* Initialize Encounter, the second time round with 
+	 * precomputed fixed-base randomizers and Montgomery-resident
+	 * counters, the third with g = n+1, the fourth with a g of order
+	 * alpha n and short decryption exponents */
+	memset(&conf, 0, sizeof conf);
+	if (a == 1) {
+		conf.pool_depth = 4;
+		conf.pool_ones = 2;
+		conf.pool_dry = EC_POOL_DRY_WAIT;
+		conf.mont_counters = true;
+		conf.fixed_base_window = 4;
+		conf.ecelgamal_table = BSGSTABLEPATH;
+	}
+	keytype = (a == 2 ? EC_KEYTYPE_PAILLIER_NPLUS1_PUBLIC : \
+		   a == 3 ? EC_KEYTYPE_PAILLIER_SUBGROUP_PUBLIC : \
+					EC_KEYTYPE_PAILLIER_PUBLIC);
+	rc = encounter_init_conf(0, &conf, &ctx);
 	if (rc != ENCOUNTER_OK) goto end;
 
 	printf("Init: succeeded\n");
 
 #if 1
-	if(encounter_keygen(ctx, EC_KEYTYPE_PAILLIER_PUBLIC, \
+	if(encounter_keygen(ctx, keytype, \
 			KEYSIZE, &pubK, &privK) != ENCOUNTER_OK) goto end;
 
 	printf("Keygen: succeeded\n");
@@ -54,6 +126,19 @@ start:
 
 	printf("Adding public key to keyset: succeeded\n");
 
+	/* A key with g = n+1 is kept as n alone */
+	if (a == 2) {
+		FILE *f = fopen(PUBLICKEYPATH, "r");
+		char line[16];
+		int lines = 0;
+
+		assert(f);
+		while (fgets(line, sizeof line, f))
+			if (strchr(line, '\n')) ++lines;
+		fclose(f);
+		assert(lines == 1);
+	}
+
 #endif
 	if(encounter_create_keyset(ctx, EC_KEYSET_PLAIN, PRIVATEKEYPATH,\
 				NULL, &keyset2) != ENCOUNTER_OK) goto end;
@@ -65,6 +150,18 @@ start:
 
 	printf("Adding private key to keyset2: succeeded\n");
 
+	/* Blank lines past a key are neither a degree nor a tag */
+	if (a == 0 || a == 3) {
+		FILE *f = fopen(PUBLICKEYPATH, "a");
+
+		assert(f);
+		fputs("\n \n", f);
+		fclose(f);
+		f = fopen(PRIVATEKEYPATH, "a");
+		assert(f);
+		fputs("\n \n", f);
+		fclose(f);
+	}
 
 	encounter_dispose_counter(ctx, encounter); encounter = NULL;
 	encounter_dispose_keyctx(ctx, pubK);   pubK = NULL;
@@ -240,6 +337,543 @@ start:
 	printf("Cryptocounter copy decryption: succeeded\n");
 	printf("Plaintext counter: %lld\n", c);
 
+	/* 110 -> 117, owner mode */
+	if (encounter_inc_owner(ctx, pubK, privK, counter_copy, 7) \
+                != ENCOUNTER_OK) goto end;
+	if (encounter_touch_owner(ctx, pubK, privK, counter_copy) \
+                != ENCOUNTER_OK) goto end;
+
+	/* 117 -> 234 */
+	if (encounter_mul_owner(ctx, pubK, privK, counter_copy, 2) \
+                != ENCOUNTER_OK) goto end;
+
+	/* 234 -> 124 */
+	if (encounter_sub_owner(ctx, pubK, privK, counter_copy, encounter) \
+                != ENCOUNTER_OK) goto end;
+
+	printf("Owner mode updates: succeeded\n");
+
+	if (encounter_decrypt(ctx, counter_copy, privK, &c) \
+                != ENCOUNTER_OK) goto end;
+
+        assert(c == 124);
+	printf("Owner mode counter decryption: succeeded\n");
+	printf("Plaintext counter: %lld\n", c);
+
+	c = 0;
+	if (encounter_decrypt_bounded(ctx, counter_copy, privK, &c) \
+                != ENCOUNTER_OK) goto end;
+
+        assert(c == 124);
+	printf("Bounded counter decryption: succeeded\n");
+
+	batch[0] = encounter; batch[1] = counter_copy; batch[2] = counter_dup;
+	if (encounter_decrypt_batch(ctx, batch, 3, privK, plain) \
+                != ENCOUNTER_OK) goto end;
+
+        assert(plain[0] == 110 && plain[1] == 124 && plain[2] == 110);
+	printf("Batch counter decryption: succeeded\n");
+
+	/* 124 -> 120, 110 -> 0 */
+	batch[0] = counter_copy; batch[1] = counter_dup;
+	batchB[0] = encounterB; batchB[1] = encounter;
+	if (encounter_sub_batch(ctx, pubK, batch, batchB, 2) \
+                != ENCOUNTER_OK) goto end;
+
+	/* 120 -> 100, 110 -> 100 */
+	batch[1] = encounter;
+	amount[0] = 20; amount[1] = 10;
+	if (encounter_dec_batch(ctx, pubK, batch, amount, 2) \
+                != ENCOUNTER_OK) goto end;
+
+	printf("Batch updates: succeeded\n");
+
+	batch[2] = counter_dup;
+	if (encounter_decrypt_batch(ctx, batch, 3, privK, plain) \
+                != ENCOUNTER_OK) goto end;
+
+        assert(plain[0] == 100 && plain[1] == 100 && plain[2] == 0);
+	printf("Batch updates decryption: succeeded\n");
+
+	/* 2*100 + 3*100 + 5*4 = 520 */
+	batch[2] = encounterB;
+	amount3[0] = 2; amount3[1] = 3; amount3[2] = 5;
+	if (encounter_linear_combination(ctx, pubK, batch, amount3, 3, \
+			counter_dup) != ENCOUNTER_OK) goto end;
+	if (encounter_decrypt(ctx, counter_dup, privK, &c) \
+                != ENCOUNTER_OK) goto end;
+
+        assert(c == 520);
+	printf("Linear combination of counters: succeeded\n");
+
+	/* 100 + 100 + 4 */
+	c = 0;
+	if (encounter_sum(ctx, pubK, batch, 3, NULL, privK, &c) \
+                != ENCOUNTER_OK) goto end;
+
+        assert(c == 204);
+	if (encounter_sum(ctx, pubK, batch, 3, counter_dup, NULL, NULL) \
+                != ENCOUNTER_OK) goto end;
+	if (encounter_decrypt(ctx, counter_dup, privK, &c) \
+                != ENCOUNTER_OK) goto end;
+
+        assert(c == 204);
+	printf("Sum of counters: succeeded\n");
+
+	if (encounter_new_counters(ctx, pubK, 5, initial, bulk) \
+                != ENCOUNTER_OK) goto end;
+	if (encounter_inc(ctx, pubK, bulk[0], 3) != ENCOUNTER_OK) goto end;
+	if (encounter_decrypt_batch(ctx, bulk, 5, privK, bulkPlain) \
+                != ENCOUNTER_OK) goto end;
+
+        assert(bulkPlain[0] == 3 && bulkPlain[1] == 1 \
+		&& bulkPlain[2] == 7 && bulkPlain[3] == 1000 \
+		&& bulkPlain[4] == 65535);
+	if (encounter_dispose_counters(ctx, bulk, 5) != ENCOUNTER_OK)
+		goto end;
+	printf("Bulk counter creation: succeeded\n");
+
+	/* Four 32-bit slots: [5, 0, 0, 1000] + [0, 7, 0, 24] */
+	if (encounter_new_packed_counter(ctx, pubK, 4, 32, &packA) \
+                != ENCOUNTER_OK) goto end;
+	if (encounter_new_packed_counter(ctx, pubK, 4, 32, &packB) \
+                != ENCOUNTER_OK) goto end;
+	if (encounter_inc_slot(ctx, pubK, packA, 0, 5) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_inc_slot(ctx, pubK, packA, 3, 1000) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_inc_slot(ctx, pubK, packB, 1, 7) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_inc_slot(ctx, pubK, packB, 3, 24) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_add(ctx, pubK, packA, packB) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_decrypt_packed(ctx, packA, privK, slot, 4) \
+                != ENCOUNTER_OK) goto end;
+
+        assert(slot[0] == 5 && slot[1] == 7 && slot[2] == 0 && \
+						slot[3] == 1024);
+
+	/* Back to [5, 0, 0, 1000], then slot 0 down by 5 */
+	if (encounter_sub(ctx, pubK, packA, packB) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_dec_slot(ctx, pubK, packA, 0, 5) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_decrypt_packed(ctx, packA, privK, slot, 4) \
+                != ENCOUNTER_OK) goto end;
+
+        assert(slot[0] == 0 && slot[1] == 0 && slot[2] == 0 && \
+						slot[3] == 1000);
+
+	/* Past the slot width, and below zero */
+	if (encounter_inc_slot(ctx, pubK, packB, 2, 0xffffffffULL) \
+                != ENCOUNTER_OK) goto end;
+	if (encounter_inc_slot(ctx, pubK, packB, 2, 1) != ENCOUNTER_OK)
+		goto end;
+	assert(encounter_decrypt_packed(ctx, packB, privK, slot, 4) \
+                == ENCOUNTER_ERR_OVERFLOW);
+	if (encounter_dec_slot(ctx, pubK, packA, 3, 1001) != ENCOUNTER_OK)
+		goto end;
+	assert(encounter_decrypt_packed(ctx, packA, privK, slot, 4) \
+                == ENCOUNTER_ERR_OVERFLOW);
+	assert(encounter_add(ctx, pubK, packA, encounter) \
+                == ENCOUNTER_ERR_PARAM);
+
+	/* The scalar updates refuse packed counters */
+	assert(encounter_inc(ctx, pubK, packA, 1) == ENCOUNTER_ERR_PARAM);
+	assert(encounter_mul(ctx, pubK, packA, 2) == ENCOUNTER_ERR_PARAM);
+
+	/* The packing round-trips, and a bad one does not load */
+	if (encounter_dec_slot(ctx, pubK, packB, 2, 1) != ENCOUNTER_OK)
+		goto end;
+	if (encounter_persist_counter(ctx, packB, COUNTERPATH) \
+		!= ENCOUNTER_OK) goto end;
+	disposeRun(ctx, &packB, NULL, NULL, NULL);
+	if (encounter_get_counter(ctx, COUNTERPATH, &packB) \
+		!= ENCOUNTER_OK) goto end;
+	if (encounter_decrypt_packed(ctx, packB, privK, slot, 4) \
+                != ENCOUNTER_OK) goto end;
+
+        assert(slot[0] == 0 && slot[1] == 7 && slot[2] == 0xffffffffULL \
+						&& slot[3] == 24);
+	disposeRun(ctx, &packB, NULL, NULL, NULL);
+
+	if ((table = fopen(COUNTERPATH, "w")) == NULL) goto end;
+	fputs("P0.32:1\n", table); fclose(table);
+	assert(encounter_get_counter(ctx, COUNTERPATH, &packB) \
+                == ENCOUNTER_ERR_DATA);
+	if ((table = fopen(COUNTERPATH, "w")) == NULL) goto end;
+	fputs("P4.65:1\n", table); fclose(table);
+	assert(encounter_get_counter(ctx, COUNTERPATH, &packB) \
+                == ENCOUNTER_ERR_DATA);
+	if ((table = fopen(COUNTERPATH, "w")) == NULL) goto end;
+	fputs("P4000000000.32:1\n", table); fclose(table);
+	if (encounter_get_counter(ctx, COUNTERPATH, &packB) \
+		!= ENCOUNTER_OK) goto end;
+	assert(encounter_inc_slot(ctx, pubK, packB, 0, 1) \
+                == ENCOUNTER_ERR_PARAM);
+	printf("Packed counters: succeeded\n");
+
+	/* Paillier subgroup keys: the short randomizers, inline and in
+	 * owner mode, keep to the subgroup the exponent alpha clears */
+	if (a == 3) {
+		if (encounter_new_counter(ctx, pubK, &sgA) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_inc(ctx, pubK, sgA, 1000) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_inc_owner(ctx, pubK, privK, sgA, 5) \
+			!= ENCOUNTER_OK) goto end;
+		if (encounter_touch(ctx, pubK, sgA) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_decrypt(ctx, sgA, privK, &c) != ENCOUNTER_OK)
+			goto end;
+
+		assert(c == 1005);
+		printf("Paillier subgroup counters: succeeded\n");
+	}
+
+	/* The GMP backend, when built in, shares keys and counters */
+	conf.backend = EC_BACKEND_GMP;
+	rc = encounter_init_conf(0, &conf, &gctx);
+	if (rc == ENCOUNTER_OK) {
+		if (encounter_decrypt(ctx, encounter, privK, &c) \
+			!= ENCOUNTER_OK) goto end;
+		if (encounter_inc(gctx, pubK, encounter, 5) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_decrypt(gctx, encounter, privK, &gc) \
+			!= ENCOUNTER_OK) goto end;
+		assert(gc == c + 5);
+		if (encounter_decrypt(ctx, encounter, privK, &c) \
+			!= ENCOUNTER_OK) goto end;
+		assert(c == gc);
+		printf("GMP backend: succeeded\n");
+	} else
+		assert(rc == ENCOUNTER_ERR_IMPL);
+
+	/* 2048-bit keys, once: runs of multi-buffer exponentiations fill
+	 * the pool of randomizers and decrypt the batch, a short run last.
+	 * A keypair pool serves a pooled keygen. The progress callback
+	 * sees both primes, then cancels a keygen */
+	if (a == 0) {
+		memset(wide, 0, sizeof wide);
+		memset(&conf, 0, sizeof conf);
+		conf.pool_depth = 8;
+		conf.pool_dry = EC_POOL_DRY_WAIT;
+		conf.keygen_progress = keygenProgress;
+		conf.keygen_arg = steps;
+		conf.keypool_depth = 1;
+		conf.keypool_sizes[0] = KEYSIZE;
+		rc = encounter_init_conf(0, &conf, &wctx);
+		if (rc != ENCOUNTER_OK) goto end;
+
+		if (encounter_keygen(wctx, EC_KEYTYPE_PAILLIER_PUBLIC, \
+			2 * KEYSIZE, &widePubK, &widePrivK) != ENCOUNTER_OK)
+			goto end;
+		for (w = 0; w < WIDE; ++w) {
+			if (encounter_new_counter(wctx, widePubK, &wide[w]) \
+				!= ENCOUNTER_OK) goto end;
+			if (encounter_inc(wctx, widePubK, wide[w], 3 * w + 1) \
+				!= ENCOUNTER_OK) goto end;
+		}
+		if (encounter_decrypt_batch(wctx, wide, WIDE, widePrivK, \
+				widePlain) != ENCOUNTER_OK)
+			goto end;
+
+		for (w = 0; w < WIDE; ++w)
+			assert(widePlain[w] == 3 * w + 1);
+		printf("Multi-buffer batch decryption: succeeded\n");
+
+		if (encounter_keygen_pooled(wctx, EC_KEYTYPE_PAILLIER_PUBLIC, \
+			KEYSIZE, &poolPubK, &poolPrivK) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_new_counter(wctx, poolPubK, &djA) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_inc(wctx, poolPubK, djA, 9) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_decrypt(wctx, djA, poolPrivK, &c) != ENCOUNTER_OK)
+			goto end;
+		assert(c == 9);
+		if (encounter_dispose_counter(wctx, djA) != ENCOUNTER_OK)
+			goto end;
+		djA = NULL;
+		printf("Pooled keygen: succeeded\n");
+
+		assert(steps[0] >= 1 && steps[1] >= 1);
+		steps[2] = 1;
+		assert(encounter_keygen(wctx, EC_KEYTYPE_PAILLIER_PUBLIC, \
+			KEYSIZE, &djPubK, &djPrivK) == ENCOUNTER_ERR_CANCELED);
+		assert(!djPubK && !djPrivK);
+		printf("Canceled keygen: succeeded\n");
+	}
+
+	/* Damgard-Jurik counters of degree 3, once */
+	if (a == 2) {
+		if (encounter_keygen_dj(ctx, 3, KEYSIZE, &djPubK, &djPrivK) \
+			!= ENCOUNTER_OK) goto end;
+		if (encounter_new_counter(ctx, djPubK, &djA) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_new_counter(ctx, djPubK, &djB) != ENCOUNTER_OK)
+			goto end;
+
+		/* djA = 2^2170, past n = pq */
+		if (encounter_inc(ctx, djPubK, djA, 1) != ENCOUNTER_OK)
+			goto end;
+		for (len = 0; len < 70; ++len)
+			if (encounter_mul(ctx, djPubK, djA, 1U << 31) \
+				!= ENCOUNTER_OK) goto end;
+
+		/* djB = 5 */
+		if (encounter_inc(ctx, djPubK, djB, 7) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_dec(ctx, djPubK, djB, 2) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_decrypt(ctx, djB, djPrivK, &c) != ENCOUNTER_OK)
+			goto end;
+
+		assert(c == 5);
+
+		/* djA = 2^2170 + 5 */
+		if (encounter_add(ctx, djPubK, djA, djB) != ENCOUNTER_OK)
+			goto end;
+		assert(encounter_decrypt(ctx, djA, djPrivK, &c) \
+				== ENCOUNTER_ERR_OVERFLOW);
+
+		len = 4;
+		assert(encounter_decrypt_bytes(ctx, djA, djPrivK, bytes, &len) \
+				== ENCOUNTER_ERR_OVERFLOW && len == 272);
+		len = sizeof bytes;
+		if (encounter_decrypt_bytes(ctx, djA, djPrivK, bytes, &len) \
+			!= ENCOUNTER_OK) goto end;
+
+		assert(len == 272 && bytes[0] == 4 && bytes[271] == 5);
+
+		/* djA = 2^2170 */
+		if (encounter_sub(ctx, djPubK, djA, djB) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_decrypt_bytes(ctx, djA, djPrivK, bytes, &len) \
+			!= ENCOUNTER_OK) goto end;
+
+		assert(len == 272 && bytes[0] == 4 && bytes[271] == 0);
+
+		batch[0] = djB; batch[1] = djB;
+		if (encounter_sum(ctx, djPubK, batch, 2, NULL, djPrivK, &c) \
+			!= ENCOUNTER_OK) goto end;
+
+		assert(c == 10);
+
+		/* The degree goes along with the keys */
+		encounter_dispose_counter(ctx, djA); djA = NULL;
+		if (encounter_add_publicKey(ctx, djPubK, keyset) \
+			!= ENCOUNTER_OK) goto end;
+		if (encounter_add_privateKey(ctx, djPrivK, keyset2, NULL) \
+			!= ENCOUNTER_OK) goto end;
+		encounter_dispose_keyctx(ctx, djPubK);   djPubK = NULL;
+		encounter_dispose_keyctx(ctx, djPrivK); djPrivK = NULL;
+		if (encounter_get_publicKey(ctx, keyset, &djPubK) \
+			!= ENCOUNTER_OK) goto end;
+		if (encounter_get_privateKey(ctx, keyset2, NULL, &djPrivK) \
+			!= ENCOUNTER_OK) goto end;
+
+		if (encounter_inc(ctx, djPubK, djB, 1) != ENCOUNTER_OK)
+			goto end;
+		batch[0] = djB;
+		if (encounter_decrypt_batch(ctx, batch, 1, djPrivK, plain) \
+			!= ENCOUNTER_OK) goto end;
+
+		assert(plain[0] == 6);
+		printf("Damgard-Jurik counters: succeeded\n");
+	}
+
+	/* EC-ElGamal counters, once, their table persisted */
+	if (a == 1) {
+		assert(encounter_keygen(ctx, EC_KEYTYPE_ECELGAMAL_PUBLIC, \
+			KEYSIZE, &egPubK, &egPrivK) == ENCOUNTER_ERR_PARAM);
+		if (encounter_keygen(ctx, EC_KEYTYPE_ECELGAMAL_PUBLIC, \
+			ENCOUNTER_ECELGAMAL_KEYSIZE, &egPubK, &egPrivK) \
+			!= ENCOUNTER_OK) goto end;
+		if (encounter_new_counter(ctx, egPubK, &egA) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_new_counter(ctx, egPubK, &egB) != ENCOUNTER_OK)
+			goto end;
+
+		/* egA = 5 */
+		if (encounter_inc(ctx, egPubK, egA, 7) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_dec(ctx, egPubK, egA, 2) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_touch(ctx, egPubK, egA) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_decrypt(ctx, egA, egPrivK, &c) != ENCOUNTER_OK)
+			goto end;
+
+		assert(c == 5);
+
+		/* egB = 5000000 + 5, past the baby steps */
+		if (encounter_inc(ctx, egPubK, egB, 5000000) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_add(ctx, egPubK, egB, egA) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_decrypt(ctx, egB, egPrivK, &c) != ENCOUNTER_OK)
+			goto end;
+
+		assert(c == 5000005);
+
+		/* egA = 15 */
+		if (encounter_mul(ctx, egPubK, egA, 3) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_private_cmp(ctx, egA, egB, egPubK, egPrivK, \
+			&result) != ENCOUNTER_OK) goto end;
+		assert(result == -1);
+		if (encounter_private_cmp(ctx, egB, egA, egPubK, egPrivK, \
+			&result) != ENCOUNTER_OK) goto end;
+		assert(result == 1);
+
+		batch[0] = egA; batch[1] = egB;
+		if (encounter_sum(ctx, egPubK, batch, 2, NULL, egPrivK, &c) \
+			!= ENCOUNTER_OK) goto end;
+
+		assert(c == 5000020);
+
+		/* Counters and keys round-trip the plain keysets */
+		if (encounter_persist_counter(ctx, egB, COUNTERPATH) \
+			!= ENCOUNTER_OK) goto end;
+		encounter_dispose_counter(ctx, egB); egB = NULL;
+		if (encounter_get_counter(ctx, COUNTERPATH, &egB) \
+			!= ENCOUNTER_OK) goto end;
+		if (encounter_add_publicKey(ctx, egPubK, keyset) \
+			!= ENCOUNTER_OK) goto end;
+		if (encounter_add_privateKey(ctx, egPrivK, keyset2, NULL) \
+			!= ENCOUNTER_OK) goto end;
+		encounter_dispose_keyctx(ctx, egPubK);   egPubK = NULL;
+		encounter_dispose_keyctx(ctx, egPrivK); egPrivK = NULL;
+		if (encounter_get_publicKey(ctx, keyset, &egPubK) \
+			!= ENCOUNTER_OK) goto end;
+		if (encounter_get_privateKey(ctx, keyset2, NULL, &egPrivK) \
+			!= ENCOUNTER_OK) goto end;
+
+		/* The table comes from the file this time */
+		table = fopen(BSGSTABLEPATH, "rb");
+		assert(table != NULL);
+		fclose(table);
+
+		if (encounter_sub(ctx, egPubK, egB, egA) != ENCOUNTER_OK)
+			goto end;
+		batch[0] = egA; batch[1] = egB;
+		if (encounter_decrypt_batch(ctx, batch, 2, egPrivK, plain) \
+			!= ENCOUNTER_OK) goto end;
+
+		assert(plain[0] == 15 && plain[1] == 4999990);
+
+		/* Below zero, and across schemes */
+		if (encounter_dec(ctx, egPubK, egA, 16) != ENCOUNTER_OK)
+			goto end;
+		assert(encounter_decrypt(ctx, egA, egPrivK, &c) \
+				== ENCOUNTER_ERR_OVERFLOW);
+		assert(encounter_add(ctx, egPubK, egA, encounter) \
+				== ENCOUNTER_ERR_PARAM);
+		assert(encounter_decrypt(ctx, egA, privK, &c) \
+				== ENCOUNTER_ERR_PARAM);
+		printf("EC-ElGamal counters: succeeded\n");
+	}
+
+	/* Okamoto-Uchiyama counters, once */
+	if (a == 0) {
+		if (encounter_keygen(ctx, EC_KEYTYPE_OKAMOTO_UCHIYAMA_PUBLIC, \
+			KEYSIZE, &ouPubK, &ouPrivK) != ENCOUNTER_OK) goto end;
+		if (encounter_new_counter(ctx, ouPubK, &ouA) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_new_counter(ctx, ouPubK, &ouB) != ENCOUNTER_OK)
+			goto end;
+
+		/* ouA = 5, ouB = 1005 */
+		if (encounter_inc(ctx, ouPubK, ouA, 7) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_dec(ctx, ouPubK, ouA, 2) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_touch(ctx, ouPubK, ouA) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_inc(ctx, ouPubK, ouB, 1000) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_add(ctx, ouPubK, ouB, ouA) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_decrypt(ctx, ouB, ouPrivK, &c) != ENCOUNTER_OK)
+			goto end;
+
+		assert(c == 1005);
+
+		/* ouA = 15, ouB = 990 */
+		if (encounter_mul(ctx, ouPubK, ouA, 3) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_sub(ctx, ouPubK, ouB, ouA) != ENCOUNTER_OK)
+			goto end;
+		if (encounter_private_cmp(ctx, ouA, ouB, ouPubK, ouPrivK, \
+			&result) != ENCOUNTER_OK) goto end;
+		assert(result == -1);
+		if (encounter_private_cmp(ctx, ouB, ouA, ouPubK, ouPrivK, \
+			&result) != ENCOUNTER_OK) goto end;
+		assert(result == 1);
+		if (encounter_private_cmp(ctx, ouA, ouA, ouPubK, ouPrivK, \
+			&result) != ENCOUNTER_OK) goto end;
+		assert(result == 0);
+
+		batch[0] = ouA; batch[1] = ouB;
+		if (encounter_sum(ctx, ouPubK, batch, 2, NULL, ouPrivK, &c) \
+			!= ENCOUNTER_OK) goto end;
+
+		assert(c == 1005);
+
+		/* Counters and keys round-trip the plain keysets */
+		if (encounter_persist_counter(ctx, ouB, COUNTERPATH) \
+			!= ENCOUNTER_OK) goto end;
+		encounter_dispose_counter(ctx, ouB); ouB = NULL;
+		if (encounter_get_counter(ctx, COUNTERPATH, &ouB) \
+			!= ENCOUNTER_OK) goto end;
+		if (encounter_add_publicKey(ctx, ouPubK, keyset) \
+			!= ENCOUNTER_OK) goto end;
+		if (encounter_add_privateKey(ctx, ouPrivK, keyset2, NULL) \
+			!= ENCOUNTER_OK) goto end;
+		encounter_dispose_keyctx(ctx, ouPubK);   ouPubK = NULL;
+		encounter_dispose_keyctx(ctx, ouPrivK); ouPrivK = NULL;
+		if (encounter_get_publicKey(ctx, keyset, &ouPubK) \
+			!= ENCOUNTER_OK) goto end;
+		if (encounter_get_privateKey(ctx, keyset2, NULL, &ouPrivK) \
+			!= ENCOUNTER_OK) goto end;
+
+		if (encounter_inc(ctx, ouPubK, ouB, 10) != ENCOUNTER_OK)
+			goto end;
+		batch[0] = ouA; batch[1] = ouB;
+		if (encounter_decrypt_batch(ctx, batch, 2, ouPrivK, plain) \
+			!= ENCOUNTER_OK) goto end;
+
+		assert(plain[0] == 15 && plain[1] == 1000);
+
+		/* The GMP backend, when built in, runs their exponentiations:
+		 * ouA = 30, compared, then back to 15 */
+		if (gctx) {
+			if (encounter_mul(gctx, ouPubK, ouA, 2) != ENCOUNTER_OK)
+				goto end;
+			if (encounter_decrypt(gctx, ouA, ouPrivK, &gc) \
+				!= ENCOUNTER_OK) goto end;
+			assert(gc == 30);
+			if (encounter_private_cmp(gctx, ouA, ouB, ouPubK, \
+				ouPrivK, &result) != ENCOUNTER_OK) goto end;
+			assert(result == -1);
+			if (encounter_dec(gctx, ouPubK, ouA, 15) != ENCOUNTER_OK)
+				goto end;
+		}
+
+		/* Below zero, and across schemes */
+		if (encounter_dec(ctx, ouPubK, ouA, 16) != ENCOUNTER_OK)
+			goto end;
+		assert(encounter_decrypt(ctx, ouA, ouPrivK, &c) \
+				== ENCOUNTER_ERR_OVERFLOW);
+		assert(encounter_add(ctx, ouPubK, ouA, encounter) \
+				== ENCOUNTER_ERR_PARAM);
+		assert(encounter_new_packed_counter(ctx, ouPubK, 4, 32, \
+				&packA) == ENCOUNTER_ERR_IMPL);
+		printf("Okamoto-Uchiyama counters: succeeded\n");
+	}
+
 
 end:
 	a++;
@@ -250,11 +884,32 @@ end:
 	if (encounterB) encounter_dispose_counter(ctx, encounterB);
 	if (counter_dup) encounter_dispose_counter(ctx, counter_dup);
 	if (counter_copy) encounter_dispose_counter(ctx, counter_copy);
+	disposeRun(ctx, &packA, &packB, NULL, NULL);
+	disposeRun(ctx, &sgA, NULL, NULL, NULL);
+	if (bulk[0]) encounter_dispose_counters(ctx, bulk, 5);
+	if (gctx) {
+		encounter_term(gctx);
+		gctx = NULL;
+	}
+	if (wctx) {
+		for (w = 0; w < WIDE; ++w)
+			if (wide[w]) encounter_dispose_counter(wctx, wide[w]);
+		if (widePubK) encounter_dispose_keyctx(wctx, widePubK);
+		if (widePrivK) encounter_dispose_keyctx(wctx, widePrivK);
+		if (poolPubK) encounter_dispose_keyctx(wctx, poolPubK);
+		if (poolPrivK) encounter_dispose_keyctx(wctx, poolPrivK);
+		encounter_term(wctx);
+		wctx = NULL; widePubK = widePrivK = NULL;
+		poolPubK = poolPrivK = NULL;
+	}
+	disposeRun(ctx, &djA, &djB, &djPubK, &djPrivK);
+	disposeRun(ctx, &egA, &egB, &egPubK, &egPrivK);
+	disposeRun(ctx, &ouA, &ouB, &ouPubK, &ouPrivK);
 	if (pubK) encounter_dispose_keyctx(ctx, pubK);
 	if (privK) encounter_dispose_keyctx(ctx, privK);
 	if (ctx) encounter_term(ctx);
 
-	if (a < 2) goto start;
+	if (a < 4) goto start;
 	return rc;
 
 }
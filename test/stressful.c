@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "encounter.h"
@@ -13,6 +14,10 @@
 
 #define CYCLES	300
 
+/* Rounds of the Paillier against subgroup keys comparison */
+#define ROUNDS	20
+#define BATCH	16
+
 #define TIMER_SAMPLE_CNT (10)
 
 
@@ -87,10 +92,98 @@ time */
     return dtMin;
 }
 
+/* Best cycles of a one step increment and of a decryption under fresh
+ * keys of the given type and size, 0 on failure */
+int bench(encounter_t *ctx, encounter_key_t type, unsigned int bits, \
+	uint32_t calibration, uint32_t *incmin, uint32_t *decmin)
+{
+	ec_keyctx_t *pubK = NULL, *privK = NULL;
+	ec_count_t  *counter = NULL;
+	unsigned long long int c = 0;
+	uint32_t t0, t1, i;
+	int ok = 0;
+
+	*incmin = *decmin = 0xffffffff;
+
+	if (encounter_keygen(ctx, type, bits, &pubK, &privK) \
+			!= ENCOUNTER_OK) goto end;
+	if (encounter_new_counter(ctx, pubK, &counter) != ENCOUNTER_OK)
+		goto end;
+
+	for (i = 0; i < ROUNDS; ++i) {
+		t0 = HiResTime();
+		if (encounter_inc(ctx, pubK, counter, 1) != ENCOUNTER_OK)
+			goto end;
+		t1 = HiResTime();
+		if (*incmin > (t1-t0-calibration))
+			*incmin = t1-t0 - calibration;
+
+		t0 = HiResTime();
+		if (encounter_decrypt(ctx, counter, privK, &c) \
+				!= ENCOUNTER_OK)
+			goto end;
+		t1 = HiResTime();
+		if (*decmin > (t1-t0-calibration))
+			*decmin = t1-t0 - calibration;
+	}
+	ok = (c == ROUNDS);
+
+end:
+	if (counter) encounter_dispose_counter(ctx, counter);
+	if (pubK) encounter_dispose_keyctx(ctx, pubK);
+	if (privK) encounter_dispose_keyctx(ctx, privK);
+
+	return ok;
+}
+
+/* Best cycles a counter of a decryption batch of BATCH counters under
+ * fresh keys of the given size, 0 on failure */
+int batchBench(encounter_t *ctx, unsigned int bits, uint32_t calibration, \
+							uint32_t *permin)
+{
+	ec_keyctx_t *pubK = NULL, *privK = NULL;
+	ec_count_t  *counters[BATCH];
+	unsigned long long int plain[BATCH];
+	uint32_t t0, t1, i;
+	int ok = 0;
+
+	*permin = 0xffffffff;
+	memset(counters, 0, sizeof counters);
+
+	if (encounter_keygen(ctx, EC_KEYTYPE_PAILLIER_PUBLIC, bits, &pubK, \
+			&privK) != ENCOUNTER_OK) goto end;
+	for (i = 0; i < BATCH; ++i) {
+		if (encounter_new_counter(ctx, pubK, &counters[i]) \
+				!= ENCOUNTER_OK) goto end;
+		if (encounter_inc(ctx, pubK, counters[i], i) != ENCOUNTER_OK)
+			goto end;
+	}
+
+	for (i = 0; i < 3; ++i) {
+		t0 = HiResTime();
+		if (encounter_decrypt_batch(ctx, counters, BATCH, privK, \
+				plain) != ENCOUNTER_OK)
+			goto end;
+		t1 = HiResTime();
+		if (*permin > (t1-t0-calibration) / BATCH)
+			*permin = (t1-t0 - calibration) / BATCH;
+	}
+	ok = (plain[BATCH - 1] == BATCH - 1);
+
+end:
+	for (i = 0; i < BATCH; ++i)
+		if (counters[i]) encounter_dispose_counter(ctx, counters[i]);
+	if (pubK) encounter_dispose_keyctx(ctx, pubK);
+	if (privK) encounter_dispose_keyctx(ctx, privK);
+
+	return ok;
+}
+
 int main(int argc, char *argv[]) 
 {
 	encounter_err_t rc = ENCOUNTER_OK;
-	encounter_t *ctx = NULL;
+	encounter_t *ctx = NULL, *pctx = NULL, *bctx = NULL;
+	encounter_conf_t conf;
 	ec_keyctx_t *pubK = NULL;
 	ec_keyctx_t *privK = NULL;
 	ec_count_t  *encounter = NULL;
@@ -99,6 +192,8 @@ int main(int argc, char *argv[])
 	uint32_t calibration;
 	uint32_t tmin = 0xffffffff;	
 	uint32_t t0, t1, i;
+	uint32_t inc[2], dec[2];
+	unsigned int bits;
 
 	/* Initialize Encounter */
 	rc = encounter_init(0, &ctx);
@@ -144,6 +239,58 @@ int main(int argc, char *argv[])
 	printf("Crypto-counter decryption: succeeded\n");
 	printf("Plaintext counter: %lld\n", c);
 
+	/* Paillier against the subgroup keys: short randomizer exponents
+	 * for the increments, the short alpha for the decryptions */
+	if (!bench(ctx, EC_KEYTYPE_PAILLIER_PUBLIC, KEYSIZE, calibration, \
+			&inc[0], &dec[0]))
+		goto end;
+	if (!bench(ctx, EC_KEYTYPE_PAILLIER_SUBGROUP_PUBLIC, KEYSIZE, \
+			calibration, &inc[1], &dec[1]))
+		goto end;
+
+	printf("Cycles per counter increment, Paillier: %lu, subgroup: %lu\n",\
+			(unsigned long) inc[0], (unsigned long) inc[1]);
+	printf("Cycles per decryption, Paillier: %lu, subgroup: %lu\n", \
+			(unsigned long) dec[0], (unsigned long) dec[1]);
+
+	/* The IFMA kernels, where the CPU has them, against the portable
+	 * Montgomery arithmetic: n^2 from 1024-bit keys on, p^2 and q^2
+	 * from 2048-bit keys on */
+	memset(&conf, 0, sizeof conf);
+	conf.batch_threads = 1;
+	conf.portable_kernels = true;
+	if (encounter_init_conf(0, &conf, &pctx) != ENCOUNTER_OK) goto end;
+
+	for (bits = KEYSIZE; bits <= 2 * KEYSIZE; bits *= 2) {
+		if (!bench(ctx, EC_KEYTYPE_PAILLIER_PUBLIC, bits, \
+				calibration, &inc[0], &dec[0]))
+			goto end;
+		if (!bench(pctx, EC_KEYTYPE_PAILLIER_PUBLIC, bits, \
+				calibration, &inc[1], &dec[1]))
+			goto end;
+
+		printf("Cycles per counter increment at %u bits, " \
+			"kernels: %lu, portable: %lu\n", bits, \
+			(unsigned long) inc[0], (unsigned long) inc[1]);
+		printf("Cycles per decryption at %u bits, " \
+			"kernels: %lu, portable: %lu\n", bits, \
+			(unsigned long) dec[0], (unsigned long) dec[1]);
+	}
+
+	/* Batch decryptions on a single thread: runs of multi-buffer
+	 * exponentiations modulo p^2 and q^2 for the 2048-bit keys */
+	conf.portable_kernels = false;
+	if (encounter_init_conf(0, &conf, &bctx) != ENCOUNTER_OK) goto end;
+
+	if (!batchBench(bctx, 2 * KEYSIZE, calibration, &dec[0]))
+		goto end;
+	if (!batchBench(pctx, 2 * KEYSIZE, calibration, &dec[1]))
+		goto end;
+
+	printf("Cycles a counter of a batch decryption at %u bits, " \
+		"kernels: %lu, portable: %lu\n", 2 * KEYSIZE, \
+		(unsigned long) dec[0], (unsigned long) dec[1]);
+
 
 end:
 	if (ctx) rc = encounter_error(ctx);
@@ -153,6 +300,8 @@ end:
 	if (pubK) encounter_dispose_keyctx(ctx, pubK);
 	if (privK) encounter_dispose_keyctx(ctx, privK);
 	if (ctx) encounter_term(ctx);
+	if (pctx) encounter_term(pctx);
+	if (bctx) encounter_term(bctx);
 
 	return rc;
 